@@ -0,0 +1,141 @@
+# -*- coding: utf-8 -*-
+"""
+@file codec.py
+@brief Giải mã frame telemetry nhị phân (varint + delta) do firmware gửi qua 4G.
+
+Định dạng frame v2 mô tả chi tiết tại src/telemetry_codec.h của firmware (v1 của firmware cũ không có
+epoch/bootId, vẫn nhận với boot_id = None). Frame được nhận trên
+/api/ingest và /api/ingest/batch khi header Content-Type là FRAME_CONTENT_TYPE; kết quả giải mã
+là các dict cùng trường với schemas.ReadingFields nên đi chung đường xử lý với JSON. seq 0 (bản ghi
+chưa qua hàng đợi flash) giải mã thành None để không bị khử trùng, giống JSON bỏ trường "seq".
+"""
+
+FRAME_CONTENT_TYPE = "application/vnd.battery-telemetry"
+FRAME_VERSION = 2
+FRAME_VERSIONS = (1, 2)
+
+# Khớp TLOG_NULL_CENTI (INT16_MIN) của firmware
+NULL_CENTI = -32768
+
+# Khớp enum RiskLevel / TelemetryFlag của firmware
+RISK_LEVEL_NAMES = ("normal", "watch", "warning", "critical")
+FLAG_TEMP_ALERT = 1 << 0
+FLAG_SMOKE_ALERT = 1 << 1
+FLAG_FIRE_ALERT = 1 << 2
+FLAG_TEMP_RISE_ALERT = 1 << 3
+
+
+class FrameError(ValueError):
+    """Frame hỏng, sai phiên bản hoặc bị cắt cụt."""
+
+
+class _Reader:
+    def __init__(self, data: bytes):
+        self.data = data
+        self.pos = 0
+
+    def byte(self) -> int:
+        if self.pos >= len(self.data):
+            raise FrameError("frame bị cắt cụt")
+        b = self.data[self.pos]
+        self.pos += 1
+        return b
+
+    def varint(self) -> int:
+        value = 0
+        for shift in range(0, 35, 7):
+            b = self.byte()
+            value |= (b & 0x7F) << shift
+            if not b & 0x80:
+                return value
+        raise FrameError("varint quá dài")
+
+    def zigzag(self) -> int:
+        v = self.varint()
+        return (v >> 1) ^ -(v & 1)
+
+
+def _centi(value: int):
+    return None if value == NULL_CENTI else value / 100.0
+
+
+def decode_frame(data: bytes):
+    """
+    Giải mã một frame thành (device_id, danh sách bản ghi).
+
+    Args:
+        data (bytes): Body request nguyên bản
+
+    Returns:
+        tuple[str, list[dict]]: device_id và các bản ghi theo thứ tự trong frame
+
+    Raises:
+        FrameError: Frame không hợp lệ
+    """
+    r = _Reader(data)
+    version = r.byte()
+    if version not in FRAME_VERSIONS:
+        raise FrameError(f"không hỗ trợ frame version {version}")
+    id_len = r.byte()
+    if r.pos + id_len > len(data):
+        raise FrameError("frame bị cắt cụt")
+    device_id = data[r.pos:r.pos + id_len].decode("utf-8", errors="replace")
+    r.pos += id_len
+    epoch = r.varint() if version >= 2 else None
+    count = r.varint()
+
+    # Trạng thái tham chiếu cho delta, giống hệt bộ mã hóa
+    prev_seq = prev_boot = prev_age = prev_temp = prev_rise = prev_smoke = prev_fire = 0
+    prev_probes = []
+
+    readings = []
+    for _ in range(count):
+        flags_kind = r.byte()
+        counts = r.byte()
+        risk_score = r.byte()
+        probe_count = counts & 0x0F
+        has_age = bool(flags_kind & 0x80)
+
+        prev_seq = (prev_seq + r.zigzag()) & 0xFFFFFFFF
+        boot_id = None
+        if epoch is not None:
+            prev_boot = (prev_boot + r.zigzag()) & 0xFFFF
+            boot_id = (epoch << 16) | prev_boot  # tlogBootKey() của firmware
+        age_ms = None
+        if has_age:
+            prev_age = (prev_age + r.zigzag()) & 0xFFFFFFFF
+            age_ms = prev_age
+
+        prev_temp += r.zigzag()
+        prev_rise += r.zigzag()
+        probes = []
+        for i in range(probe_count):
+            ref = prev_probes[i] if i < len(prev_probes) else prev_temp
+            probes.append(ref + r.zigzag())
+        prev_probes = probes
+        prev_smoke += r.zigzag()
+        prev_fire += r.zigzag()
+
+        flags = flags_kind & 0x1F
+        reading = {
+            "temperature": prev_temp / 100.0,
+            "probe_temps": [_centi(p) for p in probes],
+            "smoke_value": prev_smoke,
+            "fire_value": prev_fire,
+            "temp_alert": bool(flags & FLAG_TEMP_ALERT),
+            "smoke_alert": bool(flags & FLAG_SMOKE_ALERT),
+            "fire_alert": bool(flags & FLAG_FIRE_ALERT),
+            "temp_rise_alert": bool(flags & FLAG_TEMP_RISE_ALERT),
+            "temp_rise_rate": _centi(prev_rise),
+            "risk_score": risk_score,
+            "risk_level": RISK_LEVEL_NAMES[(counts >> 4) & 0x03],
+            "seq": prev_seq or None,  # 0 = bản ghi khẩn chưa qua log, như JSON không có "seq"
+            "boot_id": boot_id,
+        }
+        if age_ms is not None:
+            reading["age_ms"] = age_ms
+        readings.append(reading)
+
+    if r.pos != len(data):
+        raise FrameError("thừa byte sau bản ghi cuối")
+    return device_id, readings
@@ -10,15 +10,18 @@ Module này cung cấp:
 - Telegram notification khi có cảnh báo
 - Database migration tự động cho SQLite
 """
-from fastapi import FastAPI, Depends, Request, HTTPException, Header, UploadFile, File, Form, BackgroundTasks
+from fastapi import FastAPI, Depends, Request, HTTPException, Header, UploadFile, File, Form, BackgroundTasks, Query
 from fastapi.middleware.cors import CORSMiddleware
-from fastapi.responses import HTMLResponse, FileResponse
+from fastapi.responses import HTMLResponse, FileResponse, Response
+from sqlalchemy import func
 from sqlalchemy.orm import Session
-from . import models, schemas
+from pydantic import ValidationError
+from . import models, schemas, codec
 from .db import get_db, engine
 from fastapi.templating import Jinja2Templates
 import os
 import json
+import time
 from datetime import datetime, timezone, timedelta
 # from typing import Optional  # unused
 import requests
@@ -36,6 +39,9 @@ def ensure_migrations():
     Hàm này chỉ chạy với SQLite, kiểm tra schema hiện tại và thêm các cột:
     - fire_value: Giá trị cảm biến lửa KY-026
     - temp_alert, smoke_alert, fire_alert: Các cờ cảnh báo
+    - temp_rise_alert, temp_rise_rate: Phát hiện tăng nhiệt nhanh
+    - risk_score, risk_level: Điểm/mức rủi ro gộp đa cảm biến
+    - probe_temps: Nhiệt độ từng đầu dò DS18B20 (JSON)
     
     Lưu ý: Với database khác (PostgreSQL, MySQL), dùng migration tool như Alembic.
     """
@@ -57,6 +63,35 @@ def ensure_migrations():
                     if col not in cols:
                         conn.execute(text(f"ALTER TABLE readings ADD COLUMN {col} BOOLEAN"))
                         print(f" Added column {col} to readings")
+
+                # Thêm cột nhiệt độ từng đầu dò nếu chưa có
+                if "probe_temps" not in cols:
+                    conn.execute(text("ALTER TABLE readings ADD COLUMN probe_temps JSON"))
+                    print(" Added column probe_temps to readings")
+
+                # Thêm cột phát hiện tăng nhiệt nhanh (thermal runaway) nếu chưa có
+                if "temp_rise_alert" not in cols:
+                    conn.execute(text("ALTER TABLE readings ADD COLUMN temp_rise_alert BOOLEAN"))
+                    print(" Added column temp_rise_alert to readings")
+                if "temp_rise_rate" not in cols:
+                    conn.execute(text("ALTER TABLE readings ADD COLUMN temp_rise_rate FLOAT"))
+                    print(" Added column temp_rise_rate to readings")
+
+                # Thêm cột điểm/mức rủi ro gộp đa cảm biến nếu chưa có
+                if "risk_score" not in cols:
+                    conn.execute(text("ALTER TABLE readings ADD COLUMN risk_score INTEGER"))
+                    print(" Added column risk_score to readings")
+                if "risk_level" not in cols:
+                    conn.execute(text("ALTER TABLE readings ADD COLUMN risk_level VARCHAR(16)"))
+                    print(" Added column risk_level to readings")
+
+                # Thêm cột số thứ tự store-and-forward nếu chưa có
+                if "seq" not in cols:
+                    conn.execute(text("ALTER TABLE readings ADD COLUMN seq BIGINT"))
+                    print(" Added column seq to readings")
+                if "boot_id" not in cols:
+                    conn.execute(text("ALTER TABLE readings ADD COLUMN boot_id BIGINT"))
+                    print(" Added column boot_id to readings")
     except Exception as e:
         print(f" Migration check failed: {e}")
 
@@ -233,7 +268,7 @@ def format_alert_message(payload: schemas.IngestRequest, server_timestamp: int)
     - Danh sách modules đang cảnh báo
     
     Args:
-        payload (schemas.IngestRequest): Dữ liệu cảm biến từ ESP32
+        payload (schemas.IngestRequest): Dữ liệu cảm biến từ ESP32 (JSON hoặc frame nhị phân, xem codec.py)
         server_timestamp (int): Unix timestamp từ server
         
     Returns:
@@ -246,6 +281,8 @@ def format_alert_message(payload: schemas.IngestRequest, server_timestamp: int)
     modules = []
     if payload.temp_alert:
         modules.append("NHIET DO")
+    if payload.temp_rise_alert:
+        modules.append("TANG NHIET NHANH")
     if payload.smoke_alert:
         modules.append("MQ-135")
     if payload.fire_alert:
@@ -257,6 +294,19 @@ def format_alert_message(payload: schemas.IngestRequest, server_timestamp: int)
         f"Device: <code>{payload.device_id}</code>",
         f"Thoi gian (UTC+7): {time_str}",
         f"Nhiet do: <b>{payload.temperature:.1f} C</b>",
+    ]
+    if payload.risk_level:
+        lines.insert(1, f"Muc rui ro: <b>{payload.risk_level.upper()}</b> ({payload.risk_score if payload.risk_score is not None else '-'}/100)")
+    # Liệt kê từng đầu dò để biết cell nào đang nóng
+    if payload.probe_temps:
+        probes = ", ".join(
+            f"#{i}: {t:.1f}" if t is not None else f"#{i}: --"
+            for i, t in enumerate(payload.probe_temps)
+        )
+        lines.append(f"Dau do (C): {probes}")
+    if payload.temp_rise_rate is not None:
+        lines.append(f"Toc do tang nhiet: <b>{payload.temp_rise_rate:.2f} C/phut</b>")
+    lines += [
         f"MQ-135: <b>{payload.smoke_value}</b>",
         f"KY-026 (10-bit): <b>{payload.fire_value}</b>",
         f"Modules: {', '.join(modules) if modules else 'NONE'}",
@@ -340,12 +390,134 @@ def debug_dashboard(request: Request, db: Session = Depends(get_db)):
 # REST API Endpoints: Nhận và truy vấn dữ liệu cảm biến
 # --------------------------------------------------------------------
 
+# Thống kê ingest từ lúc server khởi động, xem /api/ingest/stats
+ingest_stats = {
+    "started_at": time.time(),
+    "requests": 0,          # POST /api/ingest
+    "batch_requests": 0,    # POST /api/ingest/batch
+    "inserted": 0,
+    "duplicates": 0,
+    "commit_seconds": 0.0,  # Tổng thời gian ghi DB (add + commit)
+}
+
+# Cửa sổ khử trùng seq: thiết bị gửi at-least-once nên có thể gửi lại bản ghi đã nhận
+DEDUPE_WINDOW_SECONDS = 86400
+
+
+def reading_timestamp(reading: schemas.ReadingFields, now: int) -> int:
+    """
+    Tính timestamp của bản ghi theo giờ server (không dùng timestamp từ ESP32 để đảm bảo đồng bộ).
+    
+    Bản ghi gửi bù từ hàng đợi flash mang age_ms: lùi về đúng lúc thiết bị lấy mẫu.
+    """
+    if reading.age_ms:
+        return now - reading.age_ms // 1000
+    return now
+
+
+def existing_keys(db: Session, device_id: str, keys: list, since: int) -> dict:
+    """
+    Tìm các khóa (boot_id, seq) đã có trong DB của thiết bị (trong cửa sổ khử trùng).
+    
+    seq chỉ duy nhất trong một boot_id (epoch NVS + bộ đếm boot, xem tlogBootKey() của firmware): thiết bị
+    bị xóa NVS đếm seq lại từ 1 nhưng mang epoch mới nên không bị coi là trùng với bản ghi cũ. Firmware
+    cũ không gửi boot_id: khớp với bản ghi boot_id null như trước.
+    
+    Returns:
+        dict: (boot_id, seq) -> id bản ghi đã có
+    """
+    if not keys:
+        return {}
+    rows = (
+        db.query(models.Reading.boot_id, models.Reading.seq, models.Reading.id)
+        .filter(
+            models.Reading.device_id == device_id,
+            models.Reading.seq.in_({seq for _, seq in keys}),
+            models.Reading.timestamp >= since,
+        )
+        .all()
+    )
+    wanted = set(keys)
+    return {(row.boot_id, row.seq): row.id for row in rows if (row.boot_id, row.seq) in wanted}
+
+
+def make_reading(device_id: str, reading: schemas.ReadingFields, timestamp: int) -> models.Reading:
+    """Tạo entity Reading từ các trường đo của một bản ghi."""
+    return models.Reading(
+        device_id=device_id,
+        timestamp=timestamp,
+        temperature=reading.temperature,
+        probe_temps=reading.probe_temps,
+        smoke_value=reading.smoke_value,
+        fire_value=reading.fire_value,
+        temp_alert=reading.temp_alert,
+        smoke_alert=reading.smoke_alert,
+        fire_alert=reading.fire_alert,
+        temp_rise_alert=reading.temp_rise_alert,
+        temp_rise_rate=reading.temp_rise_rate,
+        risk_score=reading.risk_score,
+        risk_level=reading.risk_level,
+        seq=reading.seq,
+        boot_id=reading.boot_id,
+    )
+
+
+def reading_needs_alert(reading: schemas.ReadingFields) -> bool:
+    """Bản ghi có module nào cảnh báo hoặc mức rủi ro warning/critical không."""
+    return bool(reading.temp_alert or reading.smoke_alert or reading.fire_alert or reading.temp_rise_alert
+                or reading.risk_level in ("warning", "critical"))
+
+
+async def read_ingest_body(request: Request):
+    """
+    Đọc body ingest theo Content-Type: frame nhị phân (codec.FRAME_CONTENT_TYPE) hoặc JSON.
+
+    Returns:
+        tuple[str | None, list[dict] | dict]: (device_id, các bản ghi) nếu là frame, (None, JSON) nếu là JSON
+
+    Raises:
+        HTTPException: 400 nếu frame hoặc JSON không hợp lệ
+    """
+    body = await request.body()
+    content_type = request.headers.get("content-type", "").split(";")[0].strip().lower()
+    try:
+        if content_type == codec.FRAME_CONTENT_TYPE:
+            return codec.decode_frame(body)
+        return None, json.loads(body)
+    except (codec.FrameError, ValueError) as e:
+        raise HTTPException(status_code=400, detail=f"Invalid body: {e}")
+
+
+async def ingest_payload(request: Request) -> schemas.IngestRequest:
+    """Dependency cho /api/ingest: một bản ghi JSON hoặc frame nhị phân chứa đúng một bản ghi."""
+    device_id, data = await read_ingest_body(request)
+    try:
+        if device_id is None:
+            return schemas.IngestRequest.model_validate(data)
+        if len(data) != 1:
+            raise HTTPException(status_code=400, detail="Frame for /api/ingest must hold exactly one reading")
+        return schemas.IngestRequest(device_id=device_id, **data[0])
+    except ValidationError as e:
+        raise HTTPException(status_code=422, detail=e.errors())
+
+
+async def ingest_batch_payload(request: Request) -> schemas.IngestBatchRequest:
+    """Dependency cho /api/ingest/batch: lô JSON {device_id, readings} hoặc frame nhị phân."""
+    device_id, data = await read_ingest_body(request)
+    try:
+        if device_id is None:
+            return schemas.IngestBatchRequest.model_validate(data)
+        return schemas.IngestBatchRequest(device_id=device_id, readings=data)
+    except ValidationError as e:
+        raise HTTPException(status_code=422, detail=e.errors())
+
+
 @app.post("/api/ingest", response_model=schemas.IngestResponse)
 def ingest(
-    payload: schemas.IngestRequest,
     background_tasks: BackgroundTasks,
+    api_key: str = Depends(verify_api_key),
+    payload: schemas.IngestRequest = Depends(ingest_payload),
     db: Session = Depends(get_db),
-    api_key: str = Depends(verify_api_key)
 ):
     """
     Endpoint chính để ESP32 gửi dữ liệu cảm biến lên server.
@@ -354,10 +526,10 @@ def ingest(
     1. Nhận dữ liệu từ ESP32 (temperature, smoke_value, fire_value, alerts)
     2. Tạo timestamp từ server (không dùng timestamp từ ESP32 để đảm bảo đồng bộ)
     3. Lưu vào database
-    4. Nếu có cảnh báo (temp_alert, smoke_alert, fire_alert), gửi Telegram bất đồng bộ
+    4. Nếu có cảnh báo (temp_alert, smoke_alert, fire_alert, temp_rise_alert), gửi Telegram bất đồng bộ
     
     Args:
-        payload (schemas.IngestRequest): Dữ liệu cảm biến từ ESP32
+        payload (schemas.IngestRequest): Dữ liệu cảm biến từ ESP32 (JSON hoặc frame nhị phân, xem codec.py)
         background_tasks (BackgroundTasks): FastAPI background tasks để gửi Telegram
         db (Session): Database session
         api_key (str): API key đã được verify
@@ -365,27 +537,29 @@ def ingest(
     Returns:
         schemas.IngestResponse: ID của bản ghi vừa tạo và status "ok"
     """
-    # Lấy thời gian server thay vì dùng timestamp từ ESP32 (đảm bảo đồng bộ)
-    server_timestamp = int(datetime.now().timestamp())
-    
+    ingest_stats["requests"] += 1
+    server_timestamp = reading_timestamp(payload, int(datetime.now().timestamp()))
+
+    # Thiết bị gửi at-least-once: bỏ qua bản ghi trùng (boot_id, seq) trong 24 giờ gần nhất
+    if payload.seq is not None:
+        key = (payload.boot_id, payload.seq)
+        existing = existing_keys(db, payload.device_id, [key], server_timestamp - DEDUPE_WINDOW_SECONDS)
+        if key in existing:
+            ingest_stats["duplicates"] += 1
+            return schemas.IngestResponse(id=existing[key], status="duplicate")
+
     # Tạo entity mới từ payload
-    entity = models.Reading(
-        device_id=payload.device_id,
-        timestamp=server_timestamp,  # Sử dụng thời gian server
-        temperature=payload.temperature,
-        smoke_value=payload.smoke_value,
-        fire_value=payload.fire_value,
-        temp_alert=payload.temp_alert,
-        smoke_alert=payload.smoke_alert,
-        fire_alert=payload.fire_alert,
-    )
+    entity = make_reading(payload.device_id, payload, server_timestamp)
+    t0 = time.perf_counter()
     db.add(entity)
     db.commit()
+    ingest_stats["commit_seconds"] += time.perf_counter() - t0
+    ingest_stats["inserted"] += 1
     db.refresh(entity)
 
     # Gửi cảnh báo Telegram bất đồng bộ nếu có bất kỳ module nào cảnh báo
     try:
-        if payload.temp_alert or payload.smoke_alert or payload.fire_alert:
+        if reading_needs_alert(payload):
             message = format_alert_message(payload, server_timestamp)
             background_tasks.add_task(send_telegram_message, message)
     except Exception as e:
@@ -395,6 +569,135 @@ def ingest(
     return schemas.IngestResponse(id=entity.id, status="ok")
 
 
+@app.post("/api/ingest/batch", response_model=schemas.IngestBatchResponse)
+def ingest_batch(
+    background_tasks: BackgroundTasks,
+    api_key: str = Depends(verify_api_key),
+    payload: schemas.IngestBatchRequest = Depends(ingest_batch_payload),
+    db: Session = Depends(get_db),
+):
+    """
+    Nhận nhiều bản ghi của một thiết bị trong một request (firmware gom lô từ hàng đợi flash).
+    Body là JSON {device_id, readings} hoặc frame nhị phân theo Content-Type (xem codec.py).
+    
+    Quy trình:
+    1. Tính timestamp từng bản ghi theo age_ms
+    2. Khử trùng (boot_id, seq) bằng một truy vấn cho cả lô (và trong chính lô)
+    3. Ghi mọi bản ghi mới trong một transaction: lỗi thì không ghi gì, thiết bị sẽ gửi lại cả lô
+    4. Gửi một tin Telegram cho bản ghi cảnh báo mới nhất trong lô (tránh spam khi gửi bù)
+    
+    Returns:
+        schemas.IngestBatchResponse: Số bản ghi đã thêm và số bản ghi trùng
+    """
+    ingest_stats["batch_requests"] += 1
+    now = int(datetime.now().timestamp())
+    timestamps = [reading_timestamp(r, now) for r in payload.readings]
+
+    keys = [(r.boot_id, r.seq) for r in payload.readings if r.seq is not None]
+    since = (min(timestamps) if timestamps else now) - DEDUPE_WINDOW_SECONDS
+    seen = set(existing_keys(db, payload.device_id, keys, since))
+
+    entities = []
+    duplicates = 0
+    alert_reading = None
+    for reading, ts in zip(payload.readings, timestamps):
+        if reading.seq is not None:
+            key = (reading.boot_id, reading.seq)
+            if key in seen:
+                duplicates += 1
+                continue
+            seen.add(key)
+        entities.append(make_reading(payload.device_id, reading, ts))
+        if reading_needs_alert(reading):
+            alert_reading = (reading, ts)
+
+    t0 = time.perf_counter()
+    try:
+        db.add_all(entities)
+        db.commit()
+    except Exception:
+        db.rollback()
+        raise
+    ingest_stats["commit_seconds"] += time.perf_counter() - t0
+    ingest_stats["inserted"] += len(entities)
+    ingest_stats["duplicates"] += duplicates
+
+    if alert_reading is not None:
+        try:
+            reading, ts = alert_reading
+            alert_payload = schemas.IngestRequest(device_id=payload.device_id, **reading.model_dump())
+            background_tasks.add_task(send_telegram_message, format_alert_message(alert_payload, ts))
+        except Exception as e:
+            print(f" Failed to schedule Telegram alert: {e}")
+
+    print(f" Received batch of {len(payload.readings)} from {payload.device_id} "
+          f"({len(entities)} new, {duplicates} duplicate) at {datetime.now().strftime('%Y-%m-%d %H:%M:%S')}")
+    return schemas.IngestBatchResponse(status="ok", inserted=len(entities), duplicates=duplicates)
+
+
+@app.get("/api/ping", status_code=204)
+def ping():
+    """
+    Heartbeat của socket cảnh báo khẩn trên firmware (giữ kết nối 4G/NAT sống).
+    
+    Trả 204 không body, không chạm DB để mỗi lần chỉ tốn vài chục byte.
+    """
+    return Response(status_code=204)
+
+
+BENCH_MAX_BYTES = 4 * 1024 * 1024
+
+
+@app.get("/api/bench/download")
+def bench_download(size: int = Query(65536, alias="bytes"), api_key: str = Depends(verify_api_key)):
+    """
+    Trả đúng `?bytes=` byte để firmware đo thông lượng tải xuống (so sánh PPP và socket AT trên 4G).
+
+    Dữ liệu là mẫu lặp cố định, không chạm DB; giới hạn BENCH_MAX_BYTES.
+    """
+    if size < 1 or size > BENCH_MAX_BYTES:
+        raise HTTPException(status_code=400, detail=f"bytes phải trong 1..{BENCH_MAX_BYTES}")
+    pattern = b"0123456789abcdef" * 64
+    body = (pattern * (size // len(pattern) + 1))[:size]
+    return Response(content=body, media_type="application/octet-stream")
+
+
+@app.post("/api/bench/upload")
+async def bench_upload(request: Request, api_key: str = Depends(verify_api_key)):
+    """
+    Nhận body bất kỳ (đo thông lượng tải lên), chỉ trả lại số byte đã nhận.
+    """
+    received = 0
+    async for chunk in request.stream():
+        received += len(chunk)
+        if received > BENCH_MAX_BYTES:
+            raise HTTPException(status_code=413, detail="Body quá lớn")
+    return {"received": received}
+
+
+@app.get("/api/ingest/stats")
+def ingest_statistics():
+    """
+    Thống kê ingest từ lúc server khởi động: số request, số bản ghi và tốc độ ghi DB.
+    
+    - inserts_per_sec: bản ghi mới trên mỗi giây chạy (tải trung bình)
+    - inserts_per_commit_sec: bản ghi trên mỗi giây thực sự nằm trong add/commit (thông lượng ghi)
+    """
+    uptime = max(time.time() - ingest_stats["started_at"], 1e-6)
+    requests_total = ingest_stats["requests"] + ingest_stats["batch_requests"]
+    return {
+        "uptime_seconds": int(uptime),
+        "requests": ingest_stats["requests"],
+        "batch_requests": ingest_stats["batch_requests"],
+        "inserted": ingest_stats["inserted"],
+        "duplicates": ingest_stats["duplicates"],
+        "readings_per_request": ingest_stats["inserted"] / requests_total if requests_total else 0,
+        "inserts_per_sec": ingest_stats["inserted"] / uptime,
+        "inserts_per_commit_sec": (ingest_stats["inserted"] / ingest_stats["commit_seconds"]
+                                   if ingest_stats["commit_seconds"] > 0 else 0),
+    }
+
+
 @app.get("/api/readings", response_model=list[schemas.ReadingOut])
 def list_readings(limit: int = 100, db: Session = Depends(get_db)):
     """
@@ -517,32 +820,82 @@ def check_firmware_update(current_version: str, device_id: str = "battery_monito
         return {"update_available": False, "error": str(e)}
 
 
+def parse_byte_range(range_header: str, size: int):
+    """
+    Tách header "Range: bytes=start-end" (một khoảng; "start-" và "-suffix" cũng được).
+
+    Returns:
+        tuple: (start, end) đã kẹp trong file, hoặc None nếu không thỏa được (→ 416)
+    """
+    unit, _, spec = range_header.partition("=")
+    if unit.strip().lower() != "bytes" or "," in spec:
+        return None
+    first, _, last = spec.strip().partition("-")
+    try:
+        if first == "":
+            suffix = int(last)
+            if suffix <= 0:
+                return None
+            return max(size - suffix, 0), size - 1
+        start = int(first)
+        end = int(last) if last else size - 1
+    except ValueError:
+        return None
+    if start >= size or end < start:
+        return None
+    return start, min(end, size - 1)
+
+
 @app.get("/api/firmware/download/{version}")
-def download_firmware(version: str):
+def download_firmware(version: str, range_header: str = Header(None, alias="Range")):
     """
     Tải file firmware binary để ESP32 cập nhật OTA.
     
     ESP32 gọi endpoint này sau khi phát hiện có firmware mới từ /api/firmware/check.
     Server trả về file .bin với media type application/octet-stream.
+    Có header Range thì chỉ trả khoảng byte đó (206 + Content-Range): ESP32 tải theo từng chunk
+    cố định và tải tiếp từ chỗ đã ghi sau khi rớt mạng/khởi động lại.
     
     Args:
         version (str): Phiên bản firmware (ví dụ: "1.0.0")
+        range_header (str): Header Range, ví dụ "bytes=32768-65535"
         
     Returns:
-        FileResponse: File firmware binary
+        FileResponse: File firmware binary, hoặc Response 206 với khoảng được yêu cầu
         
     Raises:
-        HTTPException: 404 nếu file không tồn tại
+        HTTPException: 404 nếu file không tồn tại, 416 nếu khoảng nằm ngoài file
     """
     firmware_file = f"firmware/battery_monitor_v{version}.bin"
     
     if not os.path.exists(firmware_file):
         raise HTTPException(status_code=404, detail="Firmware not found")
     
-    return FileResponse(
-        firmware_file,
+    if range_header is None:
+        return FileResponse(
+            firmware_file,
+            media_type="application/octet-stream",
+            filename=f"battery_monitor_v{version}.bin",
+            headers={"Accept-Ranges": "bytes"}
+        )
+    
+    size = os.path.getsize(firmware_file)
+    byte_range = parse_byte_range(range_header, size)
+    if byte_range is None:
+        raise HTTPException(
+            status_code=416,
+            detail="Range not satisfiable",
+            headers={"Content-Range": f"bytes */{size}"}
+        )
+    start, end = byte_range
+    with open(firmware_file, "rb") as f:
+        f.seek(start)
+        content = f.read(end - start + 1)
+    return Response(
+        content=content,
+        status_code=206,
         media_type="application/octet-stream",
-        filename=f"battery_monitor_v{version}.bin"
+        headers={"Content-Range": f"bytes {start}-{end}/{size}", "Accept-Ranges": "bytes"}
     )
 
 
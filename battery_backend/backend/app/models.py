@@ -6,7 +6,7 @@
 Mỗi model tương ứng với một bảng trong database, định nghĩa cấu trúc dữ liệu
 và các ràng buộc (constraints, indexes, defaults).
 """
-from sqlalchemy import Column, Integer, String, Float, Boolean, DateTime, BigInteger, func
+from sqlalchemy import Column, Integer, String, Float, Boolean, DateTime, BigInteger, JSON, func
 from .db import Base
 
 
@@ -23,12 +23,19 @@ class Reading(Base):
         id (int): Primary key, tự động tăng
         device_id (str): ID của thiết bị ESP32 (tối đa 64 ký tự, có index)
         timestamp (int): Unix timestamp (BigInteger, có index) - hiện dùng thời gian server
-        temperature (float): Nhiệt độ đo được từ DS18B20 (°C)
+        temperature (float): Nhiệt độ đo được từ DS18B20 (°C) - đầu dò nóng nhất
+        probe_temps (list): Nhiệt độ từng đầu dò DS18B20 theo thứ tự ROM (null nếu đầu dò lỗi)
         smoke_value (int): Giá trị ADC từ cảm biến MQ-135 (0-4095, 12-bit)
         fire_value (int): Giá trị ADC từ cảm biến KY-026 (0-1023, 10-bit)
         temp_alert (bool): Cờ cảnh báo nhiệt độ cao (mặc định False)
         smoke_alert (bool): Cờ cảnh báo khí độc (mặc định False)
         fire_alert (bool): Cờ cảnh báo lửa (mặc định False)
+        temp_rise_alert (bool): Cờ cảnh báo nhiệt độ tăng nhanh (thermal runaway)
+        temp_rise_rate (float): Tốc độ tăng nhiệt lớn nhất trong các đầu dò (°C/phút)
+        risk_score (int): Điểm rủi ro gộp đa cảm biến (0-100)
+        risk_level (str): Mức rủi ro: normal / watch / warning / critical
+        seq (int): Số thứ tự bản ghi trong hàng đợi flash của thiết bị (khử trùng khi gửi lại)
+        boot_id (int): Epoch NVS + bộ đếm boot của bản ghi, cùng seq tạo khóa khử trùng
         smoke_connected (bool): Trạng thái kết nối MQ-135 (legacy, có thể null)
         mq2_preheated (bool): Trạng thái preheat MQ-2 (legacy, có thể null)
         fire_detected (bool): Trạng thái phát hiện lửa (legacy, có thể null)
@@ -48,7 +55,8 @@ class Reading(Base):
     timestamp = Column(BigInteger, index=True)
     
     # Dữ liệu cảm biến
-    temperature = Column(Float)  # Nhiệt độ từ DS18B20 (°C)
+    temperature = Column(Float)  # Nhiệt độ từ DS18B20 (°C), đầu dò nóng nhất
+    probe_temps = Column(JSON)  # Danh sách nhiệt độ từng đầu dò (°C), có thể null
     smoke_value = Column(Integer)  # Giá trị MQ-135 (0-4095)
     fire_value = Column(Integer)  # Giá trị KY-026 (0-1023, 10-bit)
     
@@ -56,6 +64,12 @@ class Reading(Base):
     temp_alert = Column(Boolean, default=False)
     smoke_alert = Column(Boolean, default=False)
     fire_alert = Column(Boolean, default=False)
+    temp_rise_alert = Column(Boolean, default=False)  # Tốc độ tăng nhiệt vượt ngưỡng °C/phút
+    temp_rise_rate = Column(Float)  # °C/phút, null nếu firmware cũ hoặc chưa đủ cửa sổ
+    risk_score = Column(Integer)  # Điểm rủi ro gộp 0-100 (firmware tính)
+    risk_level = Column(String(16), index=True)  # normal / watch / warning / critical
+    seq = Column(BigInteger, index=True)  # Số thứ tự store-and-forward, null với firmware cũ
+    boot_id = Column(BigInteger)  # Khóa kỷ nguyên của seq (epoch << 16 | boot), null với firmware cũ
     
     # Các trường legacy (có thể null, không dùng trong logic mới)
     smoke_connected = Column(Boolean)
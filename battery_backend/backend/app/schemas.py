@@ -9,33 +9,57 @@ Schemas đảm bảo:
 - Type safety và auto-documentation cho FastAPI
 """
 from pydantic import BaseModel
-from typing import Optional
+from typing import List, Optional
 from datetime import datetime
 
 
-class IngestRequest(BaseModel):
+class ReadingFields(BaseModel):
     """
-    Schema cho request POST /api/ingest từ ESP32.
-    
-    ESP32 gửi dữ liệu cảm biến lên server, server sẽ tự tạo timestamp.
+    Các trường đo của một bản ghi, dùng chung cho POST /api/ingest và từng phần tử của /api/ingest/batch.
     
     Attributes:
         timestamp (Optional[int]): Unix timestamp từ ESP32 (không bắt buộc, server tự tạo)
-        temperature (float): Nhiệt độ từ DS18B20 (°C)
+        temperature (float): Nhiệt độ từ DS18B20 (°C), đầu dò nóng nhất
+        probe_temps (Optional[List[Optional[float]]]): Nhiệt độ từng đầu dò (null nếu đầu dò lỗi)
         smoke_value (int): Giá trị ADC từ MQ-135 (0-4095)
         fire_value (int): Giá trị ADC từ KY-026 (0-1023, 10-bit)
         temp_alert (bool): Cờ cảnh báo nhiệt độ cao (mặc định False)
         smoke_alert (bool): Cờ cảnh báo khí độc (mặc định False)
         fire_alert (bool): Cờ cảnh báo lửa (mặc định False)
-        device_id (str): ID của thiết bị ESP32 (bắt buộc)
+        temp_rise_alert (bool): Cờ cảnh báo nhiệt độ tăng nhanh (mặc định False)
+        temp_rise_rate (Optional[float]): Tốc độ tăng nhiệt lớn nhất (°C/phút)
+        risk_score (Optional[int]): Điểm rủi ro gộp (0-100)
+        risk_level (Optional[str]): Mức rủi ro (normal / watch / warning / critical)
+        seq (Optional[int]): Số thứ tự bản ghi trong hàng đợi flash của thiết bị
+        boot_id (Optional[int]): Epoch NVS + bộ đếm boot của bản ghi; seq chỉ duy nhất trong một boot_id
+        age_ms (Optional[int]): Tuổi bản ghi lúc gửi (ms), dùng để lùi timestamp khi gửi bù
     """
     timestamp: Optional[int] = None  # Không bắt buộc, server sẽ tự tạo
     temperature: float
+    probe_temps: Optional[List[Optional[float]]] = None  # Firmware cũ không gửi trường này
     smoke_value: int
     fire_value: int  # KY-026 10-bit (0..1023)
     temp_alert: bool = False
     smoke_alert: bool = False
     fire_alert: bool = False
+    temp_rise_alert: bool = False
+    temp_rise_rate: Optional[float] = None  # Null khi firmware chưa đủ cửa sổ đo
+    risk_score: Optional[int] = None
+    risk_level: Optional[str] = None
+    seq: Optional[int] = None
+    boot_id: Optional[int] = None  # Firmware cũ không gửi: khử trùng chỉ theo seq
+    age_ms: Optional[int] = None  # Chỉ có khi bản ghi cùng lần boot với lúc gửi
+
+
+class IngestRequest(ReadingFields):
+    """
+    Schema cho request POST /api/ingest từ ESP32: một bản ghi (xem ReadingFields) kèm device_id.
+    
+    ESP32 gửi dữ liệu cảm biến lên server, server sẽ tự tạo timestamp.
+    
+    Attributes:
+        device_id (str): ID của thiết bị ESP32 (bắt buộc)
+    """
     device_id: str
 
 
@@ -51,6 +75,32 @@ class IngestResponse(BaseModel):
     status: str
 
 
+class IngestBatchRequest(BaseModel):
+    """
+    Schema cho request POST /api/ingest/batch: nhiều bản ghi của cùng một thiết bị trong một request.
+    
+    Attributes:
+        device_id (str): ID của thiết bị ESP32 (gửi một lần cho cả lô)
+        readings (List[ReadingFields]): Các bản ghi theo thứ tự cũ nhất trước
+    """
+    device_id: str
+    readings: List[ReadingFields]
+
+
+class IngestBatchResponse(BaseModel):
+    """
+    Schema cho response từ POST /api/ingest/batch.
+    
+    Attributes:
+        status (str): "ok" nếu cả lô đã được ghi (kể cả bản ghi trùng bị bỏ qua)
+        inserted (int): Số bản ghi mới được thêm
+        duplicates (int): Số bản ghi trùng seq bị bỏ qua
+    """
+    status: str
+    inserted: int
+    duplicates: int
+
+
 class ReadingOut(BaseModel):
     """
     Schema cho response khi trả về dữ liệu cảm biến từ database.
@@ -63,22 +113,32 @@ class ReadingOut(BaseModel):
         device_id (str): ID thiết bị
         timestamp (int): Unix timestamp (server tạo)
         temperature (float): Nhiệt độ (°C)
+        probe_temps (Optional[List[Optional[float]]]): Nhiệt độ từng đầu dò
         smoke_value (int): Giá trị MQ-135
         fire_value (int): Giá trị KY-026 (10-bit)
         temp_alert (bool): Cờ cảnh báo nhiệt độ
         smoke_alert (bool): Cờ cảnh báo khí độc
         fire_alert (bool): Cờ cảnh báo lửa
+        temp_rise_alert (Optional[bool]): Cờ cảnh báo nhiệt độ tăng nhanh
+        temp_rise_rate (Optional[float]): Tốc độ tăng nhiệt (°C/phút)
+        risk_score (Optional[int]): Điểm rủi ro gộp
+        risk_level (Optional[str]): Mức rủi ro
         created_at (datetime): Thời gian tạo bản ghi (UTC)
     """
     id: int
     device_id: str
     timestamp: int  # Unix timestamp (hiện đang dùng thời gian server)
     temperature: float
+    probe_temps: Optional[List[Optional[float]]] = None
     smoke_value: int
     fire_value: int
     temp_alert: bool
     smoke_alert: bool
     fire_alert: bool
+    temp_rise_alert: Optional[bool] = None  # Bản ghi cũ trước migration là null
+    temp_rise_rate: Optional[float] = None
+    risk_score: Optional[int] = None
+    risk_level: Optional[str] = None
     created_at: datetime
 
     class Config:
@@ -0,0 +1,115 @@
+# -*- coding: utf-8 -*-
+"""
+@file bench_cell_datapath.py
+@brief So sánh thông lượng 4G giữa socket AT (TinyGSM, CELL_DATA_MODE_AT) và PPPoS (CELL_DATA_MODE_PPP)
+trên đường truyền giả lập, với cùng hai request như /api/cell-bench của firmware: tải xuống
+/api/bench/download và tải lên /api/bench/upload của backend thật.
+
+Mô hình (RTT LTE `--rtt-ms`, UART ở CELL_BAUD và CELL_BAUD_MAX):
+- AT: TCP chạy trên modem, byte qua UART trong lệnh AT. Đọc: mỗi lượt TinyGSM hỏi AT+CIPRXGET=4 rồi
+  đọc tối đa TINY_GSM_RX_BUFFER byte bằng AT+CIPRXGET=2; ghi: AT+CIPSEND từng đoạn, chờ '>' và
+  "+CIPSEND:". Mỗi lệnh tốn AT_TURNAROUND_S trên modem cộng byte lệnh/phản hồi trên UART, không chồng lấn.
+- PPP: TCP chạy trên lwIP của ESP32, UART chở liên tục khung PPP (IP/TCP + HDLC, escape 0x7E/0x7D),
+  cửa sổ TCP mặc định của lwIP (TCP_WND/TCP_SND_BUF 5744, MSS 1436) giới hạn byte đang bay.
+
+Chạy từ battery_backend/backend: python bench/bench_cell_datapath.py [--kb 64] [--rtt-ms 120]
+"""
+
+import argparse
+import contextlib
+import io
+import os
+import sys
+import time
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+
+from http_wire import LteProxy, WireClient, start_backend  # noqa: E402
+
+CELL_BAUDS = (115200, 921600)       # CELL_BAUD, CELL_BAUD_MAX
+TINY_GSM_RX_BUFFER = 1024
+CIPSEND_CHUNK = 1460
+AT_TURNAROUND_S = 0.005             # Modem xử lý một lệnh AT tới khi bắt đầu trả lời
+LWIP_TCP_WND = 5744
+LWIP_TCP_MSS = 1436
+UPLOAD_MAX_BYTES = 32768            # CELL_BENCH_UPLOAD_MAX_BYTES
+
+# Byte lệnh/phản hồi AT quanh dữ liệu (SIM7600, mux 0)
+CIPRXGET_QUERY_BYTES = len("AT+CIPRXGET=4,0\r") + len("\r\n+CIPRXGET: 4,0,1024\r\n\r\nOK\r\n")
+CIPRXGET_READ_BYTES = len("AT+CIPRXGET=2,0,1024\r") + len("\r\n+CIPRXGET: 2,0,1024,0\r\n") + len("\r\nOK\r\n")
+CIPSEND_BYTES = len("AT+CIPSEND=0,1460\r") + len("\r\n>") + len("\r\nOK\r\n\r\n+CIPSEND: 0,1460,1460\r\n")
+
+
+def uart_s(nbytes: int, baud: int) -> float:
+    return nbytes * 10 / baud  # 8N1
+
+
+def ppp_wire_bytes(segment: bytes) -> int:
+    """Byte trên UART của một đoạn TCP trong khung PPP: IP+TCP 40, HDLC (cờ, địa chỉ, điều khiển, giao thức,
+    FCS, cờ) 8, và escape cho 0x7E/0x7D (ACCM = 0 sau LCP)."""
+    return len(segment) + 40 + 8 + segment.count(b"\x7e") + segment.count(b"\x7d")
+
+
+class AtSocketClient(WireClient):
+    """Client đi qua socket AT của modem: byte tới ESP32 theo từng lượt lệnh AT nối tiếp nhau."""
+
+    def __init__(self, port: int, baud: int):
+        super().__init__(port)
+        self.baud = baud
+
+    def _send(self, raw: bytes):
+        for off in range(0, len(raw), CIPSEND_CHUNK):
+            chunk = raw[off:off + CIPSEND_CHUNK]
+            time.sleep(2 * AT_TURNAROUND_S + uart_s(CIPSEND_BYTES + len(chunk), self.baud))
+            self.sock.sendall(chunk)
+
+    def _recv(self, max_bytes: int) -> bytes:
+        chunk = self.sock.recv(min(max_bytes, TINY_GSM_RX_BUFFER))
+        if chunk:
+            time.sleep(2 * AT_TURNAROUND_S + uart_s(CIPRXGET_QUERY_BYTES + CIPRXGET_READ_BYTES + len(chunk), self.baud))
+        return chunk
+
+
+def measure(client: WireClient, download_bytes: int, upload_bytes: int) -> tuple:
+    """Giống cellularBenchTask(): một lượt tải xuống, một lượt tải lên. Trả (kbit/s xuống, kbit/s lên)."""
+    client.request("GET", "/api/ping")  # Mở socket trước: chỉ đo đường dữ liệu
+    t0 = time.perf_counter()
+    status, _, body = client.request("GET", f"/api/bench/download?bytes={download_bytes}")
+    down_s = time.perf_counter() - t0
+    if status != 200 or len(body) != download_bytes:
+        raise RuntimeError(f"tải xuống lỗi: HTTP {status}, {len(body)} byte")
+
+    payload = bytes(i & 0xFF for i in range(upload_bytes))  # Cùng mẫu với firmware
+    t0 = time.perf_counter()
+    status, _, _ = client.request("POST", "/api/bench/upload", payload, content_type="application/octet-stream")
+    up_s = time.perf_counter() - t0
+    if status != 200:
+        raise RuntimeError(f"tải lên lỗi: HTTP {status}")
+    client.close()
+    return download_bytes * 8 / down_s / 1000, upload_bytes * 8 / up_s / 1000
+
+
+def main():
+    parser = argparse.ArgumentParser(description="So sánh thông lượng socket AT và PPPoS trên 4G giả lập")
+    parser.add_argument("--kb", type=int, default=64, help="KB tải xuống (tải lên tối đa 32 KB)")
+    parser.add_argument("--rtt-ms", type=float, default=120)
+    args = parser.parse_args()
+    rtt_s = args.rtt_ms / 1000
+    download_bytes = args.kb * 1024
+    upload_bytes = min(download_bytes, UPLOAD_MAX_BYTES)
+
+    backend_port, _ = start_backend()
+    lte = LteProxy(backend_port, rtt_s, 0)  # AT: UART tính ở client, TCP của modem không bị cửa sổ nhỏ chặn
+    print(f"xuống {download_bytes} B, lên {upload_bytes} B, RTT {args.rtt_ms:.0f} ms")
+    print(f"{'chế độ':<8}{'baud':>8}{'xuống kbit/s':>14}{'lên kbit/s':>12}{'trần UART kbit/s':>18}")
+    for baud in CELL_BAUDS:
+        ppp = LteProxy(backend_port, rtt_s, 10e6 / baud, framing=ppp_wire_bytes, window_bytes=LWIP_TCP_WND,
+                       segment_bytes=LWIP_TCP_MSS)
+        for name, client in (("at", AtSocketClient(lte.port, baud)), ("ppp", WireClient(ppp.port))):
+            with contextlib.redirect_stdout(io.StringIO()):
+                down, up = measure(client, download_bytes, upload_bytes)
+            print(f"{name:<8}{baud:>8}{down:>14.0f}{up:>12.0f}{baud * 0.8 / 1000:>18.0f}")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,122 @@
+# -*- coding: utf-8 -*-
+"""
+@file bench_ingest.py
+@brief So sánh upload từng bản ghi (/api/ingest) với upload theo lô (/api/ingest/batch) trên backend thật.
+
+Phát lại `--days` ngày bản ghi định kỳ 60 s của `--devices` thiết bị vào app FastAPI chạy bằng uvicorn với
+SQLite trong thư mục tạm, qua socket thật:
+- before: mỗi bản ghi một POST /api/ingest, đóng kết nối sau mỗi request (firmware trước khi gom lô);
+- batch-N: lô N bản ghi lên /api/ingest/batch, cũng đóng kết nối sau mỗi request để chỉ đo tác dụng
+  của gom lô. N = 5 là lô do UPLOAD_BATCH_MAX_AGE_MS (5 phút) quyết định ở nhịp 60 s,
+  N = 20 là UPLOAD_BATCH_MAX_4G khi xả tồn đọng.
+
+In ra số request/ngày, byte HTTP/ngày (request + response, mỗi thiết bị) và tốc độ ghi của backend:
+bản ghi/giây trên toàn bộ lần phát lại và bản ghi/giây trong lúc add/commit (/api/ingest/stats).
+
+Chạy từ battery_backend/backend: python bench/bench_ingest.py [--devices 5] [--days 1]
+"""
+
+import argparse
+import contextlib
+import io
+import json
+import os
+import random
+import sys
+import time
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+
+from http_wire import DEVICE_ID, WireClient, start_backend  # noqa: E402
+
+READINGS_PER_DAY = 1440  # tryBackendUpload(): một bản ghi mỗi 60 s
+TCP_OVERHEAD_BYTES = 280  # SYN/SYN-ACK/ACK + FIN/ACK hai chiều, ~7 đoạn x 40 byte header IPv4+TCP
+
+
+def make_reading(rng: random.Random, seq: int, age_ms: int) -> dict:
+    """Bản ghi cùng trường và cách làm tròn như fillReadingJson() của firmware."""
+    probes = [round(25 + rng.random() * 10, 2) for _ in range(3)]
+    return {
+        "temperature": max(probes),
+        "probe_temps": probes,
+        "smoke_value": rng.randint(900, 1400),
+        "fire_value": rng.randint(850, 1023),
+        "temp_alert": False,
+        "smoke_alert": False,
+        "fire_alert": False,
+        "temp_rise_alert": False,
+        "temp_rise_rate": round(rng.uniform(-0.2, 0.4), 2),
+        "risk_score": rng.randint(0, 20),
+        "risk_level": "normal",
+        "seq": seq,
+        "age_ms": age_ms,
+    }
+
+
+def dumps(obj) -> bytes:
+    # ArduinoJson serializeJson(): không có khoảng trắng
+    return json.dumps(obj, separators=(",", ":")).encode()
+
+
+def run_mode(port: int, app_main, devices: int, days: int, batch: int) -> dict:
+    rng = random.Random(12)
+    for key in ("requests", "batch_requests", "inserted", "duplicates"):
+        app_main.ingest_stats[key] = 0
+    app_main.ingest_stats["commit_seconds"] = 0.0
+
+    total = READINGS_PER_DAY * days
+    clients = [WireClient(port) for _ in range(devices)]
+    seq_base = 1 + (batch * 10_000_000)  # Mỗi chế độ một dải seq riêng: không bị khử trùng lẫn nhau
+    t0 = time.perf_counter()
+    for start in range(0, total, max(batch, 1)):
+        count = min(batch, total - start) if batch else 1
+        for dev, client in enumerate(clients):
+            device_id = f"{DEVICE_ID}_{dev}"
+            readings = [make_reading(rng, seq_base + start + i, (count - 1 - i) * 60000) for i in range(count)]
+            if batch:
+                status, _, _ = client.request("POST", "/api/ingest/batch",
+                                              dumps({"device_id": device_id, "readings": readings}), keep_alive=False)
+            else:
+                body = dict(readings[0], device_id=device_id)
+                status, _, _ = client.request("POST", "/api/ingest", dumps(body), keep_alive=False)
+            if status != 200:
+                raise RuntimeError(f"HTTP {status}")
+    elapsed = time.perf_counter() - t0
+
+    stats = app_main.ingest_statistics()
+    inserted = stats["inserted"]
+    if inserted != total * devices:
+        raise RuntimeError(f"chỉ ghi {inserted}/{total * devices} bản ghi")
+    requests = sum(c.requests for c in clients)
+    connects = sum(c.connects for c in clients)
+    http_bytes = sum(c.bytes_sent + c.bytes_received for c in clients)
+    per_device_day = devices * days
+    return {
+        "requests_day": requests / per_device_day,
+        "http_kb_day": http_bytes / per_device_day / 1024,
+        "wire_kb_day": (http_bytes + connects * TCP_OVERHEAD_BYTES) / per_device_day / 1024,
+        "bytes_per_reading": (http_bytes + connects * TCP_OVERHEAD_BYTES) / inserted,
+        "inserts_sec": inserted / elapsed,
+        "inserts_commit_sec": stats["inserts_per_commit_sec"],
+    }
+
+
+def main():
+    parser = argparse.ArgumentParser(description="So sánh upload từng bản ghi và theo lô trên backend thật")
+    parser.add_argument("--devices", type=int, default=5)
+    parser.add_argument("--days", type=int, default=1)
+    args = parser.parse_args()
+
+    port, app_main = start_backend()
+    print(f"{args.devices} thiết bị x {args.days} ngày x {READINGS_PER_DAY} bản ghi, SQLite, uvicorn 127.0.0.1")
+    print(f"{'chế độ':<10}{'req/ngày':>10}{'KB HTTP/ngày':>14}{'KB +TCP/ngày':>14}{'B/bản ghi':>11}"
+          f"{'ghi/s':>9}{'ghi/s commit':>14}")
+    for name, batch in (("before", 0), ("batch-5", 5), ("batch-20", 20)):
+        with contextlib.redirect_stdout(io.StringIO()):  # Bỏ log "Received ..." mỗi request của backend
+            r = run_mode(port, app_main, args.devices, args.days, batch)
+        print(f"{name:<10}{r['requests_day']:>10.0f}{r['http_kb_day']:>14.1f}{r['wire_kb_day']:>14.1f}"
+              f"{r['bytes_per_reading']:>11.0f}{r['inserts_sec']:>9.0f}{r['inserts_commit_sec']:>14.0f}")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,119 @@
+# -*- coding: utf-8 -*-
+"""
+@file bench_keepalive.py
+@brief So sánh socket dùng một lần (Connection: close + gsmClient.stop()) với phiên keep-alive trên đường 4G
+giả lập: backend thật (uvicorn, SQLite tạm) sau LteProxy, client mô phỏng chi phí AT của modem.
+
+Mô hình (mỗi request là một lô 5 bản ghi lên /api/ingest/batch, cứ 10 request có một lần kiểm tra firmware):
+- LteProxy: RTT `--rtt-ms` (mặc định 120 ms) và UART 115200 baud (87 us/byte) cho mỗi chiều;
+- mở socket: AT+CIPOPEN = bắt tay TCP (một RTT) + xử lý AT trên modem (AT_OPEN_S);
+- đóng socket: gsmClient.stop() chờ "+CIPCLOSE: 0" (AT_CLOSE_S);
+- chế độ idle-drop: NAT đóng im lặng socket rảnh quá 1 s, cứ 5 request có một lần rảnh 1.5 s; client phát
+  hiện khi dùng lại socket và gửi lại một lần như httpRequestOnce(). Thời gian rảnh không tính vào độ trễ.
+
+Chưa tính DNS (cache DNS của firmware) và TLS (backend chạy HTTP).
+
+Chạy từ battery_backend/backend: python bench/bench_keepalive.py [--requests 30] [--rtt-ms 120]
+"""
+
+import argparse
+import contextlib
+import io
+import json
+import os
+import statistics
+import sys
+import time
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+
+from http_wire import DEVICE_ID, LteProxy, WireClient, start_backend  # noqa: E402
+
+UART_US_PER_BYTE = 87       # 115200 baud 8N1
+AT_OPEN_S = 0.05            # AT+CIPOPEN: xử lý lệnh + URC "+CIPOPEN: 0"
+AT_CLOSE_S = 0.05           # AT+CIPCLOSE tới "+CIPCLOSE: 0"
+TCP_OVERHEAD_BYTES = 280    # SYN/SYN-ACK/ACK + FIN/ACK hai chiều
+IDLE_CLOSE_S = 1.0
+IDLE_GAP_S = 1.5
+
+
+class ModemClient(WireClient):
+    """WireClient trả thêm thời gian lệnh AT mở/đóng socket của modem."""
+
+    def __init__(self, port: int, rtt_s: float):
+        super().__init__(port)
+        self.rtt_s = rtt_s
+
+    def open(self):
+        time.sleep(self.rtt_s + AT_OPEN_S)
+        super().open()
+
+    def close(self):
+        if self.sock is not None:
+            time.sleep(AT_CLOSE_S)
+        super().close()
+
+
+def batch_body(seq: int) -> bytes:
+    readings = [{
+        "temperature": 27.5, "probe_temps": [27.5, 26.94, 27.13], "smoke_value": 1180, "fire_value": 1002,
+        "temp_alert": False, "smoke_alert": False, "fire_alert": False, "temp_rise_alert": False,
+        "temp_rise_rate": 0.06, "risk_score": 4, "risk_level": "normal", "seq": seq + i, "age_ms": (4 - i) * 60000,
+    } for i in range(5)]
+    return json.dumps({"device_id": DEVICE_ID, "readings": readings}, separators=(",", ":")).encode()
+
+
+def run_mode(proxy_port: int, rtt_s: float, requests: int, keep_alive: bool, idle_gaps: bool, seq_base: int) -> dict:
+    client = ModemClient(proxy_port, rtt_s)
+    latencies = []
+    for i in range(requests):
+        if idle_gaps and i > 0 and i % 5 == 0:
+            time.sleep(IDLE_GAP_S)
+        t0 = time.perf_counter()
+        if i % 10 == 9:
+            status, _, _ = client.request("GET", "/api/firmware/check?current_version=1.0.0", keep_alive=keep_alive)
+        else:
+            status, _, _ = client.request("POST", "/api/ingest/batch", batch_body(seq_base + i * 5),
+                                          keep_alive=keep_alive)
+        latencies.append(time.perf_counter() - t0)
+        if status != 200:
+            raise RuntimeError(f"HTTP {status}")
+    client.close()
+    http_bytes = client.bytes_sent + client.bytes_received
+    return {
+        "mean_ms": statistics.mean(latencies) * 1000,
+        "p50_ms": statistics.median(latencies) * 1000,
+        "max_ms": max(latencies) * 1000,
+        "connects": client.connects,
+        "stale": client.stale_recovered,
+        "bytes_per_req": (http_bytes + client.connects * TCP_OVERHEAD_BYTES) / requests,
+    }
+
+
+def main():
+    parser = argparse.ArgumentParser(description="So sánh socket dùng một lần với keep-alive trên 4G giả lập")
+    parser.add_argument("--requests", type=int, default=30)
+    parser.add_argument("--rtt-ms", type=float, default=120)
+    args = parser.parse_args()
+    rtt_s = args.rtt_ms / 1000
+
+    backend_port, _ = start_backend()
+    proxy = LteProxy(backend_port, rtt_s, UART_US_PER_BYTE)
+    idle_proxy = LteProxy(backend_port, rtt_s, UART_US_PER_BYTE, idle_close_s=IDLE_CLOSE_S)
+    print(f"{args.requests} request, RTT {args.rtt_ms:.0f} ms, UART {UART_US_PER_BYTE} us/byte")
+    print(f"{'chế độ':<12}{'TB ms':>8}{'p50 ms':>8}{'max ms':>8}{'socket':>8}{'gửi lại':>9}{'B/req':>8}")
+    modes = (
+        ("close", proxy, False, False),
+        ("keep-alive", proxy, True, False),
+        ("idle-drop", idle_proxy, True, True),
+    )
+    for n, (name, p, keep_alive, idle_gaps) in enumerate(modes):
+        with contextlib.redirect_stdout(io.StringIO()):  # Bỏ log "Received ..." mỗi request của backend
+            r = run_mode(p.port, rtt_s, args.requests, keep_alive, idle_gaps, 1 + n * 1_000_000)
+        print(f"{name:<12}{r['mean_ms']:>8.0f}{r['p50_ms']:>8.0f}{r['max_ms']:>8.0f}{r['connects']:>8}"
+              f"{r['stale']:>9}{r['bytes_per_req']:>8.0f}")
+    print(f"idle-drop: NAT giả đóng {idle_proxy.idle_closes} socket rảnh")
+
+
+if __name__ == "__main__":
+    main()
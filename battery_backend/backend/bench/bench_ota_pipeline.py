@@ -0,0 +1,273 @@
+# -*- coding: utf-8 -*-
+"""
+@file bench_ota_pipeline.py
+@brief So sánh tải OTA tuần tự (OTA_PIPELINE 0) với đường ống buffer đôi (OTA_PIPELINE 1) trên đường truyền
+giả lập: ảnh firmware tải từ /api/firmware/download của backend thật theo từng khoảng Range như ota_resume.
+
+Mô hình (flash theo thông số NOR SPI của module ESP32, xem FLASH_*):
+- tuần tự: đọc tối đa 512 byte rồi ghi ngay trên task tải (otaPipelineProduce gọi flashWrite), mạng đứng
+  chờ trong lúc xóa/ghi flash;
+- pipeline: OTA_PIPE_BUFFERS buffer OTA_PIPE_BUF_BYTES xoay vòng giữa task đọc mạng và task flash (luồng
+  riêng); hết buffer trống thì phía mạng chờ. Cuối mỗi response chờ flash ghi xong (otaPipelineDrain).
+- Xóa sector 4096 khi ghi chạm sector mới (như otaResumeWrite), ghi tính theo byte.
+- Đường truyền tính ở phía ESP32 vì buffer socket của máy host lớn hơn nhiều so với thiết bị (nếu để kernel
+  gom hộ thì mạng luôn chạy song song với flash, kể cả chế độ tuần tự):
+  - socket AT (4G mặc định): byte chỉ qua UART khi ESP32 đọc, mỗi lượt AT+CIPRXGET tối đa
+    TINY_GSM_RX_BUFFER byte (cùng mô hình bench_cell_datapath.py), nên chỉ chồng được khi có task đọc riêng;
+  - WiFi và PPP: byte tự tới buffer lwIP ở tốc độ đường truyền, tối đa cửa sổ TCP_WND chưa đọc; buffer đầy
+    (ESP32 đang ghi flash) thì bên gửi dừng.
+- LteProxy thêm RTT `--rtt-ms` (WiFi 20 ms) cho request Range kế tiếp.
+
+Chạy từ battery_backend/backend: python bench/bench_ota_pipeline.py [--kb 256] [--rtt-ms 120]
+"""
+
+import argparse
+import contextlib
+import io
+import os
+import queue
+import sys
+import threading
+import time
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+
+from bench_cell_datapath import (CIPRXGET_QUERY_BYTES, CIPRXGET_READ_BYTES, AT_TURNAROUND_S,  # noqa: E402
+                                 LWIP_TCP_MSS, LWIP_TCP_WND, TINY_GSM_RX_BUFFER, uart_s)
+from http_wire import LteProxy, WireClient, build_request, start_backend  # noqa: E402
+
+OTA_RANGE_BYTES = 131072
+OTA_PIPE_BUFFERS = 2
+OTA_PIPE_BUF_BYTES = 8192
+OTA_PIPE_SYNC_BYTES = 512
+SECTOR_BYTES = 4096
+FLASH_SECTOR_ERASE_S = 0.030      # Xóa một sector 4 KB (NOR SPI 4 MB điển hình 30-45 ms)
+FLASH_WRITE_S_PER_BYTE = 2.5e-6   # Ghi trang 256 B ~0.6 ms: ~400 KB/s
+WIFI_RTT_S = 0.02
+WIFI_BYTES_PER_S = 1.0e6          # Thông lượng TCP thực tế của ESP32 trên WiFi khi không bị cửa sổ chặn
+VERSION = "9.9.9"
+
+
+class AtLink:
+    """Socket AT của modem: ESP32 kéo từng lượt CIPRXGET qua UART khi FIFO của TinyGSM cạn."""
+
+    def __init__(self, baud: int):
+        self.baud = baud
+        self.name = f"4g-at-{baud}"
+        self.fifo = b""
+
+    def sent(self):
+        pass
+
+    def recv(self, sock, max_bytes: int) -> bytes:
+        if not self.fifo:
+            chunk = sock.recv(TINY_GSM_RX_BUFFER)
+            if not chunk:
+                return b""
+            time.sleep(2 * AT_TURNAROUND_S + uart_s(CIPRXGET_QUERY_BYTES + CIPRXGET_READ_BYTES + len(chunk), self.baud))
+            self.fifo = chunk
+        out, self.fifo = self.fifo[:max_bytes], self.fifo[max_bytes:]
+        return out
+
+
+class WindowLink:
+    """WiFi/PPP: byte tới buffer lwIP ở `rate`, tối đa `window` byte chưa đọc (bên gửi dừng khi đầy)."""
+
+    def __init__(self, name: str, rate: float, rtt_s: float, window: int = LWIP_TCP_WND):
+        self.name = name
+        self.rate = min(rate, window / rtt_s)  # Không hơn một cửa sổ mỗi RTT
+        self.window = window
+        self.buffered = 0.0
+        self.last = None
+
+    def sent(self):
+        """Request mới: chưa có byte nào của response trong buffer cho tới khi server trả lời."""
+        self.buffered = 0.0
+        self.last = None
+
+    def recv(self, sock, max_bytes: int) -> bytes:
+        chunk = sock.recv(max_bytes)
+        now = time.perf_counter()
+        if self.last is not None:
+            self.buffered = min(self.window, self.buffered + (now - self.last) * self.rate)
+        if self.buffered < len(chunk):
+            time.sleep((len(chunk) - self.buffered) / self.rate)
+            self.buffered = 0.0
+        else:
+            self.buffered -= len(chunk)
+        self.last = time.perf_counter()
+        return chunk
+
+
+class FlashModel:
+    """Thời gian xóa/ghi của otaResumeWrite(): xóa sector khi chạm sector mới, rồi ghi theo byte."""
+
+    def __init__(self):
+        self.erased_until = 0
+        self.pos = 0
+        self.busy_s = 0.0
+
+    def write(self, n: int):
+        cost = n * FLASH_WRITE_S_PER_BYTE
+        end = self.pos + n
+        while self.erased_until < end:
+            cost += FLASH_SECTOR_ERASE_S
+            self.erased_until += SECTOR_BYTES
+        self.pos = end
+        self.busy_s += cost
+        time.sleep(cost)
+
+
+class OtaClient(WireClient):
+    """Đọc body theo từng lần đọc socket (như http.read của firmware) thay vì gom cả response."""
+
+    def __init__(self, port: int, link):
+        super().__init__(port)
+        self.link = link
+
+    def _recv(self, max_bytes: int) -> bytes:
+        return self.link.recv(self.sock, max_bytes)
+
+    def fetch(self, offset: int, on_data, read_size):
+        """GET một khoảng Range; `read_size()` cho số byte tối đa của lần đọc kế tiếp. Trả (tổng ảnh, byte body)."""
+        if self.sock is None:
+            self.open()
+        raw = build_request("GET", f"/api/firmware/download/{VERSION}")
+        raw = raw[:-2] + f"Range: bytes={offset}-{offset + OTA_RANGE_BYTES - 1}\r\n\r\n".encode()
+        self._send(raw)
+        self.link.sent()
+        buf = b""
+        while b"\r\n\r\n" not in buf:
+            chunk = self._recv(4096)
+            if not chunk:
+                raise ConnectionError("server đóng giữa response")
+            buf += chunk
+        head, _, rest = buf.partition(b"\r\n\r\n")
+        headers = {}
+        for line in head.split(b"\r\n")[1:]:
+            name, _, value = line.partition(b":")
+            headers[name.strip().lower().decode()] = value.strip().decode()
+        if int(head.split(b" ", 2)[1]) != 206:
+            raise RuntimeError(f"cần 206: {head[:40]!r}")
+        length = int(headers["content-length"])
+        total = int(headers["content-range"].rpartition("/")[2])
+        got = 0
+        while got < length:
+            if rest:
+                chunk, rest = rest[:read_size()], rest[read_size():]
+            else:
+                chunk = self._recv(min(read_size(), length - got))
+                if not chunk:
+                    raise ConnectionError("server đóng giữa body")
+            on_data(chunk)
+            got += len(chunk)
+        return total, length
+
+
+def download_sequential(client: OtaClient, flash: FlashModel) -> int:
+    offset = total = 0
+    while total == 0 or offset < total:
+        total, n = client.fetch(offset, lambda chunk: flash.write(len(chunk)), lambda: OTA_PIPE_SYNC_BYTES)
+        offset += n
+    return offset
+
+
+def download_pipelined(client: OtaClient, flash: FlashModel) -> tuple:
+    free, full = queue.Queue(), queue.Queue()
+    for _ in range(OTA_PIPE_BUFFERS):
+        free.put(0)
+    stall = [0.0]
+    current = [None]
+
+    def flash_task():
+        while True:
+            n = full.get()
+            if n is None:
+                return
+            flash.write(n)
+            free.put(0)
+
+    def acquire():
+        if current[0] is None:
+            t0 = time.perf_counter()
+            current[0] = free.get()
+            stall[0] += time.perf_counter() - t0
+        return OTA_PIPE_BUF_BYTES - current[0]
+
+    def produce(chunk):
+        current[0] += len(chunk)
+        if current[0] == OTA_PIPE_BUF_BYTES:
+            full.put(current[0])
+            current[0] = None
+
+    def drain():
+        if current[0] is not None:
+            (full if current[0] else free).put(current[0])
+            current[0] = None
+        while free.qsize() < OTA_PIPE_BUFFERS:
+            time.sleep(0.002)
+
+    worker = threading.Thread(target=flash_task, daemon=True)
+    worker.start()
+    offset = total = 0
+    while total == 0 or offset < total:
+        total, n = client.fetch(offset, produce, acquire)
+        drain()
+        offset += n
+    full.put(None)
+    worker.join()
+    return offset, stall[0]
+
+
+def measure(port: int, link, pipelined: bool) -> tuple:
+    client = OtaClient(port, link)
+    client.request("GET", "/api/ping")  # Mở socket trước: chỉ đo phần tải ảnh
+    flash = FlashModel()
+    t0 = time.perf_counter()
+    if pipelined:
+        written, stall_s = download_pipelined(client, flash)
+    else:
+        written, stall_s = download_sequential(client, flash), 0.0
+    elapsed = time.perf_counter() - t0
+    client.close()
+    return written, elapsed, flash.busy_s, stall_s
+
+
+def main():
+    parser = argparse.ArgumentParser(description="So sánh OTA tuần tự và pipeline trên đường truyền giả lập")
+    parser.add_argument("--kb", type=int, default=256, help="Kích thước ảnh firmware (KB)")
+    parser.add_argument("--rtt-ms", type=float, default=120, help="RTT của đường 4G")
+    args = parser.parse_args()
+    size = args.kb * 1024
+
+    backend_port, _ = start_backend()  # cwd là thư mục tạm của backend
+    os.makedirs("firmware", exist_ok=True)
+    with open(os.path.join("firmware", f"battery_monitor_v{VERSION}.bin"), "wb") as f:
+        f.write(bytes((i * 7 + (i >> 8)) & 0xFF for i in range(size)))
+
+    lte_rtt_s = args.rtt_ms / 1000
+    ppp_rate = 921600 / 10 * LWIP_TCP_MSS / (LWIP_TCP_MSS + 48)  # UART CELL_BAUD_MAX trừ khung IP/TCP + HDLC
+    links = (
+        (WIFI_RTT_S, lambda: WindowLink("wifi", WIFI_BYTES_PER_S, WIFI_RTT_S)),
+        (lte_rtt_s, lambda: AtLink(115200)),
+        (lte_rtt_s, lambda: AtLink(921600)),
+        (lte_rtt_s, lambda: WindowLink("4g-ppp-921600", ppp_rate, lte_rtt_s)),
+    )
+    print(f"ảnh {size} B, khoảng Range {OTA_RANGE_BYTES} B, RTT 4G {args.rtt_ms:.0f} ms, WiFi {WIFI_RTT_S * 1000:.0f} ms")
+    print(f"{'đường':<15}{'chế độ':<10}{'giây':>7}{'B/s':>9}{'flash s':>9}{'chờ flash s':>13}{'tăng tốc':>10}")
+    for rtt_s, make_link in links:
+        proxy = LteProxy(backend_port, rtt_s, 0)
+        baseline = None
+        for pipelined in (False, True):
+            link = make_link()
+            with contextlib.redirect_stdout(io.StringIO()):
+                written, elapsed, flash_s, stall_s = measure(proxy.port, link, pipelined)
+            if written != size:
+                raise RuntimeError(f"tải thiếu: {written}/{size}")
+            baseline = baseline or elapsed
+            mode = "pipeline" if pipelined else "tuần tự"
+            print(f"{link.name:<15}{mode:<10}{elapsed:>7.2f}{size / elapsed:>9.0f}{flash_s:>9.2f}{stall_s:>13.2f}"
+                  f"{baseline / elapsed:>9.2f}x")
+
+if __name__ == "__main__":
+    main()
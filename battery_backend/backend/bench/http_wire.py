@@ -0,0 +1,265 @@
+# -*- coding: utf-8 -*-
+"""
+@file http_wire.py
+@brief Tiện ích chung cho các benchmark: chạy backend thật (uvicorn, SQLite tạm) trong tiến trình và gửi
+request HTTP/1.1 thô qua socket, đếm đúng số byte trên dây như firmware thấy.
+
+Request được dựng theo đúng header firmware gửi (httpExchange trong src/cellular.cpp), nên số byte đếm
+được là byte HTTP thật (chưa gồm TCP/IP/TLS).
+"""
+
+import contextlib
+import io
+import os
+import queue
+import socket
+import sys
+import tempfile
+import threading
+import time
+
+BACKEND_DIR = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..")
+
+# Khớp DEVICE_ID / BACKEND_HOST của firmware (src/config.h)
+DEVICE_ID = "battery_monitor_001"
+BACKEND_HOST = "cloud.anhnguyxn.io.vn"
+API_KEY = "bench_api_key_0123456789"
+
+
+def start_backend():
+    """
+    Khởi động app FastAPI trên 127.0.0.1 với SQLite trong thư mục tạm.
+
+    Phải gọi trước mọi import `app`: db.py đọc DATABASE_URL lúc import.
+
+    Returns:
+        tuple: (port, module app.main)
+    """
+    workdir = tempfile.mkdtemp(prefix="battery_bench_")
+    os.environ["DATABASE_URL"] = f"sqlite:///{os.path.join(workdir, 'bench.db')}"
+    os.environ["BATTERY_API_KEY"] = API_KEY
+    os.environ.pop("TELEGRAM_BOT_TOKEN", None)
+    os.chdir(workdir)  # db.py tạo ./data tương đối
+    sys.path.insert(0, BACKEND_DIR)
+    with contextlib.redirect_stdout(io.StringIO()):
+        from app import main as app_main
+    import uvicorn
+
+    sock = socket.socket()
+    sock.bind(("127.0.0.1", 0))
+    port = sock.getsockname()[1]
+    sock.close()
+    config = uvicorn.Config(app_main.app, host="127.0.0.1", port=port, log_level="warning",
+                            timeout_keep_alive=300, access_log=False)
+    server = uvicorn.Server(config)
+    threading.Thread(target=server.run, daemon=True).start()
+    while not server.started:
+        time.sleep(0.01)
+    return port, app_main
+
+
+def build_request(method: str, path: str, body: bytes = b"", content_type: str = "application/json",
+                  keep_alive: bool = True) -> bytes:
+    """Dựng request giống ArduinoHttpClient của firmware (Host, User-Agent, Connection, X-API-Key...)."""
+    lines = [
+        f"{method} {path} HTTP/1.1",
+        f"Host: {BACKEND_HOST}",
+        "User-Agent: Arduino/2.2.0",
+        f"Connection: {'keep-alive' if keep_alive else 'close'}",
+        f"X-API-Key: {API_KEY}",
+    ]
+    if body:
+        lines += [f"Content-Type: {content_type}", f"Content-Length: {len(body)}"]
+    else:
+        lines.append("Accept: application/json")
+    return ("\r\n".join(lines) + "\r\n\r\n").encode() + body
+
+
+class WireClient:
+    """
+    Client HTTP/1.1 tối giản trên socket thô: đếm byte gửi/nhận và số kết nối đã mở.
+    """
+
+    def __init__(self, port: int, host: str = "127.0.0.1"):
+        self.addr = (host, port)
+        self.sock = None
+        self.connects = 0
+        self.bytes_sent = 0
+        self.bytes_received = 0
+        self.requests = 0
+        self.stale_recovered = 0
+
+    def close(self):
+        if self.sock is not None:
+            self.sock.close()
+            self.sock = None
+
+    def _recv_response(self):
+        buf = b""
+        while b"\r\n\r\n" not in buf:
+            chunk = self._recv(65536)
+            if not chunk:
+                raise ConnectionError("server đóng giữa response")
+            buf += chunk
+        head, _, rest = buf.partition(b"\r\n\r\n")
+        headers = {}
+        for line in head.split(b"\r\n")[1:]:
+            name, _, value = line.partition(b":")
+            headers[name.strip().lower().decode()] = value.strip().decode()
+        length = int(headers.get("content-length", "0"))
+        while len(rest) < length:
+            chunk = self._recv(length - len(rest))
+            if not chunk:
+                raise ConnectionError("server đóng giữa body")
+            rest += chunk
+        self.bytes_received += len(head) + 4 + len(rest)
+        status = int(head.split(b" ", 2)[1])
+        return status, headers, rest[:length]
+
+    def request(self, method: str, path: str, body: bytes = b"", content_type: str = "application/json",
+                keep_alive: bool = True):
+        """
+        Gửi một request; keep_alive=False đóng socket sau response như firmware trước khi giữ phiên.
+
+        Socket giữ sẵn mà hỏng (server/NAT đã đóng) thì mở socket mới và gửi lại một lần, như
+        httpRequestOnce() của firmware.
+
+        Returns:
+            tuple: (status, headers, body)
+        """
+        reused = self.sock is not None
+        raw = build_request(method, path, body, content_type, keep_alive)
+        self.requests += 1
+        try:
+            resp = self._exchange(raw)
+        except (ConnectionError, OSError):
+            if not reused:
+                raise
+            self.stale_recovered += 1
+            self.close()
+            resp = self._exchange(raw)
+        if not keep_alive or resp[1].get("connection", "").lower() == "close":
+            self.close()
+        return resp
+
+    def _exchange(self, raw: bytes):
+        if self.sock is None:
+            self.open()
+        self._send(raw)
+        self.bytes_sent += len(raw)
+        return self._recv_response()
+
+    # Điểm móc cho client mô phỏng cách modem chở byte (bench_cell_datapath.py)
+    def _send(self, raw: bytes):
+        self.sock.sendall(raw)
+
+    def _recv(self, max_bytes: int) -> bytes:
+        return self.sock.recv(max_bytes)
+
+    def open(self):
+        self.sock = socket.create_connection(self.addr)
+        self.sock.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+        self.connects += 1
+
+
+class LteProxy:
+    """
+    Proxy TCP giả lập đường 4G giữa client và backend: mỗi chiều trễ thêm nửa RTT và tốn thời gian truyền
+    qua UART modem (byte đi tuần tự, không vượt nhau). Kết nối rảnh quá `idle_close_s` bị đóng im lặng như
+    NAT của nhà mạng, client chỉ biết khi dùng lại socket.
+    """
+
+    def __init__(self, upstream_port: int, rtt_s: float, us_per_byte: float, idle_close_s: float = 0.0,
+                 framing=None, window_bytes: int = 0, segment_bytes: int = 0):
+        """
+        Args:
+            framing: hàm(bytes) -> số byte thật trên UART (khung PPP...); None = đúng số byte dữ liệu
+            window_bytes: > 0 thì mỗi chiều chỉ có tối đa bấy nhiêu byte chưa được ACK (cửa sổ TCP của
+                bên nhận): byte thứ k không đi trước khi byte k - window_bytes tới nơi được một RTT
+            segment_bytes: > 0 thì cắt dữ liệu thành đoạn TCP (MSS) trước khi tính khung và cửa sổ
+        """
+        self.upstream = ("127.0.0.1", upstream_port)
+        self.rtt_s = rtt_s
+        self.one_way_s = rtt_s / 2
+        self.s_per_byte = us_per_byte / 1e6
+        self.idle_close_s = idle_close_s
+        self.framing = framing
+        self.window_bytes = window_bytes
+        self.segment_bytes = segment_bytes
+        self.idle_closes = 0
+        self.listener = socket.socket()
+        self.listener.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+        self.listener.bind(("127.0.0.1", 0))
+        self.listener.listen(16)
+        self.port = self.listener.getsockname()[1]
+        threading.Thread(target=self._accept_loop, daemon=True).start()
+
+    def _accept_loop(self):
+        while True:
+            client, _ = self.listener.accept()
+            server = socket.create_connection(self.upstream)
+            for s in (client, server):
+                s.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+            state = {"last": time.monotonic(), "closed": False}
+            threading.Thread(target=self._pump, args=(client, server, state), daemon=True).start()
+            threading.Thread(target=self._pump, args=(server, client, state), daemon=True).start()
+
+    def _pump(self, src: socket.socket, dst: socket.socket, state: dict):
+        pending = queue.Queue()
+
+        def sender():
+            while True:
+                due, data = pending.get()
+                delay = due - time.monotonic()
+                if delay > 0:
+                    time.sleep(delay)
+                try:
+                    if data is None:
+                        dst.shutdown(socket.SHUT_WR)
+                        return
+                    dst.sendall(data)
+                except OSError:
+                    return
+
+        threading.Thread(target=sender, daemon=True).start()
+        last_due = 0.0
+        sent_total = 0
+        delivered = []  # (tổng byte tới hết đoạn, thời điểm tới) cho giới hạn cửa sổ
+        src.settimeout(0.05)
+        while True:
+            try:
+                data = src.recv(65536)
+            except socket.timeout:
+                if self.idle_close_s and time.monotonic() - state["last"] > self.idle_close_s:
+                    if not state["closed"]:
+                        state["closed"] = True
+                        self.idle_closes += 1
+                    for s in (src, dst):
+                        try:
+                            s.shutdown(socket.SHUT_RDWR)
+                        except OSError:
+                            pass
+                    return
+                continue
+            except OSError:
+                return
+            now = time.monotonic()
+            state["last"] = now
+            if not data:
+                pending.put((max(now + self.one_way_s, last_due), None))
+                return
+            step = self.segment_bytes or len(data)
+            for off in range(0, len(data), step):
+                seg = data[off:off + step]
+                start = max(now + self.one_way_s, last_due)
+                sent_total += len(seg)
+                acked_needed = sent_total - self.window_bytes
+                if self.window_bytes and acked_needed > 0:
+                    for end, due in delivered:
+                        if end >= acked_needed:
+                            start = max(start, due + self.rtt_s)
+                            break
+                last_due = start + (self.framing(seg) if self.framing else len(seg)) * self.s_per_byte
+                if self.window_bytes:
+                    delivered.append((sent_total, last_due))
+                pending.put((last_due, seg))
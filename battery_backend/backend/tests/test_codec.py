@@ -0,0 +1,139 @@
+# -*- coding: utf-8 -*-
+"""
+@file test_codec.py
+@brief Giải mã frame do firmware mã hóa (test/test_telemetry_codec của firmware giữ cùng dãy byte).
+
+Chạy từ battery_backend/backend: python -m unittest discover -s tests
+"""
+
+import os
+import sys
+import unittest
+
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)), ".."))
+
+from app import codec  # noqa: E402
+
+# Trùng GOLDEN_FRAME trong test/test_telemetry_codec/test_main.cpp (telemetryEncodeFrame, nowMs = 61000)
+GOLDEN_FRAME = bytes([
+    0x02, 0x06, 0x70, 0x69, 0x6E, 0x2D, 0x30, 0x31, 0xBC, 0xB4, 0x01, 0x04,
+    0x80, 0x13, 0x0C, 0x03, 0x0E, 0xC0, 0xA9, 0x07, 0xCC, 0x27, 0xFF, 0xFF,
+    0x03, 0x00, 0xCB, 0xA7, 0x04, 0x57, 0xE0, 0x12, 0x88, 0x0E, 0x2A, 0x22,
+    0x37, 0x02, 0x01, 0x84, 0x01, 0xAC, 0x82, 0x04, 0x84, 0x01, 0xF6, 0xA7,
+    0x04, 0x13, 0x27, 0xD4, 0x34, 0x64, 0x02, 0x02, 0xAB, 0xA9, 0x07, 0xB7,
+    0x30, 0xD3, 0x02, 0xB7, 0x30, 0xF5, 0xA7, 0x04, 0x97, 0xF8, 0x03, 0xC8,
+    0xDC, 0x03, 0xB2, 0x2D, 0xDF, 0x0D, 0x80, 0x00, 0x00, 0x02, 0x00, 0xFC,
+    0xF8, 0x07, 0x97, 0xF8, 0x03, 0xD7, 0xFF, 0x03, 0xFD, 0x3F, 0xFE, 0x0F,
+])
+
+# Frame v1 của firmware cũ (chưa có epoch/bootId) với cùng các bản ghi: backend vẫn phải nhận
+GOLDEN_FRAME_V1 = bytes([
+    0x01, 0x06, 0x70, 0x69, 0x6E, 0x2D, 0x30, 0x31, 0x04, 0x80, 0x13, 0x0C,
+    0x03, 0xC0, 0xA9, 0x07, 0xCC, 0x27, 0xFF, 0xFF, 0x03, 0x00, 0xCB, 0xA7,
+    0x04, 0x57, 0xE0, 0x12, 0x88, 0x0E, 0x2A, 0x22, 0x37, 0x02, 0x84, 0x01,
+    0xAC, 0x82, 0x04, 0x84, 0x01, 0xF6, 0xA7, 0x04, 0x13, 0x27, 0xD4, 0x34,
+    0x64, 0x02, 0xAB, 0xA9, 0x07, 0xB7, 0x30, 0xD3, 0x02, 0xB7, 0x30, 0xF5,
+    0xA7, 0x04, 0x97, 0xF8, 0x03, 0xC8, 0xDC, 0x03, 0xB2, 0x2D, 0xDF, 0x0D,
+    0x80, 0x00, 0x00, 0x02, 0xFC, 0xF8, 0x07, 0x97, 0xF8, 0x03, 0xD7, 0xFF,
+    0x03, 0xFD, 0x3F, 0xFE, 0x0F,
+])
+
+# epoch 0x5A3C (EPOCH trong test firmware): boot_id = epoch << 16 | bootId
+BOOT_KEY = 0x5A3C << 16
+
+# Trùng URGENT_FRAME: cảnh báo khẩn gửi thẳng, chưa qua hàng đợi flash nên seq = 0 trên dây
+URGENT_FRAME = bytes([
+    0x02, 0x06, 0x70, 0x69, 0x6E, 0x2D, 0x30, 0x31, 0xBC, 0xB4, 0x01, 0x01,
+    0xD4, 0x32, 0x5C, 0x00, 0x0E, 0x64, 0x8C, 0x60, 0xC8, 0x06, 0x00, 0xD3,
+    0x02, 0xE8, 0x20, 0x50,
+])
+
+# Giá trị của các bản ghi firmware đã mã hóa (buildGoldenRecords)
+EXPECTED = [
+    {
+        # seq sát biên quay vòng, cùng lần boot nên có age_ms
+        "temperature": 25.34, "probe_temps": [25.34, None, 24.9], "smoke_value": 1200, "fire_value": 900,
+        "temp_alert": False, "smoke_alert": False, "fire_alert": False, "temp_rise_alert": False,
+        "temp_rise_rate": None, "risk_score": 12, "risk_level": "watch", "seq": 0xFFFFFFFE, "age_ms": 60000,
+        "boot_id": BOOT_KEY | 7,
+    },
+    {
+        # Lần boot trước: không có age_ms
+        "temperature": 26.0, "probe_temps": [26.0, 25.55], "smoke_value": 1190, "fire_value": 880,
+        "temp_alert": False, "smoke_alert": True, "fire_alert": False, "temp_rise_alert": True,
+        "temp_rise_rate": 1.5, "risk_score": 55, "risk_level": "warning", "seq": 0xFFFFFFFF,
+        "boot_id": BOOT_KEY | 6,
+    },
+    {
+        # seq quay vòng về 0 (= không có seq, không khử trùng), giá trị âm, thêm đầu dò so với bản ghi trước
+        "temperature": -5.0, "probe_temps": [-5.0, None, None, 300.0], "smoke_value": 4095, "fire_value": 0,
+        "temp_alert": False, "smoke_alert": False, "fire_alert": True, "temp_rise_alert": False,
+        "temp_rise_rate": -0.2, "risk_score": 100, "risk_level": "critical", "seq": None, "age_ms": 10,
+        "boot_id": BOOT_KEY | 7,
+    },
+    {
+        # Không đầu dò nào: temperature là TLOG_NULL_CENTI / 100 như đường JSON (fillReadingJson);
+        # uptime lúc lấy mẫu lớn hơn nowMs (millis() quay vòng) nên age_ms tính theo uint32
+        "temperature": -327.68, "probe_temps": [], "smoke_value": 0, "fire_value": 1023,
+        "temp_alert": False, "smoke_alert": False, "fire_alert": False, "temp_rise_alert": False,
+        "temp_rise_rate": None, "risk_score": 0, "risk_level": "normal", "seq": 1, "age_ms": 65096,
+        "boot_id": BOOT_KEY | 7,
+    },
+]
+
+
+class DecodeFrameTest(unittest.TestCase):
+    def assert_readings(self, readings, expected):
+        self.assertEqual(len(readings), len(expected))
+        for got, want in zip(readings, expected):
+            self.assertEqual(set(got), set(want))
+            for key, value in want.items():
+                if isinstance(value, float):
+                    self.assertAlmostEqual(got[key], value, places=6, msg=key)
+                elif isinstance(value, list):
+                    self.assertEqual(len(got[key]), len(value), key)
+                    for g, w in zip(got[key], value):
+                        if w is None:
+                            self.assertIsNone(g, key)
+                        else:
+                            self.assertAlmostEqual(g, w, places=6, msg=key)
+                else:
+                    self.assertEqual(got[key], value, key)
+
+    def test_golden_frame_round_trip(self):
+        device_id, readings = codec.decode_frame(GOLDEN_FRAME)
+        self.assertEqual(device_id, "pin-01")
+        self.assert_readings(readings, EXPECTED)
+
+    def test_v1_frame_has_no_boot_id(self):
+        device_id, readings = codec.decode_frame(GOLDEN_FRAME_V1)
+        self.assertEqual(device_id, "pin-01")
+        self.assert_readings(readings, [dict(want, boot_id=None) for want in EXPECTED])
+
+    def test_urgent_frame_has_no_seq(self):
+        # seq 0 mà giải mã thành 0 thì /api/ingest coi mọi cảnh báo khẩn sau cái đầu tiên là trùng
+        device_id, readings = codec.decode_frame(URGENT_FRAME)
+        self.assertEqual(device_id, "pin-01")
+        self.assertEqual(len(readings), 1)
+        self.assertIsNone(readings[0]["seq"])
+        self.assertEqual(readings[0]["risk_level"], "critical")
+        self.assertTrue(readings[0]["fire_alert"])
+        self.assertEqual(readings[0]["age_ms"], 50)
+        self.assertEqual(readings[0]["boot_id"], BOOT_KEY | 7)
+
+    def test_truncated_frame_is_rejected(self):
+        for cut in range(len(GOLDEN_FRAME)):
+            with self.assertRaises(codec.FrameError):
+                codec.decode_frame(GOLDEN_FRAME[:cut])
+
+    def test_trailing_bytes_are_rejected(self):
+        with self.assertRaises(codec.FrameError):
+            codec.decode_frame(GOLDEN_FRAME + b"\x00")
+
+    def test_unknown_version_is_rejected(self):
+        with self.assertRaises(codec.FrameError):
+            codec.decode_frame(b"\x03" + GOLDEN_FRAME[1:])
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,112 @@
+# -*- coding: utf-8 -*-
+"""
+@file test_firmware_range.py
+@brief Tải firmware theo Range (OTA tải tiếp được): parse_byte_range và /api/firmware/download trả 206 với
+Content-Range, 416 khi khoảng nằm ngoài file, 200 cả file khi không có Range.
+
+Gọi thẳng hàm endpoint, file firmware đặt trong thư mục tạm (endpoint đọc firmware/ tương đối cwd).
+
+Chạy từ battery_backend/backend: python -m unittest discover -s tests
+"""
+
+import contextlib
+import io
+import os
+import sys
+import tempfile
+import unittest
+
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)), ".."))
+
+_workdir = tempfile.mkdtemp(prefix="battery_test_")
+os.environ.setdefault("DATABASE_URL", f"sqlite:///{os.path.join(_workdir, 'test.db')}")
+os.environ.pop("TELEGRAM_BOT_TOKEN", None)
+
+from fastapi import HTTPException  # noqa: E402
+from fastapi.responses import FileResponse  # noqa: E402
+
+with contextlib.redirect_stdout(io.StringIO()):
+    from app import main  # noqa: E402
+
+IMAGE = bytes((i * 7 + (i >> 8)) & 0xFF for i in range(300000))  # Không chia hết cho khoảng 128 KB của firmware
+RANGE_BYTES = 131072  # OTA_RANGE_BYTES trong src/config.h
+
+
+class ParseByteRangeTest(unittest.TestCase):
+    def test_closed_range(self):
+        self.assertEqual(main.parse_byte_range("bytes=0-131071", 300000), (0, 131071))
+        self.assertEqual(main.parse_byte_range("bytes=131072-262143", 300000), (131072, 262143))
+
+    def test_end_past_file_is_clamped(self):
+        # Khoảng cuối firmware xin đủ OTA_RANGE_BYTES, server cắt ở cuối file
+        self.assertEqual(main.parse_byte_range("bytes=262144-393215", 300000), (262144, 299999))
+
+    def test_open_and_suffix_ranges(self):
+        self.assertEqual(main.parse_byte_range("bytes=299000-", 300000), (299000, 299999))
+        self.assertEqual(main.parse_byte_range("bytes=-1000", 300000), (299000, 299999))
+        self.assertEqual(main.parse_byte_range("bytes=-500000", 300000), (0, 299999))
+        self.assertEqual(main.parse_byte_range(" BYTES = 5-9", 300000), (5, 9))
+
+    def test_unsatisfiable_ranges(self):
+        self.assertIsNone(main.parse_byte_range("bytes=300000-", 300000))      # Checkpoint vượt file đã đổi
+        self.assertIsNone(main.parse_byte_range("bytes=300000-310000", 300000))
+        self.assertIsNone(main.parse_byte_range("bytes=10-5", 300000))
+        self.assertIsNone(main.parse_byte_range("bytes=-0", 300000))
+
+    def test_malformed_ranges(self):
+        self.assertIsNone(main.parse_byte_range("items=0-10", 300000))
+        self.assertIsNone(main.parse_byte_range("bytes=0-10,20-30", 300000))  # Nhiều khoảng: không hỗ trợ
+        self.assertIsNone(main.parse_byte_range("bytes=a-b", 300000))
+        self.assertIsNone(main.parse_byte_range("bytes=", 300000))
+
+
+class FirmwareDownloadTest(unittest.TestCase):
+    VERSION = "9.9.9"
+
+    def setUp(self):
+        self.cwd = os.getcwd()
+        self.dir = tempfile.mkdtemp(prefix="battery_fw_")
+        os.makedirs(os.path.join(self.dir, "firmware"))
+        with open(os.path.join(self.dir, "firmware", f"battery_monitor_v{self.VERSION}.bin"), "wb") as f:
+            f.write(IMAGE)
+        os.chdir(self.dir)
+
+    def tearDown(self):
+        os.chdir(self.cwd)
+
+    def download(self, range_header=None):
+        return main.download_firmware(self.VERSION, range_header)
+
+    def test_ranges_reassemble_image(self):
+        # Trình tự như ota_resume: bytes=<offset>-<offset+OTA_RANGE_BYTES-1> tới hết ảnh
+        image = b""
+        while len(image) < len(IMAGE):
+            resp = self.download(f"bytes={len(image)}-{len(image) + RANGE_BYTES - 1}")
+            self.assertEqual(resp.status_code, 206)
+            end = min(len(image) + RANGE_BYTES, len(IMAGE)) - 1
+            self.assertEqual(resp.headers["content-range"], f"bytes {len(image)}-{end}/{len(IMAGE)}")
+            self.assertEqual(resp.headers["accept-ranges"], "bytes")
+            self.assertEqual(int(resp.headers["content-length"]), end - len(image) + 1)
+            image += resp.body
+        self.assertEqual(image, IMAGE)
+
+    def test_range_past_end_is_416(self):
+        with self.assertRaises(HTTPException) as ctx:
+            self.download(f"bytes={len(IMAGE)}-{len(IMAGE) + RANGE_BYTES - 1}")
+        self.assertEqual(ctx.exception.status_code, 416)
+        self.assertEqual(ctx.exception.headers["Content-Range"], f"bytes */{len(IMAGE)}")
+
+    def test_without_range_returns_whole_file(self):
+        resp = self.download()
+        self.assertIsInstance(resp, FileResponse)
+        self.assertEqual(resp.status_code, 200)
+        self.assertEqual(resp.headers["accept-ranges"], "bytes")
+
+    def test_unknown_version_is_404(self):
+        with self.assertRaises(HTTPException) as ctx:
+            main.download_firmware("0.0.0", "bytes=0-10")
+        self.assertEqual(ctx.exception.status_code, 404)
+
+
+if __name__ == "__main__":
+    unittest.main()
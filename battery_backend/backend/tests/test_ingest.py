@@ -0,0 +1,97 @@
+# -*- coding: utf-8 -*-
+"""
+@file test_ingest.py
+@brief Khử trùng bản ghi gửi lại trên /api/ingest và /api/ingest/batch theo (device_id, boot_id, seq).
+
+Gọi thẳng hàm endpoint với session SQLite trong thư mục tạm (không cần server hay client HTTP).
+
+Chạy từ battery_backend/backend: python -m unittest discover -s tests
+"""
+
+import contextlib
+import io
+import os
+import sys
+import tempfile
+import unittest
+
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)), ".."))
+
+# db.py đọc DATABASE_URL lúc import: phải đặt trước khi import app.main
+_workdir = tempfile.mkdtemp(prefix="battery_test_")
+os.environ["DATABASE_URL"] = f"sqlite:///{os.path.join(_workdir, 'test.db')}"
+os.environ.pop("TELEGRAM_BOT_TOKEN", None)
+
+from fastapi import BackgroundTasks  # noqa: E402
+
+with contextlib.redirect_stdout(io.StringIO()):
+    from app import codec, main, schemas  # noqa: E402
+    from app.db import SessionLocal  # noqa: E402
+
+from test_codec import GOLDEN_FRAME, URGENT_FRAME  # noqa: E402
+
+OLD_EPOCH = 0x1234 << 16
+NEW_EPOCH = 0xBEEF << 16
+
+
+def reading(seq=None, boot_id=None, **extra) -> dict:
+    fields = {"temperature": 27.5, "smoke_value": 1100, "fire_value": 1000, "seq": seq, "boot_id": boot_id}
+    fields.update(extra)
+    return fields
+
+
+class IngestDedupeTest(unittest.TestCase):
+    def setUp(self):
+        self.db = SessionLocal()
+
+    def tearDown(self):
+        self.db.close()
+
+    def post(self, device_id: str, fields: dict) -> str:
+        with contextlib.redirect_stdout(io.StringIO()):
+            return main.ingest(BackgroundTasks(), "key", schemas.IngestRequest(device_id=device_id, **fields),
+                               self.db).status
+
+    def post_batch(self, device_id: str, readings: list) -> tuple:
+        payload = schemas.IngestBatchRequest(device_id=device_id, readings=readings)
+        with contextlib.redirect_stdout(io.StringIO()):
+            r = main.ingest_batch(BackgroundTasks(), "key", payload, self.db)
+        return r.inserted, r.duplicates
+
+    def test_resent_batch_is_duplicate(self):
+        batch = [reading(seq, OLD_EPOCH | 3) for seq in (1, 2, 3)]
+        self.assertEqual(self.post_batch("dev-resend", batch), (3, 0))
+        self.assertEqual(self.post_batch("dev-resend", batch), (0, 3))
+
+    def test_nvs_reset_with_low_seq_is_not_duplicate(self):
+        # Thiết bị mới chạy vài giờ (seq còn nhỏ) rồi bị xóa NVS: seq đếm lại từ 1 với epoch mới
+        old = [reading(seq, OLD_EPOCH | 1) for seq in range(1, 6)]
+        new = [reading(seq, NEW_EPOCH | 1) for seq in range(1, 6)]
+        self.assertEqual(self.post_batch("dev-reset", old), (5, 0))
+        self.assertEqual(self.post_batch("dev-reset", new), (5, 0))
+        self.assertEqual(self.post_batch("dev-reset", new), (0, 5))
+
+    def test_same_seq_in_another_boot_is_not_duplicate(self):
+        self.assertEqual(self.post("dev-boot", reading(40, OLD_EPOCH | 2)), "ok")
+        self.assertEqual(self.post("dev-boot", reading(40, OLD_EPOCH | 3)), "ok")
+        self.assertEqual(self.post("dev-boot", reading(40, OLD_EPOCH | 2)), "duplicate")
+
+    def test_legacy_firmware_without_boot_id_dedupes_on_seq(self):
+        self.assertEqual(self.post("dev-legacy", reading(7)), "ok")
+        self.assertEqual(self.post("dev-legacy", reading(7)), "duplicate")
+        self.assertEqual(self.post("dev-legacy", reading(7, OLD_EPOCH | 1)), "ok")
+
+    def test_urgent_frame_is_stored_every_time(self):
+        device_id, readings = codec.decode_frame(URGENT_FRAME)
+        for _ in range(3):
+            self.assertEqual(self.post(device_id, readings[0]), "ok")
+
+    def test_binary_batch_resend(self):
+        device_id, readings = codec.decode_frame(GOLDEN_FRAME)
+        self.assertEqual(self.post_batch(device_id, readings), (4, 0))
+        # Bản ghi không có seq (giải mã từ seq 0) không khử trùng được nên được ghi lại
+        self.assertEqual(self.post_batch(device_id, readings), (1, 3))
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,76 @@
+#include "adc_sampler.h"
+
+/**
+ * @file adc_sampler.cpp
+ * @brief Hiện thực task lấy mẫu ADC nền cho MQ-135 và KY-026.
+ *
+ * Task được đánh thức bằng xTaskDelayUntil() nên chu kỳ lấy mẫu đều, không trôi theo thời gian
+ * xử lý. Chỉ dùng ADC1 (GPIO 34/35) nên không xung đột với Wi-Fi.
+ */
+
+static SpscRing<uint16_t, ADC_RING_SIZE> adcRings[ADC_CH_COUNT];
+static const uint8_t adcPins[ADC_CH_COUNT] = { SMOKE_SENSOR_PIN, FIRE_SENSOR_ANALOG_PIN };
+
+static volatile uint32_t statSamples = 0;
+static volatile uint32_t statOverruns = 0;
+static volatile uint32_t statLateTicks = 0;
+static TaskHandle_t adcSamplerHandle = NULL;
+
+/**
+ * @brief Vòng lặp lấy mẫu: mỗi chu kỳ đọc lần lượt các kênh và đẩy vào ring buffer tương ứng.
+ */
+static void adcSamplerTask(void* param) {
+  TickType_t period = pdMS_TO_TICKS(1000 / ADC_SAMPLE_RATE_HZ);
+  if (period == 0) period = 1;
+  TickType_t lastWake = xTaskGetTickCount();
+
+  while (true) {
+    if (xTaskDelayUntil(&lastWake, period) == pdFALSE) {
+      statLateTicks++;
+    }
+    for (int ch = 0; ch < ADC_CH_COUNT; ch++) {
+      uint16_t v = (uint16_t)analogRead(adcPins[ch]);
+      if (!adcRings[ch].push(v)) {
+        statOverruns++;
+      }
+    }
+    statSamples++;
+  }
+}
+
+/**
+ * @brief Khởi động task lấy mẫu trên core ADC_SAMPLER_CORE.
+ */
+bool adcSamplerBegin() {
+  if (adcSamplerHandle != NULL) return true;
+  BaseType_t ok = xTaskCreatePinnedToCore(adcSamplerTask, "adcSampler", 2048, NULL,
+                                          ADC_SAMPLER_PRIORITY, &adcSamplerHandle, ADC_SAMPLER_CORE);
+  if (ok != pdPASS) {
+    adcSamplerHandle = NULL;
+    Serial.println("[ADC] Không tạo được task lấy mẫu");
+    return false;
+  }
+  Serial.printf("[ADC] Lấy mẫu nền %d Hz, block %d mẫu\n", ADC_SAMPLE_RATE_HZ, ADC_SAMPLES);
+  return true;
+}
+
+/**
+ * @brief Rút block mẫu cho tầng lọc; an toàn khi chỉ có một consumer cho mỗi kênh.
+ */
+bool adcSamplerReadBlock(AdcChannel ch, uint16_t* out, size_t count) {
+  if (ch >= ADC_CH_COUNT || out == NULL || count == 0) return false;
+  return adcRings[ch].popExact(out, count);
+}
+
+size_t adcSamplerAvailable(AdcChannel ch) {
+  if (ch >= ADC_CH_COUNT) return 0;
+  return adcRings[ch].size();
+}
+
+AdcSamplerStats adcSamplerGetStats() {
+  AdcSamplerStats s;
+  s.samples = statSamples;
+  s.overruns = statOverruns;
+  s.lateTicks = statLateTicks;
+  return s;
+}
@@ -0,0 +1,96 @@
+#ifndef ADC_SAMPLER_H
+#define ADC_SAMPLER_H
+
+/**
+ * @file adc_sampler.h
+ * @brief Bộ lấy mẫu ADC liên tục cho MQ-135 và KY-026 (task định thời + ring buffer lock-free).
+ *
+ * Task lấy mẫu chạy nền với chu kỳ cố định (ADC_SAMPLE_RATE_HZ), đẩy từng mẫu vào ring buffer
+ * riêng cho mỗi kênh. Các kênh của sensor_scheduler chỉ việc rút ra từng block mẫu để lọc,
+ * không còn analogRead() + delayMicroseconds() trong loop chính.
+ */
+
+#include <Arduino.h>
+#include <atomic>
+#include "config.h"
+
+// Kênh analog được lấy mẫu nền
+enum AdcChannel {
+  ADC_CH_SMOKE = 0,   // MQ-135 (SMOKE_SENSOR_PIN)
+  ADC_CH_FIRE = 1,    // KY-026 AO (FIRE_SENSOR_ANALOG_PIN)
+  ADC_CH_COUNT = 2
+};
+
+/**
+ * @brief Ring buffer một producer / một consumer, không khóa.
+ *
+ * Producer (task lấy mẫu) chỉ ghi `head_`, consumer chỉ ghi `tail_`; hai chỉ số là atomic
+ * nên hai core có thể truy cập đồng thời mà không cần mutex. N phải là lũy thừa của 2.
+ * Khi đầy, mẫu mới bị bỏ và push() trả về false để caller đếm overrun.
+ */
+template <typename T, size_t N>
+class SpscRing {
+  static_assert(N >= 2 && (N & (N - 1)) == 0, "SpscRing: N phai la luy thua cua 2");
+
+ public:
+  bool push(const T& value) {
+    size_t head = head_.load(std::memory_order_relaxed);
+    size_t tail = tail_.load(std::memory_order_acquire);
+    if (head - tail >= N) return false;
+    buf_[head & (N - 1)] = value;
+    head_.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Lấy đúng `count` phần tử; nếu chưa đủ thì không lấy gì và trả về false
+  bool popExact(T* out, size_t count) {
+    size_t tail = tail_.load(std::memory_order_relaxed);
+    size_t head = head_.load(std::memory_order_acquire);
+    if (head - tail < count) return false;
+    for (size_t i = 0; i < count; i++) {
+      out[i] = buf_[(tail + i) & (N - 1)];
+    }
+    tail_.store(tail + count, std::memory_order_release);
+    return true;
+  }
+
+  size_t size() const {
+    return head_.load(std::memory_order_acquire) - tail_.load(std::memory_order_acquire);
+  }
+
+ private:
+  T buf_[N];
+  std::atomic<size_t> head_{0};
+  std::atomic<size_t> tail_{0};
+};
+
+// Thống kê để kiểm tra tốc độ lấy mẫu thực tế
+struct AdcSamplerStats {
+  uint32_t samples;     // Tổng số lần lấy mẫu (mỗi lần đọc đủ các kênh)
+  uint32_t overruns;    // Số mẫu bị bỏ do consumer không rút kịp
+  uint32_t lateTicks;   // Số chu kỳ bị trễ so với lịch (task bị chiếm CPU)
+};
+
+/**
+ * @brief Tạo task lấy mẫu nền (gọi một lần trong setup(), sau khi cấu hình ADC).
+ * @return false nếu không tạo được task.
+ */
+bool adcSamplerBegin();
+
+/**
+ * @brief Rút một block `count` mẫu liên tiếp của kênh `ch` (cũ nhất trước).
+ * @return false nếu ring buffer chưa tích đủ `count` mẫu.
+ */
+bool adcSamplerReadBlock(AdcChannel ch, uint16_t* out, size_t count);
+
+/**
+ * @brief Số mẫu đang chờ trong ring buffer của kênh.
+ */
+size_t adcSamplerAvailable(AdcChannel ch);
+
+/**
+ * @brief Sao chép thống kê lấy mẫu hiện tại.
+ */
+AdcSamplerStats adcSamplerGetStats();
+
+#endif
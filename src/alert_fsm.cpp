@@ -0,0 +1,144 @@
+#include "alert_fsm.h"
+#include <math.h>
+
+/**
+ * @file alert_fsm.cpp
+ * @brief Bảng cấu hình kênh và bước chuyển trạng thái.
+ *
+ * OFF → PENDING_ON khi vượt ngưỡng bật; sang ON khi giữ đủ setDelayMs (0 = bật ngay).
+ * ON giữ ít nhất minOnMs; sau đó nếu về dưới ngưỡng tắt thì sang PENDING_OFF, phải giữ
+ * clearDelayMs mới về OFF (thời gian tắt tối thiểu). Bật lại trong coalesceMs kể từ lần tắt
+ * trước bị gộp: vẫn bật còi nhưng không tính là sự kiện mới (không upload khẩn lần nữa).
+ */
+
+enum AlertFsmState : uint8_t {
+  ALERT_FSM_OFF = 0,
+  ALERT_FSM_PENDING_ON,
+  ALERT_FSM_ON,
+  ALERT_FSM_PENDING_OFF
+};
+
+struct AlertChannelConfig {
+  const char* name;
+  bool below;             // true: cảnh báo khi giá trị NHỎ hơn ngưỡng (KY-026)
+  float hysteresis;       // Khoảng cách ngưỡng tắt so với ngưỡng bật
+  uint32_t setDelayMs;
+  uint32_t minOnMs;
+  uint32_t clearDelayMs;
+};
+
+// Bảng cấu hình theo thứ tự AlertChannelId
+static const AlertChannelConfig alertFsmTable[ALERT_CH_COUNT] = {
+  // name        below  hysteresis                 setDelay  minOn   clearDelay
+  { "TEMP",      false, ALERT_HYST_TEMP_C,         0,        10000,  10000 },
+  { "TEMP_RISE", false, ALERT_HYST_TEMP_RISE,      0,        30000,  10000 },
+  { "SMOKE",     false, ALERT_HYST_SMOKE,          1000,     10000,  5000 },
+  { "FIRE",      true,  ALERT_HYST_FIRE,           0,        5000,   2000 },   // Lửa: bật ngay
+  { "RISK",      false, 1.0f,                      1000,     10000,  5000 },
+};
+
+struct AlertChannelState {
+  AlertFsmState state;
+  uint32_t since;         // Thời điểm vào trạng thái PENDING_* / ON
+  uint32_t lastClearAt;
+  bool everCleared;
+  AlertChannelStats stats;
+};
+
+static AlertChannelState channelState[ALERT_CH_COUNT];
+
+static bool aboveSet(const AlertChannelConfig& cfg, float v, float set) {
+  if (isnan(v)) return false;
+  return cfg.below ? (v < set) : (v > set);
+}
+
+static bool belowClear(const AlertChannelConfig& cfg, float v, float set) {
+  if (isnan(v)) return true;
+  return cfg.below ? (v > set + cfg.hysteresis) : (v < set - cfg.hysteresis);
+}
+
+AlertFsmResult alertFsmEvaluate(const float values[ALERT_CH_COUNT], const float setThresholds[ALERT_CH_COUNT],
+                                uint32_t nowMs) {
+  AlertFsmResult res = { 0, 0, 0 };
+  for (uint8_t i = 0; i < ALERT_CH_COUNT; i++) {
+    const AlertChannelConfig& cfg = alertFsmTable[i];
+    AlertChannelState& st = channelState[i];
+    float v = values[i];
+    float set = setThresholds[i];
+    bool enterOn = false;
+
+    switch (st.state) {
+      case ALERT_FSM_OFF:
+        if (aboveSet(cfg, v, set)) {
+          if (cfg.setDelayMs == 0) enterOn = true;
+          else {
+            st.state = ALERT_FSM_PENDING_ON;
+            st.since = nowMs;
+          }
+        }
+        break;
+      case ALERT_FSM_PENDING_ON:
+        if (!aboveSet(cfg, v, set)) st.state = ALERT_FSM_OFF;
+        else if (nowMs - st.since >= cfg.setDelayMs) enterOn = true;
+        break;
+      case ALERT_FSM_ON:
+        if (nowMs - st.since >= cfg.minOnMs && belowClear(cfg, v, set)) {
+          st.state = ALERT_FSM_PENDING_OFF;
+          st.since = nowMs;
+        }
+        break;
+      case ALERT_FSM_PENDING_OFF:
+        if (!belowClear(cfg, v, set)) {
+          st.state = ALERT_FSM_ON;  // Quay lại vùng cảnh báo: vẫn là sự kiện cũ
+        } else if (nowMs - st.since >= cfg.clearDelayMs) {
+          st.state = ALERT_FSM_OFF;
+          st.lastClearAt = nowMs;
+          st.everCleared = true;
+          res.clearedMask |= (1 << i);
+        }
+        break;
+    }
+
+    if (enterOn) {
+      st.state = ALERT_FSM_ON;
+      st.since = nowMs;
+      if (st.everCleared && nowMs - st.lastClearAt < ALERT_COALESCE_MS) {
+        st.stats.coalesced++;
+      } else {
+        st.stats.events++;
+        res.raisedMask |= (1 << i);
+      }
+    }
+
+    st.stats.active = (st.state == ALERT_FSM_ON || st.state == ALERT_FSM_PENDING_OFF);
+    if (st.stats.active) res.activeMask |= (1 << i);
+  }
+  return res;
+}
+
+const char* alertReasonName(uint16_t reasonBit) {
+  for (uint8_t i = 0; i < ALERT_CH_COUNT; i++) {
+    if (reasonBit == (1 << i)) return alertFsmTable[i].name;
+  }
+  if (reasonBit == ALERT_REASON_HOT_GAS) return "HOT_GAS";
+  return "";
+}
+
+void alertReasonPrint(uint16_t mask) {
+  bool first = true;
+  for (uint8_t b = 0; b < 16; b++) {
+    uint16_t bit = 1 << b;
+    if (!(mask & bit)) continue;
+    const char* name = alertReasonName(bit);
+    if (!name[0]) continue;
+    if (!first) Serial.print('|');
+    Serial.print(name);
+    first = false;
+  }
+  if (first) Serial.print("NONE");
+}
+
+AlertChannelStats alertFsmGetStats(AlertChannelId ch) {
+  if (ch >= ALERT_CH_COUNT) return AlertChannelStats();
+  return channelState[ch].stats;
+}
@@ -0,0 +1,68 @@
+#ifndef ALERT_FSM_H
+#define ALERT_FSM_H
+
+/**
+ * @file alert_fsm.h
+ * @brief Máy trạng thái cảnh báo theo bảng: mỗi kênh có ngưỡng bật/tắt (hysteresis), thời gian
+ * xác nhận bật, thời gian bật tối thiểu, thời gian xác nhận tắt và cửa sổ gộp dao động (flap).
+ *
+ * Không cấp phát, không String: kết quả là bitmask AlertReason để log/upload tự diễn giải.
+ */
+
+#include <Arduino.h>
+#include "config.h"
+
+// Kênh cảnh báo (thứ tự = thứ tự hàng trong bảng alertFsmTable)
+enum AlertChannelId : uint8_t {
+  ALERT_CH_TEMP = 0,
+  ALERT_CH_TEMP_RISE,
+  ALERT_CH_SMOKE,
+  ALERT_CH_FIRE,
+  ALERT_CH_RISK,
+  ALERT_CH_COUNT
+};
+
+// Mã lý do dạng bitmask; bit 0..ALERT_CH_COUNT-1 trùng chỉ số kênh
+enum AlertReason : uint16_t {
+  ALERT_REASON_NONE = 0,
+  ALERT_REASON_TEMP = 1 << ALERT_CH_TEMP,
+  ALERT_REASON_TEMP_RISE = 1 << ALERT_CH_TEMP_RISE,
+  ALERT_REASON_SMOKE = 1 << ALERT_CH_SMOKE,
+  ALERT_REASON_FIRE = 1 << ALERT_CH_FIRE,
+  ALERT_REASON_RISK = 1 << ALERT_CH_RISK,
+  ALERT_REASON_HOT_GAS = 1 << 8   // Điều kiện chéo pin nóng + khí tăng (không phải kênh FSM)
+};
+
+struct AlertFsmResult {
+  uint16_t activeMask;   // Kênh đang ở trạng thái cảnh báo (gồm cả đang chờ tắt)
+  uint16_t raisedMask;   // Kênh vừa bật thành sự kiện mới (đã loại lần bật lại trong cửa sổ gộp)
+  uint16_t clearedMask;  // Kênh vừa tắt hẳn
+};
+
+struct AlertChannelStats {
+  uint32_t events;       // Số lần bật được tính là sự kiện mới
+  uint32_t coalesced;    // Số lần bật lại bị gộp vào sự kiện trước (flap)
+  bool active;
+};
+
+/**
+ * @brief Đánh giá mọi kênh một lượt.
+ * @param values Giá trị đo từng kênh (NAN = không có dữ liệu, coi như phía an toàn).
+ * @param setThresholds Ngưỡng bật từng kênh; ngưỡng tắt = ngưỡng bật ∓ hysteresis trong bảng.
+ */
+AlertFsmResult alertFsmEvaluate(const float values[ALERT_CH_COUNT], const float setThresholds[ALERT_CH_COUNT],
+                                uint32_t nowMs);
+
+/**
+ * @brief Tên ngắn của một bit lý do (cho log/JSON), "" nếu bit không hợp lệ.
+ */
+const char* alertReasonName(uint16_t reasonBit);
+
+/**
+ * @brief In danh sách lý do dạng "TEMP|SMOKE" ra Serial, không tạo chuỗi tạm.
+ */
+void alertReasonPrint(uint16_t mask);
+
+AlertChannelStats alertFsmGetStats(AlertChannelId ch);
+
+#endif
@@ -0,0 +1,466 @@
+#include "at_engine.h"
+#include <atomic>
+
+/**
+ * @file at_engine.cpp
+ * @brief Task RX, ring chuyển tiếp cho TinyGSM, hàng đợi lệnh và phát URC (xem at_engine.h).
+ */
+
+static_assert((AT_ENGINE_RX_RING & (AT_ENGINE_RX_RING - 1)) == 0, "AT_ENGINE_RX_RING phai la luy thua cua 2");
+
+enum AtSlotState : uint8_t {
+  SLOT_FREE = 0,
+  SLOT_QUEUED,
+  SLOT_RUNNING,
+  SLOT_DONE
+};
+
+struct AtSlot {
+  volatile AtSlotState state;
+  AtPriority prio;
+  uint32_t seq;                   // Thứ tự đưa vào, FIFO trong cùng mức ưu tiên
+  char cmd[AT_ENGINE_CMD_MAX];
+  uint32_t timeoutMs;
+  uint32_t startMs;
+  AtCallback callback;            // NULL = lệnh đồng bộ, người gọi chờ `done`
+  void* ctx;
+  TaskHandle_t submitter;
+  SemaphoreHandle_t done;
+  AtCommandState cmdState;
+  uint32_t elapsedMs;
+};
+
+static HardwareSerial* uart = NULL;
+static TaskHandle_t rxTask = NULL;
+static SemaphoreHandle_t uartMutex = NULL;     // Khóa UART (recursive)
+static SemaphoreHandle_t rxPauseMutex = NULL;  // Task RX giữ khi đọc; atEngineRxPause() giữ khi cấu hình lại UART
+static portMUX_TYPE engineMux = portMUX_INITIALIZER_UNLOCKED;
+
+static AtSlot slots[AT_ENGINE_QUEUE_DEPTH];
+static uint32_t nextSeq = 0;
+static AtSlot* active = NULL;                  // Lệnh engine đang chạy (chỉ task RX ghi)
+static bool activeHoldsLock = false;           // Task RX tự giữ khóa UART cho lệnh hiện tại
+static bool chunkForwarded = false;            // Đoạn byte đang xử lý đã chuyển nguyên vẹn cho TinyGSM
+
+static AtParser rxParser;                      // Chỉ task RX dùng
+static AtParser txTracker;                     // Người ghi (đang giữ khóa UART) dùng
+static char sharedPrefix[AT_CMD_PREFIX_MAX];   // Tiền tố lệnh vừa gửi, chép sang rxParser mỗi đoạn byte
+
+static volatile AtDataSink dataSink = NULL;   // Khác NULL: UART đang chở dữ liệu (PPP), không phải lệnh AT
+static void* dataCtx = NULL;
+static volatile AtDataSink dialSink = NULL;   // Lệnh quay số đang chạy: "CONNECT" thì chuyển sang sink này
+static void* dialCtx = NULL;
+
+static AtUrcHandler urcHandlers[AT_URC_HANDLERS_MAX];
+static uint8_t urcHandlerCount = 0;
+static AtEngineStats stats = {};
+
+// --------------------------------------------------------------------
+// Ring chuyển tiếp byte cho TinyGSM: task RX ghi, task đang giữ khóa UART đọc
+// --------------------------------------------------------------------
+static uint8_t ringBuf[AT_ENGINE_RX_RING];
+static std::atomic<uint32_t> ringHead(0);
+static std::atomic<uint32_t> ringTail(0);
+
+static void ringPush(const uint8_t* data, size_t n) {
+  uint32_t head = ringHead.load(std::memory_order_relaxed);
+  uint32_t tail = ringTail.load(std::memory_order_acquire);
+  for (size_t i = 0; i < n; i++) {
+    if (head - tail >= AT_ENGINE_RX_RING) {
+      stats.passthroughOverflows += (uint32_t)(n - i);
+      break;
+    }
+    ringBuf[head & (AT_ENGINE_RX_RING - 1)] = data[i];
+    head++;
+  }
+  ringHead.store(head, std::memory_order_release);
+}
+
+static void ringPushLine(const char* line) {
+  static const uint8_t crlf[2] = { '\r', '\n' };
+  ringPush(crlf, 2);
+  ringPush((const uint8_t*)line, strlen(line));
+  ringPush(crlf, 2);
+}
+
+/**
+ * @brief Stream TinyGSM đọc/ghi: đọc từ ring, ghi thẳng UART và ghi nhận lệnh vừa gửi.
+ */
+class AtStream : public Stream {
+ public:
+  int available() override {
+    return (int)(ringHead.load(std::memory_order_acquire) - ringTail.load(std::memory_order_relaxed));
+  }
+  int read() override {
+    uint32_t tail = ringTail.load(std::memory_order_relaxed);
+    if (ringHead.load(std::memory_order_acquire) == tail) return -1;
+    uint8_t c = ringBuf[tail & (AT_ENGINE_RX_RING - 1)];
+    ringTail.store(tail + 1, std::memory_order_release);
+    return c;
+  }
+  int peek() override {
+    uint32_t tail = ringTail.load(std::memory_order_relaxed);
+    if (ringHead.load(std::memory_order_acquire) == tail) return -1;
+    return ringBuf[tail & (AT_ENGINE_RX_RING - 1)];
+  }
+  using Print::write;
+  size_t write(uint8_t c) override { return write(&c, 1); }
+  size_t write(const uint8_t* buf, size_t size) override {
+    if (uart == NULL) return 0;
+    atParserNoteTx(txTracker, buf, size);
+    portENTER_CRITICAL(&engineMux);
+    memcpy(sharedPrefix, txTracker.cmdPrefix, AT_CMD_PREFIX_MAX);
+    portEXIT_CRITICAL(&engineMux);
+    return uart->write(buf, size);
+  }
+  void flush() override {
+    if (uart) uart->flush();
+  }
+};
+
+Stream& atEngineStream() {
+  static AtStream stream;
+  return stream;
+}
+
+// --------------------------------------------------------------------
+// Khóa UART
+// --------------------------------------------------------------------
+static void createLocks() {
+  if (uartMutex == NULL) uartMutex = xSemaphoreCreateRecursiveMutex();
+  if (rxPauseMutex == NULL) rxPauseMutex = xSemaphoreCreateMutex();
+}
+
+bool atEngineLock(TickType_t wait) {
+  createLocks();
+  return xSemaphoreTakeRecursive(uartMutex, wait) == pdTRUE;
+}
+
+void atEngineUnlock() {
+  xSemaphoreGiveRecursive(uartMutex);
+}
+
+void atEngineRxPause(bool paused) {
+  createLocks();
+  if (paused) {
+    xSemaphoreTake(rxPauseMutex, portMAX_DELAY);
+  } else {
+    xSemaphoreGive(rxPauseMutex);
+  }
+}
+
+// --------------------------------------------------------------------
+// Hàng đợi lệnh (chạy trong task RX)
+// --------------------------------------------------------------------
+static void finishActive() {
+  AtSlot* slot = active;
+  slot->elapsedMs = millis() - slot->startMs;
+  active = NULL;
+  if (activeHoldsLock) {
+    atEngineUnlock();
+    activeHoldsLock = false;
+  }
+
+  AtStatus status = slot->cmdState.status;
+  stats.commands++;
+  if (status == AT_ERROR) stats.errors++;
+  if (status == AT_TIMEOUT) stats.timeouts++;
+  stats.lastLatencyMs = slot->elapsedMs;
+  if (slot->elapsedMs > stats.maxLatencyMs) stats.maxLatencyMs = slot->elapsedMs;
+  if (status != AT_OK) {
+    Serial.printf("[AT] AT%s -> %s (%lu ms) %s\n", slot->cmd, status == AT_TIMEOUT ? "TIMEOUT" : "ERROR",
+                  (unsigned long)slot->elapsedMs, slot->cmdState.response);
+  }
+
+  if (slot->callback) {
+    AtResult result;
+    result.status = status;
+    result.cmeError = slot->cmdState.cmeError;
+    result.elapsedMs = slot->elapsedMs;
+    memcpy(result.response, slot->cmdState.response, AT_RESPONSE_MAX);
+    slot->callback(result, slot->ctx);
+    slot->state = SLOT_FREE;
+  } else {
+    slot->state = SLOT_DONE;
+    xSemaphoreGive(slot->done);
+  }
+}
+
+/**
+ * @brief Chọn lệnh kế tiếp. Khóa UART đang bị giữ thì chỉ chạy được lệnh của chính task giữ khóa
+ * (task đó đang chờ kết quả); khóa rảnh thì chọn ưu tiên cao nhất, cùng mức thì cũ nhất.
+ */
+static AtSlot* pickNext(TaskHandle_t holder) {
+  AtSlot* best = NULL;
+  for (uint8_t i = 0; i < AT_ENGINE_QUEUE_DEPTH; i++) {
+    AtSlot* s = &slots[i];
+    if (s->state != SLOT_QUEUED) continue;
+    if (holder != NULL && s->submitter != holder) continue;
+    if (best == NULL || s->prio > best->prio || (s->prio == best->prio && (int32_t)(s->seq - best->seq) < 0)) {
+      best = s;
+    }
+  }
+  return best;
+}
+
+static void serviceCommands() {
+  if (dataSink != NULL) return;
+  if (active != NULL) {
+    if (millis() - active->startMs >= active->timeoutMs) {
+      active->cmdState.status = AT_TIMEOUT;
+      finishActive();
+    }
+    if (active != NULL) return;
+  }
+
+  TaskHandle_t holder = xSemaphoreGetMutexHolder(uartMutex);
+  portENTER_CRITICAL(&engineMux);
+  AtSlot* next = pickNext(holder);
+  if (next != NULL) next->state = SLOT_RUNNING;
+  portEXIT_CRITICAL(&engineMux);
+  if (next == NULL) return;
+
+  if (holder == NULL) {
+    if (!atEngineLock(0)) {
+      // Task khác vừa giành khóa: trả lệnh về hàng đợi, thử lại vòng sau
+      next->state = SLOT_QUEUED;
+      return;
+    }
+    activeHoldsLock = true;
+  }
+  atCommandStart(next->cmdState, next->cmdState.finalPrefix);
+  next->startMs = millis();
+  active = next;
+  Stream& stream = atEngineStream();
+  stream.write((const uint8_t*)"AT", 2);
+  stream.write((const uint8_t*)next->cmd, strlen(next->cmd));
+  stream.write((const uint8_t*)"\r", 1);
+}
+
+// --------------------------------------------------------------------
+// Task RX
+// --------------------------------------------------------------------
+static void onLine(void* ctx, const char* line, AtLineKind kind, AtUrc urc) {
+  (void)ctx;
+  if (kind == AT_LINE_URC) {
+    stats.urcs[urc]++;
+    for (uint8_t i = 0; i < urcHandlerCount; i++) urcHandlers[i](urc, line);
+    if (!chunkForwarded) ringPushLine(line);  // TinyGSM vẫn cần thấy URC (+CIPRXGET, +IPCLOSE...)
+    return;
+  }
+  if (active != NULL && dialSink != NULL && kind == AT_LINE_DATA && strncmp(line, "CONNECT", 7) == 0) {
+    // Byte ngay sau "CONNECT" đã là khung PPP: dừng tách dòng, onRx chuyển phần còn lại cho sink
+    dataCtx = dialCtx;
+    dataSink = dialSink;
+    dialSink = NULL;
+    rxParser.halt = true;
+    active->cmdState.status = AT_OK;
+    finishActive();
+    return;
+  }
+  if (active != NULL && atCommandOnLine(active->cmdState, line, kind)) finishActive();
+  // Không có lệnh engine: dòng thuộc giao dịch TinyGSM, byte đã được chuyển nguyên vẹn
+}
+
+static void onRx(const uint8_t* data, size_t n) {
+  stats.rxBytes += n;
+  if (dataSink != NULL) {
+    dataSink(data, n, dataCtx);
+    return;
+  }
+  portENTER_CRITICAL(&engineMux);
+  memcpy(rxParser.cmdPrefix, sharedPrefix, AT_CMD_PREFIX_MAX);
+  portEXIT_CRITICAL(&engineMux);
+  chunkForwarded = (active == NULL);
+  if (chunkForwarded) ringPush(data, n);
+  size_t used = atParserFeed(rxParser, data, n, onLine, NULL);
+  if (used < n && dataSink != NULL) dataSink(data + used, n - used, dataCtx);
+  stats.lines = rxParser.lines;
+  stats.truncatedLines = rxParser.truncatedLines;
+}
+
+static void wakeRxTask() {
+  if (rxTask != NULL) xTaskNotifyGive(rxTask);
+}
+
+/**
+ * @brief Lỗi nhận của driver UART (task sự kiện UART): chỉ đếm, cellular quyết định hạ baud.
+ */
+static void onUartError(hardwareSerial_error_t err) {
+  if (err == UART_FIFO_OVF_ERROR || err == UART_BUFFER_FULL_ERROR) stats.uartOverruns++;
+  else if (err == UART_FRAME_ERROR || err == UART_PARITY_ERROR) stats.uartFrameErrors++;
+}
+
+static void atRxTask(void* param) {
+  uint8_t buf[256];  // Ở 921600 baud mỗi lần thức có thể có vài trăm byte
+  while (true) {
+    xSemaphoreTake(rxPauseMutex, portMAX_DELAY);
+    int avail;
+    while ((avail = uart->available()) > 0) {
+      size_t n = uart->read(buf, avail > (int)sizeof(buf) ? sizeof(buf) : (size_t)avail);
+      if (n == 0) break;
+      onRx(buf, n);
+    }
+    xSemaphoreGive(rxPauseMutex);
+    serviceCommands();
+    // Thức dậy khi UART báo có dữ liệu hoặc có lệnh mới; 5 ms để kiểm tra timeout lệnh
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(5));
+  }
+}
+
+bool atEngineBegin(HardwareSerial& port) {
+  createLocks();
+  uart = &port;
+  uart->onReceive(wakeRxTask);
+  uart->onReceiveError(onUartError);
+  if (rxTask != NULL) return true;
+  for (uint8_t i = 0; i < AT_ENGINE_QUEUE_DEPTH; i++) {
+    if (slots[i].done == NULL) slots[i].done = xSemaphoreCreateBinary();
+  }
+  atParserReset(rxParser);
+  atParserReset(txTracker);
+  if (xTaskCreatePinnedToCore(atRxTask, "atRxTask", 4096, NULL, AT_ENGINE_TASK_PRIORITY, &rxTask,
+                              AT_ENGINE_TASK_CORE) != pdPASS) {
+    rxTask = NULL;
+    Serial.println("[AT] Không tạo được task RX");
+    return false;
+  }
+  return true;
+}
+
+// --------------------------------------------------------------------
+// API gửi lệnh
+// --------------------------------------------------------------------
+static AtSlot* enqueue(const char* cmd, uint32_t timeoutMs, AtPriority prio, const char* finalPrefix,
+                       AtCallback callback, void* ctx) {
+  if (rxTask == NULL || dataSink != NULL || strlen(cmd) >= AT_ENGINE_CMD_MAX) {
+    stats.rejected++;
+    return NULL;
+  }
+  AtSlot* slot = NULL;
+  uint32_t queued = 0;
+  portENTER_CRITICAL(&engineMux);
+  for (uint8_t i = 0; i < AT_ENGINE_QUEUE_DEPTH; i++) {
+    if (slots[i].state != SLOT_FREE) {
+      queued++;
+    } else if (slot == NULL) {
+      slot = &slots[i];
+      slot->state = SLOT_DONE;  // Giữ chỗ, chưa cho task RX thấy
+    }
+  }
+  portEXIT_CRITICAL(&engineMux);
+  if (slot == NULL) {
+    stats.rejected++;
+    return NULL;
+  }
+  if (queued + 1 > stats.queueHighWater) stats.queueHighWater = queued + 1;
+
+  strcpy(slot->cmd, cmd);
+  slot->timeoutMs = timeoutMs;
+  slot->prio = prio;
+  slot->callback = callback;
+  slot->ctx = ctx;
+  slot->submitter = xTaskGetCurrentTaskHandle();
+  slot->cmdState.finalPrefix = finalPrefix;
+  xSemaphoreTake(slot->done, 0);  // Xóa tín hiệu cũ nếu có
+  portENTER_CRITICAL(&engineMux);
+  slot->seq = nextSeq++;
+  slot->state = SLOT_QUEUED;
+  portEXIT_CRITICAL(&engineMux);
+  wakeRxTask();
+  return slot;
+}
+
+bool atSubmit(const char* cmd, uint32_t timeoutMs, AtPriority prio, const char* finalPrefix,
+              AtCallback callback, void* ctx) {
+  // Task đang giữ khóa mà gửi bất đồng bộ thì lệnh sẽ chen vào giữa giao dịch của chính nó
+  if (uartMutex != NULL && xSemaphoreGetMutexHolder(uartMutex) == xTaskGetCurrentTaskHandle()) {
+    stats.rejected++;
+    return false;
+  }
+  return enqueue(cmd, timeoutMs, prio, finalPrefix, callback, ctx) != NULL;
+}
+
+AtStatus atCommand(const char* cmd, uint32_t timeoutMs, AtResult* out, const char* finalPrefix, AtPriority prio) {
+  AtSlot* slot = enqueue(cmd, timeoutMs, prio, finalPrefix, NULL, NULL);
+  if (slot == NULL) {
+    if (out) {
+      out->status = AT_BUSY;
+      out->cmeError = -1;
+      out->elapsedMs = 0;
+      out->response[0] = '\0';
+    }
+    return AT_BUSY;
+  }
+
+  if (xSemaphoreTake(slot->done, pdMS_TO_TICKS(timeoutMs + AT_ENGINE_QUEUE_WAIT_MS)) != pdTRUE) {
+    // Chưa tới lượt thì hủy; đang chạy thì chờ task RX kết thúc (bị chặn bởi timeout của lệnh)
+    bool cancelled = false;
+    portENTER_CRITICAL(&engineMux);
+    if (slot->state == SLOT_QUEUED) {
+      slot->state = SLOT_FREE;
+      cancelled = true;
+    }
+    portEXIT_CRITICAL(&engineMux);
+    if (cancelled) {
+      stats.timeouts++;
+      if (out) {
+        out->status = AT_TIMEOUT;
+        out->cmeError = -1;
+        out->elapsedMs = 0;
+        out->response[0] = '\0';
+      }
+      return AT_TIMEOUT;
+    }
+    xSemaphoreTake(slot->done, portMAX_DELAY);
+  }
+
+  AtStatus status = slot->cmdState.status;
+  if (out) {
+    out->status = status;
+    out->cmeError = slot->cmdState.cmeError;
+    out->elapsedMs = slot->elapsedMs;
+    memcpy(out->response, slot->cmdState.response, AT_RESPONSE_MAX);
+  }
+  slot->state = SLOT_FREE;
+  return status;
+}
+
+bool atOnUrc(AtUrcHandler handler) {
+  if (urcHandlerCount >= AT_URC_HANDLERS_MAX) return false;
+  urcHandlers[urcHandlerCount++] = handler;
+  return true;
+}
+
+AtStatus atEngineDial(const char* cmd, uint32_t timeoutMs, AtDataSink sink, void* ctx) {
+  dialCtx = ctx;
+  dialSink = sink;
+  AtStatus status = atCommand(cmd, timeoutMs, NULL, NULL, AT_PRIO_HIGH);
+  dialSink = NULL;
+  if (status == AT_OK && dataSink == NULL) status = AT_ERROR;  // "OK" mà không có "CONNECT"
+  return status;
+}
+
+void atEngineDataModeExit() {
+  createLocks();
+  xSemaphoreTake(rxPauseMutex, portMAX_DELAY);  // Task RX không ở giữa một đoạn byte
+  dataSink = NULL;
+  dataCtx = NULL;
+  rxParser.len = 0;
+  rxParser.truncated = false;
+  rxParser.binarySkip = 0;
+  xSemaphoreGive(rxPauseMutex);
+}
+
+bool atEngineInDataMode() {
+  return dataSink != NULL;
+}
+
+size_t atEngineWriteRaw(const uint8_t* data, size_t n) {
+  return uart ? uart->write(data, n) : 0;
+}
+
+AtEngineStats atEngineGetStats() {
+  AtEngineStats out = stats;
+  return out;
+}
@@ -0,0 +1,118 @@
+#ifndef AT_ENGINE_H
+#define AT_ENGINE_H
+
+/**
+ * @file at_engine.h
+ * @brief Lớp lệnh AT hướng sự kiện cho modem SIMCOM: task RX đọc UART, tách dòng (at_parser), phát URC
+ * ngay cho các handler đã đăng ký và chạy hàng đợi lệnh có timeout/ưu tiên riêng từng lệnh.
+ *
+ * - TinyGSM vẫn dùng được: nó đọc qua atEngineStream() thay cho UART. Khi không có lệnh của engine,
+ *   mọi byte được chuyển nguyên vẹn cho TinyGSM (kể cả payload socket); URC vẫn được phát song song.
+ * - Khi engine đang chạy một lệnh, các dòng thuộc về lệnh đó; URC chen giữa được chuyển tiếp cho
+ *   TinyGSM dưới dạng dòng để nó vẫn thấy +CIPRXGET/+IPCLOSE.
+ * - Khóa UART (atEngineLock) bảo đảm mỗi lúc chỉ một giao dịch AT. Task đang giữ khóa gọi atCommand()
+ *   thì lệnh chạy thay cho task đó (nó đang chờ kết quả nên không dùng UART); task khác thì engine chờ
+ *   khóa rảnh mới gửi. Giữa các lệnh chờ, lệnh ưu tiên cao hơn chạy trước, cùng mức thì FIFO.
+ * - atSubmit() gọi callback trong task RX: callback phải ngắn, không gọi lại atCommand().
+ */
+
+#include <Arduino.h>
+#include "config.h"
+#include "at_parser.h"
+
+enum AtPriority : uint8_t {
+  AT_PRIO_LOW = 0,     // Truy vấn thống kê (CSQ, CPSI...)
+  AT_PRIO_NORMAL,
+  AT_PRIO_HIGH         // Dựng lại kết nối, đóng mạng
+};
+
+struct AtResult {
+  AtStatus status;
+  int cmeError;                     // Mã +CME/+CMS ERROR, -1 nếu không có
+  uint32_t elapsedMs;               // Từ lúc gửi lệnh tới kết quả cuối
+  char response[AT_RESPONSE_MAX];   // Các dòng phản hồi (không gồm "OK"), nối bằng '\n'
+};
+
+typedef void (*AtCallback)(const AtResult& result, void* ctx);
+typedef void (*AtUrcHandler)(AtUrc urc, const char* line);
+typedef void (*AtDataSink)(const uint8_t* data, size_t n, void* ctx);
+
+struct AtEngineStats {
+  uint32_t rxBytes;
+  uint32_t lines;
+  uint32_t truncatedLines;
+  uint32_t passthroughOverflows;    // Byte bị bỏ vì TinyGSM không đọc kịp ring chuyển tiếp
+  uint32_t uartOverruns;            // FIFO/buffer RX của driver UART tràn: byte đã mất
+  uint32_t uartFrameErrors;         // Lỗi khung/parity (baud lệch, nhiễu đường dây)
+  uint32_t commands;
+  uint32_t errors;
+  uint32_t timeouts;
+  uint32_t rejected;                // Hàng đợi đầy / engine chưa chạy
+  uint32_t queueHighWater;
+  uint32_t lastLatencyMs;
+  uint32_t maxLatencyMs;
+  uint32_t urcs[AT_URC_COUNT];
+};
+
+/**
+ * @brief Khởi động task RX trên UART đã begin() (gọi lại được, chỉ tạo task lần đầu).
+ */
+bool atEngineBegin(HardwareSerial& uart);
+
+/**
+ * @brief Stream cho TinyGSM: đọc từ ring do task RX đổ vào, ghi thẳng ra UART.
+ */
+Stream& atEngineStream();
+
+/**
+ * @brief Giữ/nhả khóa UART (recursive) cho một giao dịch AT.
+ */
+bool atEngineLock(TickType_t wait);
+void atEngineUnlock();
+
+/**
+ * @brief Tạm dừng đọc UART trong lúc end()/begin() lại cổng (dò chân, đổi baud).
+ */
+void atEngineRxPause(bool paused);
+
+/**
+ * @brief Đưa lệnh vào hàng đợi, không chờ. Không gọi được khi đang giữ khóa UART.
+ * @param cmd Lệnh không có tiền tố "AT", ví dụ "+CSQ".
+ * @param finalPrefix Chuỗi hằng, xem atCommandStart(); NULL = xong khi "OK".
+ * @return false nếu hàng đợi đầy (callback không được gọi).
+ */
+bool atSubmit(const char* cmd, uint32_t timeoutMs, AtPriority prio, const char* finalPrefix,
+              AtCallback callback, void* ctx);
+
+/**
+ * @brief Gửi lệnh và chờ kết quả (future đồng bộ).
+ * @param out NULL nếu không cần nội dung phản hồi.
+ */
+AtStatus atCommand(const char* cmd, uint32_t timeoutMs, AtResult* out, const char* finalPrefix, AtPriority prio);
+
+/**
+ * @brief Đăng ký handler URC (tối đa AT_URC_HANDLERS_MAX), gọi trong task RX ngay khi nhận dòng.
+ */
+bool atOnUrc(AtUrcHandler handler);
+
+/**
+ * @brief Quay số vào chế độ dữ liệu (PPP): gửi `cmd` (vd "D*99#"); modem trả "CONNECT" thì từ byte kế tiếp
+ * mọi dữ liệu RX đi thẳng vào `sink` (gọi trong task RX), không tách dòng, lệnh AT mới bị từ chối.
+ * @return AT_OK khi đã vào chế độ dữ liệu.
+ */
+AtStatus atEngineDial(const char* cmd, uint32_t timeoutMs, AtDataSink sink, void* ctx);
+
+/**
+ * @brief Về lại chế độ lệnh (gọi sau khi modem đã thoát bằng "+++" hoặc tự báo NO CARRIER).
+ */
+void atEngineDataModeExit();
+bool atEngineInDataMode();
+
+/**
+ * @brief Ghi byte thô ra UART (khung PPP), không qua bộ theo dõi lệnh.
+ */
+size_t atEngineWriteRaw(const uint8_t* data, size_t n);
+
+AtEngineStats atEngineGetStats();
+
+#endif
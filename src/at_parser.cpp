@@ -0,0 +1,263 @@
+#include "at_parser.h"
+#include <string.h>
+#include <stdlib.h>
+
+/**
+ * @file at_parser.cpp
+ * @brief Tách dòng, phân loại URC và máy trạng thái lệnh AT (xem at_parser.h).
+ */
+
+struct UrcRule {
+  const char* prefix;
+  AtUrc urc;
+  bool exact;     // true: cả dòng phải trùng (RDY)
+};
+
+static const UrcRule URC_RULES[] = {
+  { "+CIPEVENT:", AT_URC_CIPEVENT, false },
+  { "+NETCLOSE:", AT_URC_NETCLOSE, false },
+  { "+IPCLOSE:", AT_URC_IPCLOSE, false },
+  { "+CGEV:", AT_URC_CGEV, false },
+  { "RDY", AT_URC_RDY, true },
+  { "+CPIN:", AT_URC_CPIN, false },
+  { "+CIPRXGET: 1,", AT_URC_CIPRXGET, false },
+  { "+CREG:", AT_URC_CREG, false },
+  { "+CGREG:", AT_URC_CREG, false },
+  { "+CEREG:", AT_URC_CREG, false },
+  { "+CHTTPSNOTIFY:", AT_URC_CHTTPS, false },
+  { "+CHTTPS: RECV EVENT", AT_URC_CHTTPS, false },
+};
+
+// Lệnh gửi kèm payload sau dấu nhắc '>': số byte payload nằm ở tham số thứ `argIndex` (-1 = tham số cuối)
+struct TxPayloadRule {
+  const char* prefix;
+  int8_t argIndex;
+};
+
+static const TxPayloadRule TX_PAYLOAD_RULES[] = {
+  { "+CIPSEND", -1 },      // AT+CIPSEND=<mux>,<len>
+  { "+CHTTPSPOST", -1 },   // AT+CHTTPSPOST="<path>",,<len>
+  { "+CHTTPSSEND", 0 },    // AT+CHTTPSSEND=<len>
+};
+
+static bool startsWith(const char* s, const char* prefix) {
+  return strncmp(s, prefix, strlen(prefix)) == 0;
+}
+
+// Số nguyên ở tham số thứ `index` (phân tách bởi ',') của chuỗi; -1 = tham số cuối
+static long argAt(const char* args, int index) {
+  const char* p = args;
+  if (index < 0) {
+    const char* last = strrchr(args, ',');
+    p = last ? last + 1 : args;
+  } else {
+    for (int i = 0; i < index && p; i++) {
+      p = strchr(p, ',');
+      if (p) p++;
+    }
+    if (!p) return 0;
+  }
+  long v = strtol(p, NULL, 10);
+  return v > 0 ? v : 0;
+}
+
+void atParserReset(AtParser& p) {
+  memset(&p, 0, sizeof(p));
+}
+
+void atParserNoteTx(AtParser& p, const uint8_t* data, size_t n) {
+  for (size_t i = 0; i < n; i++) {
+    char c = (char)data[i];
+    if (p.txSkip > 0) {
+      // Payload socket đi sau dấu nhắc: không phải lệnh
+      p.txSkip--;
+      continue;
+    }
+    switch (p.txState) {
+      case 0:
+        if (c == 'A' || c == 'a') p.txState = 1;
+        break;
+      case 1:
+        if (c == 'T' || c == 't') {
+          p.txState = 2;
+          p.txLen = 0;
+          p.txArgsLen = 0;
+        } else if (c != 'A' && c != 'a') {
+          p.txState = 0;
+        }
+        break;
+      case 2:
+        if ((c == '+' && p.txLen == 0) ||
+            (p.txLen > 0 && ((c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || (c >= '0' && c <= '9')))) {
+          if (p.txLen < AT_CMD_PREFIX_MAX - 1) p.txPrefix[p.txLen++] = c;
+          break;
+        }
+        // Hết tên lệnh: "+XXX" thành tiền tố phản hồi, lệnh cơ bản (ATE0, AT) thì không có
+        p.txPrefix[p.txLen] = '\0';
+        if (p.txLen > 1 && p.txPrefix[0] == '+') {
+          memcpy(p.cmdPrefix, p.txPrefix, p.txLen + 1);
+        } else {
+          p.cmdPrefix[0] = '\0';
+        }
+        p.txState = 3;
+        // Ký tự hiện tại ('=', '?', '\r') xử lý như phần tham số
+        // fallthrough
+      case 3:
+        if (c == '\r') {
+          p.txArgs[p.txArgsLen] = '\0';
+          for (size_t r = 0; r < sizeof(TX_PAYLOAD_RULES) / sizeof(TX_PAYLOAD_RULES[0]); r++) {
+            if (strcmp(p.cmdPrefix, TX_PAYLOAD_RULES[r].prefix) == 0) {
+              p.txSkip = (uint32_t)argAt(p.txArgs, TX_PAYLOAD_RULES[r].argIndex);
+              break;
+            }
+          }
+          p.txState = 0;
+        } else if (c != '=' && p.txArgsLen < sizeof(p.txArgs) - 1) {
+          p.txArgs[p.txArgsLen++] = c;
+        }
+        break;
+    }
+  }
+}
+
+AtLineKind atClassifyLine(const char* line, const char* cmdPrefix, AtUrc& urc) {
+  urc = AT_URC_NONE;
+  if (strcmp(line, "OK") == 0) return AT_LINE_OK;
+  if (strcmp(line, "ERROR") == 0 || startsWith(line, "+CME ERROR:") || startsWith(line, "+CMS ERROR:") ||
+      strcmp(line, "NO CARRIER") == 0) {
+    return AT_LINE_ERROR;
+  }
+  size_t prefixLen = cmdPrefix ? strlen(cmdPrefix) : 0;
+  if (prefixLen > 0 && strncmp(line, cmdPrefix, prefixLen) == 0 && line[prefixLen] == ':') {
+    return AT_LINE_DATA;  // Phản hồi của chính lệnh vừa gửi
+  }
+  for (size_t r = 0; r < sizeof(URC_RULES) / sizeof(URC_RULES[0]); r++) {
+    const UrcRule& rule = URC_RULES[r];
+    if (rule.exact ? strcmp(line, rule.prefix) == 0 : startsWith(line, rule.prefix)) {
+      urc = rule.urc;
+      return AT_LINE_URC;
+    }
+  }
+  return AT_LINE_DATA;
+}
+
+/**
+ * @brief Kết thúc một dòng: phân loại, gọi sink, rồi đặt số byte payload cần bỏ qua nếu là header dữ liệu socket.
+ */
+static void emitLine(AtParser& p, AtLineSink sink, void* ctx) {
+  p.line[p.len] = '\0';
+  bool wasTruncated = p.truncated;
+  uint16_t len = p.len;
+  p.len = 0;
+  p.truncated = false;
+  if (len == 0 && !wasTruncated) return;  // Dòng rỗng giữa "\r\n\r\n"
+
+  p.lines++;
+  if (wasTruncated) p.truncatedLines++;
+  AtUrc urc;
+  AtLineKind kind = atClassifyLine(p.line, p.cmdPrefix, urc);
+  if (sink) sink(ctx, p.line, kind, urc);
+
+  if (startsWith(p.line, "+CIPRXGET: 2,")) {
+    p.binarySkip = (uint32_t)argAt(p.line + 13, 1);   // 2,<mux>,<len>,<còn lại>
+  } else if (startsWith(p.line, "+CHTTPSRECV: DATA,")) {
+    p.binarySkip = (uint32_t)argAt(p.line + 18, 0);
+  }
+}
+
+size_t atParserFeed(AtParser& p, const uint8_t* data, size_t n, AtLineSink sink, void* ctx) {
+  for (size_t i = 0; i < n; i++) {
+    if (p.binarySkip > 0) {
+      // Bỏ nhanh cả đoạn payload còn lại trong buffer này
+      size_t skip = n - i;
+      if (skip > p.binarySkip) skip = p.binarySkip;
+      p.binarySkip -= (uint32_t)skip;
+      i += skip - 1;
+      continue;
+    }
+    char c = (char)data[i];
+    if (c == '\n') {
+      emitLine(p, sink, ctx);
+      if (p.halt) {
+        p.halt = false;
+        return i + 1;
+      }
+    } else if (c != '\r') {
+      if (p.len < AT_LINE_MAX - 1) {
+        p.line[p.len++] = c;
+      } else {
+        p.truncated = true;
+      }
+    }
+  }
+  return n;
+}
+
+const char* atUrcName(AtUrc urc) {
+  switch (urc) {
+    case AT_URC_CIPEVENT: return "cipevent";
+    case AT_URC_NETCLOSE: return "netclose";
+    case AT_URC_IPCLOSE: return "ipclose";
+    case AT_URC_CGEV: return "cgev";
+    case AT_URC_RDY: return "rdy";
+    case AT_URC_CPIN: return "cpin";
+    case AT_URC_CIPRXGET: return "ciprxget";
+    case AT_URC_CREG: return "creg";
+    case AT_URC_CHTTPS: return "chttps";
+    default: return "none";
+  }
+}
+
+void atCommandStart(AtCommandState& c, const char* finalPrefix) {
+  c.finalPrefix = finalPrefix;
+  c.gotOk = false;
+  c.gotFinal = false;
+  c.status = AT_PENDING;
+  c.cmeError = -1;
+  c.response[0] = '\0';
+  c.responseLen = 0;
+}
+
+static void appendResponse(AtCommandState& c, const char* line) {
+  size_t len = strlen(line);
+  size_t room = AT_RESPONSE_MAX - 1 - c.responseLen;
+  if (c.responseLen > 0 && room > 0) {
+    c.response[c.responseLen++] = '\n';
+    room--;
+  }
+  if (len > room) len = room;
+  memcpy(c.response + c.responseLen, line, len);
+  c.responseLen += (uint16_t)len;
+  c.response[c.responseLen] = '\0';
+}
+
+bool atCommandOnLine(AtCommandState& c, const char* line, AtLineKind kind) {
+  if (c.status != AT_PENDING) return true;
+  switch (kind) {
+    case AT_LINE_OK:
+      if (c.finalPrefix && !c.gotFinal) {
+        c.gotOk = true;  // Kết quả thật tới sau (ví dụ "+NETOPEN: 0")
+        return false;
+      }
+      c.status = AT_OK;
+      return true;
+    case AT_LINE_ERROR:
+      appendResponse(c, line);
+      if (startsWith(line, "+CME ERROR:") || startsWith(line, "+CMS ERROR:")) c.cmeError = atoi(line + 11);
+      c.status = AT_ERROR;
+      return true;
+    case AT_LINE_DATA:
+      appendResponse(c, line);
+      if (c.finalPrefix && startsWith(line, c.finalPrefix)) {
+        // Tới trước "OK" thì vẫn chờ kết quả cuối, tránh để "OK"/"ERROR" lọt sang lệnh sau
+        c.gotFinal = true;
+        if (c.gotOk) {
+          c.status = AT_OK;
+          return true;
+        }
+      }
+      return false;
+    default:
+      return false;  // URC không thuộc về lệnh
+  }
+}
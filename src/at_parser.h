@@ -0,0 +1,123 @@
+#ifndef AT_PARSER_H
+#define AT_PARSER_H
+
+/**
+ * @file at_parser.h
+ * @brief Tách luồng byte UART của modem SIMCOM thành từng dòng, phân loại (kết quả cuối, URC, dòng dữ
+ * liệu) và máy trạng thái hoàn tất một lệnh AT.
+ *
+ * Thuần C++ (không Arduino/FreeRTOS, không cấp phát) để chạy được trên máy host với modem giả lập
+ * theo kịch bản và fuzz bằng byte ngẫu nhiên; at_engine chỉ là lớp dán FreeRTOS/UART bên ngoài.
+ *
+ * - Dòng dài quá AT_LINE_MAX bị cắt (phần thừa bỏ đi), không bao giờ ghi tràn.
+ * - Sau header "+CIPRXGET: 2,<mux>,<len>,..." hoặc "+CHTTPSRECV: DATA,<len>" bỏ qua đúng <len> byte
+ *   payload socket để dữ liệu nhị phân không bị hiểu nhầm thành URC.
+ * - Dòng trùng tiền tố với lệnh vừa gửi (theo dõi qua atParserNoteTx) là phản hồi, không phải URC:
+ *   "+CPIN: READY" sau AT+CPIN? hay "+NETCLOSE: 0" sau AT+NETCLOSE.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define AT_LINE_MAX 128         // Kể cả ký tự kết thúc chuỗi
+#define AT_CMD_PREFIX_MAX 16    // "+CDNSGIP", "+NETCLOSE"...
+#define AT_RESPONSE_MAX 192     // Các dòng dữ liệu của một lệnh, nối bằng '\n'
+
+enum AtLineKind : uint8_t {
+  AT_LINE_DATA = 0,    // Dòng trung gian/phản hồi của lệnh đang chạy
+  AT_LINE_OK,          // "OK"
+  AT_LINE_ERROR,       // "ERROR", "+CME ERROR: n", "+CMS ERROR: n", "NO CARRIER"
+  AT_LINE_URC          // Mã kết quả tự phát (xem AtUrc)
+};
+
+enum AtUrc : uint8_t {
+  AT_URC_NONE = 0,
+  AT_URC_CIPEVENT,     // +CIPEVENT: NETWORK CLOSED UNEXPECTEDLY → mất data context
+  AT_URC_NETCLOSE,     // +NETCLOSE: n ngoài lệnh AT+NETCLOSE → mạng đã đóng
+  AT_URC_IPCLOSE,      // +IPCLOSE: <mux>,<lý do> → server/NAT đóng socket
+  AT_URC_CGEV,         // +CGEV: NW DEACT / ME DETACH... → PDP bị hủy
+  AT_URC_RDY,          // RDY → modem vừa tự khởi động lại
+  AT_URC_CPIN,         // +CPIN: ... ngoài lệnh AT+CPIN? (thường là NOT READY khi SIM lỏng)
+  AT_URC_CIPRXGET,     // +CIPRXGET: 1,<mux> → socket có dữ liệu chờ đọc
+  AT_URC_CREG,         // +CREG/+CGREG/+CEREG ngoài lệnh truy vấn → đổi trạng thái đăng ký mạng
+  AT_URC_CHTTPS,       // +CHTTPSNOTIFY: PEER CLOSED / +CHTTPS: RECV EVENT → phiên HTTPS của modem
+  AT_URC_COUNT
+};
+
+struct AtParser {
+  char line[AT_LINE_MAX];
+  uint16_t len;
+  bool truncated;
+  uint32_t binarySkip;                // Số byte payload socket còn phải bỏ qua
+  char cmdPrefix[AT_CMD_PREFIX_MAX];  // Tiền tố phản hồi của lệnh gửi gần nhất, "" nếu không có
+  char txPrefix[AT_CMD_PREFIX_MAX];   // Đang gom tên lệnh từ luồng TX
+  uint8_t txLen;
+  uint8_t txState;                    // 0 = chờ "AT", 1 = đã thấy 'A', 2 = đang gom tên, 3 = gom tham số tới '\r'
+  char txArgs[24];                    // Tham số sau '=' (chỉ để đọc độ dài payload của AT+CIPSEND...)
+  uint8_t txArgsLen;
+  uint32_t txSkip;                    // Số byte payload đi sau dấu nhắc '>' còn phải bỏ qua
+  bool halt;                          // Sink đặt true để dừng ngay sau dòng hiện tại (vd "CONNECT" của PPP)
+  uint32_t lines;
+  uint32_t truncatedLines;
+};
+
+/**
+ * @brief Callback nhận từng dòng hoàn chỉnh (đã bỏ CR/LF, đã bỏ dòng rỗng).
+ */
+typedef void (*AtLineSink)(void* ctx, const char* line, AtLineKind kind, AtUrc urc);
+
+void atParserReset(AtParser& p);
+
+/**
+ * @brief Theo dõi byte gửi ra modem để biết lệnh đang chờ phản hồi ("AT+CPIN?\r" → "+CPIN").
+ */
+void atParserNoteTx(AtParser& p, const uint8_t* data, size_t n);
+
+/**
+ * @brief Đưa `n` byte nhận từ UART vào parser; gọi `sink` cho mỗi dòng hoàn chỉnh.
+ * @return Số byte đã xử lý: nhỏ hơn `n` khi sink đặt `halt` (phần còn lại không thuộc luồng AT).
+ */
+size_t atParserFeed(AtParser& p, const uint8_t* data, size_t n, AtLineSink sink, void* ctx);
+
+/**
+ * @brief Phân loại một dòng với tiền tố lệnh hiện tại `cmdPrefix` ("" nếu không có lệnh).
+ * @param urc Nhận loại URC khi kết quả là AT_LINE_URC, ngược lại AT_URC_NONE.
+ */
+AtLineKind atClassifyLine(const char* line, const char* cmdPrefix, AtUrc& urc);
+
+const char* atUrcName(AtUrc urc);
+
+// --------------------------------------------------------------------
+// Máy trạng thái một lệnh AT
+// --------------------------------------------------------------------
+enum AtStatus : int8_t {
+  AT_PENDING = 0,
+  AT_OK,
+  AT_ERROR,
+  AT_TIMEOUT,
+  AT_BUSY              // Hàng đợi đầy hoặc engine chưa chạy: lệnh không được gửi
+};
+
+struct AtCommandState {
+  const char* finalPrefix;   // NULL: xong khi "OK"; khác NULL: xong khi có cả "OK" và dòng có tiền tố này
+  bool gotOk;
+  bool gotFinal;             // Đã thấy dòng finalPrefix (ví dụ "+NETCLOSE: 2" trước "ERROR")
+  AtStatus status;
+  int cmeError;              // Mã +CME/+CMS ERROR, -1 nếu không có
+  char response[AT_RESPONSE_MAX];
+  uint16_t responseLen;
+};
+
+/**
+ * @brief Chuẩn bị trạng thái cho một lệnh mới.
+ * @param finalPrefix Ví dụ "+NETOPEN:" cho lệnh trả "OK" trước rồi mới báo kết quả thật.
+ */
+void atCommandStart(AtCommandState& c, const char* finalPrefix);
+
+/**
+ * @brief Đưa một dòng (không phải URC) cho lệnh đang chạy.
+ * @return true khi lệnh đã có kết quả cuối (status khác AT_PENDING).
+ */
+bool atCommandOnLine(AtCommandState& c, const char* line, AtLineKind kind);
+
+#endif
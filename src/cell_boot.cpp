@@ -0,0 +1,59 @@
+#include "cell_boot.h"
+#include <Preferences.h>
+
+/**
+ * @file cell_boot.cpp
+ * @brief Đọc/ghi tham số bring-up modem trong NVS và chọn nấc baud (xem cell_boot.h).
+ */
+
+const uint32_t CELL_BAUD_STEPS[] = { 921600, 460800, 230400, 115200 };
+const size_t CELL_BAUD_STEP_COUNT = sizeof(CELL_BAUD_STEPS) / sizeof(CELL_BAUD_STEPS[0]);
+
+void cellBootCacheLoad(CellBootCache& out) {
+  memset(&out, 0, sizeof(out));
+  Preferences prefs;
+  if (prefs.begin(CELL_NVS_NAMESPACE, true)) {
+    if (prefs.getBytesLength("boot") == sizeof(out)) prefs.getBytes("boot", &out, sizeof(out));
+    prefs.end();
+  }
+  if (out.version != CELL_BOOT_CACHE_VERSION || out.baud == 0) {
+    memset(&out, 0, sizeof(out));
+    out.version = CELL_BOOT_CACHE_VERSION;
+    out.rxPin = CELL_RX_PIN;
+    out.txPin = CELL_TX_PIN;
+    out.baud = CELL_BAUD;
+    out.baudCeiling = CELL_BAUD_MAX;
+  }
+}
+
+bool cellBootCacheSave(CellBootCache& current, const CellBootCache& next) {
+  if (memcmp(&next, &current, sizeof(current)) == 0) return false;
+  current = next;
+  Preferences prefs;
+  if (!prefs.begin(CELL_NVS_NAMESPACE, false)) return false;
+  prefs.putBytes("boot", &current, sizeof(current));
+  prefs.end();
+  Serial.printf("[CELL] Lưu tham số bring-up: RX=%d TX=%d baud=%lu (trần %lu) PLMN=%s APN=%s\n", current.rxPin,
+                current.txPin, (unsigned long)current.baud, (unsigned long)current.baudCeiling, current.plmn,
+                current.apn);
+  return true;
+}
+
+void cellBaudNegotiate(CellBootCache& cache, CellBaudSwitchFn trySwitch) {
+  uint32_t ceiling = cache.baudCeiling < CELL_BAUD_MAX ? cache.baudCeiling : CELL_BAUD_MAX;
+  if (ceiling < CELL_BAUD) ceiling = CELL_BAUD;
+  for (size_t i = 0; i < CELL_BAUD_STEP_COUNT; i++) {
+    uint32_t baud = CELL_BAUD_STEPS[i];
+    if (baud > ceiling) continue;
+    if (baud == cache.baud || trySwitch(cache, baud)) break;
+    ceiling = i + 1 < CELL_BAUD_STEP_COUNT ? CELL_BAUD_STEPS[i + 1] : CELL_BAUD;
+    cache.baudCeiling = ceiling;
+  }
+}
+
+uint32_t cellBaudStepBelow(uint32_t baud) {
+  for (size_t i = 0; i < CELL_BAUD_STEP_COUNT; i++) {
+    if (CELL_BAUD_STEPS[i] < baud) return CELL_BAUD_STEPS[i];
+  }
+  return CELL_BAUD;
+}
@@ -0,0 +1,62 @@
+#ifndef CELL_BOOT_H
+#define CELL_BOOT_H
+
+/**
+ * @file cell_boot.h
+ * @brief Tham số bring-up modem của lần thành công trước, lưu trong NVS (namespace CELL_NVS_NAMESPACE,
+ * key "boot") để lần khởi động sau đi thẳng tới chân/baud/mạng/APN đã chạy được, và cách chọn nấc baud UART.
+ *
+ * - Bản ghi thiếu, sai kích thước hoặc khác CELL_BOOT_CACHE_VERSION thì dùng mặc định trong config.h.
+ * - Chỉ ghi NVS khi nội dung đổi: mỗi lần reconnect không tốn một lần ghi flash.
+ * - Thương lượng baud đi từ nấc cao xuống; nấc nào link lỗi thì trần (baudCeiling) hạ dưới nấc đó và được
+ *   lưu lại, lần sau không thử lại nấc đã hỏng.
+ */
+
+#include <Arduino.h>
+#include "config.h"
+
+struct CellBootCache {
+  uint8_t version;
+  int8_t rxPin;
+  int8_t txPin;
+  uint32_t baud;             // Baud đang dùng (AT+IPR), modem vừa bật thì về CELL_BAUD
+  uint32_t baudCeiling;       // Trần thương lượng: CELL_BAUD_MAX, hạ dần khi link báo lỗi nhận
+  char plmn[8];               // MCC+MNC mạng đã đăng ký, gợi ý AT+COPS khi modem vừa bật
+  char apn[24];               // APN đã mở data thành công; khác CELL_APN thì không tin context cũ
+};
+
+static const uint8_t CELL_BOOT_CACHE_VERSION = 2;
+
+// Các nấc baud thử khi thương lượng/dò, từ cao xuống thấp
+extern const uint32_t CELL_BAUD_STEPS[];
+extern const size_t CELL_BAUD_STEP_COUNT;
+
+/**
+ * @brief Đổi baud cả hai phía sang `baud` và kiểm tra link.
+ * @return true nếu link ổn ở nấc mới (đã đặt cache.baud); false thì modem ở lại cache.baud.
+ */
+typedef bool (*CellBaudSwitchFn)(CellBootCache& cache, uint32_t baud);
+
+/**
+ * @brief Đọc bản ghi trong NVS vào `out`, không hợp lệ thì điền mặc định.
+ */
+void cellBootCacheLoad(CellBootCache& out);
+
+/**
+ * @brief Thay `current` bằng `next` và ghi NVS nếu hai bản khác nhau.
+ * @return true nếu đã ghi NVS.
+ */
+bool cellBootCacheSave(CellBootCache& current, const CellBootCache& next);
+
+/**
+ * @brief Đưa link lên nấc cao nhất không vượt trần; nấc nào lỗi thì trần hạ dưới nấc đó rồi thử nấc kế tiếp.
+ * Modem đã ở đúng nấc (ESP32 reset, modem vẫn chạy) thì không gọi `trySwitch`.
+ */
+void cellBaudNegotiate(CellBootCache& cache, CellBaudSwitchFn trySwitch);
+
+/**
+ * @brief Nấc ngay dưới `baud` (monitor hạ trần khi lỗi nhận UART); không còn nấc nào thì CELL_BAUD.
+ */
+uint32_t cellBaudStepBelow(uint32_t baud);
+
+#endif
@@ -0,0 +1,165 @@
+#include "cell_ppp.h"
+
+/**
+ * @file cell_ppp.cpp
+ * @brief Nối UART của modem vào lwIP qua PPPoS (xem cell_ppp.h).
+ */
+
+#if CELL_DATA_MODE == CELL_DATA_MODE_PPP
+
+#include "at_engine.h"
+#include <sdkconfig.h>
+#include <netif/ppp/pppapi.h>
+#include <netif/ppp/pppos.h>
+
+#if !CONFIG_LWIP_PPP_SUPPORT
+#error "CELL_DATA_MODE_PPP cần CONFIG_LWIP_PPP_SUPPORT=y trong sdkconfig"
+#endif
+
+static ppp_pcb* ppp = NULL;
+static struct netif pppNetif;
+static volatile bool linkUp = false;
+static volatile bool linkDead = true;       // Phase PPP đã về DEAD (đóng xong, mở lại được)
+static SemaphoreHandle_t linkEvent = NULL;  // Callback trạng thái báo cho task đang chờ
+static void (*downCallback)() = NULL;
+static bool stopping = false;               // Đang cellPppStop(): không tính là rớt
+static CellPppStats stats = {};
+
+/**
+ * @brief lwIP gửi khung PPP: ghi thẳng ra UART (thread tcpip).
+ */
+static u32_t pppOutput(ppp_pcb* pcb, u8_t* data, u32_t len, void* ctx) {
+  size_t n = atEngineWriteRaw(data, len);
+  stats.txBytes += n;
+  return (u32_t)n;
+}
+
+/**
+ * @brief Byte từ UART (task RX của at_engine) chuyển cho lwIP; pppos_input_tcpip chép sang pbuf.
+ */
+static void pppRx(const uint8_t* data, size_t n, void* ctx) {
+  stats.rxBytes += n;
+  if (ppp != NULL) pppos_input_tcpip(ppp, (u8_t*)data, (int)n);
+}
+
+/**
+ * @brief Trạng thái link (thread tcpip): chỉ cập nhật cờ và đánh thức task đang chờ.
+ */
+static void pppStatus(ppp_pcb* pcb, int err, void* ctx) {
+  if (err == PPPERR_NONE) {
+    linkUp = true;
+    linkDead = false;
+    stats.up = true;
+    stats.connects++;
+    ip4addr_ntoa_r(netif_ip4_addr(&pppNetif), stats.ip, sizeof(stats.ip));
+  } else {
+    bool wasUp = linkUp;
+    linkUp = false;
+    linkDead = true;
+    stats.up = false;
+    stats.ip[0] = '\0';
+    if (wasUp && !stopping) {
+      stats.drops++;
+      if (downCallback) downCallback();
+    }
+  }
+  if (linkEvent) xSemaphoreGive(linkEvent);
+}
+
+bool cellPppStart(const char* apn, const char* user, const char* pass, void (*onDown)()) {
+  if (linkUp) return true;
+  if (linkEvent == NULL) linkEvent = xSemaphoreCreateBinary();
+  downCallback = onDown;
+  uint32_t t0 = millis();
+
+  char cmd[64];
+  snprintf(cmd, sizeof(cmd), "+CGDCONT=1,\"IP\",\"%s\"", apn);
+  if (atCommand(cmd, 2000, NULL, NULL, AT_PRIO_HIGH) != AT_OK) {
+    Serial.println("[PPP] CGDCONT lỗi");
+    return false;
+  }
+  if (ppp == NULL) {
+    ppp = pppapi_pppos_create(&pppNetif, pppOutput, pppStatus, NULL);
+    if (ppp == NULL) {
+      Serial.println("[PPP] Không tạo được PPP pcb");
+      return false;
+    }
+  }
+
+  AtStatus dial = atEngineDial("D*99#", CELL_PPP_DIAL_TIMEOUT_MS, pppRx, NULL);
+  if (dial != AT_OK) {
+    Serial.printf("[PPP] ATD*99# không CONNECT (status %d)\n", dial);
+    return false;
+  }
+
+  ppp_set_usepeerdns(ppp, 1);  // DNS của nhà mạng (IPCP) thay cho DNS của WiFi
+  if (user && user[0]) ppp_set_auth(ppp, PPPAUTHTYPE_ANY, user, pass);
+  else ppp_set_auth(ppp, PPPAUTHTYPE_NONE, NULL, NULL);
+  pppapi_set_default(ppp);
+  xSemaphoreTake(linkEvent, 0);
+  stopping = false;
+  linkDead = false;
+  pppapi_connect(ppp, 0);
+
+  while (!linkUp && !linkDead && millis() - t0 < CELL_PPP_DIAL_TIMEOUT_MS + CELL_PPP_CONNECT_TIMEOUT_MS) {
+    xSemaphoreTake(linkEvent, pdMS_TO_TICKS(200));
+  }
+  if (!linkUp) {
+    Serial.println("[PPP] LCP/IPCP không xong, đóng PPP");
+    cellPppStop();
+    return false;
+  }
+  stats.lastConnectMs = millis() - t0;
+  Serial.printf("[PPP] Lên: IP %s sau %lu ms\n", stats.ip, (unsigned long)stats.lastConnectMs);
+  return true;
+}
+
+void cellPppStop() {
+  if (ppp != NULL && !linkDead) {
+    stopping = true;
+    xSemaphoreTake(linkEvent, 0);
+    // Còn link thì gửi LCP Terminate; đã rớt thì đóng luôn không chờ phía modem
+    pppapi_close(ppp, linkUp ? 0 : 1);
+    uint32_t t0 = millis();
+    while (!linkDead && millis() - t0 < 5000) xSemaphoreTake(linkEvent, pdMS_TO_TICKS(200));
+    stopping = false;
+  }
+  linkUp = false;
+  stats.up = false;
+
+  if (atEngineInDataMode()) {
+    // Thoát về chế độ lệnh: SIMCOM cần ~1 s im lặng trước và sau "+++"
+    delay(1100);
+    atEngineWriteRaw((const uint8_t*)"+++", 3);
+    delay(1100);
+    atEngineDataModeExit();
+    atCommand("H", 3000, NULL, NULL, AT_PRIO_HIGH);  // Kết thúc cuộc gọi dữ liệu
+  }
+}
+
+bool cellPppUp() {
+  return linkUp;
+}
+
+CellPppStats cellPppGetStats() {
+  return stats;
+}
+
+#else
+
+bool cellPppStart(const char* apn, const char* user, const char* pass, void (*onDown)()) {
+  return false;
+}
+
+void cellPppStop() {}
+
+bool cellPppUp() {
+  return false;
+}
+
+CellPppStats cellPppGetStats() {
+  CellPppStats out = {};
+  return out;
+}
+
+#endif
@@ -0,0 +1,44 @@
+#ifndef CELL_PPP_H
+#define CELL_PPP_H
+
+/**
+ * @file cell_ppp.h
+ * @brief PPPoS cho modem 4G (CELL_DATA_MODE == CELL_DATA_MODE_PPP): modem quay số ATD*99#, UART chở khung
+ * PPP cho lwIP. Từ đó TCP, DNS và TLS chạy trên ESP32 như với WiFi (WiFiClient, HTTPClient,
+ * WiFiClientSecure dùng nguyên), không qua lệnh AT socket và buffer TINY_GSM_RX_BUFFER.
+ *
+ * - Netif PPP được đặt làm default: kết nối tới địa chỉ ngoài subnet WiFi (AP/STA) đều đi qua 4G.
+ * - Trong lúc PPP chạy UART không nhận lệnh AT (không dùng CMUX): không lấy được CSQ/CPSI, không dùng
+ *   được socket TinyGSM hay modem_http.
+ * - PPP rớt (NO CARRIER, LCP đóng) thì gọi `onDown` (trong thread tcpip, chỉ nên đặt cờ);
+ *   cellPppStop() đưa modem về chế độ lệnh trước khi dựng lại.
+ * - Ở chế độ AT các hàm vẫn có (để code gọi không cần #if) nhưng cellPppStart() luôn trả false.
+ */
+
+#include <Arduino.h>
+#include "config.h"
+
+struct CellPppStats {
+  bool up;
+  uint32_t connects;
+  uint32_t drops;            // Rớt khi đang chạy (không tính cellPppStop chủ động)
+  uint32_t rxBytes;          // Byte UART (gồm khung PPP), cả hai chiều
+  uint32_t txBytes;
+  uint32_t lastConnectMs;    // ATD tới khi có IP
+  char ip[16];
+};
+
+/**
+ * @brief Quay số và chờ IPCP xong. Gọi khi modem đã đăng ký mạng, UART ở chế độ lệnh.
+ */
+bool cellPppStart(const char* apn, const char* user, const char* pass, void (*onDown)());
+
+/**
+ * @brief Đóng PPP và đưa modem về chế độ lệnh ("+++", ATH). Gọi được khi PPP đã rớt hoặc chưa mở.
+ */
+void cellPppStop();
+
+bool cellPppUp();
+CellPppStats cellPppGetStats();
+
+#endif
@@ -1,6 +1,18 @@
 #include "cellular.h"
+#include "at_engine.h"
+#include "seqlock.h"
+#include "dns_cache.h"
+#include "modem_http.h"
+#include "cell_ppp.h"
+#include "ota_resume.h"
+#include "ota_pipeline.h"
+#include "cell_boot.h"
 #include <esp_task_wdt.h>
-#include <Update.h>
+#if CELL_DATA_MODE == CELL_DATA_MODE_PPP
+#include <WiFi.h>
+#include <WiFiClientSecure.h>
+#include <HTTPClient.h>
+#endif
 
 /**
  * @file cellular.cpp
@@ -11,15 +23,262 @@
 
 #define TINY_GSM_DEBUG Serial  // Bật log TinyGSM ra Serial để tiện theo dõi
 
-TinyGsm modem(CELL_UART);
+TinyGsm modem(atEngineStream());  // TinyGSM đọc qua ring của at_engine, không đọc thẳng UART
 TinyGsmClient gsmClient(modem);
 
 // --------------------------------------------------------------------
 // Trạng thái nội bộ của mô-đun 4G
 // --------------------------------------------------------------------
-static bool isModemReady = false;         // Đã khởi tạo modem chưa?
-static bool isDataConnected = false;      // Đã mở kết nối data (NETOPEN/PDP) chưa?
-static SemaphoreHandle_t cellularHttpMutex = NULL; // Mutex để tuần tự hóa mọi HTTP qua 4G
+static volatile bool isModemReady = false;     // Đã khởi tạo modem chưa? (URC RDY/+CPIN xóa ngay)
+static volatile bool isDataConnected = false;  // Đã mở kết nối data (NETOPEN/PDP) chưa? (URC mất mạng xóa ngay)
+static SemaphoreHandle_t cellularHttpMutex = NULL; // Mutex để tuần tự hóa mọi HTTP qua 4G (mux 0)
+static SemaphoreHandle_t alertMutex = NULL;        // Tuần tự hóa các lượt dùng socket khẩn với nhau
+static volatile uint32_t dataContextGen = 0;       // Tăng mỗi lần data context bị đóng/dựng lại: socket cũ đã chết
+static Seqlock<CellularStatus> statusSnapshot;     // Chỉ cellularMonitorTask ghi
+static SemaphoreHandle_t regEvent = NULL;          // URC đăng ký mạng/SIM: đánh thức vòng chờ bring-up
+static uint32_t powerOnAtMs = 0;                   // millis() lần bật PWRKEY gần nhất, 0 = chưa bật
+static CellularBootTiming bootTiming = {};
+
+static CellBootCache bootCache;                    // Tham số bring-up lần thành công trước (NVS, xem cell_boot.h)
+static bool bootCacheLoaded = false;
+
+static volatile uint32_t uartBaud = 0;             // Baud ESP32 đang mở UART
+static volatile uint32_t baudDowngradeTo = 0;      // Monitor yêu cầu hạ trần; bring-up kế tiếp áp dụng
+static CellularUartStats uartStats = {};
+
+/**
+ * @brief Tạo các mutex của mô-đun (gọi được nhiều lần; lần đầu thường từ cellularBegin).
+ */
+static void cellularLocksInit() {
+  if (cellularHttpMutex == NULL) cellularHttpMutex = xSemaphoreCreateMutex();
+  if (regEvent == NULL) regEvent = xSemaphoreCreateBinary();
+  if (alertMutex == NULL) alertMutex = xSemaphoreCreateMutex();
+}
+
+/**
+ * @brief Giữ UART cho một giao dịch AT. Mọi lệnh modem.* và thao tác socket đều phải đi qua khóa này;
+ * giữ lồng nhau được (cellularBegin gọi lại chính nó qua các hàm con). Lệnh atCommand() của task đang
+ * giữ khóa vẫn chạy được (at_engine gửi thay).
+ */
+static bool atLock(TickType_t wait) {
+  return atEngineLock(wait);
+}
+
+static void atUnlock() {
+  atEngineUnlock();
+}
+
+// Khóa UART cho modem_http (mỗi giao dịch +CHTTPS* một lần khóa)
+static void modemHttpLock() {
+  atLock(portMAX_DELAY);
+}
+
+static void modemHttpUnlock() {
+  atUnlock();
+}
+
+// Truy vấn DNS cho dns_cache: AT+CDNSGIP chạy ngoài khóa bảng DNS, dòng +CDNSGIP: do dns_cache tách
+static bool cellularDnsQuery(const char* host, char* line, size_t lineSize) {
+  char cmd[72];
+  snprintf(cmd, sizeof(cmd), "+CDNSGIP=\"%s\"", host);
+  AtResult r;
+  bool ok = atCommand(cmd, DNS_RESOLVE_TIMEOUT_MS, &r, "+CDNSGIP:", AT_PRIO_NORMAL) == AT_OK;
+  strncpy(line, r.response, lineSize - 1);
+  line[lineSize - 1] = '\0';
+  return ok;
+}
+
+/**
+ * @brief URC mất kết nối: đánh dấu ngay để lần gửi kế tiếp dựng lại, không chờ timeout socket.
+ *
+ * Chạy trong task RX của at_engine nên chỉ cập nhật cờ, không gửi lệnh AT.
+ */
+static void onModemUrc(AtUrc urc, const char* line) {
+  if ((urc == AT_URC_CREG || urc == AT_URC_CPIN) && regEvent) xSemaphoreGive(regEvent);
+  if (urc == AT_URC_CHTTPS) modemHttpOnUrc(line);
+  bool dataLost = false;
+  bool modemLost = false;
+  switch (urc) {
+    case AT_URC_CIPEVENT:
+    case AT_URC_NETCLOSE:
+      dataLost = true;
+      break;
+    case AT_URC_CGEV:
+      dataLost = strstr(line, "DEACT") != NULL || strstr(line, "DETACH") != NULL;
+      break;
+    case AT_URC_RDY:
+      modemLost = true;
+      break;
+    case AT_URC_CPIN:
+      modemLost = strstr(line, "READY") == NULL;
+      break;
+    default:
+      break;
+  }
+  if (!dataLost && !modemLost) return;
+  if (isDataConnected || (modemLost && isModemReady)) {
+    Serial.printf("[CELL] URC mất kết nối: %s\n", line);
+  }
+  if (modemLost) isModemReady = false;
+  isDataConnected = false;
+  dataContextGen++;
+}
+
+/**
+ * @brief Gửi một lệnh AT qua at_engine, chỉ quan tâm OK/lỗi.
+ */
+static bool atSend(const char* cmd, uint32_t timeoutMs, const char* finalPrefix = NULL, AtResult* out = NULL) {
+  return atCommand(cmd, timeoutMs, out, finalPrefix, AT_PRIO_NORMAL) == AT_OK;
+}
+
+/**
+ * @brief Client bọc một socket TinyGSM: mỗi thao tác chỉ giữ khóa UART trong đúng một giao dịch AT
+ * (CIPOPEN, CIPSEND, CIPRXGET...) rồi nhả. Nhờ vậy socket upload (mux 0) và socket khẩn (mux
+ * CELL_ALERT_MUX) đan xen trên cùng UART, thay vì một request giữ modem từ lúc gửi tới hết backoff.
+ */
+class AtLockedClient : public Client {
+ public:
+  AtLockedClient(TinyGsmClient& socket, int connectTimeoutS, TickType_t lockWait)
+      : socket(socket), connectTimeoutS(connectTimeoutS), lockWait(lockWait) {}
+
+  int connect(IPAddress ip, uint16_t port) override {
+    if (!atLock(lockWait)) return 0;
+    int r = socket.connect(ip, port, connectTimeoutS);
+    atUnlock();
+    return r;
+  }
+  int connect(const char* host, uint16_t port) override {
+    // Mở bằng IP trong cache DNS (modem không phải phân giải lại); lỗi thì bỏ địa chỉ đó và mở bằng tên miền
+    char ip[16];
+    if (dnsCacheLookup(host, ip, sizeof(ip))) {
+      if (!atLock(lockWait)) return 0;
+      int r = socket.connect(ip, port, connectTimeoutS);
+      atUnlock();
+      if (r) return r;
+      dnsCacheReportFailure(host, ip);
+    }
+    if (!atLock(lockWait)) return 0;
+    int r = socket.connect(host, port, connectTimeoutS);
+    atUnlock();
+    return r;
+  }
+  size_t write(uint8_t c) override { return write(&c, 1); }
+  size_t write(const uint8_t* buf, size_t size) override {
+    if (!atLock(lockWait)) return 0;
+    size_t r = socket.write(buf, size);
+    atUnlock();
+    return r;
+  }
+  int available() override {
+    if (!atLock(lockWait)) return 0;
+    int r = socket.available();
+    atUnlock();
+    return r;
+  }
+  int read() override {
+    if (!atLock(lockWait)) return -1;
+    int r = socket.read();
+    atUnlock();
+    return r;
+  }
+  int read(uint8_t* buf, size_t size) override {
+    if (!atLock(lockWait)) return -1;
+    int r = socket.read(buf, size);
+    atUnlock();
+    return r;
+  }
+  int peek() override {
+    if (!atLock(lockWait)) return -1;
+    int r = socket.peek();
+    atUnlock();
+    return r;
+  }
+  void flush() override {
+    if (!atLock(lockWait)) return;
+    socket.flush();
+    atUnlock();
+  }
+  void stop() override {
+    atLock(portMAX_DELAY);  // Đóng socket luôn phải thực hiện được
+    socket.stop();
+    atUnlock();
+  }
+  uint8_t connected() override {
+    if (!atLock(lockWait)) return 0;
+    uint8_t r = socket.connected();
+    atUnlock();
+    return r;
+  }
+  operator bool() override { return connected(); }
+
+ private:
+  TinyGsmClient& socket;
+  int connectTimeoutS;
+  TickType_t lockWait;
+};
+
+#if CELL_DATA_MODE == CELL_DATA_MODE_PPP
+// PPP: socket lwIP đi qua netif PPP (default), không chạm UART/khóa AT; DNS do lwIP phân giải
+static WiFiClient uploadSocket;
+static WiFiClient alertSocket;
+#else
+// Socket upload thường (mux 0) chờ khóa UART bao lâu cũng được; socket khẩn chỉ chờ có hạn
+static AtLockedClient uploadSocket(gsmClient, CELL_TCP_CONNECT_TIMEOUT_S, portMAX_DELAY);
+static TinyGsmClient alertGsmClient(modem, CELL_ALERT_MUX);
+static AtLockedClient alertSocket(alertGsmClient, CELL_ALERT_CONNECT_TIMEOUT_S, pdMS_TO_TICKS(CELL_ALERT_AT_WAIT_MS));
+#endif
+
+static bool isBackend(const char* host, uint16_t port) {
+  return port == BACKEND_PORT && strcmp(host, BACKEND_HOST) == 0;
+}
+
+// --------------------------------------------------------------------
+// Phiên HTTP keep-alive tới backend (socket mux 0 của gsmClient)
+// --------------------------------------------------------------------
+// Request tới BACKEND_HOST:BACKEND_PORT (upload, kiểm tra firmware) dùng chung một socket giữ mở;
+// host khác và OTA mở socket dùng một lần nên phải đóng phiên trước (cùng gsmClient).
+static HttpClient backendHttp(uploadSocket, BACKEND_HOST, BACKEND_PORT);
+static bool backendSessionOpen = false;       // Socket đang giữ sau một response 2xx đọc trọn
+static unsigned long backendLastUsedMs = 0;
+// sessionStats/ttfbSumMs và trạng thái breaker được ghi cả trong lẫn ngoài cellularHttpMutex (bộ thực thi,
+// OTA, /api/status đọc từ task web) nên mọi truy cập đi qua sessionMux
+static portMUX_TYPE sessionMux = portMUX_INITIALIZER_UNLOCKED;
+static CellularSessionStats sessionStats = {};
+static uint32_t ttfbSumMs[2] = { 0, 0 };      // Tổng thời gian tới byte đầu của socket mới: [0] DNS trực tiếp, [1] cache
+
+static void sessionStatAdd(uint32_t& field, uint32_t n = 1) {
+  portENTER_CRITICAL(&sessionMux);
+  field += n;
+  portEXIT_CRITICAL(&sessionMux);
+}
+
+/**
+ * @brief Đóng phiên keep-alive (gọi khi NETCLOSE/reset modem hoặc trước khi dùng gsmClient cho host khác).
+ */
+static void httpSessionClose() {
+  if (backendSessionOpen) backendHttp.stop();
+  backendSessionOpen = false;
+}
+
+/**
+ * @brief PPP rớt (thread tcpip): chỉ đánh dấu, lần gửi sau cellularBegin() đưa modem về chế độ lệnh và quay lại.
+ */
+static void onPppDown() {
+  Serial.println("[CELL] PPP rớt, đánh dấu mất kết nối");
+  isDataConnected = false;
+  dataContextGen++;
+}
+
+/**
+ * @brief Đóng data context đang mở: NETCLOSE (socket AT) hoặc đóng PPP và thoát chế độ dữ liệu.
+ */
+static void dataLinkClose() {
+  #if CELL_DATA_MODE == CELL_DATA_MODE_PPP
+    cellPppStop();
+  #else
+    atCommand("+NETCLOSE", 2000, NULL, "+NETCLOSE:", AT_PRIO_HIGH);
+  #endif
+}
 
 /**
  * @brief Reset modem hoàn toàn (power cycle) khi gặp lỗi nặng.
@@ -31,8 +290,12 @@ static SemaphoreHandle_t cellularHttpMutex = NULL; // Mutex để tuần tự h
  */
 void cellularReset() {
   Serial.println("[CELL] Reset modem hoàn toàn...");
+  atLock(portMAX_DELAY);
+  httpSessionClose();
+  cellPppStop();  // Chế độ AT: không làm gì
   isModemReady = false;
   isDataConnected = false;
+  dataContextGen++;
   
   // Tắt modem
   pinMode(CELL_PWRKEY_PIN, OUTPUT);
@@ -45,8 +308,8 @@ void cellularReset() {
   delay(2000);
   
   // Bật lại modem
-  cellularPowerOn();
-  delay(3000);
+  cellularPowerOn();  // Bring-up kế tiếp chờ modem trả lời AT, không cần chờ cố định ở đây
+  atUnlock();
   
   Serial.println("[CELL] Modem đã được reset");
 }
@@ -57,24 +320,10 @@ void cellularReset() {
  * Hàm này chỉ dùng nội bộ cho debug, do đó giữ static.
  */
 static void logCEER() {
-  modem.sendAT("+CEER");
-  unsigned long t0 = millis();
-  String line;
-  while (millis() - t0 < 1200) {
-    while (modem.stream.available()) {
-      char c = modem.stream.read();
-      if (c == '\r') continue;
-      if (c == '\n') {
-        if (line.length()) {
-          Serial.print("[CELL][AT][CEER] ");
-          Serial.println(line);
-          line = "";
-        }
-      } else {
-        line += c;
-      }
-    }
-    delay(10);
+  AtResult r;
+  if (atCommand("+CEER", 1200, &r, NULL, AT_PRIO_LOW) != AT_BUSY && r.response[0]) {
+    Serial.print("[CELL][AT][CEER] ");
+    Serial.println(r.response);
   }
 }
 
@@ -98,7 +347,8 @@ bool cellularPowerOn() {
     delay(CELL_PWRKEY_ACTIVE_MS);
     digitalWrite(CELL_PWRKEY_PIN, LOW);
   #endif
-  delay(1500);
+  powerOnAtMs = millis();
+  if (powerOnAtMs == 0) powerOnAtMs = 1;
   return true;
 }
 
@@ -113,211 +363,441 @@ bool cellularPowerOn() {
  *
  * @return true nếu mọi bước thành công; false nếu cần thử lại sau.
  */
+static bool cellularBeginLocked();
+
 bool cellularBegin() {
-  if (cellularHttpMutex == NULL) {
-    cellularHttpMutex = xSemaphoreCreateMutex();
-  }
+  cellularLocksInit();
+  modemHttpBegin(atEngineStream(), modemHttpLock, modemHttpUnlock);
+  dnsCacheBegin(cellularDnsQuery);
   // Always try to maintain connection - don't do aggressive re-init
   if (isModemReady && isDataConnected) {
     Serial.println("[CELL]  Đã kết nối - reuse connection");
     return true;
   }
-  
+  // Giữ UART suốt quá trình dựng kết nối; task khác vừa dựng xong trong lúc chờ thì dùng luôn
+  atLock(portMAX_DELAY);
+  bool ok = (isModemReady && isDataConnected) || cellularBeginLocked();
+  atUnlock();
+  return ok;
+}
+
+static void loadBootCache() {
+  if (bootCacheLoaded) return;
+  bootCacheLoaded = true;
+  cellBootCacheLoad(bootCache);
+}
+
+/**
+ * @brief (Mở lại) UART2 với chân/baud cho trước và gắn task RX của at_engine.
+ */
+static bool cellUartOpen(int rx, int tx, uint32_t baud) {
+  atEngineRxPause(true);
+  CELL_UART.end();
+  CELL_UART.setRxBufferSize(CELL_UART_RX_BUFFER);
+  CELL_UART.begin(baud, SERIAL_8N1, rx, tx);
+  #if CELL_UART_RTS_PIN >= 0 && CELL_UART_CTS_PIN >= 0
+    // RTS hạ khi FIFO RX đầy quá ngưỡng, modem ngừng gửi; CTS của modem chặn ESP32 gửi khi modem bận
+    CELL_UART.setPins(rx, tx, CELL_UART_CTS_PIN, CELL_UART_RTS_PIN);
+    CELL_UART.setHwFlowCtrlMode(HW_FLOWCTRL_CTS_RTS, 64);
+  #endif
+  uartBaud = baud;
+  bool ok = atEngineBegin(CELL_UART);  // end() gỡ callback onReceive: luôn đăng ký lại
+  atEngineRxPause(false);
+  static bool urcRegistered = false;
+  if (ok && !urcRegistered) urcRegistered = atOnUrc(onModemUrc);
+  return ok;
+}
+
+/**
+ * @brief Dò baud modem đang chạy (trên chân trong `cache`) qua các nấc CELL_BAUD_STEPS.
+ * @return true và cập nhật cache.baud nếu modem trả lời; false thì UART mở lại ở cache.baud.
+ */
+static bool cellularFindBaud(CellBootCache& cache) {
+  for (size_t i = 0; i < CELL_BAUD_STEP_COUNT; i++) {
+    uint32_t baud = CELL_BAUD_STEPS[i];
+    if (baud == cache.baud || (baud > CELL_BAUD_MAX && baud != CELL_BAUD)) continue;
+    if (!cellUartOpen(cache.rxPin, cache.txPin, baud)) return false;
+    if (modem.testAT(300)) {
+      Serial.printf("[CELL]  Modem trả lời ở %lu baud\n", (unsigned long)baud);
+      cache.baud = baud;
+      return true;
+    }
+  }
+  cellUartOpen(cache.rxPin, cache.txPin, cache.baud);
+  return false;
+}
+
+/**
+ * @brief Vài lệnh có phản hồi dài (ATI) mà không lỗi lệnh và không thêm lỗi nhận UART.
+ */
+static bool cellularLinkCheck() {
+  AtEngineStats before = atEngineGetStats();
+  for (int i = 0; i < 3; i++) {
+    AtResult r;
+    if (atCommand("I", 1000, &r, NULL, AT_PRIO_HIGH) != AT_OK || r.response[0] == '\0') return false;
+  }
+  AtEngineStats after = atEngineGetStats();
+  return after.uartOverruns == before.uartOverruns && after.uartFrameErrors == before.uartFrameErrors;
+}
+
+/**
+ * @brief Đổi baud cả hai phía: AT+IPR (modem trả OK ở baud cũ rồi mới đổi), mở lại UART, kiểm tra link.
+ * Link không ổn thì đưa modem về baud cũ (hoặc dò lại) và trả false.
+ */
+static bool cellularSwitchBaud(CellBootCache& cache, uint32_t baud) {
+  uint32_t oldBaud = cache.baud;
+  char cmd[24];
+  snprintf(cmd, sizeof(cmd), "+IPR=%lu", (unsigned long)baud);
+  if (!atSend(cmd, 1000)) return false;  // Modem không nhận nấc này
+  delay(20);
+  cellUartOpen(cache.rxPin, cache.txPin, baud);
+  if (modem.testAT(1000) && cellularLinkCheck()) {
+    Serial.printf("[CELL] UART %lu → %lu baud\n", (unsigned long)oldBaud, (unsigned long)baud);
+    cache.baud = baud;
+    return true;
+  }
+  Serial.printf("[CELL]  Link không ổn ở %lu baud, quay về %lu\n", (unsigned long)baud, (unsigned long)oldBaud);
+  uartStats.negotiateFailures++;
+  snprintf(cmd, sizeof(cmd), "+IPR=%lu", (unsigned long)oldBaud);
+  atSend(cmd, 1000);  // Có thể không tới được modem nếu link hỏng hẳn
+  delay(20);
+  cellUartOpen(cache.rxPin, cache.txPin, oldBaud);
+  if (!modem.testAT(500)) cellularFindBaud(cache);  // Lệnh trên không tới: modem còn ở baud mới
+  return false;
+}
+
+/**
+ * @brief Thương lượng baud (cellBaudNegotiate, bật RTS/CTS phía modem nếu đã nối) rồi lưu kết quả.
+ */
+static void cellularNegotiateBaud(CellBootCache& cache) {
+  #if CELL_UART_RTS_PIN >= 0 && CELL_UART_CTS_PIN >= 0
+    atSend("+IFC=2,2", 1000);
+  #endif
+  cellBaudNegotiate(cache, cellularSwitchBaud);
+  // Baud sống tới khi modem tắt nguồn: lưu ngay, không chờ bring-up xong (ESP32 reset giữa chừng vẫn dò đúng)
+  CellBootCache next = bootCache;
+  next.baud = cache.baud;
+  next.baudCeiling = cache.baudCeiling;
+  cellBootCacheSave(bootCache, next);
+}
+
+/**
+ * @brief Đưa modem tới trạng thái trả lời AT: thử chân trong NVS, modem tắt thì bật PWRKEY và chờ
+ * modem trả lời (không delay cố định), cuối cùng mới dò các cặp chân khác.
+ */
+static bool cellularProbeModem(CellBootCache& cache) {
+  // PWRKEY vừa được bật (cellularReset) mà modem chưa lên: chờ tiếp thay vì bấm lần nữa
+  bool booting = powerOnAtMs != 0 && millis() - powerOnAtMs < CELL_BOOT_AT_TIMEOUT_MS;
+  if (booting) cache.baud = CELL_BAUD;  // AT+IPR không giữ qua lần tắt nguồn
+  if (!cellUartOpen(cache.rxPin, cache.txPin, cache.baud)) return false;
+  Serial.printf("[CELL] UART2 init: RX=%d, TX=%d, BAUD=%lu\n", cache.rxPin, cache.txPin, (unsigned long)cache.baud);
+
+  if (booting) {
+    bootTiming.poweredOn = true;
+    if (modem.testAT(CELL_BOOT_AT_TIMEOUT_MS - (millis() - powerOnAtMs))) return true;
+  } else if (modem.testAT(CELL_AT_PROBE_MS)) {
+    Serial.println("[CELL]  Modem đang bật, bỏ qua PWRKEY");
+    return true;
+  } else if (cellularFindBaud(cache)) {
+    return true;  // Modem đang bật ở baud khác (ESP32 reset giữa lúc đổi AT+IPR): không bấm PWRKEY
+  }
+
+  if (!booting) {
+    Serial.println("[CELL] Modem không trả lời, bật PWRKEY...");
+    cache.baud = CELL_BAUD;
+    if (!cellUartOpen(cache.rxPin, cache.txPin, cache.baud)) return false;
+    cellularPowerOn();
+    bootTiming.poweredOn = true;
+    if (modem.testAT(CELL_BOOT_AT_TIMEOUT_MS)) return true;
+  }
+
+  Serial.println("[CELL]  Không nhận được phản hồi AT. Thử các cấu hình chân khác...");
+  bootTiming.pinScan = true;
+  const int cand[][2] = {{CELL_RX_PIN, CELL_TX_PIN}, {CELL_TX_PIN, CELL_RX_PIN}, {27, 26}, {26, 27}};
+  for (size_t i = 0; i < sizeof(cand) / sizeof(cand[0]); i++) {
+    int rx = cand[i][0], tx = cand[i][1];
+    if (rx == cache.rxPin && tx == cache.txPin && cache.baud == CELL_BAUD) continue;
+    if (!cellUartOpen(rx, tx, CELL_BAUD)) return false;
+    Serial.printf("[CELL] Thử UART2 fallback: RX=%d, TX=%d...\n", rx, tx);
+    if (modem.testAT(1000)) {
+      Serial.printf("[CELL]  Modem phản hồi với RX=%d, TX=%d\n", rx, tx);
+      cache.rxPin = rx;
+      cache.txPin = tx;
+      cache.baud = CELL_BAUD;
+      return true;
+    }
+  }
+  Serial.println("[CELL]  Không tìm được UART hoạt động");
+  return false;
+}
+
+/**
+ * @brief Stat của +CEREG, -1 nếu lệnh lỗi.
+ */
+static int cellularRegStatus() {
+  AtResult r;
+  if (!atSend("+CEREG?", 1000, NULL, &r)) return -1;
+  const char* f = strstr(r.response, "+CEREG: ");
+  if (f == NULL) return -1;
+  const char* comma = strchr(f, ',');
+  return atoi(comma ? comma + 1 : f + 8);
+}
+
+/**
+ * @brief Chờ modem đăng ký mạng; thức dậy theo URC +CEREG (đã bật AT+CEREG=1) thay vì ngủ cố định.
+ * Modem vừa bật mà NVS có PLMN lần trước thì gợi ý AT+COPS=4 để khỏi quét toàn băng.
+ */
+static bool cellularWaitRegistered(const CellBootCache& cache, bool coldModem) {
+  atSend("+CEREG=1", 1000);
+  int stat = cellularRegStatus();
+  if (stat == 1 || stat == 5) return true;
+
+  if (coldModem && cache.plmn[0]) {
+    char cops[32];
+    snprintf(cops, sizeof(cops), "+COPS=4,2,\"%s\"", cache.plmn);
+    Serial.printf("[CELL] Gợi ý mạng lần trước: %s\n", cache.plmn);
+    atSend(cops, CELL_REG_TIMEOUT_MS);  // Trả OK khi đã đăng ký (thủ công, lỗi thì tự động)
+  }
+
+  uint32_t t0 = millis();
+  while (millis() - t0 < CELL_REG_TIMEOUT_MS) {
+    stat = cellularRegStatus();
+    if (stat == 1 || stat == 5) return true;
+    if (stat == 3) {
+      Serial.println("[CELL]  Mạng từ chối đăng ký (+CEREG stat 3)");
+      return false;
+    }
+    xSemaphoreTake(regEvent, pdMS_TO_TICKS(1000));
+    esp_task_wdt_reset();
+  }
+  Serial.printf("[CELL]  Chưa đăng ký được mạng sau %d ms (stat %d)\n", CELL_REG_TIMEOUT_MS, stat);
+  return false;
+}
+
+/**
+ * @brief Thân cellularBegin(), chạy khi đang giữ khóa UART.
+ *
+ * Modem đã bật và đã đăng ký (ESP32 vừa reset, modem vẫn chạy) thì không bật PWRKEY, không restart;
+ * data context lần trước còn mở thì cũng không GPRS/NETOPEN lại.
+ */
+static bool cellularBeginLocked() {
+  dataContextGen++;  // Khởi tạo lại modem hoặc NETCLOSE/NETOPEN: mọi socket cũ đều mất
+  cellPppStop();     // PPP vừa rớt: modem còn ở chế độ dữ liệu, phải về chế độ lệnh trước khi hỏi AT
+  loadBootCache();
+  CellBootCache cache = bootCache;
+  if (baudDowngradeTo != 0) {
+    cache.baudCeiling = baudDowngradeTo;  // Monitor thấy lỗi nhận ở baud hiện tại
+    baudDowngradeTo = 0;
+  }
+
+  uint32_t firstSendMs = bootTiming.firstSendMs;
+  memset(&bootTiming, 0, sizeof(bootTiming));
+  bootTiming.firstSendMs = firstSendMs;
+  bootTiming.startMs = millis();
+  uint32_t phaseStart = millis();
+
   // ===== PHASE 1: Initialize Modem (only if needed) =====
   if (!isModemReady) {
     Serial.println("[CELL] Khởi tạo modem...");
-    cellularPowerOn();
-    
-    // Tăng bộ đệm RX để ổn định ở baud cao
-    CELL_UART.setRxBufferSize(2048);
-    CELL_UART.begin(CELL_BAUD, SERIAL_8N1, CELL_RX_PIN, CELL_TX_PIN);
-    Serial.printf("[CELL] UART2 init: RX=%d, TX=%d, BAUD=%d\n", CELL_RX_PIN, CELL_TX_PIN, CELL_BAUD);
-    delay(300);
-    
-    bool atOk = modem.testAT();
-    if (!atOk) {
-      Serial.println("[CELL]  Không nhận được phản hồi AT. Thử các cấu hình chân khác...");
-      const int cand[][2] = {{CELL_TX_PIN, CELL_RX_PIN}, {27, 26}, {26, 27}};
-      unsigned long scanStart = millis();
-      for (size_t i = 0; i < 3; i++) {
-        if (millis() - scanStart > 8000) break;
-        int rx = cand[i][0], tx = cand[i][1];
-        if (rx == CELL_RX_PIN && tx == CELL_TX_PIN) continue;
-        CELL_UART.end();
-        delay(50);
-        CELL_UART.begin(CELL_BAUD, SERIAL_8N1, rx, tx);
-        Serial.printf("[CELL] Thử UART2 fallback: RX=%d, TX=%d...\n", rx, tx);
-        delay(200);
-        if (modem.testAT()) {
-          Serial.printf("[CELL]  Modem phản hồi với RX=%d, TX=%d\n", rx, tx);
-          atOk = true;
-          break;
-        }
-      }
-      if (!atOk) {
-        Serial.println("[CELL]  Không tìm được UART hoạt động");
-        return false;
-      }
-    }
-    
-    // Restart modem với retry logic
-    bool modemReady = false;
-    for (int retry = 0; retry < 3; retry++) {  // Tăng từ 2 lên 3 lần thử
-      Serial.printf("[CELL] Thử khởi động modem lần %d/3...\n", retry + 1);
-      if (modem.restart() || modem.init()) {
-        modemReady = true;
-        Serial.println("[CELL] Modem restart/init thành công");
-        delay(2000);
-        
-        // Clear buffer để tránh dữ liệu cũ
-        while (modem.stream.available()) {
-          modem.stream.read();
-          delayMicroseconds(100);
-        }
-        break;
-      }
-      // Exponential backoff: 1s, 2s, 3s
-      delay(1000 * (retry + 1));
+    if (!cellularProbeModem(cache)) return false;
+    bootTiming.atMs = millis() - phaseStart;
+
+    // Modem đã trả lời AT: init (ATE0, CMEE...) là đủ, restart chỉ để cứu khi init lỗi
+    phaseStart = millis();
+    bool modemReady = modem.init();
+    for (int retry = 0; !modemReady && retry < 2; retry++) {
+      Serial.printf("[CELL] Init lỗi, restart modem lần %d/2...\n", retry + 1);
+      bootTiming.restarted = true;
+      modemReady = modem.restart();
     }
-    
+    bootTiming.initMs = millis() - phaseStart;
     if (!modemReady) {
       Serial.println("[CELL]  Modem không khởi động được");
       logCEER();
       return false;
     }
-    
-    String name = modem.getModemName();
-    String info = modem.getModemInfo();
-    Serial.println("[CELL] Modem: " + name + " | " + info);
-    
+    cellularNegotiateBaud(cache);
+
     #if CELL_FORCE_LTE_ONLY
-      modem.sendAT("+CNMP=38");  modem.waitResponse(2000);
-      modem.sendAT("+CMNB=1");   modem.waitResponse(2000);
+      // CNMP lưu trong modem: chỉ ghi khi khác, ghi lại làm modem đăng ký lại từ đầu
+      AtResult cnmp;
+      if (!atSend("+CNMP?", 1000, NULL, &cnmp) || strstr(cnmp.response, "+CNMP: 38") == NULL) {
+        atSend("+CNMP=38", 2000);
+        atSend("+CMNB=1", 2000);
+      }
     #endif
-    
-    modem.sendAT("+CPSI?"); modem.waitResponse(2000);
-    isModemReady = true;
-    
-    // Check SIM
+
+    // Check SIM: modem vừa bật báo "+CPIN: READY" sau AT vài trăm ms
+    phaseStart = millis();
     Serial.println("[CELL] Kiểm tra SIM card...");
-    modem.sendAT("+CPIN?");
-    int cpinCheck = modem.waitResponse(1000);
-    
-    if (cpinCheck != 1) {
+    bool simReady = false;
+    while (true) {
+      AtResult cpin;
+      if (atSend("+CPIN?", 1000, NULL, &cpin) && strstr(cpin.response, "READY") != NULL) {
+        simReady = true;
+        break;
+      }
+      if (millis() - phaseStart >= CELL_SIM_READY_TIMEOUT_MS) break;
+      xSemaphoreTake(regEvent, pdMS_TO_TICKS(500));
+    }
+    bootTiming.simMs = millis() - phaseStart;
+    if (!simReady) {
       Serial.println("[CELL]  SIM card NOT detected");
       return false;
     }
     Serial.println("[CELL]  SIM card detected");
+    isModemReady = true;
   }
-  
-  // ===== PHASE 2: Establish Data Connection =====
-  Serial.print("[CELL] Kết nối dữ liệu với APN: ");
-  Serial.println(CELL_APN);
-  
-  // GPRS Connect with retries và exponential backoff
-  bool gprsOk = false;
-  for (int gprsRetry = 0; gprsRetry < 4; gprsRetry++) {  // Tăng từ 3 lên 4 lần thử
-    // Kiểm tra signal quality trước khi kết nối
-    int16_t csq = modem.getSignalQuality();
-    Serial.printf("[CELL]  Signal quality (CSQ): %d\n", csq);
-    if (csq < 5 && csq >= 0) {
-      Serial.println("[CELL]  Signal yếu, chờ cải thiện...");
-      delay(3000);
-    }
-    
-    if (modem.gprsConnect(CELL_APN, CELL_USER, CELL_PASS)) {
-      gprsOk = true;
-      break;
-    }
-    Serial.printf("[CELL]  GPRS connect failed (attempt %d/4)\n", gprsRetry + 1);
-    if (gprsRetry < 3) {
-      // Exponential backoff: 2s, 4s, 6s
-      delay(2000 * (gprsRetry + 1));
-    }
-  }
-  
-  if (!gprsOk) {
-    Serial.println("[CELL]  GPRS connect failed after 4 attempts");
-    isDataConnected = false;
+
+  phaseStart = millis();
+  if (!cellularWaitRegistered(cache, bootTiming.poweredOn)) {
+    logCEER();
     return false;
   }
-  Serial.println("[CELL]  GPRS connected");
-  
-  // Network Open (activate data context) - đảm bảo đóng trước khi mở lại
-  Serial.println("[CELL] Đóng NETOPEN cũ (nếu có)...");
-  modem.sendAT("+NETCLOSE");
-  modem.waitResponse(2000);  // Tăng timeout để đảm bảo đóng hoàn toàn
-  delay(500);  // Chờ thêm để modem xử lý
-  
-  // Kiểm tra trạng thái NETOPEN trước khi mở
-  bool netopenOk = false;
-  for (int i = 0; i < 3; i++) {  // Tăng từ 2 lên 3 lần thử
-    Serial.printf("[CELL] Thử NETOPEN lần %d/3...\n", i + 1);
-    modem.sendAT("+NETOPEN");
-    int response = modem.waitResponse(8000);  // Tăng timeout từ 5s lên 8s
-    if (response == 1) {
-      Serial.println("[CELL]  NETOPEN thành công");
-      netopenOk = true;
-      break;
-    }
-    Serial.printf("[CELL] NETOPEN retry (response: %d)...\n", response);
-    if (i < 2) {
-      delay(2000 * (i + 1));  // Exponential backoff: 2s, 4s
+  bootTiming.registerMs = millis() - phaseStart;
+
+  // Mạng đã đăng ký (lưu NVS khi bring-up xong); hỏi trước pha 2 vì PPP chạy rồi thì UART không nhận AT
+  AtResult cops;
+  if (atSend("+COPS=3,2", 1000) && atSend("+COPS?", 1000, NULL, &cops)) {
+    const char* q = strchr(cops.response, '"');
+    if (q) {
+      size_t n = 0;
+      for (q++; *q && *q != '"' && n + 1 < sizeof(cache.plmn); q++) cache.plmn[n++] = *q;
+      cache.plmn[n] = '\0';
     }
   }
-  
-  if (!netopenOk) {
-    Serial.println("[CELL]  NETOPEN failed after 3 attempts");
+
+  // ===== PHASE 2: Establish Data Connection =====
+  phaseStart = millis();
+  httpSessionClose();  // NETCLOSE/NETOPEN bên dưới hủy mọi socket cũ
+
+#if CELL_DATA_MODE == CELL_DATA_MODE_PPP
+  Serial.print("[CELL] Quay số PPP với APN: ");
+  Serial.println(CELL_APN);
+  if (!cellPppStart(CELL_APN, CELL_USER, CELL_PASS, onPppDown)) {
     isDataConnected = false;
-    // Thử đóng lại để cleanup
-    modem.sendAT("+NETCLOSE");
-    modem.waitResponse(2000);
+    logCEER();
     return false;
   }
-  
-  // DNS config
-  modem.sendAT("+CDNSCFG=\"8.8.8.8\",\"1.1.1.1\"");
-  modem.waitResponse(1000);
-  esp_task_wdt_reset(); // Reset after DNS config
-  
-  // Check signal strength
-  Serial.print("[CELL]  Kiểm tra signal: ");
-  modem.sendAT("+CSQ");
-  modem.waitResponse(1000);
-  esp_task_wdt_reset(); // Reset after signal check
-  
-  // Pre-resolve backend host DNS ONE TIME để cache (không resolve lại mỗi request)
-  Serial.println("[CELL]  Resolve backend host...");
-  modem.sendAT("+CDNSGIP=\"" BACKEND_HOST "\"");
-  modem.waitResponse(5000);
-  esp_task_wdt_reset(); // Reset after DNS resolution
-  
-  //  Chờ thêm cho HTTP client ổn định
-  Serial.println("[CELL]  HTTP client initializing...");
-  for (int i = 0; i < 3; i++) {  // 3 x 500ms = 1.5 giây để ổn định hơn
-    delay(500);
-    esp_task_wdt_reset(); // Reset watchdog during stabilization delays
+  // Timeout mở socket như CIPOPEN ở chế độ AT (WiFiClient mặc định 3 s, ngắn với 4G)
+  uploadSocket.setTimeout(CELL_TCP_CONNECT_TIMEOUT_S);
+  alertSocket.setTimeout(CELL_ALERT_CONNECT_TIMEOUT_S);
+#else
+  // Data context lần trước (cùng APN) vẫn mở: chỉ đóng socket sót lại, giữ nguyên NETOPEN
+  AtResult netState;
+  if (strcmp(cache.apn, CELL_APN) == 0 && atSend("+NETOPEN?", 1000, NULL, &netState) &&
+      strstr(netState.response, "+NETOPEN: 1") != NULL) {
+    Serial.println("[CELL]  Data context còn mở từ lần trước, bỏ qua GPRS/NETOPEN");
+    bootTiming.warmData = true;
+    atSend("+CIPCLOSE=0", 2000, "+CIPCLOSE:");
+    char close[24];
+    snprintf(close, sizeof(close), "+CIPCLOSE=%d", CELL_ALERT_MUX);
+    atSend(close, 2000, "+CIPCLOSE:");
+  } else {
+    Serial.print("[CELL] Kết nối dữ liệu với APN: ");
+    Serial.println(CELL_APN);
+
+    // GPRS Connect with retries và exponential backoff (đã đăng ký mạng nên không chờ sóng ở đây)
+    bool gprsOk = false;
+    for (int gprsRetry = 0; gprsRetry < 4; gprsRetry++) {  // Tăng từ 3 lên 4 lần thử
+      if (modem.gprsConnect(CELL_APN, CELL_USER, CELL_PASS)) {
+        gprsOk = true;
+        break;
+      }
+      Serial.printf("[CELL]  GPRS connect failed (attempt %d/4)\n", gprsRetry + 1);
+      if (gprsRetry < 3) {
+        // Exponential backoff: 2s, 4s, 6s
+        delay(2000 * (gprsRetry + 1));
+      }
+    }
+
+    if (!gprsOk) {
+      Serial.println("[CELL]  GPRS connect failed after 4 attempts");
+      isDataConnected = false;
+      return false;
+    }
+    Serial.println("[CELL]  GPRS connected");
+
+    // Network Open (activate data context) - đảm bảo đóng trước khi mở lại
+    Serial.println("[CELL] Đóng NETOPEN cũ (nếu có)...");
+    // Chờ tới "+NETCLOSE: <err>" (mạng đã đóng thật) thay vì chờ cố định; chưa mở thì modem trả ERROR ngay
+    atSend("+NETCLOSE", 2000, "+NETCLOSE:");
+
+    bool netopenOk = false;
+    for (int i = 0; i < 3; i++) {  // Tăng từ 2 lên 3 lần thử
+      Serial.printf("[CELL] Thử NETOPEN lần %d/3...\n", i + 1);
+      AtResult netopen;
+      AtStatus response = atCommand("+NETOPEN", 8000, &netopen, "+NETOPEN:", AT_PRIO_HIGH);
+      if (response == AT_OK && strstr(netopen.response, "+NETOPEN: 0") != NULL) {
+        Serial.println("[CELL]  NETOPEN thành công");
+        netopenOk = true;
+        break;
+      }
+      Serial.printf("[CELL] NETOPEN retry (status: %d, %s)...\n", response, netopen.response);
+      if (i < 2) {
+        delay(2000 * (i + 1));  // Exponential backoff: 2s, 4s
+      }
+    }
+
+    if (!netopenOk) {
+      Serial.println("[CELL]  NETOPEN failed after 3 attempts");
+      isDataConnected = false;
+      // Thử đóng lại để cleanup
+      atSend("+NETCLOSE", 2000, "+NETCLOSE:");
+      return false;
+    }
+
+    // DNS config
+    atSend("+CDNSCFG=\"8.8.8.8\",\"1.1.1.1\"", 1000);
+    esp_task_wdt_reset(); // Reset after DNS config
   }
-  
-  // Kiểm tra lại signal quality sau khi kết nối
-  int16_t finalCsq = modem.getSignalQuality();
-  Serial.printf("[CELL]  Final signal quality: %d\n", finalCsq);
-  
+#endif
+  bootTiming.dataMs = millis() - phaseStart;
+
+  // Lưu lại cấu hình vừa chạy được cho lần boot sau
+  strncpy(cache.apn, CELL_APN, sizeof(cache.apn) - 1);
+  cache.apn[sizeof(cache.apn) - 1] = '\0';
+  cellBootCacheSave(bootCache, cache);
+
+  bootTiming.totalMs = millis() - bootTiming.startMs;
+  Serial.printf("[CELL] Boot timing: AT %lu ms | init %lu | SIM %lu | đăng ký %lu | data %lu | tổng %lu ms"
+                " (pwrkey=%d restart=%d dò chân=%d context cũ=%d)\n",
+                (unsigned long)bootTiming.atMs, (unsigned long)bootTiming.initMs, (unsigned long)bootTiming.simMs,
+                (unsigned long)bootTiming.registerMs, (unsigned long)bootTiming.dataMs,
+                (unsigned long)bootTiming.totalMs, bootTiming.poweredOn, bootTiming.restarted, bootTiming.pinScan,
+                bootTiming.warmData);
+
   isDataConnected = true;
   Serial.println("[CELL]  Kết nối 4G hoàn tất!");
   return true;
 }
 
+CellularBootTiming cellularGetBootTiming() {
+  return bootTiming;
+}
+
+CellularUartStats cellularUartGetStats() {
+  CellularUartStats out = uartStats;
+  AtEngineStats es = atEngineGetStats();
+  out.baud = uartBaud;
+  out.baudCeiling = bootCacheLoaded ? bootCache.baudCeiling : CELL_BAUD_MAX;
+  out.flowControl = CELL_UART_RTS_PIN >= 0 && CELL_UART_CTS_PIN >= 0;
+  out.overruns = es.uartOverruns;
+  out.frameErrors = es.uartFrameErrors;
+  return out;
+}
+
 /**
  * @brief Kiểm tra và đảm bảo kết nối 4G còn hoạt động trước khi gửi request.
  * 
  * @return true nếu kết nối OK, false nếu cần reconnect
  */
 static bool ensureCellularConnection() {
-  // Kiểm tra signal quality
-  int16_t csq = modem.getSignalQuality();
-  if (csq < 0 || (csq >= 0 && csq < 3)) {
-    Serial.println("[CELL]  Signal quá yếu, đánh dấu mất kết nối");
+  // Kiểm tra signal quality theo snapshot của task theo dõi (không tốn lệnh AT); chưa có/đã cũ thì bỏ qua
+  CellularStatus status = statusSnapshot.read();
+  bool fresh = status.valid && millis() - status.sampledAtMs < CELL_MONITOR_STALE_MS;
+  if (fresh && status.csq >= 0 && status.csq < CELL_MIN_CSQ) {
+    Serial.printf("[CELL]  Signal quá yếu (CSQ %d), đánh dấu mất kết nối\n", status.csq);
     isDataConnected = false;
     return false;
   }
@@ -332,520 +812,1198 @@ static bool ensureCellularConnection() {
 }
 
 /**
- * @brief Gửi HTTP POST tiêu chuẩn qua đường 4G.
- *
- * Hàm tự động kiểm tra và reconnect nếu cần.
- * - Luôn dựng lại HttpClient mới (connection close) để tránh giữ session hỏng.
- * - Cho phép thử tối đa 3 lần với exponential backoff.
- * - Tự động reconnect nếu phát hiện mất kết nối.
- * - Reset watchdog thường xuyên để tránh WDT khi mạng chậm.
- *
- * @return true nếu nhận mã phản hồi 2xx, false nếu tất cả attempt đều thất bại.
+ * @brief Bỏ phiên keep-alive nếu không còn tin được: server/NAT đã đóng (URC +IPCLOSE cập nhật cờ
+ * connected() của TinyGSM, không tốn lệnh AT) hoặc để rảnh quá CELL_HTTP_KEEPALIVE_IDLE_MS.
  */
-bool cellularHttpPost(const char* host, uint16_t port, const char* path, const String& body, String& response) {
-  if (cellularHttpMutex) xSemaphoreTake(cellularHttpMutex, portMAX_DELAY);
-  
-  // Kiểm tra và đảm bảo kết nối trước khi gửi
-  if (!ensureCellularConnection()) {
-    Serial.println("[CELL] Đang reconnect...");
-    if (!cellularBegin()) {
-      Serial.println("[CELL]  Reconnect thất bại");
-      if (cellularHttpMutex) xSemaphoreGive(cellularHttpMutex);
-      return false;
-    }
+static void httpSessionPrune() {
+  if (!backendSessionOpen) return;
+  #if CELL_DATA_MODE != CELL_DATA_MODE_PPP
+    atLock(portMAX_DELAY);
+    modem.maintain();  // Xử lý URC đang chờ trong buffer UART
+    atUnlock();
+  #endif
+  if (!uploadSocket.connected()) {
+    sessionStatAdd(sessionStats.closedByPeer);
+    httpSessionClose();
+  } else if (millis() - backendLastUsedMs > CELL_HTTP_KEEPALIVE_IDLE_MS) {
+    sessionStatAdd(sessionStats.idleClosed);
+    httpSessionClose();
   }
-  
-  // Đảm bảo client ở trạng thái sạch trước mỗi request
-  gsmClient.stop();
-  Serial.print("[CELL] HTTP POST to ");
-  Serial.print(host);
-  Serial.print(":");
-  Serial.println(port);
-  esp_task_wdt_reset();
-  
-  //  DNS đã cached trong cellularBegin() - không cần resolve lại
-  // HTTP request với timeout
-  HttpClient http(gsmClient, host, port);
-  http.setTimeout(20000);  // Tăng timeout lên 20s để ổn định hơn với mạng chậm
-  esp_task_wdt_reset();
-
-  // Tăng số lần retry từ 2 lên 3 với exponential backoff
-  for (int attempt = 1; attempt <= 3; attempt++) {
-    http.beginRequest();
-    http.post(path);
-    http.sendHeader("Content-Type", "application/json");
-    http.sendHeader("X-API-Key", APPLICATION_KEY);
-    http.sendHeader("Content-Length", body.length());
-    http.sendHeader("Connection", "close"); // tránh keep-alive gây treo
-    http.beginBody();
-    esp_task_wdt_reset();
-
-    http.print(body);
-    http.endRequest();
-    esp_task_wdt_reset();  // Reset sau endRequest (có thể chậm)
-
-    // 🐕 Chờ response - có thể mất thời gian, reset watchdog thường xuyên
-    delay(100);
-    esp_task_wdt_reset();
-
-    int statusCode = http.responseStatusCode();
-    esp_task_wdt_reset();  // Reset sau responseStatusCode
-    if (statusCode >= 200 && statusCode < 300) {
-      response = http.responseBody();
-      esp_task_wdt_reset();  // Reset sau responseBody
-      delay(100);
-      esp_task_wdt_reset();  // Reset trước khi stop
-      http.stop();
-      Serial.print("[CELL] HTTP ");
-      Serial.println(statusCode);
-      esp_task_wdt_reset();
-      if (cellularHttpMutex) xSemaphoreGive(cellularHttpMutex);
-      return true;
-    }
-
-    // Log và xử lý lỗi
-    Serial.print("[CELL] HTTP ");
-    Serial.println(statusCode);
-    http.stop();
+}
 
-    // Với lỗi transport (-1/-2/-3) hoặc 400, đánh dấu mất kết nối và retry với reconnect
-    if (attempt < 3 && (statusCode == -3 || statusCode == -2 || statusCode == -1 || statusCode == 400)) {
-      Serial.printf("[CELL] POST lỗi (code: %d), attempt %d/3\n", statusCode, attempt);
-      isDataConnected = false;
-      
-      // Đóng NETOPEN để cleanup
-      modem.sendAT("+NETCLOSE");
-      modem.waitResponse(2000);
-      
-      // Exponential backoff: 1s, 2s, 4s
-      unsigned long backoffMs = 1000 * (1 << (attempt - 1));
-      Serial.printf("[CELL] Chờ %lu ms trước khi retry...\n", backoffMs);
-      unsigned long backoffStart = millis();
-      while (millis() - backoffStart < backoffMs) {
-        delay(100);
-        esp_task_wdt_reset();
-      }
-      
-      // Thử reconnect nếu không phải attempt cuối
-      if (attempt < 3) {
-        Serial.println("[CELL] Thử reconnect trước khi retry...");
-        if (cellularBegin()) {
-          Serial.println("[CELL]  Reconnect thành công, retry request...");
-          gsmClient.stop();  // Đảm bảo client sạch
-          http = HttpClient(gsmClient, host, port);
-          http.setTimeout(20000);
-          esp_task_wdt_reset();
-        } else {
-          Serial.println("[CELL]  Reconnect thất bại, vẫn retry...");
-        }
-      }
+/**
+ * @brief Đọc body theo từng đoạn vào `sink` thay vì gom vào String (body lớn, đo thông lượng).
+ * @return Số byte đã đưa cho sink.
+ */
+static size_t httpStreamBody(HttpClient& http, uint16_t timeoutMs, ModemHttpSink sink, void* ctx) {
+  uint8_t buf[512];
+  size_t total = 0;
+  unsigned long lastData = millis();
+  while (!http.endOfBodyReached()) {
+    int n = http.read(buf, sizeof(buf));
+    if (n > 0) {
+      total += n;
+      lastData = millis();
+      if (!sink(buf, n, ctx)) break;
       continue;
     }
-    if (cellularHttpMutex) xSemaphoreGive(cellularHttpMutex);
-    return false;
+    if (!http.connected() || millis() - lastData > timeoutMs) break;
+    delay(1);
+    esp_task_wdt_reset();
   }
-  if (cellularHttpMutex) xSemaphoreGive(cellularHttpMutex);
-  return false;
+  return total;
 }
 
 /**
- * @brief Biến thể POST cho phép cấu hình timeout/số lần thử/backoff tùy tình huống.
- *
- * Phù hợp với các API tốn thời gian (ví dụ: gửi log lớn, ota metadata).
+ * @brief Gửi một request trên HttpClient đã dựng và đọc response.
+ * @param body NULL = GET, ngược lại POST với `contentType`.
+ * @param sink Khác NULL: body 2xx đi vào sink (`streamed` nhận số byte), `response` để trống.
+ * @return Mã HTTP, hoặc mã lỗi âm của ArduinoHttpClient (-1 kết nối, -3 timeout...).
  */
-bool cellularHttpPostWithOptions(const char* host, uint16_t port, const char* path,
-                                 const String& body, String& response,
-                                 uint16_t timeoutMs, int attempts, uint16_t backoffMs) {
-  if (cellularHttpMutex) xSemaphoreTake(cellularHttpMutex, portMAX_DELAY);
-  
-  // Kiểm tra và đảm bảo kết nối trước khi gửi
-  if (!ensureCellularConnection()) {
-    Serial.println("[CELL] Đang reconnect...");
-    if (!cellularBegin()) {
-      Serial.println("[CELL]  Reconnect thất bại");
-      if (cellularHttpMutex) xSemaphoreGive(cellularHttpMutex);
-      return false;
-    }
+static int httpExchange(HttpClient& http, const char* path, const uint8_t* body, size_t length,
+                        const char* contentType, uint16_t timeoutMs, String& response, uint32_t& ttfbMs,
+                        ModemHttpSink sink, void* sinkCtx, size_t& streamed) {
+  unsigned long t0 = millis();
+  http.setTimeout(timeoutMs);
+  http.setHttpResponseTimeout(timeoutMs);
+  http.beginRequest();
+  int err = body ? http.post(path) : http.get(path);
+  if (err != 0) return err;
+  http.sendHeader("X-API-Key", APPLICATION_KEY);
+  if (body) {
+    http.sendHeader("Content-Type", contentType);
+    http.sendHeader("Content-Length", length);
+  } else {
+    http.sendHeader("Accept", "application/json");
   }
-  
-  gsmClient.stop();
-  Serial.print("[CELL] HTTP POST(opt) to "); Serial.print(host); Serial.print(":"); Serial.println(port);
+  http.beginBody();
+  if (body) http.write(body, length);
+  http.endRequest();
   esp_task_wdt_reset();
 
-  HttpClient http(gsmClient, host, port);
-  http.setTimeout(timeoutMs);
+  int statusCode = http.responseStatusCode();
+  ttfbMs = millis() - t0;  // Gồm cả mở socket (nếu cần) và gửi request
   esp_task_wdt_reset();
-
-  for (int attempt = 1; attempt <= (attempts < 1 ? 1 : attempts); attempt++) {
-    http.beginRequest();
-    http.post(path);
-    http.sendHeader("Content-Type", "application/json");
-    http.sendHeader("X-API-Key", APPLICATION_KEY);
-    http.sendHeader("Content-Length", body.length());
-    http.sendHeader("Connection", "close");
-    http.beginBody();
+  if (statusCode >= 200 && statusCode < 300) {
+    if (sink) streamed = httpStreamBody(http, timeoutMs, sink, sinkCtx);
+    else response = http.responseBody();
     esp_task_wdt_reset();
+  }
+  return statusCode;
+}
 
-    http.print(body);
-    http.endRequest();
-    esp_task_wdt_reset();
+/**
+ * @brief Một lượt request: tới backend thì chạy trên phiên keep-alive, host khác thì socket dùng một lần.
+ *
+ * Phiên chỉ được giữ khi response 2xx đã đọc trọn body; mọi trường hợp khác đóng socket. Socket dùng lại
+ * mà lỗi transport (half-open chưa kịp thấy URC) thì mở socket mới và gửi lại ngay một lần, không tính
+ * là một attempt. POST gửi lại có thể trùng nếu server đã nhận: backend khử trùng theo (boot_id, seq).
+ */
+static int httpRequestOnce(const char* host, uint16_t port, const char* path, const uint8_t* body, size_t length,
+                           const char* contentType, uint16_t timeoutMs, String& response,
+                           ModemHttpSink sink, void* sinkCtx, size_t& streamed) {
+  int statusCode;
+  uint32_t ttfbMs = 0;
+  bool opened;
+  bool keepAlive = isBackend(host, port);
+  if (keepAlive) {
+    backendHttp.connectionKeepAlive();  // Không gửi "Connection: close", không đóng socket sau response
+    httpSessionPrune();
+    bool reused = backendSessionOpen;
+    if (!reused) backendHttp.stop();  // Socket sạch trước khi mở mới
+    statusCode = httpExchange(backendHttp, path, body, length, contentType, timeoutMs, response, ttfbMs,
+                              sink, sinkCtx, streamed);
+    if (statusCode < 0 && reused) {
+      Serial.printf("[CELL] Socket keep-alive hỏng (code: %d), mở socket mới và gửi lại\n", statusCode);
+      sessionStatAdd(sessionStats.staleRecovered);
+      httpSessionClose();
+      backendHttp.stop();
+      reused = false;
+      statusCode = httpExchange(backendHttp, path, body, length, contentType, timeoutMs, response, ttfbMs,
+                                sink, sinkCtx, streamed);
+    }
+    if (statusCode >= 200 && statusCode < 300 && backendHttp.endOfBodyReached()) {
+      backendSessionOpen = true;
+      backendLastUsedMs = millis();
+    } else {
+      backendHttp.stop();
+      backendSessionOpen = false;
+    }
+    sessionStatAdd(reused ? sessionStats.reused : sessionStats.opened);
+    opened = !reused;
+  } else {
+    // gsmClient dùng chung mux 0 với phiên backend: đóng phiên trước
+    httpSessionClose();
+    uploadSocket.stop();
+    HttpClient http(uploadSocket, host, port);
+    statusCode = httpExchange(http, path, body, length, contentType, timeoutMs, response, ttfbMs,
+                              sink, sinkCtx, streamed);
+    http.stop();
+    sessionStatAdd(sessionStats.opened);
+    opened = true;
+  }
+  if (opened && statusCode > 0) {
+    // So sánh có/không cache DNS chỉ có nghĩa với socket mới (có bước mở kết nối)
+    uint8_t bucket = dnsCacheEnabled() ? 1 : 0;
+    portENTER_CRITICAL(&sessionMux);
+    ttfbSumMs[bucket] += ttfbMs;
+    if (bucket) sessionStats.ttfbDnsCacheCount++;
+    else sessionStats.ttfbDnsLiveCount++;
+    sessionStats.lastTtfbMs = ttfbMs;
+    portEXIT_CRITICAL(&sessionMux);
+  }
+  return statusCode;
+}
 
-    delay(20);
-    esp_task_wdt_reset();
+// --------------------------------------------------------------------
+// Bộ thực thi request 4G: retry có jitter, deadline, circuit breaker, nhường việc khẩn
+// --------------------------------------------------------------------
+// Mỗi lượt thử giữ cellularHttpMutex; giữa các lượt (NETCLOSE xong, đang backoff) mutex được nhả nên
+// request khẩn (host khác) và socket khẩn không phải chờ hết vòng retry của một upload lỗi.
+
+// Một lượt thử: trả mã HTTP, mã lỗi âm của ArduinoHttpClient hoặc CELL_ATTEMPT_*
+typedef int (*CellAttemptFn)(void* ctx);
+static const int CELL_ATTEMPT_RETRY = -100;  // Lỗi tạm, thử lại không cần dựng lại data context
+static const int CELL_ATTEMPT_ABORT = -101;  // Lỗi không thử lại được
+
+struct CellRequestPolicy {
+  const char* tag;
+  int attempts;
+  uint16_t backoffMs;      // 0 = lũy thừa 1 s, 2 s, 4 s... (tối đa CELL_RETRY_BACKOFF_MAX_MS)
+  uint32_t deadlineMs;     // Kiểm tra trước mỗi lượt thử; một lượt tự giới hạn bằng timeout của nó
+  bool urgent;             // Không nhường ai, không bị breaker chặn
+};
+
+enum CellFailureKind : uint8_t {
+  CELL_FAIL_NONE = 0,
+  CELL_FAIL_LINK,          // Lỗi đường truyền: NETCLOSE, lượt sau dựng lại data context
+  CELL_FAIL_TRANSIENT,     // Server bận/timeout đọc: thử lại trên kết nối hiện có
+  CELL_FAIL_PERMANENT      // 4xx, lỗi ghi flash...: thử lại cũng vậy
+};
+
+static CellFailureKind classifyAttempt(int code) {
+  if (code >= 200 && code < 300) return CELL_FAIL_NONE;
+  // Như trước: -1/-2/-3 và 400 (request bị cắt giữa chừng trên sóng yếu) coi là mất đường truyền
+  if (code == -1 || code == -2 || code == -3 || code == 400) return CELL_FAIL_LINK;
+  if (code == -4 || code == CELL_ATTEMPT_RETRY || code == 408 || code == 429 || code >= 500) return CELL_FAIL_TRANSIENT;
+  return CELL_FAIL_PERMANENT;
+}
+
+static portMUX_TYPE urgentMux = portMUX_INITIALIZER_UNLOCKED;
+static volatile uint8_t urgentActive = 0;    // Số việc khẩn đang chờ/đang dùng modem
+
+static void urgentEnter() {
+  portENTER_CRITICAL(&urgentMux);
+  urgentActive++;
+  portEXIT_CRITICAL(&urgentMux);
+}
+
+static void urgentLeave() {
+  portENTER_CRITICAL(&urgentMux);
+  if (urgentActive > 0) urgentActive--;
+  portEXIT_CRITICAL(&urgentMux);
+}
+
+static bool breakerOpen = false;
+static uint8_t breakerFailures = 0;          // Request lỗi đường truyền liên tiếp
+static uint32_t breakerOpenedAtMs = 0;
 
-    int statusCode = http.responseStatusCode();
+/**
+ * @brief Breaker mở thì request thường bị từ chối ngay; hết CELL_BREAKER_OPEN_MS thì cho request kế
+ * tiếp đi thử (nửa mở), kết quả của nó quyết định đóng hay mở tiếp.
+ */
+static bool breakerAllows(bool urgent) {
+  if (urgent) return true;
+  uint32_t now = millis();
+  portENTER_CRITICAL(&sessionMux);
+  bool allowed = !breakerOpen || now - breakerOpenedAtMs >= CELL_BREAKER_OPEN_MS;
+  if (!allowed) sessionStats.breakerRejected++;
+  portEXIT_CRITICAL(&sessionMux);
+  return allowed;
+}
+
+/**
+ * @brief Ghi kết quả một request vào breaker. Gọi sau khi đã nhả cellularHttpMutex (alertTask và uploadTask
+ * có thể cùng ghi) nên trạng thái đổi trong sessionMux, log in ra ngoài vùng khóa.
+ */
+static void breakerRecord(bool linkOk) {
+  uint32_t now = millis();
+  bool closed = false;
+  uint8_t tripped = 0;
+  portENTER_CRITICAL(&sessionMux);
+  if (linkOk) {
+    closed = breakerOpen;
+    breakerOpen = false;
+    breakerFailures = 0;
+  } else if (breakerOpen) {
+    breakerOpenedAtMs = now;  // Lượt thử nửa mở cũng lỗi: mở thêm một chu kỳ
+  } else if (++breakerFailures >= CELL_BREAKER_THRESHOLD) {
+    breakerOpen = true;
+    breakerOpenedAtMs = now;
+    sessionStats.breakerTrips++;
+    tripped = breakerFailures;
+  }
+  portEXIT_CRITICAL(&sessionMux);
+  if (closed) Serial.println("[CELL] Circuit breaker đóng lại");
+  if (tripped) {
+    Serial.printf("[CELL] Circuit breaker mở sau %u request lỗi liên tiếp, tạm dừng %d ms\n",
+                  tripped, CELL_BREAKER_OPEN_MS);
+  }
+}
+
+static uint32_t msLeft(uint32_t startMs, uint32_t deadlineMs) {
+  uint32_t elapsed = millis() - startMs;
+  return elapsed >= deadlineMs ? 0 : deadlineMs - elapsed;
+}
+
+/**
+ * @brief Ngủ không giữ mutex, vẫn nuôi watchdog.
+ */
+static void idleWait(uint32_t ms) {
+  uint32_t t0 = millis();
+  while (millis() - t0 < ms) {
+    delay(50);
     esp_task_wdt_reset();
-    if (statusCode >= 200 && statusCode < 300) {
-      response = http.responseBody();
-      http.stop();
-      if (cellularHttpMutex) xSemaphoreGive(cellularHttpMutex);
-      Serial.print("[CELL] HTTP "); Serial.println(statusCode);
+  }
+}
+
+/**
+ * @brief Chạy `attempt` theo `policy`. Thay cho các vòng retry riêng của POST/GET, OTA và HTTPS qua AT.
+ * @return true khi một lượt thử trả 2xx.
+ */
+static bool cellularExecute(const CellRequestPolicy& policy, CellAttemptFn attempt, void* ctx) {
+  cellularLocksInit();
+  uint32_t startMs = millis();
+  if (!breakerAllows(policy.urgent)) {
+    Serial.printf("[CELL] %s bỏ qua: circuit breaker đang mở\n", policy.tag);
+    return false;
+  }
+
+  int attempts = policy.attempts < 1 ? 1 : policy.attempts;
+  CellFailureKind kind = CELL_FAIL_LINK;
+  for (int n = 1; n <= attempts; n++) {
+    // Việc khẩn đang chờ modem: request thường nhường trước khi giành lại mutex
+    if (!policy.urgent && urgentActive > 0) {
+      sessionStatAdd(sessionStats.preempted);
+      while (urgentActive > 0 && msLeft(startMs, policy.deadlineMs) > 0) idleWait(20);
+    }
+    uint32_t left = msLeft(startMs, policy.deadlineMs);
+    if (left == 0 || xSemaphoreTake(cellularHttpMutex, pdMS_TO_TICKS(left)) != pdTRUE) {
+      sessionStatAdd(sessionStats.deadlineExpired);
+      Serial.printf("[CELL] %s hết hạn %lu ms\n", policy.tag, (unsigned long)policy.deadlineMs);
+      break;
+    }
+
+    int code;
+    if (!ensureCellularConnection() && !cellularBegin()) {
+      Serial.println("[CELL]  Reconnect thất bại");
+      code = HTTP_ERROR_CONNECTION_FAILED;
+    } else {
+      if (bootTiming.firstSendMs == 0) {
+        bootTiming.firstSendMs = millis();
+        Serial.printf("[CELL] Boot → request đầu tiên: %lu ms\n", (unsigned long)bootTiming.firstSendMs);
+      }
+      sessionStatAdd(sessionStats.attempts);
+      esp_task_wdt_reset();
+      code = attempt(ctx);
+    }
+
+    kind = classifyAttempt(code);
+    if (kind == CELL_FAIL_NONE) {
+      xSemaphoreGive(cellularHttpMutex);
+      breakerRecord(true);
       return true;
     }
+    Serial.printf("[CELL] %s lỗi (code: %d), attempt %d/%d\n", policy.tag, code, n, attempts);
 
-    Serial.printf("[CELL] HTTP POST(opt) lỗi (code: %d), attempt %d/%d\n", statusCode, attempt, attempts);
-    http.stop();
-    if (attempt < attempts && (statusCode == -3 || statusCode == -2 || statusCode == -1 || statusCode == 400)) {
+    bool retry = n < attempts && kind != CELL_FAIL_PERMANENT;
+    if (retry && kind == CELL_FAIL_LINK && isDataConnected) {
+      // Đóng data context ngay (còn giữ mutex); lượt sau cellularBegin() dựng lại
       isDataConnected = false;
-      modem.sendAT("+NETCLOSE");
-      modem.waitResponse(2000);  // Tăng timeout để cleanup tốt hơn
-      
-      // Exponential backoff hoặc dùng backoffMs nếu được cung cấp
-      unsigned long actualBackoff = backoffMs > 0 ? backoffMs : (1000 * (1 << (attempt - 1)));
-      Serial.printf("[CELL] Chờ %lu ms trước khi retry...\n", actualBackoff);
-      unsigned long t0 = millis();
-      while (millis() - t0 < actualBackoff) {
-        delay(50);
-        esp_task_wdt_reset();
-      }
-      
-      // Thử reconnect nếu không phải attempt cuối
-      if (attempt < attempts) {
-        Serial.println("[CELL] Thử reconnect trước khi retry...");
-        if (cellularBegin()) {
-          Serial.println("[CELL]  Reconnect thành công, retry request...");
-          gsmClient.stop();
-          http = HttpClient(gsmClient, host, port);
-          http.setTimeout(timeoutMs);
-          esp_task_wdt_reset();
-        } else {
-          Serial.println("[CELL]  Reconnect thất bại, vẫn retry...");
-        }
-      }
-      continue;
+      httpSessionClose();
+      dataContextGen++;
+      dataLinkClose();
     }
-    if (cellularHttpMutex) xSemaphoreGive(cellularHttpMutex);
-    return false;
+    xSemaphoreGive(cellularHttpMutex);
+    if (!retry) break;
+
+    // Equal jitter: nửa cố định + nửa ngẫu nhiên, tránh nhiều lượt thử dồn cùng nhịp với sóng chập chờn
+    uint32_t base = policy.backoffMs > 0 ? policy.backoffMs : (1000UL << (n - 1));
+    if (base > CELL_RETRY_BACKOFF_MAX_MS) base = CELL_RETRY_BACKOFF_MAX_MS;
+    uint32_t backoff = base / 2 + (uint32_t)random(base / 2 + 1);
+    if (backoff >= msLeft(startMs, policy.deadlineMs)) {
+      sessionStatAdd(sessionStats.deadlineExpired);
+      Serial.printf("[CELL] %s không đủ thời gian cho lượt thử tiếp\n", policy.tag);
+      break;
+    }
+    sessionStatAdd(sessionStats.retries);
+    Serial.printf("[CELL] Chờ %lu ms trước khi retry (đã nhả modem)...\n", (unsigned long)backoff);
+    idleWait(backoff);
   }
-  if (cellularHttpMutex) xSemaphoreGive(cellularHttpMutex);
+  if (kind != CELL_FAIL_PERMANENT) breakerRecord(false);
+  else breakerRecord(true);  // Server trả lời được: đường truyền vẫn tốt
   return false;
 }
 
+struct HttpAttempt {
+  const char* host;
+  uint16_t port;
+  const char* path;
+  const uint8_t* body;
+  size_t length;
+  const char* contentType;
+  uint16_t timeoutMs;
+  String* response;
+  int statusCode;
+  bool tls;                // TLS: modem_http (chế độ AT) hoặc WiFiClientSecure trên lwIP (chế độ PPP)
+  ModemHttpSink sink;      // Khác NULL: body 2xx đi thẳng vào sink, không gom vào `response`
+  void* sinkCtx;
+  size_t streamed;         // Số byte body đã đưa cho sink
+  uint32_t latencyMs;      // Thời gian lượt thử gần nhất
+};
+
+// --------------------------------------------------------------------
+// Transport: đường chở một lượt request
+// --------------------------------------------------------------------
+// "tinygsm": socket AT (CIPOPEN/CIPSEND) + HttpClient dựng/phân tích HTTP trên ESP32.
+// "modem":   modem_http, phiên +CHTTPS* của modem (TLS trên modem, phiên giữ qua nhiều request).
+// "ppp":     (CELL_DATA_MODE_PPP) cùng HttpClient nhưng socket là WiFiClient trên netif PPP.
+struct CellHttpTransport {
+  const char* name;
+  int (*request)(HttpAttempt& a);   // Một lượt: mã HTTP, mã lỗi âm hoặc CELL_ATTEMPT_*
+  void (*close)();                  // Bỏ phiên đang giữ (khi đổi transport)
+};
+
+static int tinyGsmRequest(HttpAttempt& a) {
+  return httpRequestOnce(a.host, a.port, a.path, a.body, a.length, a.contentType, a.timeoutMs, *a.response,
+                         a.sink, a.sinkCtx, a.streamed);
+}
+
+static uint32_t modemHttpGen = 0;   // dataContextGen lúc modem_http còn tin phiên của nó
+
+static bool appendBody(const uint8_t* data, size_t len, void* ctx) {
+  ((String*)ctx)->concat((const char*)data, len);
+  esp_task_wdt_reset();
+  return true;
+}
+
+static int modemRequest(HttpAttempt& a) {
+  if (modemHttpGen != dataContextGen) {
+    modemHttpInvalidate();  // Data context đã dựng lại: phiên/dịch vụ cũ trên modem không còn
+    modemHttpGen = dataContextGen;
+  }
+  // Header như đường TinyGSM; POST HTTPS tới host ngoài (cellularHttpPostAT) không mang API key
+  char headers[96];
+  snprintf(headers, sizeof(headers), "%s%s%s%s", a.tls ? "" : "X-API-Key: ", a.tls ? "" : APPLICATION_KEY,
+           a.tls ? "" : "\r\n", a.body ? "" : "Accept: application/json\r\n");
+  ModemHttpRequest req = { a.body ? "POST" : "GET", a.host, a.port, a.tls, a.path, headers,
+                           a.body, a.length, a.contentType, a.timeoutMs };
+  ModemHttpResponse resp;
+  String body;
+  int status = a.sink ? modemHttpRequest(req, resp, a.sink, a.sinkCtx) : modemHttpRequest(req, resp, appendBody, &body);
+  if (a.sink) a.streamed = resp.bodyBytes;
+  else if (status >= 200 && status < 300) *a.response = body;
+  if (status > 0) {
+    portENTER_CRITICAL(&sessionMux);
+    if (resp.reused) sessionStats.reused++;
+    else sessionStats.opened++;
+    sessionStats.lastTtfbMs = resp.ttfbMs;
+    portEXIT_CRITICAL(&sessionMux);
+  }
+  if (status == MODEM_HTTP_ERR_API || status == MODEM_HTTP_ERR_ABORTED) return CELL_ATTEMPT_ABORT;
+  return status;
+}
+
+static const CellHttpTransport MODEM_TRANSPORT = { "modem", modemRequest, modemHttpClose };
+
+#if CELL_DATA_MODE == CELL_DATA_MODE_PPP
 /**
- * @brief Gửi POST dạng "bắn nhanh" với timeout 2 giây, không retry.
+ * @brief HTTPS trên lwIP: HTTPClient + WiFiClientSecure như đường WiFi, không giữ phiên.
+ * Không kiểm chứng chỉ server, giống TLS của modem (+CHTTPS* không nạp CA).
+ */
+static int pppTlsRequest(HttpAttempt& a) {
+  WiFiClientSecure tls;
+  tls.setInsecure();
+  HTTPClient https;
+  https.setTimeout(a.timeoutMs);
+  https.setConnectTimeout(CELL_TCP_CONNECT_TIMEOUT_S * 1000);
+  if (!https.begin(tls, a.host, a.port, a.path, true)) return HTTP_ERROR_CONNECTION_FAILED;
+  int status;
+  if (a.body) {
+    https.addHeader("Content-Type", a.contentType);
+    status = https.POST((uint8_t*)a.body, a.length);
+  } else {
+    https.addHeader("Accept", "application/json");
+    status = https.GET();
+  }
+  if (status >= 200 && status < 300) *a.response = https.getString();
+  https.end();
+  if (status > 0) sessionStatAdd(sessionStats.opened);
+  // Mã lỗi HTTPClient (-1..-11) đổi sang mã ArduinoHttpClient mà bộ thực thi phân loại
+  if (status == HTTPC_ERROR_READ_TIMEOUT) return HTTP_ERROR_TIMED_OUT;
+  return status < 0 ? HTTP_ERROR_CONNECTION_FAILED : status;
+}
+
+static const CellHttpTransport TINYGSM_TRANSPORT = { "ppp", tinyGsmRequest, httpSessionClose };
+static const CellHttpTransport TLS_TRANSPORT = { "ppp-tls", pppTlsRequest, httpSessionClose };
+#else
+static const CellHttpTransport TINYGSM_TRANSPORT = { "tinygsm", tinyGsmRequest, httpSessionClose };
+static const CellHttpTransport& TLS_TRANSPORT = MODEM_TRANSPORT;
+#endif
+static const CellHttpTransport* httpTransport =
+    CELL_HTTP_TRANSPORT_MODEM && CELL_DATA_MODE != CELL_DATA_MODE_PPP ? &MODEM_TRANSPORT : &TINYGSM_TRANSPORT;
+
+static int httpAttempt(void* ctx) {
+  HttpAttempt* a = (HttpAttempt*)ctx;
+  const CellHttpTransport* transport = a->tls ? &TLS_TRANSPORT : httpTransport;
+  a->streamed = 0;
+  unsigned long t0 = millis();
+  a->statusCode = transport->request(*a);
+  uint32_t elapsed = millis() - t0;
+  uint32_t received = a->sink ? a->streamed : a->response->length();
+  a->latencyMs = elapsed;
+  portENTER_CRITICAL(&sessionMux);
+  sessionStats.requests++;
+  sessionStats.lastLatencyMs = elapsed;
+  if (elapsed > sessionStats.maxLatencyMs) sessionStats.maxLatencyMs = elapsed;
+  sessionStats.bytesSent += a->length;
+  sessionStats.bytesReceived += received;
+  if (a->length >= CELL_BULK_UPLOAD_MIN_BYTES && a->statusCode >= 200 && a->statusCode < 300 && elapsed > 0) {
+    // Thông lượng hiệu dụng của upload lớn (batch): cả request, gồm mở socket nếu có
+    sessionStats.lastUploadBytesPerSec = (uint32_t)((uint64_t)a->length * 1000 / elapsed);
+  }
+  portEXIT_CRITICAL(&sessionMux);
+  return a->statusCode;
+}
+
+void cellularSetHttpTransport(bool modemStack) {
+  #if CELL_DATA_MODE == CELL_DATA_MODE_PPP
+    if (modemStack) {
+      Serial.println("[CELL] Chế độ PPP: UART đang chở PPP, không dùng được modem_http");
+      return;
+    }
+  #endif
+  const CellHttpTransport* next = modemStack ? &MODEM_TRANSPORT : &TINYGSM_TRANSPORT;
+  if (next == httpTransport) return;
+  cellularLocksInit();
+  xSemaphoreTake(cellularHttpMutex, portMAX_DELAY);  // Không đổi giữa một lượt thử
+  httpTransport->close();
+  httpTransport = next;
+  xSemaphoreGive(cellularHttpMutex);
+  Serial.printf("[CELL] HTTP transport: %s\n", next->name);
+}
+
+const char* cellularHttpTransportName() {
+  return httpTransport->name;
+}
+
+/**
+ * @brief POST/GET qua bộ thực thi: thử tối đa `attempts` lần trong CELL_REQUEST_DEADLINE_MS
+ * (request khẩn một lần thử thì chỉ trong khoảng timeout của nó).
+ */
+static bool httpRequestWithRetry(const char* tag, const char* host, uint16_t port, const char* path,
+                                 const uint8_t* body, size_t length, const char* contentType, String& response,
+                                 uint16_t timeoutMs, int attempts, uint16_t backoffMs, bool urgent = false) {
+  Serial.printf("[CELL] HTTP %s to %s:%u via %s%s\n", tag, host, port, httpTransport->name,
+                backendSessionOpen ? " (keep-alive)" : "");
+  HttpAttempt a = { host, port, path, body, length, contentType, timeoutMs, &response, 0, false, NULL, NULL, 0 };
+  CellRequestPolicy policy = { tag, attempts, backoffMs, CELL_REQUEST_DEADLINE_MS, urgent };
+  if (urgent && attempts <= 1) policy.deadlineMs = timeoutMs + CELL_TCP_CONNECT_TIMEOUT_S * 1000UL;
+
+  if (urgent) urgentEnter();
+  bool ok = cellularExecute(policy, httpAttempt, &a);
+  if (urgent) urgentLeave();
+  if (ok) {
+    Serial.printf("[CELL] HTTP %s %d (%lu ms)\n", tag, a.statusCode, (unsigned long)a.latencyMs);
+  }
+  return ok;
+}
+
+/**
+ * @brief Gửi HTTP POST tiêu chuẩn qua đường 4G: timeout 20 s, tối đa 3 lần với exponential backoff.
+ *
+ * Tới backend thì dùng lại socket keep-alive (không bắt tay TCP mỗi lần upload).
  *
- * Dùng cho cảnh báo khẩn để tránh block task chính quá lâu.
+ * @return true nếu nhận mã phản hồi 2xx, false nếu tất cả attempt đều thất bại.
  */
-bool cellularHttpPostCritical(const char* host, uint16_t port, const char* path, const String& body, String& response) {
-  // 2s timeout, 1 attempt, 0 backoff
-  return cellularHttpPostWithOptions(host, port, path, body, response, 2000, 1, 0);
+bool cellularHttpPost(const char* host, uint16_t port, const char* path, const String& body, String& response) {
+  return cellularHttpPostWithOptions(host, port, path, body, response, 20000, 3, 0);
 }
 
 /**
- * @brief Gom thông tin cơ bản của modem để hiển thị lên giao diện web.
+ * @brief Biến thể POST cho phép cấu hình timeout/số lần thử/backoff tùy tình huống.
  *
- * Bao gồm: tên modem, IMEI, chất lượng sóng CSQ và IP hiện tại (qua AT).
+ * Phù hợp với các API tốn thời gian (ví dụ: gửi log lớn, ota metadata).
  */
-String cellularStatusSummary() {
-  String s;
-  s += String("Modem: ") + modem.getModemName();
-  s += String(" | IMEI: ") + modem.getIMEI();
-  // Signal
-  int16_t csq = modem.getSignalQuality();
-  s += String(" | CSQ: ") + String(csq);
-  // IP
-  s += String(" | IP: ");
-  modem.sendAT("+CGPADDR");
-  modem.waitResponse(1000);
-  // Leave generic; TinyGSM lacks direct PDP IP getter for all modules
-  return s;
+bool cellularHttpPostWithOptions(const char* host, uint16_t port, const char* path,
+                                 const String& body, String& response,
+                                 uint16_t timeoutMs, int attempts, uint16_t backoffMs) {
+  return cellularHttpPostBytes(host, port, path, (const uint8_t*)body.c_str(), body.length(), "application/json",
+                               response, timeoutMs, attempts, backoffMs);
 }
 
 /**
- * @brief Gửi HTTP GET qua 4G để lấy dữ liệu (ví dụ kiểm tra firmware).
+ * @brief Lõi POST có cấu hình: body là mảng byte tùy ý (JSON hoặc frame nhị phân) kèm Content-Type.
+ */
+bool cellularHttpPostBytes(const char* host, uint16_t port, const char* path,
+                           const uint8_t* body, size_t length, const char* contentType, String& response,
+                           uint16_t timeoutMs, int attempts, uint16_t backoffMs) {
+  return httpRequestWithRetry("POST", host, port, path, body, length, contentType, response,
+                              timeoutMs, attempts, backoffMs);
+}
+
+/**
+ * @brief Gửi POST dạng "bắn nhanh" với timeout 2 giây, không retry.
  *
- * Có cơ chế retry với reconnect tự động tương tự POST để chống lỗi mạng.
+ * Tới backend thì đi qua socket khẩn giữ sẵn (cellularAlertPost), không chờ cellularHttpMutex;
+ * host khác vẫn dùng đường thường với 1 lần thử.
  */
-bool cellularHttpGet(const char* host, uint16_t port, const char* path, String& response) {
-  if (cellularHttpMutex) xSemaphoreTake(cellularHttpMutex, portMAX_DELAY);
-  
-  // Kiểm tra và đảm bảo kết nối trước khi gửi
-  if (!ensureCellularConnection()) {
-    Serial.println("[CELL] Đang reconnect...");
-    if (!cellularBegin()) {
-      Serial.println("[CELL]  Reconnect thất bại");
-      if (cellularHttpMutex) xSemaphoreGive(cellularHttpMutex);
-      return false;
-    }
+bool cellularHttpPostCritical(const char* host, uint16_t port, const char* path, const String& body, String& response) {
+  if (isBackend(host, port)) {
+    return cellularAlertPost(path, (const uint8_t*)body.c_str(), body.length(), "application/json", response);
   }
-  
-  // Đảm bảo client ở trạng thái sạch trước mỗi request
-  gsmClient.stop();
-  Serial.print("[CELL] HTTP GET to ");
-  Serial.print(host);
-  Serial.print(":");
-  Serial.println(port);
-  esp_task_wdt_reset();
-  
-  //  DNS đã cached trong cellularBegin() - không cần resolve lại
-  // HTTP GET request với timeout
-  HttpClient http(gsmClient, host, port);
-  http.setTimeout(20000);  // Tăng timeout lên 20s
-  esp_task_wdt_reset();
-  
-  // Retry với exponential backoff
-  for (int attempt = 1; attempt <= 3; attempt++) {
-    http.beginRequest();
-    http.get(path);
-    http.sendHeader("X-API-Key", APPLICATION_KEY);
-    http.sendHeader("Connection", "close");        // avoid keep-alive quirks
-    http.sendHeader("Accept", "application/json");  // hint response type
-    http.endRequest();
-    esp_task_wdt_reset();  // Reset sau endRequest (có thể chậm)
-    
-    // 🐕 Chờ response - có thể mất thời gian, reset watchdog thường xuyên
-    delay(100);
-    esp_task_wdt_reset();
-    
-    int statusCode = http.responseStatusCode();
-    esp_task_wdt_reset();  // Reset sau responseStatusCode
-    if (statusCode >= 200 && statusCode < 300) {
-      response = http.responseBody();
-      esp_task_wdt_reset();  // Reset sau responseBody
-      delay(100);
-      esp_task_wdt_reset();  // Reset trước khi stop
-      http.stop();
-      Serial.print("[CELL] HTTP GET ");
-      Serial.println(statusCode);
-      esp_task_wdt_reset();
-      if (cellularHttpMutex) xSemaphoreGive(cellularHttpMutex);
-      return true;
+  // 2s timeout, 1 attempt, 0 backoff; khẩn: request thường đang backoff phải nhường
+  return httpRequestWithRetry("POST", host, port, path, (const uint8_t*)body.c_str(), body.length(),
+                              "application/json", response, 2000, 1, 0, true);
+}
+
+CellularSessionStats cellularSessionGetStats() {
+  portENTER_CRITICAL(&sessionMux);
+  CellularSessionStats out = sessionStats;
+  out.breakerOpen = breakerOpen;
+  uint32_t liveSum = ttfbSumMs[0];
+  uint32_t cacheSum = ttfbSumMs[1];
+  portEXIT_CRITICAL(&sessionMux);
+  out.open = backendSessionOpen;
+  out.ttfbDnsLiveAvgMs = out.ttfbDnsLiveCount ? liveSum / out.ttfbDnsLiveCount : 0;
+  out.ttfbDnsCacheAvgMs = out.ttfbDnsCacheCount ? cacheSum / out.ttfbDnsCacheCount : 0;
+  return out;
+}
+
+// --------------------------------------------------------------------
+// Socket khẩn (mux CELL_ALERT_MUX): kết nối sẵn tới backend, không dùng cellularHttpMutex
+// --------------------------------------------------------------------
+// Chỉ alertTask dùng (qua alertMutex). Request dựng sẵn trong alertRequest rồi gửi bằng một lần write
+// (một AT+CIPSEND); response đọc thẳng từ socket vì HttpClient ghi header thành nhiều lần gửi.
+static bool alertLinkOpen = false;
+static uint32_t alertLinkGen = 0;              // dataContextGen lúc mở socket
+static unsigned long alertLastUsedMs = 0;      // Lần cuối có response đọc trọn trên socket
+static unsigned long alertLastConnectMs = 0;   // Lần thử mở socket gần nhất (0 = chưa thử)
+static CellularAlertStats alertStats = {};
+static uint8_t alertRequest[CELL_ALERT_REQUEST_MAX];
+
+static void alertLinkClose() {
+  if (alertLinkOpen) alertSocket.stop();
+  alertLinkOpen = false;
+}
+
+/**
+ * @brief Socket khẩn còn dùng được: mở trong data context hiện tại và chưa thấy URC đóng từ server/NAT.
+ */
+static bool alertLinkUsable() {
+  if (!alertLinkOpen) return false;
+  if (alertLinkGen != dataContextGen || !alertSocket.connected()) {
+    alertLinkClose();
+    return false;
+  }
+  return true;
+}
+
+static bool alertLinkConnect() {
+  alertLastConnectMs = millis();
+  alertStats.connects++;
+  alertLinkOpen = alertSocket.connect(BACKEND_HOST, BACKEND_PORT) > 0;
+  if (alertLinkOpen) {
+    alertLinkGen = dataContextGen;
+    alertLastUsedMs = millis();
+  }
+  return alertLinkOpen;
+}
+
+/**
+ * @brief Dựng request HTTP/1.1 hoàn chỉnh (header + body) vào alertRequest.
+ * @param body NULL = GET không body.
+ * @return Số byte, 0 nếu vượt CELL_ALERT_REQUEST_MAX.
+ */
+static size_t alertBuildRequest(const char* path, const uint8_t* body, size_t length, const char* contentType) {
+  int n;
+  if (body) {
+    n = snprintf((char*)alertRequest, sizeof(alertRequest),
+                 "POST %s HTTP/1.1\r\nHost: %s:%u\r\nX-API-Key: %s\r\nContent-Type: %s\r\nContent-Length: %u\r\n\r\n",
+                 path, BACKEND_HOST, (unsigned)BACKEND_PORT, APPLICATION_KEY, contentType, (unsigned)length);
+  } else {
+    length = 0;
+    n = snprintf((char*)alertRequest, sizeof(alertRequest), "GET %s HTTP/1.1\r\nHost: %s:%u\r\n\r\n",
+                 path, BACKEND_HOST, (unsigned)BACKEND_PORT);
+  }
+  if (n < 0 || (size_t)n + length > sizeof(alertRequest)) return 0;
+  if (length > 0) memcpy(alertRequest + n, body, length);
+  return (size_t)n + length;
+}
+
+/**
+ * @brief Đọc một byte từ socket khẩn, chờ tới `deadline`. @return -1 nếu hết giờ hoặc socket đã đóng.
+ */
+static int alertReadByte(unsigned long deadline) {
+  while ((long)(deadline - millis()) > 0) {
+    int c = alertSocket.read();
+    if (c >= 0) return c;
+    if (!alertSocket.connected()) return -1;
+    delay(5);  // URC +CIPRXGET báo có dữ liệu; nhả UART cho socket upload trong lúc chờ
+  }
+  return -1;
+}
+
+static bool alertReadLine(String& line, unsigned long deadline) {
+  line = "";
+  while (true) {
+    int c = alertReadByte(deadline);
+    if (c < 0) return false;
+    if (c == '\n') return true;
+    if (c != '\r' && line.length() < 256) line += (char)c;
+  }
+}
+
+/**
+ * @brief Đọc response trên socket khẩn: status line, header, body theo Content-Length (giữ tối đa 512 byte).
+ * @param reusable true nếu body đọc trọn và server không yêu cầu đóng, socket giữ lại được.
+ * @return Mã HTTP, hoặc mã lỗi âm của ArduinoHttpClient.
+ */
+static int alertReadResponse(unsigned long deadline, String& response, bool& reusable) {
+  reusable = false;
+  String line;
+  if (!alertReadLine(line, deadline)) return HTTP_ERROR_TIMED_OUT;
+  int sp = line.indexOf(' ');
+  if (!line.startsWith("HTTP/1.") || sp < 0) return HTTP_ERROR_INVALID_RESPONSE;
+  int status = line.substring(sp + 1).toInt();
+
+  long contentLength = -1;
+  bool serverClose = false;
+  while (true) {
+    if (!alertReadLine(line, deadline)) return HTTP_ERROR_TIMED_OUT;
+    if (line.length() == 0) break;
+    line.toLowerCase();
+    if (line.startsWith("content-length:")) contentLength = line.substring(15).toInt();
+    else if (line.startsWith("connection:") && line.indexOf("close") > 0) serverClose = true;
+  }
+  if (status == 204 || status == 304) contentLength = 0;
+  if (contentLength < 0) return status;  // Không biết độ dài body (chunked): không dùng lại socket
+
+  response = "";
+  for (long i = 0; i < contentLength; i++) {
+    int c = alertReadByte(deadline);
+    if (c < 0) return HTTP_ERROR_TIMED_OUT;
+    if (response.length() < 512) response += (char)c;
+  }
+  reusable = !serverClose;
+  return status;
+}
+
+/**
+ * @brief Gửi request đã dựng trong alertRequest và đọc response. Socket giữ sẵn hóa ra đã chết
+ * (half-open chưa kịp thấy URC) thì mở lại và gửi lại một lần. Lỗi có thể tới sau khi server đã lưu
+ * request (hết giờ đọc response): an toàn vì alertTask cấp seq cho bản ghi khẩn trước khi gửi và
+ * backend khử trùng theo (boot_id, seq); heartbeat là GET không có tác dụng phụ.
+ */
+static int alertExchange(size_t requestLength, uint16_t timeoutMs, String& response) {
+  bool reused = alertLinkUsable();
+  while (true) {
+    if (!reused && !alertLinkConnect()) return HTTP_ERROR_CONNECTION_FAILED;
+    unsigned long deadline = millis() + timeoutMs;
+    int status = HTTP_ERROR_CONNECTION_FAILED;
+    bool reusable = false;
+    while (alertSocket.available() > 0) alertSocket.read();  // Bỏ byte thừa của response trước (nếu có)
+    if (alertSocket.write(alertRequest, requestLength) == requestLength) {
+      status = alertReadResponse(deadline, response, reusable);
     }
-    
-    // Log và retry với reconnect nếu cần
-    Serial.printf("[CELL] HTTP GET lỗi (code: %d), attempt %d/3\n", statusCode, attempt);
-    http.stop();
-    
-    if (attempt < 3 && (statusCode == -3 || statusCode == -2 || statusCode == -1 || statusCode == 400)) {
-      isDataConnected = false;
-      modem.sendAT("+NETCLOSE");
-      modem.waitResponse(2000);
-      
-      // Exponential backoff: 1s, 2s, 4s
-      unsigned long backoffMs = 1000 * (1 << (attempt - 1));
-      Serial.printf("[CELL] Chờ %lu ms trước khi retry...\n", backoffMs);
-      unsigned long backoffStart = millis();
-      while (millis() - backoffStart < backoffMs) {
-        delay(100);
-        esp_task_wdt_reset();
-      }
-      
-      // Thử reconnect nếu không phải attempt cuối
-      if (attempt < 3) {
-        Serial.println("[CELL] Thử reconnect trước khi retry...");
-        if (cellularBegin()) {
-          Serial.println("[CELL]  Reconnect thành công, retry request...");
-          gsmClient.stop();
-          http = HttpClient(gsmClient, host, port);
-          http.setTimeout(20000);
-          esp_task_wdt_reset();
-        }
-      }
-      continue;
+    if (status > 0 && reusable) {
+      alertLastUsedMs = millis();
+    } else {
+      alertLinkClose();
     }
-    if (cellularHttpMutex) xSemaphoreGive(cellularHttpMutex);
+    if (status > 0 || !reused) return status;
+    alertStats.staleRecovered++;
+    reused = false;
+  }
+}
+
+bool cellularAlertPost(const char* path, const uint8_t* body, size_t length, const char* contentType, String& response) {
+  cellularLocksInit();
+  urgentEnter();  // Request thường đang retry nhường UART tới khi cảnh báo gửi xong
+  if (xSemaphoreTake(alertMutex, portMAX_DELAY) != pdTRUE) {
+    urgentLeave();
     return false;
   }
-  if (cellularHttpMutex) xSemaphoreGive(cellularHttpMutex);
-  return false;
+  unsigned long t0 = millis();
+  int status = HTTP_ERROR_CONNECTION_FAILED;
+  size_t requestLength = alertBuildRequest(path, body, length, contentType);
+  if (!isModemReady || !isDataConnected) {
+    Serial.println("[CELL][ALERT] Chưa có data context, bỏ qua socket khẩn");
+  } else if (requestLength == 0) {
+    Serial.printf("[CELL][ALERT] Request %u byte vượt CELL_ALERT_REQUEST_MAX\n", (unsigned)length);
+  } else {
+    status = alertExchange(requestLength, CELL_ALERT_TIMEOUT_MS, response);
+  }
+  uint32_t elapsed = millis() - t0;
+  bool ok = status >= 200 && status < 300;
+  alertStats.posts++;
+  if (!ok) alertStats.failures++;
+  alertStats.lastLatencyMs = elapsed;
+  if (elapsed > alertStats.maxLatencyMs) alertStats.maxLatencyMs = elapsed;
+  Serial.printf("[CELL][ALERT] POST %s %d (%lu ms)\n", path, status, (unsigned long)elapsed);
+  xSemaphoreGive(alertMutex);
+  urgentLeave();
+  return ok;
+}
+
+void cellularAlertMaintain() {
+  if (!isModemReady || !isDataConnected) return;
+  cellularLocksInit();
+  if (xSemaphoreTake(alertMutex, 0) != pdTRUE) return;  // Đang gửi cảnh báo
+  if (!alertLinkUsable()) {
+    if (alertLastConnectMs == 0 || millis() - alertLastConnectMs >= CELL_ALERT_RECONNECT_MS) {
+      if (alertLinkConnect()) {
+        Serial.println("[CELL][ALERT] Socket khẩn đã kết nối sẵn");
+      } else {
+        Serial.println("[CELL][ALERT] Mở socket khẩn thất bại, thử lại sau");
+      }
+    }
+  } else if (millis() - alertLastUsedMs >= CELL_ALERT_HEARTBEAT_MS) {
+    // Heartbeat: giữ socket/NAT sống và phát hiện half-open trước khi cần gửi cảnh báo thật
+    String response;
+    size_t requestLength = alertBuildRequest(BACKEND_PING_PATH, NULL, 0, NULL);
+    int status = alertExchange(requestLength, CELL_ALERT_TIMEOUT_MS, response);
+    alertStats.heartbeats++;
+    if (status < 200 || status >= 300) {
+      alertStats.heartbeatFailures++;
+      Serial.printf("[CELL][ALERT] Heartbeat lỗi (code: %d)\n", status);
+    }
+  }
+  xSemaphoreGive(alertMutex);
+}
+
+CellularAlertStats cellularAlertGetStats() {
+  CellularAlertStats out = alertStats;
+  out.open = alertLinkOpen && alertLinkGen == dataContextGen;
+  return out;
 }
 
+// --------------------------------------------------------------------
+// Task theo dõi modem: mọi truy vấn trạng thái đi qua đây, người đọc chỉ đọc snapshot
+// --------------------------------------------------------------------
+
 /**
- * @brief Tải firmware .bin qua 4G và ghi trực tiếp vào flash thông qua lớp Update.
- *
- * Chú ý: hàm sẽ tự khởi động lại thiết bị nếu Update.end() thành công.
+ * @brief Con trỏ tới phần sau `prefix` trong phản hồi nhiều dòng, NULL nếu không có.
  */
-bool cellularOtaDownload(const char* host, uint16_t port, const char* path) {
-  if (cellularHttpMutex) xSemaphoreTake(cellularHttpMutex, portMAX_DELAY);
-  
-  // Kiểm tra và đảm bảo kết nối trước khi tải firmware
-  if (!ensureCellularConnection()) {
-    Serial.println("[CELL][OTA] Đang reconnect...");
-    if (!cellularBegin()) {
-      Serial.println("[CELL][OTA]  Reconnect thất bại");
-      if (cellularHttpMutex) xSemaphoreGive(cellularHttpMutex);
-      return false;
+static const char* responseField(const char* response, const char* prefix) {
+  const char* p = strstr(response, prefix);
+  return p ? p + strlen(prefix) : NULL;
+}
+
+/**
+ * @brief Chép một trường (tới ',' hoặc hết dòng, bỏ dấu nháy) vào `out`.
+ */
+static void copyField(const char* src, char* out, size_t outSize) {
+  size_t n = 0;
+  for (; src && *src && *src != ',' && *src != '\n' && n + 1 < outSize; src++) {
+    if (*src != '"') out[n++] = *src;
+  }
+  out[n] = '\0';
+}
+
+/**
+ * @brief Một lượt lấy mẫu. Lệnh chạy ở AT_PRIO_LOW qua at_engine, chỉ chen giữa các giao dịch AT của
+ * upload/cảnh báo chứ không chờ hết một request HTTP.
+ * @return false nếu có lệnh lỗi/timeout (giá trị cũ của trường đó được giữ nguyên).
+ */
+static bool cellularSample(CellularStatus& st) {
+  bool ok = true;
+  AtResult r;
+
+  if (st.modemName[0] == '\0' || st.imei[0] == '\0') {
+    // Thông tin tĩnh: chỉ hỏi tới khi có
+    if (atCommand("+CGMM", 1000, &r, NULL, AT_PRIO_LOW) == AT_OK) copyField(r.response, st.modemName, sizeof(st.modemName));
+    if (atCommand("+CGSN", 1000, &r, NULL, AT_PRIO_LOW) == AT_OK) copyField(r.response, st.imei, sizeof(st.imei));
+  }
+
+  if (atCommand("+CSQ", 1000, &r, NULL, AT_PRIO_LOW) == AT_OK && responseField(r.response, "+CSQ: ")) {
+    st.csq = (int16_t)atoi(responseField(r.response, "+CSQ: "));
+  } else {
+    st.csq = -1;
+    ok = false;
+  }
+
+  const char* f;
+  if (atCommand("+CEREG?", 1000, &r, NULL, AT_PRIO_LOW) == AT_OK && (f = responseField(r.response, "+CEREG: ")) != NULL) {
+    const char* comma = strchr(f, ',');
+    st.regStatus = (uint8_t)atoi(comma ? comma + 1 : f);  // "+CEREG: <n>,<stat>[,...]"
+    st.registered = st.regStatus == 1 || st.regStatus == 5;
+  } else {
+    ok = false;
+  }
+
+  if (atCommand("+CPSI?", 2000, &r, NULL, AT_PRIO_LOW) == AT_OK && (f = responseField(r.response, "+CPSI: ")) != NULL) {
+    copyField(f, st.accessTech, sizeof(st.accessTech));
+  } else {
+    ok = false;
+  }
+
+  if (atCommand("+CGACT?", 2000, &r, NULL, AT_PRIO_LOW) == AT_OK) {
+    f = responseField(r.response, "+CGACT: 1,");
+    st.pdpActive = f != NULL && *f == '1';
+  } else {
+    ok = false;
+  }
+
+  st.ip[0] = '\0';
+  if (st.pdpActive) {
+    if (atCommand("+CGPADDR=1", 1000, &r, NULL, AT_PRIO_LOW) == AT_OK && (f = responseField(r.response, "+CGPADDR: 1,")) != NULL) {
+      copyField(f, st.ip, sizeof(st.ip));
+    } else {
+      ok = false;
     }
   }
-  
-  gsmClient.stop();
-  esp_task_wdt_reset();
+  return ok;
+}
 
-  HttpClient http(gsmClient, host, port);
-  http.setTimeout(30000);
+/**
+ * @brief Lỗi nhận UART tăng quá CELL_UART_ERROR_LIMIT trong một chu kỳ ở baud trên mặc định: hạ trần
+ * một nấc và đánh dấu modem chưa sẵn sàng, bring-up kế tiếp đổi AT+IPR (và lưu NVS).
+ */
+static void cellularCheckUartErrors() {
+  static uint32_t lastErrors = 0;
+  AtEngineStats es = atEngineGetStats();
+  uint32_t errors = es.uartOverruns + es.uartFrameErrors;
+  uint32_t fresh = errors - lastErrors;
+  lastErrors = errors;
+  if (fresh < CELL_UART_ERROR_LIMIT || uartBaud <= CELL_BAUD || !isModemReady) return;
+  uint32_t lower = cellBaudStepBelow(uartBaud);
+  Serial.printf("[CELL] %lu lỗi nhận UART ở %lu baud, hạ xuống %lu\n", (unsigned long)fresh,
+                (unsigned long)uartBaud, (unsigned long)lower);
+  uartStats.downgrades++;
+  baudDowngradeTo = lower;
+  isModemReady = false;
+  isDataConnected = false;
+  dataContextGen++;
+}
+
+static void cellularMonitorTask(void* param) {
+  CellularStatus st;
+  memset(&st, 0, sizeof(st));
+  st.csq = 99;
+  while (true) {
+    cellularCheckUartErrors();
+    if (isModemReady && atEngineInDataMode()) {
+      // PPP đang chạy: UART không nhận AT, chỉ cập nhật link; CSQ không biết (-1) để ensureCellularConnection
+      // không dựa vào mẫu lấy trước khi quay số
+      CellPppStats ppp = cellPppGetStats();
+      st.csq = -1;
+      st.pdpActive = ppp.up;
+      memcpy(st.ip, ppp.ip, sizeof(st.ip));
+      st.valid = true;
+    } else if (isModemReady) {
+      uint32_t t0 = millis();
+      bool ok = cellularSample(st);
+      st.sampleMs = millis() - t0;
+      st.samples++;
+      if (!ok) st.sampleFailures++;
+      st.valid = true;
 
+      // PDP đã mất mà chưa có URC nào báo (URC có thể rơi khi modem bận): đánh dấu để lần gửi sau dựng lại
+      if (ok && !st.pdpActive && isDataConnected) {
+        Serial.println("[CELL] Monitor: PDP context không còn hoạt động, đánh dấu mất kết nối");
+        isDataConnected = false;
+        dataContextGen++;
+      }
+      // Làm mới DNS trước khi hết hạn, để đường gửi luôn trúng cache
+      if (isDataConnected) dnsCacheRefresh();
+    }
+    st.modemReady = isModemReady;
+    st.dataConnected = isDataConnected;
+    st.sampledAtMs = millis();
+    statusSnapshot.publish(st);
+    vTaskDelay(pdMS_TO_TICKS(CELL_MONITOR_INTERVAL_MS));
+  }
+}
+
+void cellularMonitorBegin() {
+  static bool started = false;
+  if (started) return;
+  started = xTaskCreatePinnedToCore(cellularMonitorTask, "cellMonitor", 4096, NULL, CELL_MONITOR_TASK_PRIORITY,
+                                    NULL, 1) == pdPASS;
+}
+
+CellularStatus cellularGetStatus() {
+  return statusSnapshot.read();
+}
+
+/**
+ * @brief Gom thông tin cơ bản của modem để hiển thị lên giao diện web.
+ *
+ * Bao gồm: tên modem, IMEI, chất lượng sóng CSQ, đăng ký mạng và IP hiện tại; đọc từ snapshot của
+ * task theo dõi nên không gửi lệnh AT nào.
+ */
+String cellularStatusSummary() {
+  CellularStatus st = statusSnapshot.read();
+  if (!st.valid) return String("Modem: đang khởi tạo...");
+  String s;
+  s += String("Modem: ") + st.modemName;
+  s += String(" | IMEI: ") + st.imei;
+  s += String(" | CSQ: ") + String(st.csq);
+  s += String(" | ") + st.accessTech + (st.registered ? " (đã đăng ký)" : " (chưa đăng ký)");
+  s += String(" | IP: ") + (st.ip[0] ? st.ip : "-");
+  s += String(" | Cập nhật ") + String((unsigned long)((millis() - st.sampledAtMs) / 1000)) + "s trước";
+  return s;
+}
+
+/**
+ * @brief Gửi HTTP GET qua 4G để lấy dữ liệu (ví dụ kiểm tra firmware).
+ *
+ * Có cơ chế retry với reconnect tự động tương tự POST; tới backend thì dùng chung phiên keep-alive
+ * với upload.
+ */
+bool cellularHttpGet(const char* host, uint16_t port, const char* path, String& response) {
+  return httpRequestWithRetry("GET", host, port, path, NULL, 0, NULL, response, 20000, 3, 0);
+}
+
+struct OtaAttempt {
+  const char* host;
+  uint16_t port;
+  const char* path;
+};
+
+/**
+ * @brief Một request Range của ảnh firmware trên kết nối keep-alive `http` (xem ota_resume.h); body đọc
+ * thẳng vào buffer của ota_pipeline, task flash ghi song song.
+ * @return 206/200 khi body đã ghi và checkpoint, mã lỗi HTTP/âm nếu không.
+ */
+static int otaFetchChunk(HttpClient& http, const char* path) {
+  char range[40];
+  otaResumeRangeHeader(range, sizeof(range));
   http.beginRequest();
   http.get(path);
   http.sendHeader("X-API-Key", APPLICATION_KEY);
-  http.sendHeader("Connection", "close");
+  http.sendHeader("Range", range);
   http.endRequest();
 
   int status = http.responseStatusCode();
-  if (status != 200) {
-    Serial.print("[CELL][OTA] HTTP "); Serial.println(status);
-    http.stop();
-    if (cellularHttpMutex) xSemaphoreGive(cellularHttpMutex);
-    return false;
-  }
-
-  int contentLength = http.contentLength();
-  if (contentLength <= 0) {
-    Serial.println("[CELL][OTA] Unknown content length (chunked?) - proceed streaming");
+  String contentRange;
+  while (status > 0 && http.headerAvailable()) {
+    String name = http.readHeaderName();
+    String value = http.readHeaderValue();
+    if (name.equalsIgnoreCase("Content-Range")) contentRange = value;
   }
-
-  if (!Update.begin(contentLength > 0 ? contentLength : UPDATE_SIZE_UNKNOWN)) {
-    Serial.println("[CELL][OTA] Update.begin failed");
+  long want = otaResumeAccept(status, contentRange.c_str(), status > 0 ? http.contentLength() : -1);
+  if (want < 0) {
+    Serial.printf("[CELL][OTA] HTTP %d, Content-Range '%s'\n", status, contentRange.c_str());
     http.stop();
-    if (cellularHttpMutex) xSemaphoreGive(cellularHttpMutex);
-    return false;
+    // 2xx không dùng được (Content-Range lệch, ảnh đổi): checkpoint đã chỉnh, thử lại như lỗi đường truyền
+    return (status >= 200 && status < 300) ? HTTP_ERROR_INVALID_RESPONSE : status;
   }
 
-  const size_t bufSize = 512;
-  uint8_t buf[bufSize];
-  int written = 0;
-  unsigned long lastProgress = millis();
-  while (contentLength <= 0 || written < contentLength) {
+  long got = 0;
+  unsigned long lastData = millis();
+  bool flashError = false;
+  while (got < want) {
     int avail = http.available();
     if (avail > 0) {
-      int toRead = avail > (int)bufSize ? (int)bufSize : avail;
-      int r = http.readBytes(buf, toRead);
-      if (r <= 0) break;
-      size_t w = Update.write(buf, r);
-      if ((int)w != r) {
-        Serial.println("[CELL][OTA] Update.write failed");
-        Update.abort();
-        http.stop();
-        if (cellularHttpMutex) xSemaphoreGive(cellularHttpMutex);
-        return false;
-      }
-      written += r;
-      unsigned long now = millis();
-      if (now - lastProgress > 1000) {
-        Serial.printf("[CELL][OTA] Written %d bytes\n", written);
-        lastProgress = now;
+      size_t room = 0;
+      uint8_t* dst = otaPipelineAcquire(room);  // Chờ ở đây khi flash chưa ghi kịp
+      if (dst == NULL) {
+        flashError = true;
+        break;
       }
-      if ((written % 4096) == 0) esp_task_wdt_reset();
+      if ((long)room > want - got) room = (size_t)(want - got);
+      if (room > (size_t)avail) room = (size_t)avail;
+      int r = http.read(dst, room);
+      if (r <= 0) break;
+      otaPipelineProduce(r);
+      got += r;
+      lastData = millis();
     } else {
-      delay(10);
+      delay(2);  // Dữ liệu tới theo URC +CIPRXGET/netif PPP; flash đang ghi ở task riêng
       esp_task_wdt_reset();
-      // nếu server đóng kết nối và không còn dữ liệu khi không biết contentLength → thoát
-      if (!http.connected() && http.available() <= 0 && contentLength <= 0) {
-        break;
-      }
+      if (!http.connected() || millis() - lastData > OTA_STALL_TIMEOUT_MS) break;
     }
   }
+  if (!otaPipelineDrain()) flashError = true;
+  if (flashError) {
+    Serial.println("[CELL][OTA] Lỗi ghi flash");
+    otaResumeRewind();
+    http.stop();
+    return CELL_ATTEMPT_ABORT;
+  }
+  if (got < want) {
+    Serial.printf("[CELL][OTA] Response dừng sau %ld/%ld byte\n", got, want);
+    otaResumeRewind();
+    http.stop();
+    return HTTP_ERROR_TIMED_OUT;
+  }
+  otaResumeCommit();
+  esp_task_wdt_reset();
+  return status;
+}
 
+/**
+ * @brief Một lượt tải firmware (chạy trong cellularExecute, đang giữ cellularHttpMutex): tải các chunk
+ * còn thiếu từ checkpoint; rớt giữa chừng thì lượt sau tiếp từ chunk cuối đã ghi.
+ */
+static int otaAttempt(void* ctx) {
+  OtaAttempt* a = (OtaAttempt*)ctx;
+  httpSessionClose();  // OTA dùng phiên riêng trên uploadSocket
+  uploadSocket.stop();
+  esp_task_wdt_reset();
+  if (!otaResumeBegin(a->path) || !otaPipelineStart()) return CELL_ATTEMPT_ABORT;
+
+  HttpClient http(uploadSocket, a->host, a->port);
+  http.setTimeout(30000);
+  http.connectionKeepAlive();
+
+  uint32_t startOffset = otaResumeGetStats().offset;
+  unsigned long bodyStart = millis();
+  unsigned long lastProgress = millis();
+  while (!otaResumeDone()) {
+    int status = otaFetchChunk(http, a->path);
+    if (status != 206 && status != 200) {
+      otaPipelineStop();
+      return status;
+    }
+    if (millis() - lastProgress > 1000) {
+      OtaResumeStats st = otaResumeGetStats();
+      Serial.printf("[CELL][OTA] %lu/%lu byte\n", (unsigned long)st.offset, (unsigned long)st.total);
+      lastProgress = millis();
+    }
+  }
   http.stop();
+  otaPipelineStop();
 
-  if (!Update.end()) {
-    Serial.println("[CELL][OTA] Update.end failed");
-    if (cellularHttpMutex) xSemaphoreGive(cellularHttpMutex);
-    return false;
+  OtaResumeStats st = otaResumeGetStats();
+  uint32_t written = st.offset - startOffset;
+  uint32_t bodyMs = millis() - bodyStart;
+  uint32_t bytesPerSec = bodyMs > 0 ? (uint32_t)((uint64_t)written * 1000 / bodyMs) : 0;
+  if (bodyMs > 0) {
+    portENTER_CRITICAL(&sessionMux);
+    sessionStats.lastOtaBytesPerSec = bytesPerSec;
+    portEXIT_CRITICAL(&sessionMux);
   }
+  Serial.printf("[CELL][OTA] %lu byte trong %lu ms (%lu B/s ở %lu baud)\n", (unsigned long)written,
+                (unsigned long)bodyMs, (unsigned long)bytesPerSec, (unsigned long)uartBaud);
+
+  if (!otaResumeFinish()) return CELL_ATTEMPT_ABORT;
+  return 200;
+}
+
+/**
+ * @brief Tải firmware .bin qua 4G theo từng chunk Range và ghi vào phân vùng OTA (ota_resume).
+ *
+ * Mỗi lượt thử tải tiếp từ checkpoint nên được phép nhiều lượt hơn request thường.
+ * Chú ý: hàm sẽ tự khởi động lại thiết bị khi ảnh đã ghi đủ và hợp lệ.
+ */
+bool cellularOtaDownload(const char* host, uint16_t port, const char* path) {
+  OtaAttempt a = { host, port, path };
+  CellRequestPolicy policy = { "OTA", CELL_OTA_ATTEMPTS, 5000, CELL_OTA_DEADLINE_MS, false };
+  if (!cellularExecute(policy, otaAttempt, &a)) return false;
 
   Serial.println("[CELL][OTA] Update success, rebooting...");
-  if (cellularHttpMutex) xSemaphoreGive(cellularHttpMutex);
   delay(500);
   ESP.restart();
   return true;
 }
 
 /**
- * @brief Thực thi HTTPS POST thông qua bộ lệnh AT +CHTTPS* (không dùng TinyGSM stack).
+ * @brief HTTPS POST với TLS trên modem (modem_http, bộ lệnh +CHTTPS*), không qua TinyGSM stack.
  *
- * Dành cho trường hợp cần TLS nhưng modem chưa hỗ trợ qua TinyGSM. Hàm sẽ cố gắng
- * khởi tạo phiên, gửi header, truyền payload và đọc phản hồi tối đa 512 byte.
- * 
- * Lưu ý: Hàm này không dùng mutex vì dùng AT commands trực tiếp, nhưng nên gọi
- * khi không có HTTP request khác đang chạy để tránh conflict.
+ * Phiên TLS tới host được giữ giữa các lần gọi khi server cho keep-alive. Response được đọc trọn
+ * (Content-Length/chunked), `response` nhận body khi mã 2xx. Chế độ PPP: TLS chạy trên ESP32
+ * (WiFiClientSecure qua netif PPP), mỗi lần một phiên mới.
+ * Chạy qua bộ thực thi chung như POST/GET: tối đa 3 lần, cách nhau ~2 s.
  */
 bool cellularHttpPostAT(const char* host, uint16_t port, const char* path, const String& body, String& response) {
-  // Kiểm tra modem đã sẵn sàng chưa
-  if (!isModemReady) {
-    Serial.println("[CELL][AT] Modem chưa sẵn sàng, khởi tạo...");
-    if (!cellularBegin()) {
-      Serial.println("[CELL][AT]  Không thể khởi tạo modem");
-      return false;
-    }
+  HttpAttempt a = { host, port, path, (const uint8_t*)body.c_str(), body.length(), "application/json", 20000,
+                    &response, 0, true, NULL, NULL, 0 };
+  CellRequestPolicy policy = { "HTTPS-AT", 3, 2000, CELL_REQUEST_DEADLINE_MS, false };
+  bool ok = cellularExecute(policy, httpAttempt, &a);
+  Serial.printf("[CELL][AT] HTTPS POST %s (code: %d)\n", ok ? "done" : "fail", a.statusCode);
+  return ok;
+}
+
+// --------------------------------------------------------------------
+// Đo thông lượng 4G qua đường dữ liệu/transport đang dùng
+// --------------------------------------------------------------------
+static Seqlock<CellularBenchResult> benchSnapshot;   // Chỉ task đo (mỗi lúc một task) ghi
+static volatile bool benchRunning = false;
+
+static bool benchDiscard(const uint8_t* data, size_t len, void* ctx) {
+  esp_task_wdt_reset();
+  return true;
+}
+
+static uint32_t benchKbps(uint32_t bytes, uint32_t ms) {
+  return ms ? (uint32_t)((uint64_t)bytes * 8 / ms) : 0;  // bit/ms = kbit/s
+}
+
+static void cellularBenchTask(void* param) {
+  uint32_t bytes = (uint32_t)(uintptr_t)param;
+  CellularBenchResult r = benchSnapshot.read();
+  r.running = true;
+  r.dataMode = CELL_DATA_MODE == CELL_DATA_MODE_PPP ? "ppp" : "at";
+  r.transport = httpTransport->name;
+  benchSnapshot.publish(r);
+
+  // Một lượt thử mỗi chiều: đo đường truyền, không đo vòng retry
+  CellRequestPolicy policy = { "BENCH", 1, 0, CELL_REQUEST_DEADLINE_MS, false };
+  char path[64];
+  snprintf(path, sizeof(path), "%s?bytes=%lu", BACKEND_BENCH_DOWNLOAD_PATH, (unsigned long)bytes);
+  String response;
+  HttpAttempt down = { BACKEND_HOST, BACKEND_PORT, path, NULL, 0, NULL, CELL_BENCH_TIMEOUT_MS, &response, 0, false,
+                       benchDiscard, NULL, 0 };
+  uint32_t t0 = millis();
+  cellularExecute(policy, httpAttempt, &down);
+  r.downloadMs = millis() - t0;
+  r.downloadBytes = down.streamed;
+  r.downloadStatus = down.statusCode;
+  r.downloadKbps = benchKbps(r.downloadBytes, r.downloadMs);
+
+  size_t upBytes = bytes < CELL_BENCH_UPLOAD_MAX_BYTES ? bytes : CELL_BENCH_UPLOAD_MAX_BYTES;
+  uint8_t* body = (uint8_t*)malloc(upBytes);
+  r.uploadBytes = 0;
+  r.uploadMs = 0;
+  r.uploadStatus = HTTP_ERROR_API;
+  if (body != NULL) {
+    for (size_t i = 0; i < upBytes; i++) body[i] = (uint8_t)i;
+    HttpAttempt up = { BACKEND_HOST, BACKEND_PORT, BACKEND_BENCH_UPLOAD_PATH, body, upBytes, "application/octet-stream",
+                       CELL_BENCH_TIMEOUT_MS, &response, 0, false, NULL, NULL, 0 };
+    t0 = millis();
+    bool ok = cellularExecute(policy, httpAttempt, &up);
+    r.uploadMs = millis() - t0;
+    r.uploadBytes = ok ? upBytes : 0;
+    r.uploadStatus = up.statusCode;
+    free(body);
   }
-  
-  // Đảm bảo stack ở trạng thái sạch và START với retry
-  modem.sendAT("+CHTTPSSTOP"); modem.waitResponse(2000);
-  esp_task_wdt_reset(); // Reset watchdog during HTTPS setup
-  
-  // Cấu hình HTTPS trước khi START
-  modem.sendAT("+CHTTPSCFG=\"sslversion\",3"); modem.waitResponse(2000); // auto
-  modem.sendAT("+CHTTPSCFG=\"sni\",1"); modem.waitResponse(2000);       // bật SNI
-  modem.sendAT("+CHTTPSCFG=\"timeout\",60"); modem.waitResponse(2000);   // timeout 60s
-  modem.sendAT("+CHTTPSCFG=\"keepidle\",60"); modem.waitResponse(2000);
-  esp_task_wdt_reset(); // Reset watchdog after HTTPS config
-  {
-    bool started = false;
-    for (int i = 0; i < 3 && !started; i++) {
-      modem.sendAT("+CHTTPSSTART");
-      int r = modem.waitResponse(8000);
-      if (r == 1) { started = true; break; }
-      Serial.println("[CELL][AT] CHTTPSSTART retry...");
-      logCEER();
-      esp_task_wdt_reset(); // Reset watchdog during retries
-      delay(2000);
-      modem.sendAT("+CHTTPSSTOP"); modem.waitResponse(2000);
-    }
-    if (!started) { Serial.println("[CELL][AT] CHTTPSSTART fail"); return false; }
-  }
-  esp_task_wdt_reset(); // Reset watchdog before session open
-  // Open session với SNI mode (tham số 3 = 2)
-  modem.sendAT("+CHTTPSOPSE=\"", host, "\",", port, ",2");
-  if (modem.waitResponse(12000) != 1) { Serial.println("[CELL][AT] CHTTPSOPSE fail"); goto CLOSE_STOP; }
-  esp_task_wdt_reset(); // Reset watchdog after session open
-  // Header
-  modem.sendAT("+CHTTPSHEADER=1"); if (modem.waitResponse(2000) != 1) { Serial.println("[CELL][AT] HEADER on fail"); goto CLOSE_STOP; }
-  modem.sendAT("+CHTTPSHEADER=" "\"Content-Type: application/json\""); if (modem.waitResponse(2000) != 1) { Serial.println("[CELL][AT] HEADER CT fail"); goto CLOSE_STOP; }
-  // Thêm Host header để chắc SNI/Proxy nhận đúng
-  modem.sendAT("+CHTTPSHEADER=" "\"Host: ", host, "\""); modem.waitResponse(2000);
-  esp_task_wdt_reset(); // Reset watchdog before POST
-  // Gửi POST
-  modem.sendAT("+CHTTPSPOST=\"", path, "\",,", body.length());
-  if (modem.waitResponse(15000, "+CHTTPSPOST: ") != 1) { Serial.println("[CELL][AT] POST start fail"); goto CLOSE_STOP; }
-  modem.streamWrite(body.c_str());
-  if (modem.waitResponse(20000) != 1) { Serial.println("[CELL][AT] POST resp fail"); goto CLOSE_STOP; }
-  esp_task_wdt_reset(); // Reset watchdog before response read
-  // Đọc trả lời
-  modem.sendAT("+CHTTPSRECV=512");
-  if (modem.waitResponse(12000, "+CHTTPSRECV: ") == 1) {
-    // Đọc phần thân (đơn giản: đọc mọi thứ còn lại trong serial buffer)
-    while (modem.stream.available()) {
-      response += (char)modem.stream.read();
-    }
-  }
-  modem.sendAT("+CHTTPSCLSE"); modem.waitResponse(2000);
-  modem.sendAT("+CHTTPSSTOP"); modem.waitResponse(2000);
-  Serial.println("[CELL][AT] HTTPS POST done");
-  return true; // đơn giản: coi như thành công; có thể parse thêm mã trạng thái nếu cần
-
-CLOSE_STOP:
-  modem.sendAT("+CHTTPSCLSE"); modem.waitResponse(2000);
-  modem.sendAT("+CHTTPSSTOP"); modem.waitResponse(2000);
-  return false;
+  r.uploadKbps = benchKbps(r.uploadBytes, r.uploadMs);
+
+  r.running = false;
+  r.done = true;
+  benchSnapshot.publish(r);
+  Serial.printf("[CELL][BENCH] %s/%s: xuống %lu B / %lu ms (%lu kbit/s, code %d), lên %lu B / %lu ms (%lu kbit/s, code %d)\n",
+                r.dataMode, r.transport, (unsigned long)r.downloadBytes, (unsigned long)r.downloadMs,
+                (unsigned long)r.downloadKbps, r.downloadStatus, (unsigned long)r.uploadBytes,
+                (unsigned long)r.uploadMs, (unsigned long)r.uploadKbps, r.uploadStatus);
+  benchRunning = false;
+  vTaskDelete(NULL);
+}
+
+bool cellularBenchmarkStart(uint32_t bytes) {
+  if (benchRunning) return false;
+  if (bytes == 0 || bytes > CELL_BENCH_MAX_BYTES) bytes = CELL_BENCH_MAX_BYTES;
+  benchRunning = true;
+  if (xTaskCreatePinnedToCore(cellularBenchTask, "cellBench", 6144, (void*)(uintptr_t)bytes, 1, NULL, 1) != pdPASS) {
+    benchRunning = false;
+    return false;
+  }
+  return true;
 }
 
+CellularBenchResult cellularBenchmarkGet() {
+  return benchSnapshot.read();
+}
@@ -66,6 +66,14 @@ bool cellularHttpPostWithOptions(const char* host, uint16_t port, const char* pa
                                  const String& body, String& response,
                                  uint16_t timeoutMs, int attempts, uint16_t backoffMs);
 
+/**
+ * @brief Như cellularHttpPostWithOptions nhưng body là mảng byte với Content-Type tùy chọn
+ * (ví dụ frame telemetry nhị phân, không thể chứa trong String vì có byte 0).
+ */
+bool cellularHttpPostBytes(const char* host, uint16_t port, const char* path,
+                           const uint8_t* body, size_t length, const char* contentType, String& response,
+                           uint16_t timeoutMs, int attempts, uint16_t backoffMs);
+
 /**
  * @brief POST cực nhanh, không retry (dành cho cảnh báo khẩn, tiết kiệm thời gian).
  */
@@ -74,17 +82,156 @@ bool cellularHttpPostCritical(const char* host, uint16_t port, const char* path,
 /**
  * @brief POST HTTPS thông qua tập lệnh AT +CHTTPS* (không dùng TinyGSM stack).
  *
- * Phù hợp khi backend yêu cầu TLS mà modem không hỗ trợ trong TinyGSM.
+ * Phù hợp khi backend yêu cầu TLS mà modem không hỗ trợ trong TinyGSM. TLS chạy trên modem
+ * (modem_http), phiên giữ giữa các lần gọi; chế độ PPP thì TLS chạy trên ESP32 (WiFiClientSecure).
+ * true chỉ khi server trả 2xx.
  */
 bool cellularHttpPostAT(const char* host, uint16_t port, const char* path, const String& body, String& response);
 
+/**
+ * @brief Chọn đường chở POST/GET thường: false = TinyGSM + HttpClient, true = HTTP của modem (+CHTTPS*).
+ *
+ * Mặc định theo CELL_HTTP_TRANSPORT_MODEM; đổi lúc chạy để so sánh độ trễ (phiên của đường cũ bị đóng).
+ * Chế độ PPP chỉ có đường socket lwIP ("ppp"): yêu cầu dùng modem bị bỏ qua.
+ */
+void cellularSetHttpTransport(bool modemStack);
+const char* cellularHttpTransportName();
+
+// Thống kê phiên HTTP keep-alive tới backend (từ lúc boot)
+struct CellularSessionStats {
+  bool open;                // Đang giữ socket tới backend
+  uint32_t requests;        // Số lượt request (kể cả host khác)
+  uint32_t opened;          // Lượt phải mở socket mới (bắt tay TCP)
+  uint32_t reused;          // Lượt chạy trên socket giữ sẵn
+  uint32_t staleRecovered;  // Socket giữ sẵn hóa ra đã chết lúc gửi, đã mở lại và gửi lại
+  uint32_t closedByPeer;    // Phát hiện server/NAT đã đóng trước khi gửi (URC)
+  uint32_t idleClosed;      // Chủ động đóng vì rảnh quá CELL_HTTP_KEEPALIVE_IDLE_MS
+  uint32_t lastLatencyMs;   // Thời gian một lượt request gần nhất
+  uint32_t maxLatencyMs;
+  uint32_t bytesSent;       // Byte body gửi đi
+  uint32_t bytesReceived;   // Byte body nhận về
+  uint32_t lastUploadBytesPerSec;  // Upload lớn gần nhất (body >= CELL_BULK_UPLOAD_MIN_BYTES), cả request
+  uint32_t lastOtaBytesPerSec;     // Lần tải firmware qua 4G gần nhất, phần body
+  // Bộ thực thi request (retry/deadline/breaker)
+  uint32_t attempts;        // Lượt thử thực sự gửi đi
+  uint32_t retries;
+  uint32_t deadlineExpired; // Request bỏ dở vì hết CELL_REQUEST_DEADLINE_MS
+  uint32_t preempted;       // Lần request thường nhường modem cho việc khẩn
+  uint32_t breakerTrips;
+  uint32_t breakerRejected; // Request bị từ chối ngay vì breaker đang mở
+  bool breakerOpen;
+  // Thời gian tới byte đầu của request mở socket mới, tách theo cache DNS bật/tắt
+  uint32_t lastTtfbMs;
+  uint32_t ttfbDnsCacheAvgMs;
+  uint32_t ttfbDnsCacheCount;
+  uint32_t ttfbDnsLiveAvgMs;
+  uint32_t ttfbDnsLiveCount;
+};
+
+/**
+ * @brief Thống kê phiên keep-alive để hiển thị trên /api/status.
+ */
+CellularSessionStats cellularSessionGetStats();
+
+/**
+ * @brief POST khẩn qua socket riêng (mux CELL_ALERT_MUX) được giữ kết nối sẵn tới backend.
+ *
+ * Không chờ cellularHttpMutex của upload thường: chỉ tranh khóa UART theo từng lệnh AT (tối đa
+ * CELL_ALERT_AT_WAIT_MS). Header + body được gửi bằng một lần ghi. Không retry, không dựng lại data
+ * context: chưa có mạng thì trả false ngay để caller lưu bản ghi vào hàng đợi flash.
+ * @return true nếu status 2xx.
+ */
+bool cellularAlertPost(const char* path, const uint8_t* body, size_t length, const char* contentType, String& response);
+
+/**
+ * @brief Giữ socket khẩn luôn ấm: mở lại khi đã đứt (cách nhau CELL_ALERT_RECONNECT_MS) và gửi
+ * heartbeat GET BACKEND_PING_PATH khi rảnh quá CELL_ALERT_HEARTBEAT_MS. Gọi định kỳ từ alertTask.
+ */
+void cellularAlertMaintain();
+
+// Thống kê socket khẩn (từ lúc boot)
+struct CellularAlertStats {
+  bool open;                  // Socket khẩn đang kết nối sẵn
+  uint32_t posts;             // POST khẩn đã thực hiện
+  uint32_t failures;
+  uint32_t connects;          // Lượt mở socket (lần đầu, sau khi đứt, sau heartbeat lỗi)
+  uint32_t staleRecovered;    // Socket giữ sẵn hóa ra đã chết lúc gửi, đã mở lại và gửi lại
+  uint32_t heartbeats;
+  uint32_t heartbeatFailures;
+  uint32_t lastLatencyMs;     // POST khẩn gần nhất: từ lúc gọi tới khi có status
+  uint32_t maxLatencyMs;
+};
+
+CellularAlertStats cellularAlertGetStats();
+
+// Thời gian từng pha của lần bring-up gần nhất (ms); pha bị bỏ qua (modem đã sẵn sàng) là 0
+struct CellularBootTiming {
+  uint32_t startMs;           // millis() lúc bắt đầu bring-up
+  uint32_t atMs;              // Mở UART tới khi modem trả lời AT (kể cả bật PWRKEY/dò chân)
+  uint32_t initMs;            // ATE0/CMEE của TinyGSM (+ AT+CRESET nếu init lỗi)
+  uint32_t simMs;
+  uint32_t registerMs;        // Chờ đăng ký mạng
+  uint32_t dataMs;            // GPRS + NETOPEN, hoặc chỉ kiểm tra context còn mở
+  uint32_t totalMs;
+  uint32_t firstSendMs;       // millis() lúc bắt đầu gửi request HTTP đầu tiên sau boot, 0 = chưa gửi
+  bool poweredOn;             // Modem đang tắt, phải bật PWRKEY
+  bool restarted;             // init lỗi, phải restart modem
+  bool pinScan;               // Chân trong NVS không dùng được, phải dò
+  bool warmData;              // Data context của lần boot trước còn mở, bỏ qua GPRS/NETOPEN
+};
+
+CellularBootTiming cellularGetBootTiming();
+
+// Link UART tới modem: baud thương lượng bằng AT+IPR và lỗi nhận của driver
+struct CellularUartStats {
+  uint32_t baud;              // Baud đang dùng
+  uint32_t baudCeiling;       // Trần hiện tại (CELL_BAUD_MAX, hạ dần khi lỗi nhận)
+  bool flowControl;           // RTS/CTS đã nối (CELL_UART_RTS_PIN/CELL_UART_CTS_PIN)
+  uint32_t overruns;          // FIFO/buffer RX tràn
+  uint32_t frameErrors;
+  uint32_t downgrades;        // Lần monitor hạ baud vì lỗi nhận
+  uint32_t negotiateFailures; // Nấc modem nhận AT+IPR nhưng link không qua kiểm tra
+};
+
+CellularUartStats cellularUartGetStats();
+
 /**
  * @brief Reset hoàn toàn modem (tắt/bật lại) khi gặp lỗi không hồi phục.
  */
 void cellularReset();
 
+// Snapshot trạng thái modem do task theo dõi phát hành (POD, đọc qua seqlock)
+struct CellularStatus {
+  bool valid;                 // Đã lấy mẫu ít nhất một lần khi modem sẵn sàng
+  bool modemReady;
+  bool dataConnected;
+  bool registered;            // +CEREG stat 1 (home) hoặc 5 (roaming)
+  bool pdpActive;             // +CGACT context 1
+  int16_t csq;                // 0..31, 99 = chưa biết, -1 = lệnh lỗi
+  uint8_t regStatus;          // Giá trị stat của +CEREG
+  char ip[16];
+  char accessTech[16];        // Trường đầu của +CPSI (LTE, WCDMA, NO SERVICE...)
+  char modemName[24];
+  char imei[20];
+  uint32_t sampledAtMs;       // millis() lúc lấy mẫu xong
+  uint32_t sampleMs;          // Thời gian một lượt lấy mẫu
+  uint32_t samples;
+  uint32_t sampleFailures;    // Lượt có lệnh AT lỗi/timeout
+};
+
 /**
- * @brief Lấy chuỗi mô tả trạng thái 4G (IMEI, chất lượng sóng, IP...) để hiển thị trên UI.
+ * @brief Khởi động task theo dõi modem (gọi một lần từ setup). Task chỉ hỏi modem khi đã sẵn sàng,
+ * không tự dựng kết nối.
+ */
+void cellularMonitorBegin();
+
+/**
+ * @brief Bản sao snapshot mới nhất, không chạm UART.
+ */
+CellularStatus cellularGetStatus();
+
+/**
+ * @brief Lấy chuỗi mô tả trạng thái 4G (IMEI, chất lượng sóng, IP...) từ snapshot để hiển thị trên UI.
  */
 String cellularStatusSummary();
 
@@ -93,6 +240,31 @@ String cellularStatusSummary();
  */
 bool cellularOtaDownload(const char* host, uint16_t port, const char* path);
 
+// Kết quả lượt đo thông lượng gần nhất
+struct CellularBenchResult {
+  bool running;
+  bool done;                  // Đã có ít nhất một lượt đo xong
+  const char* dataMode;       // "at" hoặc "ppp" (CELL_DATA_MODE lúc biên dịch)
+  const char* transport;      // Transport HTTP lúc đo
+  uint32_t downloadBytes;
+  uint32_t downloadMs;        // Gồm cả mở socket nếu chưa có phiên keep-alive
+  uint32_t downloadKbps;
+  int downloadStatus;         // Mã HTTP hoặc mã lỗi âm
+  uint32_t uploadBytes;
+  uint32_t uploadMs;
+  uint32_t uploadKbps;
+  int uploadStatus;
+};
+
+/**
+ * @brief Đo thông lượng 4G trong task riêng: GET `bytes` byte từ BACKEND_BENCH_DOWNLOAD_PATH (đọc bỏ)
+ * rồi POST tối đa CELL_BENCH_UPLOAD_MAX_BYTES lên BACKEND_BENCH_UPLOAD_PATH, qua bộ thực thi chung.
+ * So sánh chế độ AT/PPP bằng hai bản build, transport tinygsm/modem bằng cellularSetHttpTransport().
+ * @return false nếu đang có lượt đo khác.
+ */
+bool cellularBenchmarkStart(uint32_t bytes);
+CellularBenchResult cellularBenchmarkGet();
+
 #endif
 
 
@@ -37,17 +37,55 @@
 // 1 = ép chạy LTE-only để ổn định; 0 = để modem tự chọn (khi sóng LTE yếu)
 #define CELL_FORCE_LTE_ONLY 1
 
+// Đường dữ liệu 4G, chọn lúc biên dịch:
+// - CELL_DATA_MODE_AT: socket AT của modem (TinyGSM, +CHTTPS*), TCP/DNS chạy trên modem
+// - CELL_DATA_MODE_PPP: PPPoS (cell_ppp), modem chỉ chở khung PPP; TCP/DNS/TLS chạy trên lwIP của ESP32,
+//   WiFiClient/HTTPClient dùng chung với đường WiFi. UART không nhận lệnh AT trong lúc PPP chạy.
+// Thông lượng (battery_backend/backend/bench/bench_cell_datapath.py): PPP hơn AT ~15% ở 115200 baud; ở 921600
+// baud với RTT 120 ms PPP bị cửa sổ TCP 5744 byte của lwIP chặn, ngang AT.
+#define CELL_DATA_MODE_AT 0
+#define CELL_DATA_MODE_PPP 1
+#define CELL_DATA_MODE CELL_DATA_MODE_AT
+#define CELL_PPP_DIAL_TIMEOUT_MS 10000      // ATD*99# tới "CONNECT"
+#define CELL_PPP_CONNECT_TIMEOUT_MS 20000   // LCP/IPCP tới khi có IP
+
 // UART phần cứng kết nối module 4G
 #define CELL_UART Serial2
-#define CELL_BAUD 115200
+#define CELL_BAUD 115200               // Baud modem khi vừa bật (AT+IPR không giữ qua lần tắt nguồn)
+#define CELL_BAUD_MAX 921600           // Trần thương lượng AT+IPR (921600/460800/230400); CELL_BAUD = không đổi
 #define CELL_TX_PIN 26
 #define CELL_RX_PIN 27
+#define CELL_UART_RTS_PIN -1           // RTS/CTS nối tới modem thì bật flow control (AT+IFC=2,2); -1 = không nối
+#define CELL_UART_CTS_PIN -1
+#define CELL_UART_RX_BUFFER 4096       // Buffer RX của driver UART (đệm khi task RX chậm ở baud cao)
+#define CELL_UART_ERROR_LIMIT 3        // Lỗi nhận (tràn/khung) trong một chu kỳ monitor thì hạ một nấc baud
+
+// Lớp lệnh AT (at_engine): task RX đọc UART, hàng đợi lệnh, phát URC
+#define AT_ENGINE_TASK_PRIORITY 4      // Cao hơn mọi task mạng: URC và phản hồi được đọc ngay
+#define AT_ENGINE_TASK_CORE 1
+#define AT_ENGINE_QUEUE_DEPTH 6        // Lệnh chờ/đang chạy cùng lúc
+#define AT_ENGINE_CMD_MAX 96           // Độ dài lệnh tối đa (không gồm "AT")
+#define AT_ENGINE_RX_RING 2048         // Ring chuyển tiếp byte cho TinyGSM (lũy thừa của 2)
+#define AT_ENGINE_QUEUE_WAIT_MS 5000   // atCommand chờ thêm ngoài timeout lệnh khi hàng đợi đang bận
+#define AT_URC_HANDLERS_MAX 4
+// Task theo dõi modem: lấy mẫu sóng/đăng ký/PDP/IP định kỳ, web UI và đường gửi chỉ đọc snapshot
+#define CELL_MONITOR_TASK_PRIORITY 1   // Ngang uploadTask, lệnh AT ở mức AT_PRIO_LOW nên không chen lệnh upload
+#define CELL_MONITOR_INTERVAL_MS 15000
+#define CELL_MONITOR_STALE_MS 60000    // Snapshot cũ hơn mức này thì đường gửi không dựa vào CSQ nữa
+#define CELL_MIN_CSQ 3                 // CSQ dưới mức này coi như không gửi được
 
 // PWRKEY điều khiển nguồn cho modem; cần giữ mức kích đủ lâu
 #define CELL_PWRKEY_PIN 4
 #define CELL_PWRKEY_ACTIVE_MS 1500
 #define CELL_PWRKEY_ACTIVE_LOW 1  // SIMCOM thường là active-LOW
 
+// Bring-up nhanh: chân UART, baud, mạng (PLMN) và APN của lần thành công trước lưu trong NVS
+#define CELL_NVS_NAMESPACE "cell"
+#define CELL_AT_PROBE_MS 600            // Modem đang bật trả lời AT gần như ngay; không trả lời thì mới bật PWRKEY
+#define CELL_BOOT_AT_TIMEOUT_MS 15000   // Sau PWRKEY SIM7600 cần ~10-12 s mới nhận AT
+#define CELL_SIM_READY_TIMEOUT_MS 5000  // Chờ "+CPIN: READY" sau khi modem vừa khởi động
+#define CELL_REG_TIMEOUT_MS 30000       // Chờ đăng ký mạng (+CEREG stat 1/5)
+
 // --------------------------------------------------------------------
 // CẤU HÌNH BACKEND (Upload qua Wi-Fi hoặc 4G)
 // --------------------------------------------------------------------
@@ -55,16 +93,65 @@
 #define BACKEND_HOST "cloud.anhnguyxn.io.vn"   // Backend FastAPI
 #define BACKEND_PORT 8000
 #define BACKEND_PATH "/api/ingest"
+#define BACKEND_BATCH_PATH "/api/ingest/batch"  // Nhiều bản ghi trong một POST
+// Giữ socket HTTP tới backend giữa các request; phải nhỏ hơn --timeout-keep-alive của uvicorn (Dockerfile)
+#define CELL_HTTP_KEEPALIVE_IDLE_MS 240000
+// Upload có body từ mức này (batch) được tính thông lượng B/s trong /api/status
+#define CELL_BULK_UPLOAD_MIN_BYTES 1024
+// Timeout AT+CIPOPEN cho socket upload thường (TinyGSM mặc định 75 s giữ UART quá lâu)
+#define CELL_TCP_CONNECT_TIMEOUT_S 15
+// Socket riêng cho cảnh báo khẩn: mux 1 của modem, luôn giữ kết nối sẵn tới backend
+#define CELL_ALERT_MUX 1
+#define CELL_ALERT_TIMEOUT_MS 2000         // Chờ response cho một POST khẩn
+#define CELL_ALERT_CONNECT_TIMEOUT_S 5
+#define CELL_ALERT_AT_WAIT_MS 3000         // Chờ tối đa khóa UART (upload thường đang giữ một lệnh AT)
+#define CELL_ALERT_HEARTBEAT_MS 120000     // Rảnh quá lâu thì GET BACKEND_PING_PATH để giữ socket/NAT
+#define CELL_ALERT_RECONNECT_MS 30000      // Khoảng cách giữa các lần mở lại socket khẩn khi đang lỗi
+#define CELL_ALERT_REQUEST_MAX 1024        // Buffer dựng sẵn header + body cho một lần ghi
+#define BACKEND_PING_PATH "/api/ping"      // Endpoint heartbeat, trả 204 không body
+// Cache DNS (dns_cache): socket mở bằng IP đã phân giải, header Host vẫn là tên miền
+#define DNS_CACHE_ENABLE 1
+#define DNS_CACHE_ENTRIES 4
+#define DNS_CACHE_TTL_MS 1800000           // SIM7600 không trả TTL thật: tự đặt 30 phút
+#define DNS_CACHE_REFRESH_MS 1200000       // Task nền làm mới bản ghi cũ hơn mức này, trước khi hết TTL
+#define DNS_RESOLVE_TIMEOUT_MS 8000
+// Bộ thực thi request 4G: nhả cellularHttpMutex giữa các lần thử, backoff có jitter, circuit breaker
+#define CELL_REQUEST_DEADLINE_MS 60000     // Tổng thời gian tối đa một request (kể cả chờ mutex/reconnect/backoff)
+#define CELL_RETRY_BACKOFF_MAX_MS 8000
+#define CELL_BREAKER_THRESHOLD 5           // Số request lỗi đường truyền liên tiếp thì mở breaker
+#define CELL_BREAKER_OPEN_MS 60000         // Breaker mở: request thường trả lỗi ngay, không đụng modem
+#define CELL_OTA_DEADLINE_MS 600000        // Tải firmware qua 4G (cả các lượt thử, mỗi lượt tải tiếp từ checkpoint)
+#define CELL_OTA_ATTEMPTS 6
+// HTTP(S) qua stack của modem (modem_http, +CHTTPS*): TLS do modem làm, phiên giữ qua nhiều request
+#define CELL_HTTP_TRANSPORT_MODEM 0        // 1: POST/GET đi qua modem_http thay vì TinyGSM + HttpClient (đổi được lúc chạy)
+#define MODEM_HTTP_CHUNK 1024              // Byte mỗi AT+CHTTPSSEND/AT+CHTTPSRECV (nhỏ hơn AT_ENGINE_RX_RING)
+#define MODEM_HTTP_LINE_MAX 256            // Dòng status/header dài hơn bị cắt
+#define MODEM_HTTP_OPEN_TIMEOUT_MS 15000   // AT+CHTTPSOPSE (gồm bắt tay TLS)
+#define MODEM_HTTP_POLL_MS 50              // Chờ URC "+CHTTPS: RECV EVENT" tối đa bấy nhiêu rồi hỏi lại
+// Đo thông lượng 4G (/api/cell-bench): tải xuống/lên qua đường dữ liệu và transport đang dùng
+#define BACKEND_BENCH_DOWNLOAD_PATH "/api/bench/download"
+#define BACKEND_BENCH_UPLOAD_PATH "/api/bench/upload"
+#define CELL_BENCH_MAX_BYTES 262144          // Tải xuống (đọc bỏ, không giữ trong RAM)
+#define CELL_BENCH_UPLOAD_MAX_BYTES 32768     // Tải lên: body dựng sẵn trong heap
+#define CELL_BENCH_TIMEOUT_MS 60000           // Mỗi chiều, kể cả mở kết nối
 #define APPLICATION_KEY "battery_monitor_2025_secure_key"  // API key xác thực
 
 // --------------------------------------------------------------------
 // CHÂN CẢM BIẾN VÀ NGOẠI VI
 // --------------------------------------------------------------------
 #define TEMP_SENSOR_PIN 23         // DS18B20 (1-Wire)
+// Độ phân giải mặc định cho mỗi DS18B20 (9..12 bit): 12 bit ~750 ms/lần chuyển đổi, 9 bit ~94 ms
+#define TEMP_SENSOR_RESOLUTION 12
+// Số đầu dò DS18B20 tối đa trên bus (mỗi cell/ngăn pin một đầu dò, ROM được cache trong NVS)
+#define MAX_TEMP_PROBES 8
 #define SMOKE_SENSOR_PIN 35        // MQ-135 → ESP32 ADC1 (tránh ADC2 khi bật Wi-Fi)
 #define FIRE_SENSOR_ANALOG_PIN 34  // KY-026 analog AO → ESP32 ADC1
 
-// Nếu có dùng chân digital của KY-026 thì bật pull-up tương ứng (mặc định không dùng)
+// Chân digital DO của KY-026 cho đường báo cháy nhanh bằng ngắt (fire_fastpath)
+// Chọn chân có pull-up nội (GPIO34..39 không có); DO của module LM393 kéo xuống khi thấy lửa
+#define FIRE_SENSOR_DIGITAL_PIN 32
+#define FIRE_DIGITAL_ACTIVE_LEVEL LOW
+// Bật pull-up nội cho DO khi module không có điện trở kéo lên (ngõ ra open-collector)
 #define FIRE_INPUT_PULLUP 0
 
 // LED cảnh báo: để -1 nếu không sử dụng đèn báo
@@ -84,15 +171,73 @@
 #define SMOKE_THRESHOLD 1500         // Giá trị ADC MQ-135 (0-4095)
 #define FIRE_ANALOG_THRESHOLD 375    // KY-026 ADC (0-1023): nhỏ hơn ngưỡng = có lửa
 
+// Phát hiện thermal runaway: độ dốc bình phương tối thiểu trên cửa sổ trượt của từng đầu dò
+#define TEMP_RISE_LIMIT_C_PER_MIN 2.0   // °C/phút: vượt mức này là cảnh báo dù chưa tới TEMP_THRESHOLD
+#define TEMP_RISE_WINDOW_SAMPLES 30     // Số mẫu trong cửa sổ (30 x TEMP_CHANNEL_PERIOD_MS = 60 s)
+
 // Ngưỡng phụ: nếu nhiệt độ cao, hạ ngưỡng MQ-135 xuống 80% để phát hiện sớm
 #define TEMP_SMOKE_THRESHOLD_MULTIPLIER 0.8
+#define TEMP_WARM_THRESHOLD 50.0        // °C: từ mức này coi là "pin nóng" (hạ ngưỡng khí, bắt đầu tính điểm)
+
+// Hysteresis cảnh báo (alert_fsm): ngưỡng tắt = ngưỡng bật ∓ khoảng dưới đây
+#define ALERT_HYST_TEMP_C 2.0           // °C
+#define ALERT_HYST_TEMP_RISE 0.5        // °C/phút
+#define ALERT_HYST_SMOKE 100            // ADC MQ-135
+#define ALERT_HYST_FIRE 25              // KY-026 10-bit
+#define ALERT_COALESCE_MS 60000         // Bật lại trong 60 s sau khi tắt → gộp vào sự kiện cũ, không upload khẩn
+#define ALERT_REPEAT_INTERVAL_MS 30000  // Gửi lại cảnh báo mỗi 30 s khi còn active
+
+// Gộp đa cảm biến (risk_fusion): trọng số từng kênh trên thang điểm 0..100
+#define SMOKE_RISE_LIMIT_PER_MIN 300.0  // ADC/phút: khí MQ-135 tăng nhanh cỡ này được tính đủ điểm xu hướng
+#define SMOKE_TREND_WINDOW_SAMPLES 40   // 40 x SMOKE_CHANNEL_PERIOD_MS = 10 s
+#define RISK_WEIGHT_TEMP 30.0
+#define RISK_WEIGHT_TEMP_RISE 30.0
+#define RISK_WEIGHT_SMOKE 30.0
+#define RISK_WEIGHT_SMOKE_RISE 15.0
+#define RISK_WEIGHT_FIRE 60.0
+#define RISK_CROSS_HOT_GAS_BONUS 25.0   // Pin nóng + khí đang tăng
+#define RISK_LEVEL_WATCH_SCORE 20
+#define RISK_LEVEL_WARNING_SCORE 45
+#define RISK_LEVEL_CRITICAL_SCORE 70
+#define RISK_LEVEL_HYST_SCORE 5         // Điểm phải tụt dưới ngưỡng bật của mức hiện tại bấy nhiêu mới hạ mức
 
 // --------------------------------------------------------------------
 // TẦN SUẤT ĐỌC/GỬI DỮ LIỆU
 // --------------------------------------------------------------------
-#define SENSOR_INTERVAL 1000      // ms: đọc cảm biến mỗi 1 giây
+#define SENSOR_TASK_CORE 0        // Core riêng cho lấy mẫu; loop/network/upload chạy core 1
+#define SENSOR_TASK_PRIORITY 5    // Cao hơn mọi task mạng để lấy mẫu không bị trễ
 #define DATA_SEND_INTERVAL 3000   // ms: tối thiểu 3 giây mới gửi server một lần
 
+// Lịch lấy mẫu từng kênh trong sensorTask (sensor_scheduler): chu kỳ ms + ngân sách thời gian µs
+#define SENSOR_SCHED_MAX_CHANNELS 8
+#define TEMP_CHANNEL_PERIOD_MS 2000    // DS18B20: nhiệt độ pin thay đổi chậm, 12-bit cần ~750 ms chuyển đổi
+#define TEMP_CHANNEL_BUDGET_US 60000   // Đọc scratchpad ~7 ms mỗi đầu dò x MAX_TEMP_PROBES
+#define SMOKE_CHANNEL_PERIOD_MS 250    // MQ-135: khí tích tụ trong vài giây
+#define SMOKE_CHANNEL_BUDGET_US 1500
+#define FIRE_CHANNEL_PERIOD_MS 20      // KY-026: ngọn lửa cần phản ứng nhanh nhất
+#define FIRE_CHANNEL_BUDGET_US 500
+#define FIRE_BLOCK_SAMPLES 4           // Mẫu mỗi block KY-026 (20 ms ở ADC_SAMPLE_RATE_HZ)
+#define ALERT_CHANNEL_PERIOD_MS 100    // Đánh giá ngưỡng + publish snapshot
+#define ALERT_CHANNEL_BUDGET_US 2000
+
+// Hàng đợi store-and-forward trên SPIFFS (telemetry_log): 64 x 44 B ≈ 2.8 KB mỗi segment
+#define TLOG_RECORDS_PER_SEGMENT 64
+#define TLOG_MAX_SEGMENTS 32            // ~2048 bản ghi ≈ 34 giờ mất mạng ở nhịp 60 s, ~90 KB SPIFFS
+#define TLOG_CURSOR_COMMIT_EVERY 8      // Ghi vị trí đọc vào NVS sau mỗi 8 bản ghi đã gửi
+// Gom lô: gửi khi đủ số bản ghi tối đa của đường truyền, hoặc bản ghi cũ nhất đã chờ quá
+// UPLOAD_BATCH_MAX_AGE_MS, hoặc có cảnh báo mới vào hàng đợi
+#define UPLOAD_BATCH_MAX_WIFI 50        // ~15 KB JSON, Wi-Fi không tốn phí theo byte
+#define UPLOAD_BATCH_MAX_4G 20          // ~6 KB JSON, vừa một lần gửi TinyGSM mà không quá lâu trên sóng yếu
+#define UPLOAD_BATCH_MAX_AGE_MS 300000  // Độ trễ tối đa của bản ghi định kỳ: 5 phút
+// Mã hóa payload: 1 = frame nhị phân varint/delta (telemetry_codec), 0 = JSON dễ đọc khi debug
+#define UPLOAD_BINARY_4G 1
+#define UPLOAD_BINARY_WIFI 0
+#define UPLOAD_RETRY_BACKOFF_MS 15000   // Gửi thất bại: chờ trước khi thử xả log lại
+#define UPLOAD_URGENT_QUEUE_DEPTH 8     // Bản ghi CRITICAL chờ gửi trong RAM (upload_queue), 48 B mỗi phần tử
+#define UPLOAD_NORMAL_QUEUE_DEPTH 16    // Bản ghi thường chờ uploadTask ghi xuống log flash, 44 B mỗi phần tử
+#define ALERT_TASK_PRIORITY 2           // alertTask cao hơn uploadTask (1) cùng core 1: cảnh báo chen trước lô thường
+#define ALERT_TASK_MAINTAIN_MS 5000     // Nhịp alertTask tự thức để kiểm tra socket khẩn/heartbeat
+
 // --------------------------------------------------------------------
 #define DEVICE_ID "battery_monitor_001"
 #define SERIAL_BAUD_RATE 115200
@@ -106,13 +251,29 @@
 // Cấu hình OTA
 #define FIRMWARE_CHECK_INTERVAL 43200000  // 12 giờ (ms)
 #define FIRMWARE_UPDATE_TIMEOUT 300000    // 5 phút
+// OTA tải tiếp được (ota_resume): GET từng khoảng Range, checkpoint NVS sau mỗi chunk đã ghi vào flash
+#define OTA_CHUNK_BYTES 32768             // Checkpoint mỗi chừng này byte, bội số của sector flash 4096
+#define OTA_RANGE_BYTES 131072            // Mỗi request Range lấy chừng này (bội số của OTA_CHUNK_BYTES)
+#define OTA_CHUNK_RETRIES 5               // WiFi: số chunk lỗi liên tiếp thì dừng (lần OTA sau tải tiếp)
+#define OTA_STALL_TIMEOUT_MS 30000        // Không nhận thêm byte trong khoảng này: bỏ chunk, tải lại
+#define OTA_NVS_NAMESPACE "ota"
+// Đường ống OTA (ota_pipeline): đọc mạng và ghi flash chồng lên nhau qua buffer đôi
+#define OTA_PIPELINE 1                    // 0: đọc 512 byte rồi ghi ngay như trước (bản build để so sánh thời gian)
+#define OTA_PIPE_BUFFERS 2
+#define OTA_PIPE_BUF_BYTES 8192           // Bội số sector 4096, ước số của OTA_CHUNK_BYTES
+#define OTA_FLASH_TASK_PRIORITY 2         // Cao hơn task tải để buffer đầy được ghi ngay
+#define OTA_FLASH_TASK_CORE 0             // Khác core với task đọc mạng (loop/web chạy ở core 1)
 #define FIRMWARE_NOTIFICATION_AP_SSID "FirmwareUpdate-v" FIRMWARE_VERSION
 #define FIRMWARE_NOTIFICATION_AP_PASSWORD "update123"
 
 // --------------------------------------------------------------------
 // XỬ LÝ NHIỄU ADC (MQ-135)
 // --------------------------------------------------------------------
-#define ADC_SAMPLES 16           // Lấy trung bình 16 mẫu cho mỗi lần đọc
+#define ADC_SAMPLES 16           // Số mẫu trong mỗi block giao cho bộ lọc (decimation)
+#define ADC_SAMPLE_RATE_HZ 200   // Tần số lấy mẫu nền cho mỗi kênh analog
+#define ADC_RING_SIZE 512        // Dung lượng ring buffer mỗi kênh (lũy thừa của 2, ~2.5 s ở 200 Hz)
+#define ADC_SAMPLER_CORE 0       // Core chạy task lấy mẫu (loop/upload chạy ở core 1)
+#define ADC_SAMPLER_PRIORITY 3   // Cao hơn loop (1) để chu kỳ lấy mẫu đều
 #define SMOKE_FLOAT_RANGE 800    // Nếu biên độ dao động lớn → cảnh báo cảm biến lỏng
 #define MEDIAN_FILTER_SIZE 5     // Bộ lọc trung vị để bỏ outlier
 #define MOVING_AVERAGE_SIZE 10   // Trung bình trượt để làm mượt giá trị cuối
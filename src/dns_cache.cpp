@@ -0,0 +1,191 @@
+#include "dns_cache.h"
+
+/**
+ * @file dns_cache.cpp
+ * @brief Bảng DNS nhỏ cho socket 4G (xem dns_cache.h).
+ */
+
+#define DNS_HOST_MAX 48
+#define DNS_ADDR_MAX 16   // "255.255.255.255"
+#define DNS_ADDRS_PER_HOST 2
+#define DNS_LINE_MAX 128  // "+CDNSGIP: 1,\"<host>\",\"<ip1>\",\"<ip2>\""
+
+struct DnsEntry {
+  bool used;
+  char host[DNS_HOST_MAX];
+  char addrs[DNS_ADDRS_PER_HOST][DNS_ADDR_MAX];
+  uint8_t addrCount;
+  uint8_t current;            // Địa chỉ đang dùng; lỗi thì chuyển sang địa chỉ kế tiếp
+  uint32_t resolvedAtMs;
+  uint32_t lastUsedMs;
+};
+
+static DnsEntry entries[DNS_CACHE_ENTRIES];
+static SemaphoreHandle_t dnsMutex = NULL;  // Chỉ bảo vệ bảng; AT+CDNSGIP chạy ngoài khóa
+static bool enabled = DNS_CACHE_ENABLE;
+static DnsQueryFn queryFn = NULL;
+static DnsCacheStats stats = {};
+
+static void lockTable() {
+  if (dnsMutex == NULL) dnsMutex = xSemaphoreCreateMutex();
+  xSemaphoreTake(dnsMutex, portMAX_DELAY);
+}
+
+static void unlockTable() {
+  xSemaphoreGive(dnsMutex);
+}
+
+static bool isIpLiteral(const char* host) {
+  for (const char* p = host; *p; p++) {
+    if (!((*p >= '0' && *p <= '9') || *p == '.')) return false;
+  }
+  return host[0] != '\0';
+}
+
+static DnsEntry* findEntry(const char* host) {
+  for (uint8_t i = 0; i < DNS_CACHE_ENTRIES; i++) {
+    if (entries[i].used && strcmp(entries[i].host, host) == 0) return &entries[i];
+  }
+  return NULL;
+}
+
+/**
+ * @brief AT+CDNSGIP="<host>" → `+CDNSGIP: 1,"<host>","<ip1>"[,"<ip2>"]`; lỗi thì `+CDNSGIP: 0,<err>`.
+ */
+static bool resolve(const char* host, DnsEntry& out) {
+  char line[DNS_LINE_MAX] = "";
+  if (queryFn == NULL) return false;
+  if (!queryFn(host, line, sizeof(line)) || strncmp(line, "+CDNSGIP: 1,", 12) != 0) {
+    stats.resolveFailures++;
+    Serial.printf("[DNS] Phân giải %s lỗi: %s\n", host, line);
+    return false;
+  }
+
+  // Bỏ chuỗi tên miền (cặp nháy đầu tiên), các cặp nháy sau là địa chỉ
+  const char* p = strchr(line, '"');
+  p = p ? strchr(p + 1, '"') : NULL;
+  out.addrCount = 0;
+  while (p && out.addrCount < DNS_ADDRS_PER_HOST) {
+    const char* start = strchr(p + 1, '"');
+    if (!start) break;
+    const char* end = strchr(start + 1, '"');
+    if (!end) break;
+    size_t len = end - start - 1;
+    if (len > 0 && len < DNS_ADDR_MAX) {
+      memcpy(out.addrs[out.addrCount], start + 1, len);
+      out.addrs[out.addrCount][len] = '\0';
+      out.addrCount++;
+    }
+    p = end;
+  }
+  if (out.addrCount == 0) {
+    stats.resolveFailures++;
+    return false;
+  }
+  strncpy(out.host, host, DNS_HOST_MAX - 1);
+  out.host[DNS_HOST_MAX - 1] = '\0';
+  out.current = 0;
+  out.resolvedAtMs = millis();
+  out.used = true;
+  stats.resolves++;
+  return true;
+}
+
+/**
+ * @brief Ghi bản ghi vừa phân giải vào bảng (thay bản ghi cũ cùng host hoặc bản ghi lâu không dùng nhất).
+ */
+static void store(const DnsEntry& fresh) {
+  lockTable();
+  DnsEntry* slot = findEntry(fresh.host);
+  if (slot == NULL) {
+    slot = &entries[0];
+    for (uint8_t i = 0; i < DNS_CACHE_ENTRIES; i++) {
+      if (!entries[i].used) {
+        slot = &entries[i];
+        break;
+      }
+      if ((int32_t)(entries[i].lastUsedMs - slot->lastUsedMs) < 0) slot = &entries[i];
+    }
+  }
+  uint32_t lastUsed = slot->used && strcmp(slot->host, fresh.host) == 0 ? slot->lastUsedMs : millis();
+  *slot = fresh;
+  slot->lastUsedMs = lastUsed;
+  unlockTable();
+}
+
+void dnsCacheBegin(DnsQueryFn query) {
+  queryFn = query;
+}
+
+void dnsCacheSetEnabled(bool on) {
+  enabled = on;
+  Serial.printf("[DNS] Cache %s\n", on ? "bật" : "tắt");
+}
+
+bool dnsCacheEnabled() {
+  return enabled;
+}
+
+bool dnsCacheLookup(const char* host, char* ip, size_t ipSize) {
+  if (!enabled || host == NULL || isIpLiteral(host) || strlen(host) >= DNS_HOST_MAX) return false;
+
+  lockTable();
+  DnsEntry* e = findEntry(host);
+  if (e && millis() - e->resolvedAtMs < DNS_CACHE_TTL_MS) {
+    strncpy(ip, e->addrs[e->current], ipSize - 1);
+    ip[ipSize - 1] = '\0';
+    e->lastUsedMs = millis();
+    stats.hits++;
+    unlockTable();
+    return true;
+  }
+  unlockTable();
+
+  stats.misses++;
+  DnsEntry fresh = {};
+  if (!resolve(host, fresh)) return false;
+  store(fresh);
+  strncpy(ip, fresh.addrs[0], ipSize - 1);
+  ip[ipSize - 1] = '\0';
+  return true;
+}
+
+void dnsCacheReportFailure(const char* host, const char* ip) {
+  stats.connectFailures++;
+  lockTable();
+  DnsEntry* e = findEntry(host);
+  if (e && strcmp(e->addrs[e->current], ip) == 0) {
+    if (e->current + 1 < e->addrCount) {
+      e->current++;  // Còn địa chỉ khác: lần sau thử địa chỉ đó
+    } else {
+      e->used = false;  // Hết địa chỉ: phân giải lại ở lần sau
+    }
+  }
+  unlockTable();
+  Serial.printf("[DNS] Kết nối %s (%s) lỗi, bỏ địa chỉ khỏi cache\n", host, ip);
+}
+
+void dnsCacheRefresh() {
+  if (!enabled) return;
+  for (uint8_t i = 0; i < DNS_CACHE_ENTRIES; i++) {
+    char host[DNS_HOST_MAX];
+    lockTable();
+    bool due = entries[i].used && millis() - entries[i].resolvedAtMs >= DNS_CACHE_REFRESH_MS;
+    if (due) memcpy(host, entries[i].host, sizeof(host));
+    unlockTable();
+    if (!due) continue;
+
+    DnsEntry fresh = {};
+    if (resolve(host, fresh)) {
+      store(fresh);
+      stats.refreshes++;
+    }
+    // Lỗi thì giữ bản ghi cũ tới hết TTL; đường gửi sẽ tự phân giải lại sau đó
+  }
+}
+
+DnsCacheStats dnsCacheGetStats() {
+  DnsCacheStats out = stats;
+  out.enabled = enabled;
+  return out;
+}
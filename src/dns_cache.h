@@ -0,0 +1,67 @@
+#ifndef DNS_CACHE_H
+#define DNS_CACHE_H
+
+/**
+ * @file dns_cache.h
+ * @brief Cache DNS cho socket 4G: phân giải bằng AT+CDNSGIP, giữ địa chỉ theo TTL để socket mở thẳng
+ * bằng IP (modem không phải tự phân giải lại mỗi lần AT+CIPOPEN).
+ *
+ * Lệnh AT do cellular.cpp gửi qua hàm gắn bằng dnsCacheBegin(); mô-đun này chỉ giữ bảng và tách phản hồi
+ * nên chạy được trên máy host.
+ *
+ * - SIM7600 không trả TTL của bản ghi DNS nên dùng TTL cố định DNS_CACHE_TTL_MS.
+ * - Task theo dõi modem gọi dnsCacheRefresh() để làm mới trước khi hết hạn, đường gửi hầu như luôn trúng cache.
+ * - Kết nối bằng IP lỗi thì gọi dnsCacheReportFailure(): chuyển sang địa chỉ kế tiếp hoặc bỏ bản ghi;
+ *   caller tự mở lại bằng tên miền (modem phân giải trực tiếp).
+ * - Header Host vẫn là tên miền vì HttpClient giữ tên miền, chỉ lớp socket đổi sang IP.
+ */
+
+#include <Arduino.h>
+#include "config.h"
+
+struct DnsCacheStats {
+  bool enabled;
+  uint32_t hits;
+  uint32_t misses;            // Không có/hết hạn, phải phân giải trên đường gửi
+  uint32_t resolves;          // Lượt AT+CDNSGIP thành công
+  uint32_t resolveFailures;
+  uint32_t refreshes;         // Làm mới nền trước khi hết hạn
+  uint32_t connectFailures;   // Mở socket bằng IP trong cache bị lỗi
+};
+
+/**
+ * @brief Gửi AT+CDNSGIP="<host>" và chép dòng phản hồi `+CDNSGIP: ...` vào `line`.
+ * @return false nếu lệnh lỗi hoặc hết giờ.
+ */
+typedef bool (*DnsQueryFn)(const char* host, char* line, size_t lineSize);
+
+/**
+ * @brief Gắn hàm truy vấn modem (gọi lại được). Chưa gắn thì dnsCacheLookup() luôn trả false.
+ */
+void dnsCacheBegin(DnsQueryFn query);
+
+/**
+ * @brief Bật/tắt cache lúc chạy (để so sánh thời gian tới byte đầu có/không cache).
+ */
+void dnsCacheSetEnabled(bool enabled);
+bool dnsCacheEnabled();
+
+/**
+ * @brief Lấy IP cho `host`: trúng cache thì trả ngay, không thì phân giải bằng AT+CDNSGIP và lưu lại.
+ * @return false nếu cache đang tắt, `host` đã là IP hoặc phân giải lỗi: caller dùng tên miền.
+ */
+bool dnsCacheLookup(const char* host, char* ip, size_t ipSize);
+
+/**
+ * @brief Báo mở socket bằng `ip` (lấy từ dnsCacheLookup) thất bại.
+ */
+void dnsCacheReportFailure(const char* host, const char* ip);
+
+/**
+ * @brief Làm mới các bản ghi sắp hết hạn (gọi từ task nền khi có data context).
+ */
+void dnsCacheRefresh();
+
+DnsCacheStats dnsCacheGetStats();
+
+#endif
@@ -0,0 +1,215 @@
+#ifndef FILTERS_H
+#define FILTERS_H
+
+/**
+ * @file filters.h
+ * @brief Thư viện bộ lọc header-only cho tín hiệu ADC, kích thước cửa sổ cố định lúc biên dịch.
+ *
+ * Mỗi bộ lọc là một "stage" có cùng giao diện:
+ * - `int32_t push(int32_t x)`: đưa mẫu mới vào và trả về giá trị đã lọc.
+ * - `void reset()`: xóa trạng thái (lần push kế tiếp sẽ mồi lại cửa sổ).
+ *
+ * Các stage được ghép bằng FilterChain<...>, mỗi kênh cảm biến giữ chain riêng (không dùng biến
+ * toàn cục, không cấp phát heap). Toàn bộ bộ nhớ nằm trong object nên có thể khai báo static.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * @brief So sánh-hoán đổi không rẽ nhánh: sau lệnh a <= b.
+ */
+inline void filterCompareSwap(int32_t& a, int32_t& b) {
+  int32_t lo = a < b ? a : b;
+  int32_t hi = a < b ? b : a;
+  a = lo;
+  b = hi;
+}
+
+/**
+ * @brief Mạng sắp xếp Batcher odd-even merge cho N phần tử bất kỳ.
+ *
+ * Dãy cặp so sánh chỉ phụ thuộc N: số phép so sánh O(N log² N) thay cho O(N²) của bubble sort cũ,
+ * và không phụ thuộc dữ liệu (thời gian chạy cố định). Vòng lặp sinh cặp vẫn còn sau khi biên dịch
+ * (g++ -Os/-O2 không trải phẳng nó), chỉ phép so sánh-hoán đổi là không rẽ nhánh.
+ */
+template <size_t N>
+struct SortingNetwork {
+  static void sort(int32_t* a) {
+    for (size_t p = 1; p < N; p <<= 1) {
+      for (size_t k = p; k >= 1; k >>= 1) {
+        for (size_t j = k % p; j + k < N; j += 2 * k) {
+          for (size_t i = 0; i < k && i + j + k < N; i++) {
+            if ((i + j) / (2 * p) == (i + j + k) / (2 * p)) {
+              filterCompareSwap(a[i + j], a[i + j + k]);
+            }
+          }
+        }
+      }
+    }
+  }
+};
+
+/**
+ * @brief Trung vị của N giá trị (không thay đổi mảng đầu vào).
+ */
+template <size_t N>
+inline int32_t medianOf(const int32_t* values) {
+  static_assert(N >= 1, "medianOf: N >= 1");
+  int32_t tmp[N];
+  for (size_t i = 0; i < N; i++) tmp[i] = values[i];
+  SortingNetwork<N>::sort(tmp);
+  return tmp[N / 2];
+}
+
+/**
+ * @brief Cửa sổ vòng N mẫu gần nhất, dùng chung cho các stage cần lịch sử.
+ *
+ * Lần push đầu tiên sau reset sẽ lấp đầy cả cửa sổ bằng mẫu đó để tránh kéo giá trị về 0.
+ */
+template <size_t N>
+class FilterWindow {
+  static_assert(N >= 1, "FilterWindow: N >= 1");
+
+ public:
+  // Trả về mẫu bị đẩy ra khỏi cửa sổ
+  int32_t push(int32_t x) {
+    if (!primed_) {
+      for (size_t i = 0; i < N; i++) buf_[i] = x;
+      primed_ = true;
+    }
+    int32_t old = buf_[idx_];
+    buf_[idx_] = x;
+    idx_ = (idx_ + 1) % N;
+    return old;
+  }
+  void reset() { primed_ = false; idx_ = 0; }
+  bool primed() const { return primed_; }
+  const int32_t* data() const { return buf_; }
+
+ private:
+  int32_t buf_[N];
+  size_t idx_ = 0;
+  bool primed_ = false;
+};
+
+/**
+ * @brief Median trượt N mẫu (sorting network trên bản sao cửa sổ).
+ */
+template <size_t N>
+class MedianFilter {
+ public:
+  int32_t push(int32_t x) {
+    win_.push(x);
+    return medianOf<N>(win_.data());
+  }
+  void reset() { win_.reset(); }
+
+ private:
+  FilterWindow<N> win_;
+};
+
+/**
+ * @brief Trung bình trượt N mẫu với tổng chạy: O(1) mỗi mẫu thay vì cộng lại cả cửa sổ.
+ */
+template <size_t N>
+class MovingAverageFilter {
+ public:
+  int32_t push(int32_t x) {
+    if (!win_.primed()) sum_ = (int64_t)x * N;
+    int32_t old = win_.push(x);
+    sum_ += (int64_t)x - old;
+    return (int32_t)(sum_ / (int64_t)N);
+  }
+  void reset() { win_.reset(); sum_ = 0; }
+
+ private:
+  FilterWindow<N> win_;
+  int64_t sum_ = 0;
+};
+
+/**
+ * @brief Trung bình mũ (EMA) với hệ số alpha = 1 / 2^Shift, tính bằng fixed-point số nguyên.
+ */
+template <uint8_t Shift>
+class EmaFilter {
+  static_assert(Shift >= 1 && Shift <= 16, "EmaFilter: 1 <= Shift <= 16");
+
+ public:
+  int32_t push(int32_t x) {
+    if (!primed_) {
+      acc_ = (int64_t)x << Shift;
+      primed_ = true;
+    }
+    acc_ += (int64_t)x - ((acc_ + (1 << (Shift - 1))) >> Shift);
+    return (int32_t)((acc_ + (1 << (Shift - 1))) >> Shift);
+  }
+  void reset() { primed_ = false; acc_ = 0; }
+
+ private:
+  int64_t acc_ = 0;
+  bool primed_ = false;
+};
+
+/**
+ * @brief Bộ lọc Hampel: thay mẫu ngoại lai bằng trung vị cửa sổ.
+ *
+ * Mẫu x bị coi là outlier khi |x - median| > K * 1.4826 * MAD (MAD = median độ lệch tuyệt đối),
+ * với K = KTenths / 10. MinDev là ngưỡng tối thiểu (đơn vị ADC) để tín hiệu phẳng (MAD = 0)
+ * không biến mọi dao động nhỏ thành outlier. Mẫu bình thường đi qua nguyên vẹn, không bị trễ.
+ */
+template <size_t N, uint16_t KTenths = 30, int32_t MinDev = 8>
+class HampelFilter {
+ public:
+  int32_t push(int32_t x) {
+    win_.push(x);
+    const int32_t* w = win_.data();
+    int32_t med = medianOf<N>(w);
+    int32_t dev[N];
+    for (size_t i = 0; i < N; i++) {
+      int32_t d = w[i] - med;
+      dev[i] = d < 0 ? -d : d;
+    }
+    int32_t mad = medianOf<N>(dev);
+    int64_t limit = ((int64_t)KTenths * 14826 * mad) / 100000;
+    if (limit < MinDev) limit = MinDev;
+    int32_t diff = x - med;
+    if (diff < 0) diff = -diff;
+    return diff > limit ? med : x;
+  }
+  void reset() { win_.reset(); }
+
+ private:
+  FilterWindow<N> win_;
+};
+
+/**
+ * @brief Ghép nhiều stage nối tiếp: đầu ra stage trước là đầu vào stage sau.
+ *
+ * Ví dụ: FilterChain<HampelFilter<5>, MovingAverageFilter<10>> smokeFilter;
+ */
+template <typename... Stages>
+class FilterChain;
+
+template <>
+class FilterChain<> {
+ public:
+  int32_t push(int32_t x) { return x; }
+  void reset() {}
+};
+
+template <typename Head, typename... Tail>
+class FilterChain<Head, Tail...> {
+ public:
+  int32_t push(int32_t x) { return tail_.push(head_.push(x)); }
+  void reset() {
+    head_.reset();
+    tail_.reset();
+  }
+
+ private:
+  Head head_;
+  FilterChain<Tail...> tail_;
+};
+
+#endif
@@ -0,0 +1,87 @@
+#include "fire_fastpath.h"
+#include <esp_timer.h>
+#include <hal/gpio_ll.h>
+#include <soc/gpio_struct.h>
+
+/**
+ * @file fire_fastpath.cpp
+ * @brief ISR KY-026 DO → relay, và phần xác nhận cho pipeline cảnh báo.
+ */
+
+static volatile bool relayActiveLow = RELAY_ACTIVE_LOW;
+static volatile bool edgePending = false;      // Cạnh đã kích relay nhưng checkAlerts chưa thấy
+static volatile int64_t edgeAtUs = 0;
+static TaskHandle_t alertTask = NULL;
+
+static portMUX_TYPE fastPathMux = portMUX_INITIALIZER_UNLOCKED;
+static FireFastPathStats stats = {};
+
+static inline bool fireInputActive() {
+  return digitalRead(FIRE_SENSOR_DIGITAL_PIN) == FIRE_DIGITAL_ACTIVE_LEVEL;
+}
+
+/**
+ * @brief ISR cạnh kích hoạt: chỉ dùng hàm nằm trong IRAM (gpio_ll, esp_timer), không log.
+ *
+ * Bỏ qua cạnh lặp trong lúc sự kiện trước chưa được xác nhận (chống dội tiếp điểm comparator).
+ */
+static void IRAM_ATTR fireEdgeIsr() {
+  int64_t t0 = esp_timer_get_time();
+  if (edgePending) return;
+  gpio_ll_set_level(&GPIO, (gpio_num_t)RELAY_PIN, relayActiveLow ? 0 : 1);
+  int64_t t1 = esp_timer_get_time();
+
+  portENTER_CRITICAL_ISR(&fastPathMux);
+  edgeAtUs = t0;
+  edgePending = true;
+  stats.events++;
+  stats.lastRelayUs = (uint32_t)(t1 - t0);
+  if (stats.lastRelayUs > stats.maxRelayUs) stats.maxRelayUs = stats.lastRelayUs;
+  portEXIT_CRITICAL_ISR(&fastPathMux);
+
+  if (alertTask != NULL) {
+    BaseType_t woken = pdFALSE;
+    vTaskNotifyGiveFromISR(alertTask, &woken);
+    if (woken) portYIELD_FROM_ISR();
+  }
+}
+
+void fireFastPathBegin(TaskHandle_t notifyTask) {
+  alertTask = notifyTask;
+  pinMode(FIRE_SENSOR_DIGITAL_PIN, FIRE_INPUT_PULLUP ? INPUT_PULLUP : INPUT);
+  attachInterrupt(digitalPinToInterrupt(FIRE_SENSOR_DIGITAL_PIN), fireEdgeIsr,
+                  FIRE_DIGITAL_ACTIVE_LEVEL == LOW ? FALLING : RISING);
+  Serial.printf("[FIRE] Ngắt DO trên GPIO%d (%s, pull-up %s)\n", FIRE_SENSOR_DIGITAL_PIN,
+                FIRE_DIGITAL_ACTIVE_LEVEL == LOW ? "active LOW" : "active HIGH",
+                FIRE_INPUT_PULLUP ? "bật" : "tắt");
+}
+
+void fireFastPathSetRelayActiveLow(bool activeLow) {
+  relayActiveLow = activeLow;
+}
+
+bool fireFastPathActive() {
+  bool active = fireInputActive();
+  if (edgePending) {
+    uint32_t latency = (uint32_t)(esp_timer_get_time() - edgeAtUs);
+    portENTER_CRITICAL(&fastPathMux);
+    stats.lastPipelineUs = latency;
+    if (latency > stats.maxPipelineUs) stats.maxPipelineUs = latency;
+    edgePending = false;
+    portEXIT_CRITICAL(&fastPathMux);
+    active = true;  // Giữ cảnh báo ít nhất một lượt dù xung DO đã hết
+  }
+  return active;
+}
+
+bool fireFastPathLatched() {
+  return edgePending || fireInputActive();
+}
+
+FireFastPathStats fireFastPathGetStats() {
+  portENTER_CRITICAL(&fastPathMux);
+  FireFastPathStats out = stats;
+  portEXIT_CRITICAL(&fastPathMux);
+  out.inputActive = fireInputActive();
+  return out;
+}
@@ -0,0 +1,55 @@
+#ifndef FIRE_FASTPATH_H
+#define FIRE_FASTPATH_H
+
+/**
+ * @file fire_fastpath.h
+ * @brief Đường báo cháy nhanh: ngắt từ chân DO của KY-026 kích relay còi ngay trong ISR.
+ *
+ * ISR ghi thẳng thanh ghi GPIO của RELAY_PIN (không qua digitalWrite/task), ghi timestamp rồi
+ * đánh thức sensorTask để pipeline cảnh báo thường (checkAlerts, upload gấp) chạy ngay sau đó.
+ * Đường analog (ngưỡng FIRE_ANALOG_THRESHOLD) vẫn giữ nguyên làm lớp dự phòng.
+ */
+
+#include <Arduino.h>
+#include "config.h"
+
+// Thống kê độ trễ của đường nhanh (µs, đo bằng esp_timer)
+struct FireFastPathStats {
+  uint32_t events;            // Số cạnh kích hoạt đã xử lý
+  uint32_t lastRelayUs;       // Vào ISR → đã ghi relay, lần gần nhất
+  uint32_t maxRelayUs;
+  uint32_t lastPipelineUs;    // Vào ISR → checkAlerts() ghi nhận, lần gần nhất
+  uint32_t maxPipelineUs;
+  bool inputActive;           // Mức hiện tại của chân DO đang báo lửa
+};
+
+/**
+ * @brief Cấu hình chân DO (pull-up theo FIRE_INPUT_PULLUP) và gắn ngắt.
+ * @param notifyTask Task nhận xTaskNotifyGive khi có lửa (sensorTask), có thể NULL.
+ */
+void fireFastPathBegin(TaskHandle_t notifyTask);
+
+/**
+ * @brief Đồng bộ mức kích relay khi đổi chế độ active-low/high lúc runtime.
+ */
+void fireFastPathSetRelayActiveLow(bool activeLow);
+
+/**
+ * @brief Gọi từ checkAlerts(): true nếu chân DO đang báo lửa hoặc có cạnh chưa được xác nhận.
+ *
+ * Lần gọi đầu tiên sau một cạnh sẽ xác nhận sự kiện và ghi độ trễ pipeline.
+ */
+bool fireFastPathActive();
+
+/**
+ * @brief Chân DO đang báo lửa hoặc ISR đã kích relay mà checkAlerts() chưa xác nhận. Không xác nhận cạnh,
+ * dùng cho code khác muốn ghi relay (chime khởi động) để không thả relay ISR vừa kích.
+ */
+bool fireFastPathLatched();
+
+/**
+ * @brief Bản sao thống kê cho /api/status.
+ */
+FireFastPathStats fireFastPathGetStats();
+
+#endif
@@ -1,12 +1,14 @@
 #include <Arduino.h>
 #include <WiFi.h>
 #include <HTTPClient.h>
-#include <Update.h>
 #include <WebServer.h>
 #include <ArduinoJson.h>
 #include <esp_task_wdt.h>
+#include <lwip/sockets.h>
 #include "config.h"
 #include "cellular.h"
+#include "ota_resume.h"
+#include "ota_pipeline.h"
 
 /**
  * @file firmware_update.cpp
@@ -204,9 +206,89 @@ void stopFirmwareNotificationAP() {
   Serial.println(" Đã tắt WiFi AP thông báo firmware");
 }
 
+/**
+ * @brief Chờ socket có dữ liệu tới tối đa `timeoutMs` (select trên fd thay cho vòng delay(1)).
+ */
+static bool waitReadable(WiFiClient* client, uint32_t timeoutMs) {
+  if (client->available() > 0) return true;
+  int fd = client->fd();
+  if (fd < 0) return false;
+  fd_set readSet;
+  FD_ZERO(&readSet);
+  FD_SET(fd, &readSet);
+  struct timeval tv = { (time_t)(timeoutMs / 1000), (suseconds_t)((timeoutMs % 1000) * 1000) };
+  return select(fd + 1, &readSet, NULL, NULL, &tv) > 0;
+}
+
+/**
+ * @brief Một request Range của ảnh firmware qua Wi-Fi: body đọc thẳng vào buffer của ota_pipeline, task
+ * flash ghi song song.
+ * @return true khi body đã ghi đủ và checkpoint.
+ */
+static bool fetchOtaChunk(const String& url) {
+  static const char* headerKeys[] = { "Content-Range" };
+  char range[40];
+  otaResumeRangeHeader(range, sizeof(range));
+
+  HTTPClient http;
+  http.begin(url);
+  http.collectHeaders(headerKeys, 1);
+  http.addHeader("X-API-Key", APPLICATION_KEY);
+  http.addHeader("Range", range);
+  int httpCode = http.GET();
+  esp_task_wdt_reset();
+
+  String contentRange = http.header("Content-Range");
+  long want = otaResumeAccept(httpCode, contentRange.c_str(), httpCode > 0 ? http.getSize() : -1);
+  if (want < 0) {
+    Serial.println(" Lỗi tải firmware: " + String(httpCode) + " " + contentRange);
+    http.end();
+    return false;
+  }
+
+  WiFiClient* client = http.getStreamPtr();
+  long got = 0;
+  unsigned long lastData = millis();
+  while (got < want) {
+    size_t room = 0;
+    uint8_t* dst = otaPipelineAcquire(room);  // Chờ ở đây khi flash chưa ghi kịp
+    if (dst == NULL) {
+      Serial.println(" Lỗi ghi firmware");
+      break;
+    }
+    if (!waitReadable(client, 100)) {
+      if (!client->connected() || millis() - lastData > OTA_STALL_TIMEOUT_MS) break;
+      esp_task_wdt_reset();
+      continue;
+    }
+    if ((long)room > want - got) room = (size_t)(want - got);
+    int c = client->read(dst, room);
+    if (c <= 0) {
+      if (!client->connected()) break;
+      continue;
+    }
+    otaPipelineProduce(c);
+    got += c;
+    lastData = millis();
+    esp_task_wdt_reset();
+  }
+  http.end();
+
+  bool flashed = otaPipelineDrain();
+  if (got < want || !flashed) {
+    otaResumeRewind();
+    return false;
+  }
+  otaResumeCommit();
+  return true;
+}
+
 /**
  * @brief Thực hiện quy trình tải và ghi firmware qua Wi-Fi.
  *
+ * Ảnh được tải theo từng khoảng Range và checkpoint vào NVS (ota_resume): mất WiFi hay khởi động lại
+ * giữa chừng thì lần OTA sau cùng phiên bản tải tiếp từ chunk cuối đã ghi. Đọc mạng và ghi flash chạy
+ * chồng lên nhau qua ota_pipeline.
  * Hàm trả về false nếu bất kỳ bước nào thất bại để caller chủ động hiển thị lỗi.
  */
 bool performOTAUpdate(String url, String method) {
@@ -214,63 +296,47 @@ bool performOTAUpdate(String url, String method) {
   
   // 4G OTA bị vô hiệu hóa: luôn dùng WiFi path
   
-  HTTPClient http;
-  http.begin(url);
-  http.addHeader("X-API-Key", APPLICATION_KEY);
-  
-  int httpCode = http.GET();
-  if (httpCode != 200) {
-    Serial.println(" Lỗi tải firmware: " + String(httpCode));
-    return false;
-  }
-  
-  int contentLength = http.getSize();
-  if (contentLength <= 0) {
-    Serial.println(" Không thể xác định kích thước file");
+  // Checkpoint theo đường dẫn (chứa phiên bản), không theo host: đổi IP backend vẫn tải tiếp được
+  int pathStart = url.indexOf('/', url.indexOf("//") + 2);
+  String imageId = pathStart >= 0 ? url.substring(pathStart) : url;
+  if (!otaResumeBegin(imageId.c_str())) {
+    Serial.println(" Không thể bắt đầu update");
     return false;
   }
   
-  if (!Update.begin(contentLength)) {
-    Serial.println(" Không thể bắt đầu update");
+  if (!otaPipelineStart()) {
     return false;
   }
   
   esp_task_wdt_reset(); // Reset watchdog before starting transfer
   
-  WiFiClient* client = http.getStreamPtr();
-  uint8_t buff[512] = { 0 };
-  int totalBytes = 0;
-  int progressCounter = 0; // Counter for periodic watchdog resets
-  
-  while (http.connected() && (totalBytes < contentLength)) {
-    size_t size = client->available();
-    if (size) {
-      int c = client->readBytes(buff, ((size > sizeof(buff)) ? sizeof(buff) : size));
-      if (Update.write(buff, c) != c) {
-        Serial.println(" Lỗi ghi firmware");
-        return false;
-      }
-      totalBytes += c;
-      Serial.print(".");
-      
-      // Reset watchdog every 5KB to prevent timeout during large transfers
-      progressCounter++;
-      if (progressCounter % 10 == 0) {
-        esp_task_wdt_reset();
-        progressCounter = 0;
-      }
+  int failures = 0;
+  while (!otaResumeDone()) {
+    if (fetchOtaChunk(url)) {
+      failures = 0;
+      OtaResumeStats st = otaResumeGetStats();
+      Serial.printf(" %lu/%lu byte\n", (unsigned long)st.offset, (unsigned long)st.total);
+      continue;
     }
-    delay(1);
-    
-    // Also reset watchdog during delays
-    if (progressCounter % 2 == 0) {
-      esp_task_wdt_reset();
+    if (otaPipelineFailed()) {
+      // Flash lỗi thì chunk nào tải lại cũng lỗi: bỏ lượt ngay thay vì tiêu hết số lần thử
+      Serial.println(" Lỗi ghi flash, dừng OTA");
+      otaPipelineStop();
+      return false;
+    }
+    if (++failures > OTA_CHUNK_RETRIES || WiFi.status() != WL_CONNECTED) {
+      Serial.println(" Tải firmware dừng lại, lần OTA sau sẽ tải tiếp");
+      otaPipelineStop();
+      return false;
     }
+    delay(2000);
+    esp_task_wdt_reset();
   }
+  otaPipelineStop();
   
   esp_task_wdt_reset(); // Reset before finishing
   
-  if (Update.end()) {
+  if (otaResumeFinish()) {
     Serial.println("\n Update thành công! Khởi động lại...");
     esp_task_wdt_reset(); // Reset one more time before reboot
     delay(1000);
@@ -6,12 +6,30 @@
 #include <driver/adc.h>
 #include <HTTPClient.h>
 #include "cellular.h"
+#include "at_engine.h"
+#include "dns_cache.h"
+#include "modem_http.h"
+#include "cell_ppp.h"
+#include "adc_sampler.h"
+#include "filters.h"
+#include "sensor_snapshot.h"
+#include "temp_probes.h"
+#include "sensor_scheduler.h"
+#include "fire_fastpath.h"
+#include "thermal_runaway.h"
+#include "risk_fusion.h"
+#include "alert_fsm.h"
+#include "telemetry_log.h"
+#include "telemetry_codec.h"
+#include "upload_queue.h"
 #include <ArduinoJson.h>
 #include "config.h"
 #include <time.h>
 #include <Update.h>
 #include <WiFiClientSecure.h>
 #include "firmware_update.h"
+#include "ota_resume.h"
+#include "ota_pipeline.h"
 #include <SPIFFS.h>
 #include <esp_task_wdt.h>
 
@@ -33,28 +51,37 @@ const char* password = WIFI_PASSWORD;
 // HTTP Server
 WebServer server(HTTP_SERVER_PORT);
 
-// Khởi tạo cảm biến nhiệt độ
-OneWire oneWire(TEMP_SENSOR_PIN);
-DallasTemperature tempSensor(&oneWire);
-
-// Biến lưu trữ dữ liệu
-float temperature = 0.0;
-int smokeValue = 0;
-bool alertActive = false;
-int fireValue10 = 0; // KY-026 analog value (0..1023)
-bool tempAlertFlag = false;
-bool smokeAlertFlag = false;
-bool fireAlertFlag = false;
+// Biến lưu trữ dữ liệu - CHỈ sensorTask đọc/ghi trực tiếp
+// Các task khác (web, upload, network) đọc bản chụp qua sensorSnapshot
+static float temperature = 0.0;                  // Nhiệt độ cao nhất trong các đầu dò (cell nóng nhất)
+static float probeTemps[MAX_TEMP_PROBES];         // Nhiệt độ từng đầu dò, NAN nếu lỗi/mất kết nối
+static int8_t hottestProbe = -1;                  // Chỉ số đầu dò nóng nhất (-1 nếu không có)
+static SlopeEstimator<TEMP_RISE_WINDOW_SAMPLES> probeSlopes[MAX_TEMP_PROBES];  // dT/dt từng đầu dò
+static float tempRiseRate = NAN;                  // °C/phút lớn nhất, NAN nếu chưa đầu dò nào đủ cửa sổ
+static int8_t risingProbe = -1;                   // Đầu dò đang tăng nhiệt nhanh nhất
+static int smokeValue = 0;
+static SlopeEstimator<SMOKE_TREND_WINDOW_SAMPLES> smokeSlope;  // Xu hướng MQ-135 cho risk_fusion
+static float smokeRiseRate = NAN;                 // ADC/phút, NAN nếu chưa đủ cửa sổ
+static RiskAssessment riskState = { 0, RISK_NORMAL, SMOKE_THRESHOLD, false };
+static bool alertActive = false;
+static int fireValue10 = 0; // KY-026 analog value (0..1023)
+static bool tempAlertFlag = false;
+static bool tempRiseAlertFlag = false;
+static bool smokeAlertFlag = false;
+static bool fireAlertFlag = false;
+static Seqlock<SensorSnapshot> sensorSnapshot;  // Phát hành bởi sensorTask, không khóa reader
 static bool buzzerIsOn = false;
 static bool relayActiveLowRuntime = RELAY_ACTIVE_LOW; // Cho phép đổi mode tại runtime
 
-// Biến cho MQ-135 filtering (không dùng preheat gating)
-int smokeHistory[MOVING_AVERAGE_SIZE];
-int smokeHistoryIndex = 0;
+// Bộ lọc riêng cho từng kênh analog (không dùng preheat gating cho MQ-135)
+// Mỗi block ADC được rút gọn bằng median, sau đó qua chain của kênh tương ứng
+static FilterChain<HampelFilter<MEDIAN_FILTER_SIZE>, MovingAverageFilter<MOVING_AVERAGE_SIZE>> smokeFilter;
+static FilterChain<MedianFilter<MEDIAN_FILTER_SIZE>> fireFilter;
 int lastSmokeValue = 0;
+static bool smokePrimed = false;  // Đã có block MQ-135 đầu tiên từ bộ lấy mẫu nền chưa
+static bool firePrimed = false;   // Đã có block KY-026 đầu tiên chưa
 
 // Biến thời gian
-unsigned long lastSensorRead = 0;
 unsigned long lastDataSend = 0;
 unsigned long lastNtpSync = 0;
 bool timeSynced = false;
@@ -88,11 +115,19 @@ bool networkTaskCompleted = false;  // CẤM UPLOAD TRƯỚC KHI NETWORK TASK XO
 static volatile bool wifiScanInProgress = false;
 static unsigned long wifiScanLastStartMs = 0;
 
-// Biến quản lý upload async
-static bool uploadPending = false;
-static bool urgentUploadPending = false;
-static String uploadBody;
-static SemaphoreHandle_t uploadMutex = NULL;  // Thread-safe protection
+// Upload async qua upload_queue: bản ghi thường đi qua telemetry_log (SPIFFS), bản ghi khẩn qua queue RAM
+
+// Thống kê upload từ lúc boot (request/byte/bản ghi) để so sánh chi phí gửi lẻ và gửi lô
+struct UploadStats {
+  uint32_t requests;
+  uint32_t failures;
+  uint32_t bytes;          // Byte payload (chưa tính header HTTP/TCP)
+  uint32_t records;
+  uint32_t lastBatchSize;
+  uint32_t batchLimit;     // Giới hạn lô hiện tại (tự co khi lỗi, tăng dần khi thành công)
+};
+static UploadStats uploadStats = {};
+static portMUX_TYPE uploadStatsMux = portMUX_INITIALIZER_UNLOCKED;  // uploadTask và alertTask cùng ghi
 
 // Chime khởi động sau khi setup mạng
 #if STARTUP_CHIME_ENABLED
@@ -104,7 +139,9 @@ static bool startupChimeWas4G = false; // true: 1 beep; false: 2 beeps with 0.5s
 #endif
 
 // Khai báo các hàm
-void readSensors();
+void publishSensorSnapshot();
+void sensorTask(void* param);
+void registerSensorChannels();
 void checkAlerts();
 void activateAlerts();
 void deactivateAlerts();
@@ -116,11 +153,12 @@ String renderHtml();
 void handleRoot();
 void handleApiStatus();
 void testSensors();
-int medianFilter(int values[], int size);
-int movingAverage(int newValue);
 void tryBackendUpload();
 void uploadImmediate();
 void uploadImmediateCritical();
+String buildReadingBody(const TelemetryRecord& rec);
+String buildBatchBody(const TelemetryRecord* recs, uint32_t count);
+TelemetryRecord makeTelemetryRecord(const SensorSnapshot& snap, TelemetryKind kind);
 void syncNTP();
 unsigned long getCurrentTimestamp();
 void checkFirmwareUpdate();
@@ -139,6 +177,7 @@ void handleFirmwareUpdate4G();
 void handleFirmwareCheck();
 void forceSyncNTP();
 void networkTask(void* param);
+void alertTask(void* param);
 void startMainAP();
 void handleFirmwareUploadData();
 void handleFirmwareUploadComplete();
@@ -161,118 +200,221 @@ void buzzerOff() {
   buzzerIsOn = false;
 }
 
+/**
+ * @brief Gửi một payload lên backend qua 4G (nếu đang ở mode 4G) hoặc Wi-Fi.
+ * @param path BACKEND_PATH (một bản ghi) hoặc BACKEND_BATCH_PATH (lô).
+ * @param contentType "application/json" hoặc TELEMETRY_FRAME_CONTENT_TYPE.
+ * @param urgent true: qua 4G thì đi socket khẩn giữ sẵn (cellularAlertPost), không retry.
+ */
+static bool postReading(const char* path, const uint8_t* body, size_t length, const char* contentType, bool urgent) {
+  Serial.printf("[UPLOAD] Data size: %u bytes (%s)\n", (unsigned)length, contentType);
+  portENTER_CRITICAL(&uploadStatsMux);
+  uploadStats.requests++;
+  uploadStats.bytes += length;
+  portEXIT_CRITICAL(&uploadStatsMux);
+  bool uploadSuccess = false;
+  if (currentConnectionMode == CONNECTION_4G_FIRST && urgent) {
+    // Không gọi cellularBegin: dựng lại kết nối là việc của đường thường, cảnh báo lỗi thì vào hàng đợi flash
+    String resp;
+    if (cellularAlertPost(path, body, length, contentType, resp)) {
+      Serial.println(String("[UPLOAD] Upload 4G khẩn OK: ") + resp);
+      uploadSuccess = true;
+    } else {
+      Serial.println("[UPLOAD] Upload 4G khẩn FAIL");
+    }
+  } else if (currentConnectionMode == CONNECTION_4G_FIRST) {
+    if (cellularBegin()) {
+      String resp;
+      // 20 s, 3 lần, backoff lũy thừa (như cellularHttpPost)
+      bool ok = cellularHttpPostBytes(BACKEND_HOST, BACKEND_PORT, path, body, length, contentType, resp,
+                                      20000, 3, 0);
+      if (ok) {
+        Serial.println(String("[UPLOAD] Upload 4G OK: ") + resp);
+        uploadSuccess = true;
+      } else {
+        Serial.println("[UPLOAD] Upload 4G FAIL");
+      }
+    } else {
+      Serial.println("[UPLOAD] 4G not connected");
+    }
+  } else if (WiFi.status() == WL_CONNECTED) {
+    HTTPClient http;
+    String url = String("http://") + String(BACKEND_HOST) + ":" + String(BACKEND_PORT) + String(path);
+    http.begin(url);
+    http.addHeader("Content-Type", contentType);
+    http.addHeader("X-API-Key", APPLICATION_KEY);
+
+    int httpCode = http.POST((uint8_t*)body, length);
+    if (httpCode == 200) {
+      String response = http.getString();
+      Serial.println("[UPLOAD] Upload WiFi OK: " + response);
+      uploadSuccess = true;
+    } else {
+      Serial.println("[UPLOAD] Upload WiFi FAIL: " + String(httpCode));
+    }
+    http.end();
+  } else {
+    Serial.println("[UPLOAD] No connection (4G or WiFi)");
+  }
+  if (!uploadSuccess) {
+    portENTER_CRITICAL(&uploadStatsMux);
+    uploadStats.failures++;
+    portEXIT_CRITICAL(&uploadStatsMux);
+  }
+  return uploadSuccess;
+}
+
+/**
+ * @brief Mã hóa rồi gửi bản ghi: frame nhị phân hoặc JSON tùy đường truyền (UPLOAD_BINARY_4G/_WIFI).
+ * @param batch true: gửi lên BACKEND_BATCH_PATH; false: một bản ghi lên BACKEND_PATH.
+ */
+static bool postRecords(const TelemetryRecord* recs, uint32_t count, bool batch, bool urgent) {
+  const char* path = batch ? BACKEND_BATCH_PATH : BACKEND_PATH;
+  bool binary = (currentConnectionMode == CONNECTION_4G_FIRST) ? UPLOAD_BINARY_4G : UPLOAD_BINARY_WIFI;
+  if (binary) {
+    // Lô chỉ do uploadTask gửi: buffer tĩnh đủ cho lô lớn nhất; một bản ghi (alertTask) dùng buffer trên stack
+    static uint8_t batchFrame[TELEMETRY_FRAME_HEADER_MAX_BYTES + UPLOAD_BATCH_MAX_WIFI * TELEMETRY_FRAME_RECORD_MAX_BYTES];
+    uint8_t singleFrame[TELEMETRY_FRAME_HEADER_MAX_BYTES + TELEMETRY_FRAME_RECORD_MAX_BYTES];
+    uint8_t* frame = batch ? batchFrame : singleFrame;
+    size_t capacity = batch ? sizeof(batchFrame) : sizeof(singleFrame);
+    if (count > UPLOAD_BATCH_MAX_WIFI) count = UPLOAD_BATCH_MAX_WIFI;
+    if (!batch) count = 1;
+    size_t length = telemetryEncodeFrame(DEVICE_ID, recs, count, millis(), tlogBootId(), tlogEpoch(), frame,
+                                         capacity);
+    if (length > 0) return postReading(path, frame, length, TELEMETRY_FRAME_CONTENT_TYPE, urgent);
+    Serial.println("[UPLOAD] Mã hóa frame thất bại, gửi JSON");
+  }
+  String body = batch ? buildBatchBody(recs, count) : buildReadingBody(recs[0]);
+  return postReading(path, (const uint8_t*)body.c_str(), body.length(), "application/json", urgent);
+}
+
+/**
+ * @brief Thời gian còn phải chờ trước khi gửi lô: 0 nếu đủ `limit` bản ghi, có yêu cầu flush, hoặc bản
+ * ghi cũ nhất đã chờ quá UPLOAD_BATCH_MAX_AGE_MS (bản ghi từ lần boot trước luôn gửi ngay).
+ */
+static uint32_t batchWaitMs(const TelemetryRecord& oldest, uint32_t limit) {
+  if (uploadQueueFlushPending() || tlogDepth() >= limit) return 0;
+  if (oldest.bootId != tlogBootId()) return 0;
+  uint32_t age = millis() - oldest.uptimeMs;
+  return age >= UPLOAD_BATCH_MAX_AGE_MS ? 0 : UPLOAD_BATCH_MAX_AGE_MS - age;
+}
+
 /**
  * @brief Task nền chuyên xử lý upload dữ liệu lên backend mà không chặn loop chính.
  *
- * Quy trình:
- * - Chờ cờ `uploadPending` hoặc `urgentUploadPending`.
- * - Sao chép payload dưới mutex để tránh race condition.
- * - Ưu tiên 4G nếu hệ thống đang chạy ở mode 4G; fallback Wi-Fi khi có.
- * - Gửi xong thì hạ cờ, tiếp tục vòng lặp.
+ * Task ngủ trong uploadQueueWait() và được đánh thức bằng task notification ngay khi có bản ghi mới;
+ * hết giờ chờ chỉ dùng cho backoff và hạn gom lô. Queue URGENT do alertTask rút riêng. Mỗi lần thức:
+ * - Xả telemetry_log theo lô, cũ nhất trước, qua BACKEND_BATCH_PATH khi batchWaitMs() = 0;
+ *   cỡ lô tối đa theo đường truyền (UPLOAD_BATCH_MAX_4G / _WIFI). Bản ghi chỉ bị xóa khỏi log khi
+ *   server trả 200 cho cả lô (server khử trùng theo seq nên gửi lại cả lô là an toàn).
+ * - Gửi thất bại thì giảm nửa cỡ lô và chờ UPLOAD_RETRY_BACKOFF_MS mới thử lại; mỗi lô thành công
+ *   tăng cỡ lô thêm 2 đến trần của đường truyền.
  */
 void uploadTask(void* param) {
   // Disable watchdog cho uploadTask vì nó chạy HTTP operations
   esp_task_wdt_delete(NULL);
+  uploadQueueSetConsumer(xTaskGetCurrentTaskHandle());
 
   Serial.println("[UPLOAD] Task khởi động...");
+  unsigned long drainBlockedUntil = 0;
+  bool retryPending = false;
+  uint32_t batchLimit = 0;  // Giới hạn lô hiện tại, chỉ task này ghi; chép sang uploadStats cho /api/status
+  // Bộ đệm lô tĩnh (UPLOAD_BATCH_MAX_WIFI x 44 B) để không chiếm stack của task
+  static TelemetryRecord batchRecords[UPLOAD_BATCH_MAX_WIFI];
 
   while (true) {
-    // ƯU TIÊN URGENT: Kiểm tra urgent trước, nếu có thì bỏ qua upload thường
-    bool isUrgent = urgentUploadPending;
-    bool isNormal = uploadPending && !urgentUploadPending; // Chỉ upload thường nếu không có urgent
-    
-    if (isUrgent || isNormal) {
-      if (!networkTaskCompleted) {
-        // Chưa sẵn sàng mạng, đợi lần sau
-        delay(500);
-        continue;
-      }
-      
-      if (isUrgent) {
-        Serial.println("[UPLOAD] Bắt đầu upload (URGENT - CẢNH BÁO)...");
-      } else {
-        Serial.println("[UPLOAD] Bắt đầu upload...");
-      }
+    // Bản ghi thường do sensorTask/alertTask đẩy vào RAM: ghi xuống log flash ở đây, ngoài đường cảm biến
+    uploadQueueMoveToLog();
 
-      // Copy uploadBody với mutex protection - copy ngay trước khi gửi để lấy dữ liệu mới nhất
-      String localBody;
-      bool wasUrgent = false;
-      if (xSemaphoreTake(uploadMutex, portMAX_DELAY)) {
-        localBody = uploadBody;  // Safe copy
-        wasUrgent = urgentUploadPending; // Lưu trạng thái urgent tại thời điểm copy
-        xSemaphoreGive(uploadMutex);
-      }
+    if (!networkTaskCompleted) {
+      // Chưa sẵn sàng mạng, bản ghi vẫn tích lũy trong log
+      uploadQueueWait(500);
+      continue;
+    }
 
-      Serial.println("[UPLOAD] Data size: " + String(localBody.length()) + " bytes");
-
-      // Upload từ từ mà không block main loop
-      bool uploadSuccess = false;
-      if (currentConnectionMode == CONNECTION_4G_FIRST) {
-        Serial.println("[UPLOAD] Trying 4G upload...");
-        if (cellularBegin()) {
-          String resp;
-          bool ok = false;
-          if (wasUrgent) {
-            ok = cellularHttpPostCritical(BACKEND_HOST, BACKEND_PORT, BACKEND_PATH, localBody, resp);
-          } else {
-            ok = cellularHttpPost(BACKEND_HOST, BACKEND_PORT, BACKEND_PATH, localBody, resp);
-          }
-          if (ok) {
-            Serial.println(String("[UPLOAD] Upload 4G OK: ") + resp);
-            uploadSuccess = true;
-          } else {
-            Serial.println("[UPLOAD] Upload 4G FAIL");
-          }
-        } else {
-          Serial.println("[UPLOAD] 4G not connected");
-        }
-      } else if (WiFi.status() == WL_CONNECTED) {
-        Serial.println("[UPLOAD] Trying WiFi upload...");
-        HTTPClient http;
-        String url = String("http://") + String(BACKEND_HOST) + ":" + String(BACKEND_PORT) + String(BACKEND_PATH);
-        Serial.println("[UPLOAD] URL: " + url);
-
-        http.begin(url);
-        http.addHeader("Content-Type", "application/json");
-        http.addHeader("X-API-Key", APPLICATION_KEY);
-
-        int httpCode = http.POST(localBody);
-        Serial.println("[UPLOAD] HTTP Code: " + String(httpCode));
-
-        if (httpCode == 200) {
-          String response = http.getString();
-          Serial.println("[UPLOAD] Upload WiFi OK: " + response);
-          uploadSuccess = true;
+    // Cỡ lô tối đa theo đường truyền hiện tại
+    uint32_t transportMax = (currentConnectionMode == CONNECTION_4G_FIRST) ? UPLOAD_BATCH_MAX_4G : UPLOAD_BATCH_MAX_WIFI;
+    if (batchLimit == 0 || batchLimit > transportMax) batchLimit = transportMax;
+
+    // Xả hàng đợi flash theo lô, cũ nhất trước
+    uint32_t waitMs = portMAX_DELAY;  // Không còn việc: ngủ tới khi có notification
+    long blockedMs = (long)(drainBlockedUntil - millis());
+    if (blockedMs > 0) {
+      waitMs = (uint32_t)blockedMs;  // Đang backoff sau lỗi
+    } else if (tlogPeekBatch(batchRecords, 1) == 1) {
+      waitMs = retryPending ? 0 : batchWaitMs(batchRecords[0], batchLimit);
+      if (waitMs == 0) {
+        uploadQueueFlushStarted();
+        TelemetryLogCursor batchStart;
+        uint32_t n = tlogPeekBatch(batchRecords, batchLimit, &batchStart);
+        if (postRecords(batchRecords, n, true, false)) {
+          tlogAck(batchStart, n);
+          retryPending = false;
+          batchLimit = min(batchLimit + 2, transportMax);
+          portENTER_CRITICAL(&uploadStatsMux);
+          uploadStats.records += n;
+          uploadStats.lastBatchSize = n;
+          portEXIT_CRITICAL(&uploadStatsMux);
         } else {
-          Serial.println("[UPLOAD] Upload WiFi FAIL: " + String(httpCode));
+          batchLimit = max(batchLimit / 2, (uint32_t)1);
+          drainBlockedUntil = millis() + UPLOAD_RETRY_BACKOFF_MS;
+          retryPending = true;  // Hết backoff thì thử lại ngay, không chờ gom lại
+          Serial.printf("[UPLOAD] Gửi lô %lu bản ghi thất bại, giữ %lu bản ghi trong hàng đợi, lô kế tiếp tối đa %lu\n",
+                        (unsigned long)n, (unsigned long)tlogDepth(), (unsigned long)batchLimit);
         }
-        http.end();
-      } else {
-        Serial.println("[UPLOAD] No connection (4G or WiFi)");
+        portENTER_CRITICAL(&uploadStatsMux);
+        uploadStats.batchLimit = batchLimit;
+        portEXIT_CRITICAL(&uploadStatsMux);
+        // Vòng kế tiếp tự tính thời gian chờ (backoff, hạn gom lô hoặc log rỗng)
       }
+    }
 
-      // CHỈ RESET CỜ TƯƠNG ỨNG: Reset urgent nếu đã gửi urgent, reset normal nếu đã gửi normal
-      // QUAN TRỌNG: Kiểm tra lại trạng thái trước khi reset để tránh mất dữ liệu cảnh báo mới
-      if (xSemaphoreTake(uploadMutex, portMAX_DELAY)) {
-        if (wasUrgent && urgentUploadPending) {
-          // Chỉ reset nếu vẫn là urgent (có thể có urgent mới xuất hiện trong lúc upload)
-          urgentUploadPending = false;
-          Serial.println("[UPLOAD] Đã gửi dữ liệu cảnh báo, reset urgentUploadPending");
-        }
-        if (!wasUrgent && uploadPending && !urgentUploadPending) {
-          // Chỉ reset normal nếu không có urgent mới
-          uploadPending = false;
-          Serial.println("[UPLOAD] Đã gửi dữ liệu định kỳ, reset uploadPending");
-        }
-        // Nếu có urgent mới xuất hiện trong lúc upload normal, giữ nguyên urgentUploadPending
-        if (!wasUrgent && urgentUploadPending) {
-          Serial.println("[UPLOAD] Phát hiện cảnh báo mới trong lúc upload, sẽ xử lý ngay ở lần lặp tiếp theo");
-        }
-        xSemaphoreGive(uploadMutex);
+    if (waitMs > 0) uploadQueueWait(waitMs);
+  }
+}
+
+/**
+ * @brief Task gửi cảnh báo khẩn, tách khỏi uploadTask để không phải chờ lô thường đang gửi hay backoff.
+ *
+ * Ưu tiên ALERT_TASK_PRIORITY (cao hơn uploadTask cùng core 1), thức dậy bằng UPLOAD_NOTIFY_URGENT:
+ * - Rút hết queue URGENT, mỗi bản ghi một POST qua socket khẩn (4G) hoặc Wi-Fi; thất bại thì ghi thẳng
+ *   vào telemetry_log (kind URGENT) và flush để uploadTask gửi lại. Ghi log cũng lỗi thì giữ bản ghi và
+ *   thử lại (gửi rồi ghi log) ở lần thức sau, trước khi rút bản ghi mới, nên không mất cảnh báo. Bản ghi lấy seq
+ *   (tlogReserveSeq) trước lần gửi đầu và giữ seq đó khi vào log, nên nếu server đã lưu mà response
+ *   bị mất thì lần gửi lại chỉ là bản trùng bị bỏ, không thêm bản ghi hay tin Telegram.
+ * - Mỗi ALERT_TASK_MAINTAIN_MS kiểm tra socket khẩn: mở lại nếu đứt, heartbeat khi rảnh lâu.
+ */
+void alertTask(void* param) {
+  uploadQueueSetUrgentConsumer(xTaskGetCurrentTaskHandle());
+  Serial.println("[ALERT] Task khởi động...");
+
+  UploadMessage msg;
+  bool held = false;  // Bản ghi gửi lỗi và ghi log cũng lỗi: giữ lại, không rút bản ghi mới
+  while (true) {
+    uploadQueueWait(ALERT_TASK_MAINTAIN_MS);
+    if (!networkTaskCompleted) continue;  // Bản ghi khẩn vẫn nằm trong queue tới khi có mạng
+
+    while (held || uploadQueueTakeUrgent(msg)) {
+      Serial.println("[UPLOAD] Bắt đầu upload (URGENT - CẢNH BÁO)...");
+      // Cấp seq trước lần gửi đầu: gửi lại (socket khẩn hoặc qua log) sẽ được backend khử trùng
+      if (msg.rec.seq == 0) msg.rec.seq = tlogReserveSeq();
+      if (postRecords(&msg.rec, 1, false, true)) {
+        portENTER_CRITICAL(&uploadStatsMux);
+        uploadStats.records++;
+        portEXIT_CRITICAL(&uploadStatsMux);
+        held = false;
+      } else if (uploadQueueSaveUrgent(msg.rec)) {
+        // Không gửi được: đã ghi vào log, uploadTask gửi lại khi có mạng
+        Serial.println("[UPLOAD] Cảnh báo khẩn chưa gửi được, đã lưu vào hàng đợi flash");
+        held = false;
+      } else {
+        Serial.println("[UPLOAD] Cảnh báo khẩn chưa gửi được, ghi flash lỗi: giữ lại và thử lại");
+        held = true;
+        break;
       }
     }
 
-    delay(500);  // Check every 500ms
+    if (currentConnectionMode == CONNECTION_4G_FIRST) cellularAlertMaintain();
   }
 }
 
@@ -297,7 +439,8 @@ void firmwareCheckTask(void* param) {
  *
  * - Thiết lập Serial, watchdog, SPIFFS và GPIO.
  * - Khởi động cảm biến, SoftAP, web server.
- * - Tạo hai task nền: `networkTask` (khởi tạo kết nối) và `uploadTask`.
+ * - Tạo các task nền: `sensorTask` (lấy mẫu/cảnh báo), `networkTask` (khởi tạo kết nối), `uploadTask`
+ *   và `alertTask` (cảnh báo khẩn).
  */
 void setup() {
   Serial.begin(SERIAL_BAUD_RATE);
@@ -312,12 +455,11 @@ void setup() {
   Serial.println("MAC Address: " + WiFi.macAddress());
   Serial.println("ESP32 Battery Monitor - Fast Boot Starting...");
 
-  // Create upload mutex EARLY, before any task starts
-  uploadMutex = xSemaphoreCreateMutex();
-  if (uploadMutex == NULL) {
-    Serial.println("Failed to create upload mutex!");
+  // Create upload queue EARLY, before any task starts (queue bản ghi upload khẩn)
+  if (!uploadQueueBegin()) {
+    Serial.println("Failed to create upload queue!");
   } else {
-    Serial.println("Upload mutex created");
+    Serial.println("Upload queue created");
   }
 
   // Khởi tạo watchdog với timeout dài hơn
@@ -332,6 +474,8 @@ void setup() {
     Serial.println("SPIFFS mount failed");
   } else {
     Serial.println("SPIFFS đã khởi tạo");
+    // Hàng đợi store-and-forward: khôi phục bản ghi chưa gửi từ lần chạy trước
+    tlogBegin();
   }
 
   // GPIO setup
@@ -343,14 +487,21 @@ void setup() {
   // Bật LED báo đang boot
   if (LED_PIN >= 0) digitalWrite(LED_PIN, HIGH);
 
-  // Khởi tạo cảm biến nhiệt độ
-  tempSensor.begin();
+  // Khởi tạo các đầu dò DS18B20: dò bus một lần, đối chiếu ROM đã lưu trong NVS, chạy async
+  for (uint8_t i = 0; i < MAX_TEMP_PROBES; i++) probeTemps[i] = NAN;
+  tempProbesBegin();
 
   // Khởi tạo ADC cho MQ-135 & KY-026 (Analog)
   analogReadResolution(12);
   analogSetPinAttenuation(SMOKE_SENSOR_PIN, ADC_11db);
   analogSetPinAttenuation(FIRE_SENSOR_ANALOG_PIN, ADC_11db);
 
+  // Lấy mẫu liên tục MQ-135 & KY-026 ở task nền, loop chỉ rút block đã gom sẵn
+  adcSamplerBegin();
+
+  // Task lấy mẫu + đánh giá cảnh báo riêng ở core 0, ưu tiên cao hơn mọi task mạng
+  xTaskCreatePinnedToCore(sensorTask, "sensorTask", 6144, NULL, SENSOR_TASK_PRIORITY, NULL, SENSOR_TASK_CORE);
+
   // Start AP management ngay để user có thể truy cập web sớm
   startMainAP();
   startWebServer();
@@ -361,6 +512,12 @@ void setup() {
   // Bật task riêng cho phần upload để chạy song song
   xTaskCreatePinnedToCore(uploadTask, "uploadTask", 8192, NULL, 1, NULL, 1);
 
+  // Task riêng cho cảnh báo khẩn: giữ socket 4G khẩn và gửi ngay, không chờ uploadTask
+  xTaskCreatePinnedToCore(alertTask, "alertTask", 6144, NULL, ALERT_TASK_PRIORITY, NULL, 1);
+
+  // Task theo dõi modem: web UI và đường gửi đọc trạng thái 4G từ snapshot, không hỏi UART
+  cellularMonitorBegin();
+
   Serial.println("Fast Boot Path done (<5s) - Web interface ready!");
   Serial.println("Network initialization running in background...");
 }
@@ -380,12 +537,7 @@ void networkTask(void* param) {
   // Ưu tiên 4G
   if (cellularBegin()) {
     currentConnectionMode = CONNECTION_4G_FIRST;
-    // NỤ THÊM STABILIZATION DELAY SAU NETOPEN - KHÔNG CẦN RESET WATCHDOG
-    Serial.println("[CELL] Chờ modem ổn định 3 giây...");
-    for (int i = 0; i < 6; i++) {  // 6 x 500ms = 3 giây
-      delay(500);
-      // Watchdog disabled - không cần reset
-    }
+    // cellularBegin() chỉ trả true khi NETOPEN đã báo thành công: gửi ngay, không chờ "ổn định"
 
     connectionEstablished = true;
     Serial.println("4G connected (background)");
@@ -403,7 +555,10 @@ void networkTask(void* param) {
     // KHÔNG SYNC NTP - SERVER XỬ LÝ TIMESTAMP
     Serial.println("Network setup hoàn tất - bắt đầu gửi dữ liệu...");
 
-    readSensors();
+    // Không tự đọc cảm biến (tránh tranh chấp với sensorTask); chờ snapshot đầu tiên nếu chưa có
+    for (int i = 0; i < 40 && sensorSnapshot.version() == 0; i++) {
+      delay(50);
+    }
     uploadImmediate();
 
     // Không tự động kiểm tra firmware trên boot để tránh gây khó chịu sau khi update
@@ -429,7 +584,7 @@ void networkTask(void* param) {
 }
 
 /**
- * @brief Vòng lặp chính: bảo trì AP, đọc cảm biến, xử lý HTTP và kiểm tra upload.
+ * @brief Vòng lặp chính: bảo trì AP, xử lý HTTP và kiểm tra upload.
  */
 void loop() {
   // Reset watchdog timer để tránh crash - reset thường xuyên hơn
@@ -444,13 +599,7 @@ void loop() {
     lastEnsureAP = currentTime;
   }
 
-  // Đọc dữ liệu từ các cảm biến
-  if (currentTime - lastSensorRead >= SENSOR_INTERVAL) {
-    readSensors();
-    checkAlerts();
-    lastSensorRead = currentTime;
-    esp_task_wdt_reset(); // Reset after sensor operations
-  }
+  // Đọc cảm biến và cảnh báo đã chuyển sang sensorTask (core 0), loop chỉ phục vụ web/upload
 
   // Xử lý request HTTP
   server.handleClient();
@@ -477,7 +626,10 @@ void loop() {
 #if STARTUP_CHIME_ENABLED
   // Chạy chime khi đã hoàn tất network task và có yêu cầu
   if (networkTaskCompleted && startupChimeQueued && !startupChimeDone) {
-    if (currentTime >= startupChimeNextAt) {
+    if (fireFastPathLatched() || sensorSnapshot.read().alertActive) {
+      // Relay đang do ISR lửa/cảnh báo giữ: bỏ chime, không buzzerOff() chen vào thả relay
+      startupChimeDone = true;
+    } else if (currentTime >= startupChimeNextAt) {
       // Pattern theo yêu cầu:
       // - Có 4G: 1 beep (100ms)
       // - Không 4G: 2 beep, mỗi beep 100ms, cách nhau 500ms
@@ -519,130 +671,248 @@ void loop() {
 }
 
 /**
- * @brief Đọc toàn bộ cảm biến và cập nhật biến toàn cục.
+ * @brief Kênh DS18B20, chạy hai pha xen kẽ trên cùng một slot của scheduler.
  *
- * - DS18B20: lấy nhiệt độ theo °C.
- * - MQ-135: đọc nhiều mẫu, áp dụng median filter + moving average để giảm nhiễu.
- * - KY-026: đọc ADC 12-bit, chuyển về thang 10-bit (0..1023) cho backend.
+ * Pha start gửi Convert T rồi hẹn lại đúng lúc chuyển đổi xong; pha collect đọc mọi đầu dò và
+ * hẹn lượt kế tiếp sao cho tổng một vòng vẫn bằng TEMP_CHANNEL_PERIOD_MS. `temperature` giữ giá
+ * trị của cell nóng nhất để so ngưỡng; nếu mọi đầu dò đều lỗi thì trả về DEVICE_DISCONNECTED_C.
  */
-void readSensors() {
-  // Đọc nhiệt độ từ DS18B20
-  tempSensor.requestTemperatures();
-  temperature = tempSensor.getTempCByIndex(0);
-
-  // // Kiểm tra cảm biến nhiệt độ
-  // if (temperature == DEVICE_DISCONNECTED_C) {
-  //   Serial.println("Lỗi: Không tìm thấy cảm biến DS18B20!");
-  //   Serial.println("Kiểm tra kết nối: VCC->3.3V, GND->GND, Data->GPIO23");
-  //   Serial.println("Cần điện trở pull-up 4.7kΩ giữa Data và VCC");
-  // }
-
-  // Đọc giá trị cảm biến khí MQ-135 với filtering nâng cao
-  int rawSamples[MEDIAN_FILTER_SIZE];
-  int minSample = 4095;
-  int maxSample = 0;
-
-  // Lấy nhiều mẫu để median filter
-  for (int i = 0; i < MEDIAN_FILTER_SIZE; i++) {
-    int v = analogRead(SMOKE_SENSOR_PIN);
-    rawSamples[i] = v;
-    if (v < minSample) minSample = v;
-    if (v > maxSample) maxSample = v;
-    // Reduce delay and add watchdog reset every few samples
-    if (i % 5 == 0) {
-      esp_task_wdt_reset();
+static uint32_t tempChannel(void* ctx) {
+  if (!tempProbesConversionPending()) {
+    uint32_t waitMs = tempProbesStartConversion();
+    return waitMs < TEMP_CHANNEL_PERIOD_MS ? waitMs : TEMP_CHANNEL_PERIOD_MS;
+  }
+  if (!tempProbesCollect(probeTemps)) return 5;  // millis() chưa qua hết thời gian chờ, thử lại ngay sau
+
+  float hottest = DEVICE_DISCONNECTED_C;
+  int8_t hottestIdx = -1;
+  for (uint8_t i = 0; i < tempProbesCount(); i++) {
+    if (isnan(probeTemps[i])) continue;
+    if (hottestIdx < 0 || probeTemps[i] > hottest) {
+      hottest = probeTemps[i];
+      hottestIdx = i;
     }
-    delayMicroseconds(100); // Much shorter delay
   }
+  temperature = hottest;
+  hottestProbe = hottestIdx;
+
+  // Tốc độ tăng nhiệt: mỗi đầu dò một cửa sổ riêng, lấy đầu dò tăng nhanh nhất
+  float maxRate = NAN;
+  int8_t maxRateIdx = -1;
+  for (uint8_t i = 0; i < tempProbesCount(); i++) {
+    probeSlopes[i].push(probeTemps[i]);
+    if (!probeSlopes[i].ready()) continue;
+    float rate = probeSlopes[i].ratePerMinute(TEMP_CHANNEL_PERIOD_MS);
+    if (maxRateIdx < 0 || rate > maxRate) {
+      maxRate = rate;
+      maxRateIdx = i;
+    }
+  }
+  tempRiseRate = maxRate;
+  risingProbe = maxRateIdx;
 
-  // Áp dụng median filter để loại bỏ nhiễu
-  int medianValue = medianFilter(rawSamples, MEDIAN_FILTER_SIZE);
+  uint32_t waitMs = tempProbesStartConversion();
+  // Chuyển đổi lượt sau bắt đầu ngay nên lần collect kế tiếp hẹn sau một chu kỳ đầy đủ
+  return TEMP_CHANNEL_PERIOD_MS > waitMs ? TEMP_CHANNEL_PERIOD_MS : waitMs;
+}
 
-  // Áp dụng moving average để làm mượt
-  smokeValue = movingAverage(medianValue);
+/**
+ * @brief Kênh MQ-135: rút mọi block ADC_SAMPLES mẫu đã gom ở nền, mỗi block → median → Hampel →
+ * moving average (filters.h).
+ */
+static uint32_t smokeChannel(void* ctx) {
+  uint16_t block[ADC_SAMPLES];
+  int32_t blockSamples[ADC_SAMPLES];
+  while (adcSamplerReadBlock(ADC_CH_SMOKE, block, ADC_SAMPLES)) {
+    for (int i = 0; i < ADC_SAMPLES; i++) blockSamples[i] = block[i];
+    smokeValue = smokeFilter.push(medianOf<ADC_SAMPLES>(blockSamples));
+    smokePrimed = true;
+  }
+  if (!smokePrimed) {
+    // Bộ lấy mẫu chưa đủ block đầu tiên (ngay sau boot): đọc trực tiếp một mẫu
+    smokeValue = analogRead(SMOKE_SENSOR_PIN);
+  }
 
   // Không dùng smokeConnected; chỉ lưu giá trị đo
   lastSmokeValue = smokeValue;
 
-  // Đọc cảm biến lửa KY-026 qua Analog
-  int fireSamples[5];
-  for (int i = 0; i < 5; i++) {
-    fireSamples[i] = analogRead(FIRE_SENSOR_ANALOG_PIN);
-    if (i % 2 == 0) { esp_task_wdt_reset(); }
-    delayMicroseconds(100);
+  // Xu hướng khí lấy theo nhịp kênh (đều SMOKE_CHANNEL_PERIOD_MS), không theo từng block
+  smokeSlope.push((float)smokeValue);
+  smokeRiseRate = smokeSlope.ready() ? smokeSlope.ratePerMinute(SMOKE_CHANNEL_PERIOD_MS) : NAN;
+  return 0;
+}
+
+/**
+ * @brief Kênh KY-026: block ngắn FIRE_BLOCK_SAMPLES mẫu → median → median trượt, chuyển 12-bit
+ * về thang 10-bit (0..1023) cho backend. Chu kỳ ngắn nhất để ngọn lửa được thấy sớm nhất.
+ */
+static uint32_t fireChannel(void* ctx) {
+  uint16_t block[FIRE_BLOCK_SAMPLES];
+  int32_t blockSamples[FIRE_BLOCK_SAMPLES];
+  while (adcSamplerReadBlock(ADC_CH_FIRE, block, FIRE_BLOCK_SAMPLES)) {
+    for (int i = 0; i < FIRE_BLOCK_SAMPLES; i++) blockSamples[i] = block[i];
+    int32_t fireMedian = fireFilter.push(medianOf<FIRE_BLOCK_SAMPLES>(blockSamples));
+    fireValue10 = fireMedian >> 2; // chuyển 12-bit → 10-bit (0..1023)
+    firePrimed = true;
+  }
+  if (!firePrimed) {
+    fireValue10 = analogRead(FIRE_SENSOR_ANALOG_PIN) >> 2;
+  }
+  return 0;
+}
+
+/**
+ * @brief Kênh đánh giá cảnh báo; checkAlerts() tự publish snapshot trước khi lên lịch upload.
+ */
+static int alertChannelId = -1;
+
+static uint32_t alertChannel(void* ctx) {
+  checkAlerts();
+  return 0;
+}
+
+/**
+ * @brief Đăng ký các kênh cảm biến với scheduler, mỗi kênh chu kỳ/ngân sách riêng (config.h).
+ *
+ * Kênh nhanh đăng ký trước để khi nhiều kênh cùng hạn thì lửa được xử lý trước nhiệt độ.
+ */
+void registerSensorChannels() {
+  sensorSchedulerRegister("ky026", FIRE_CHANNEL_PERIOD_MS, FIRE_CHANNEL_BUDGET_US, fireChannel, NULL);
+  sensorSchedulerRegister("mq135", SMOKE_CHANNEL_PERIOD_MS, SMOKE_CHANNEL_BUDGET_US, smokeChannel, NULL);
+  sensorSchedulerRegister("ds18b20", TEMP_CHANNEL_PERIOD_MS, TEMP_CHANNEL_BUDGET_US, tempChannel, NULL);
+  alertChannelId = sensorSchedulerRegister("alerts", ALERT_CHANNEL_PERIOD_MS, ALERT_CHANNEL_BUDGET_US, alertChannel, NULL);
+}
+
+/**
+ * @brief Task lấy mẫu cảm biến ưu tiên cao, chạy riêng ở core SENSOR_TASK_CORE.
+ *
+ * Không còn nhịp cố định: mỗi vòng chạy các kênh đã tới hạn rồi ngủ đúng tới hạn gần nhất.
+ * Giấc ngủ là chờ task notification nên ISR báo cháy (fire_fastpath) đánh thức task ngay và kênh
+ * "alerts" được chạy tức thì thay vì chờ tới chu kỳ kế tiếp.
+ * Kết quả được publish qua sensorSnapshot để các task khác đọc mà không bao giờ chặn task này.
+ */
+void sensorTask(void* param) {
+  registerSensorChannels();
+  fireFastPathSetRelayActiveLow(relayActiveLowRuntime);
+  fireFastPathBegin(xTaskGetCurrentTaskHandle());
+  while (true) {
+    uint32_t waitMs = sensorSchedulerRunDue();
+    TickType_t ticks = pdMS_TO_TICKS(waitMs) ? pdMS_TO_TICKS(waitMs) : 1;
+    if (ulTaskNotifyTake(pdTRUE, ticks) > 0) {
+      sensorSchedulerTrigger(alertChannelId);
+    }
   }
-  int fireMedian = medianFilter(fireSamples, 5);
-  int fireMedian10 = fireMedian >> 2; // chuyển 12-bit → 10-bit (0..1023)
-  fireValue10 = fireMedian10;
 }
 
 /**
- * @brief Xác định trạng thái cảnh báo dựa trên các ngưỡng cấu hình.
+ * @brief Chụp toàn bộ số liệu hiện tại của sensorTask và phát hành qua seqlock.
+ */
+void publishSensorSnapshot() {
+  SensorSnapshot snap;
+  snap.sampledAtMs = millis();
+  snap.temperature = temperature;
+  snap.tempRiseRate = tempRiseRate;
+  snap.probeCount = tempProbesCount();
+  for (uint8_t i = 0; i < MAX_TEMP_PROBES; i++) snap.probeTemps[i] = probeTemps[i];
+  snap.smokeValue = smokeValue;
+  snap.fireValue10 = fireValue10;
+  snap.riskScore = riskState.score;
+  snap.riskLevel = riskState.level;
+  snap.tempAlert = tempAlertFlag;
+  snap.tempRiseAlert = tempRiseAlertFlag;
+  snap.smokeAlert = smokeAlertFlag;
+  snap.fireAlert = fireAlertFlag;
+  snap.alertActive = alertActive;
+  sensorSnapshot.publish(snap);
+}
+
+/**
+ * @brief In một dòng log cảnh báo dạng "CANH BAO (...): TEMP|SMOKE risk=.. (...)" không dùng String.
+ */
+static void logAlert(const char* tag, uint16_t reasons) {
+  Serial.print(tag);
+  alertReasonPrint(reasons);
+  Serial.printf(" | T=%.1f°C (probe #%d) dT=%.2f°C/phut MQ=%d KY=%d risk=%u (%s)\n",
+                temperature, hottestProbe, isnan(tempRiseRate) ? 0.0f : tempRiseRate, smokeValue, fireValue10,
+                riskState.score, riskLevelName(riskState.level));
+}
+
+/**
+ * @brief Xác định trạng thái cảnh báo qua máy trạng thái alert_fsm (hysteresis + debounce).
  *
- * Khi bất kỳ mô-đun nào vượt ngưỡng, bật còi/LED và lên lịch upload gấp.
- * Đồng thời lưu lại cờ alert để gửi về backend.
- * Gửi lại cảnh báo định kỳ (mỗi 30 giây) khi cảnh báo vẫn còn active để đảm bảo backend nhận được dữ liệu.
+ * Mỗi kênh bật/tắt theo bảng trong alert_fsm.cpp nên giá trị dao động quanh ngưỡng không còn làm
+ * relay bật/tắt liên tục. Upload:
+ * - Sự kiện mới (cảnh báo bắt đầu, thêm kênh mới, mức rủi ro leo thang) → gửi ngay.
+ * - Cảnh báo vẫn còn → gửi lại mỗi ALERT_REPEAT_INTERVAL_MS.
+ * - Kênh bật lại trong cửa sổ gộp chỉ giữ còi, không sinh thêm upload khẩn.
+ * Không cấp phát heap: lý do cảnh báo là bitmask AlertReason.
  */
 void checkAlerts() {
   static unsigned long lastAlertUpload = 0; // Thời gian gửi cảnh báo cuối cùng
-  const unsigned long ALERT_REPEAT_INTERVAL = 30000; // Gửi lại cảnh báo mỗi 30 giây
-  
-  bool tempAlert = (temperature > TEMP_THRESHOLD);
-  bool smokeAlert = (smokeValue > SMOKE_THRESHOLD);
-  bool fireAlert = (fireValue10 < FIRE_ANALOG_THRESHOLD); // KY-026: giá trị thấp hơn = gần lửa
+  static RiskLevel lastUploadedLevel = RISK_NORMAL;
+
+  // KY-026: giá trị analog thấp hơn = gần lửa; DO đã kích relay từ ISR thì coi như đang cháy
+  bool fireDigital = fireFastPathActive();  // Luôn gọi để xác nhận cạnh và đo độ trễ pipeline
 
-  int activeModules = 0;
-  if (tempAlert) activeModules++;
-  if (smokeAlert) activeModules++;
-  if (fireAlert) activeModules++;
+  // Điểm rủi ro gộp mọi kênh; ngưỡng MQ-135 thực tế hạ xuống khi pin nóng
+  RiskInputs riskIn = { temperature, tempRiseRate, smokeValue, smokeRiseRate, fireValue10, fireDigital,
+                        riskState.level };
+  riskState = riskEvaluate(riskIn);
 
-  // Bỏ SENSITIVITY: chỉ cần 1 mô-đun cảnh báo là báo
-  bool shouldAlert = (activeModules >= 1);
+  unsigned long now = millis();
+  float values[ALERT_CH_COUNT];
+  float thresholds[ALERT_CH_COUNT];
+  values[ALERT_CH_TEMP] = (temperature == DEVICE_DISCONNECTED_C) ? NAN : temperature;
+  thresholds[ALERT_CH_TEMP] = TEMP_THRESHOLD;
+  values[ALERT_CH_TEMP_RISE] = tempRiseRate;
+  thresholds[ALERT_CH_TEMP_RISE] = TEMP_RISE_LIMIT_C_PER_MIN;
+  values[ALERT_CH_SMOKE] = smokeValue;
+  thresholds[ALERT_CH_SMOKE] = riskState.smokeThreshold;
+  values[ALERT_CH_FIRE] = fireDigital ? 0.0f : (float)fireValue10;
+  thresholds[ALERT_CH_FIRE] = FIRE_ANALOG_THRESHOLD;
+  values[ALERT_CH_RISK] = (float)riskState.level;
+  thresholds[ALERT_CH_RISK] = (float)RISK_WARNING - 0.5f;  // Bật từ WARNING, tắt khi về NORMAL
+  AlertFsmResult fsm = alertFsmEvaluate(values, thresholds, now);
 
   // Lưu cờ cho upload/backend
-  tempAlertFlag = tempAlert;
-  smokeAlertFlag = smokeAlert;
-  fireAlertFlag = fireAlert;
+  tempAlertFlag = fsm.activeMask & ALERT_REASON_TEMP;
+  tempRiseAlertFlag = fsm.activeMask & ALERT_REASON_TEMP_RISE;
+  smokeAlertFlag = fsm.activeMask & ALERT_REASON_SMOKE;
+  fireAlertFlag = fsm.activeMask & ALERT_REASON_FIRE;
 
-  String alertReason = "";
-  if (shouldAlert) {
-    // Liệt kê các mô-đun đang cảnh báo (không dùng sensitivity)
-    if (tempAlert) {
-      alertReason += "NHIET DO CAO (" + String(temperature, 1) + "°C)";
-    }
-    if (smokeAlert) {
-      if (alertReason.length()) alertReason += " | ";
-      alertReason += "KHI DOC HAI (" + String(smokeValue) + ")";
-    }
-    if (fireAlert) {
-      if (alertReason.length()) alertReason += " | ";
-      alertReason += "LUA (KY-026)";
-    }
-  }
+  uint16_t reasons = fsm.activeMask;
+  if (riskState.crossHotGas) reasons |= ALERT_REASON_HOT_GAS;
+  bool shouldAlert = fsm.activeMask != 0;
 
   // Kích hoạt/tắt cảnh báo và đảm bảo trạng thái còi/LED theo thời gian thực
   if (shouldAlert) {
-    unsigned long now = millis();
     bool shouldUploadAlert = false;
     
     if (!alertActive) {
       // Cảnh báo mới xuất hiện - gửi ngay lập tức
       alertActive = true;
-      Serial.println("CANH BAO: " + alertReason);
-      shouldUploadAlert = true;
       lastAlertUpload = now;
-    } else {
+      logAlert("CANH BAO: ", reasons);
+      shouldUploadAlert = fsm.raisedMask != 0;  // Bật lại trong cửa sổ gộp: chỉ còi, không upload
+    } else if (fsm.raisedMask != 0 || riskState.level > lastUploadedLevel) {
+      // Thêm kênh mới hoặc mức rủi ro leo thang - gửi ngay, không chờ chu kỳ lặp
+      logAlert("CANH BAO (leo thang): ", reasons);
+      shouldUploadAlert = true;
+    } else if (now - lastAlertUpload >= ALERT_REPEAT_INTERVAL_MS) {
       // Cảnh báo vẫn còn active - gửi lại định kỳ để đảm bảo backend nhận được
-      if (now - lastAlertUpload >= ALERT_REPEAT_INTERVAL) {
-        Serial.println("CANH BAO (lap lai): " + alertReason);
-        shouldUploadAlert = true;
-        lastAlertUpload = now;
-      }
+      logAlert("CANH BAO (lap lai): ", reasons);
+      shouldUploadAlert = true;
     }
     
-    // Gửi dữ liệu cảnh báo nếu cần
+    // Phát hành snapshot trước để payload cảnh báo mang đúng cờ vừa tính
+    publishSensorSnapshot();
+
+    // Gửi dữ liệu cảnh báo nếu cần: chỉ CRITICAL mới chiếm đường upload khẩn
     if (shouldUploadAlert) {
-      uploadImmediateCritical();
+      lastAlertUpload = now;
+      lastUploadedLevel = riskState.level;
+      if (riskState.level >= RISK_CRITICAL) uploadImmediateCritical();
+      else uploadImmediate();
     }
     
     // Đảm bảo bật còi/LED khi đang trong trạng thái cảnh báo
@@ -651,9 +921,10 @@ void checkAlerts() {
   } else {
     if (alertActive) {
       alertActive = false;
-      lastAlertUpload = 0; // Reset timer khi hết cảnh báo
+      lastUploadedLevel = RISK_NORMAL;
       Serial.println("Tinh trang binh thuong");
     }
+    publishSensorSnapshot();
     // Đảm bảo tắt còi/LED khi hết cảnh báo
     if (LED_PIN >= 0) digitalWrite(LED_PIN, LOW);
     if (buzzerIsOn) buzzerOff();
@@ -673,15 +944,19 @@ void activateAlerts() {
   // In thông báo chi tiết theo thứ tự ưu tiên
   Serial.println("=== CHI TIẾT CẢNH BÁO ===");
 
-  if (temperature > TEMP_THRESHOLD) {
-    Serial.println("NHIET DO CAO: " + String(temperature, 1) + "°C (Nguy hiểm!)");
+  SensorSnapshot snap = sensorSnapshot.read();
+  if (snap.temperature > TEMP_THRESHOLD) {
+    Serial.println("NHIET DO CAO: " + String(snap.temperature, 1) + "°C (Nguy hiểm!)");
+  }
+  if (snap.tempRiseAlert) {
+    Serial.println("NHIET DO TANG NHANH: " + String(snap.tempRiseRate, 2) + "°C/phut (Nguy cơ thermal runaway!)");
   }
 
-  if (smokeValue > SMOKE_THRESHOLD) {
-    Serial.println("KHI DOC HAI: " + String(smokeValue) + " (Pin có thể xì khí)");
+  if (snap.smokeAlert) {
+    Serial.println("KHI DOC HAI: " + String(snap.smokeValue) + " (Pin có thể xì khí)");
   }
-  if (fireValue10 < FIRE_ANALOG_THRESHOLD) {
-    Serial.println("LUA (KY-026): " + String(fireValue10) + " (< ngưỡng " + String(FIRE_ANALOG_THRESHOLD) + ")");
+  if (snap.fireValue10 < FIRE_ANALOG_THRESHOLD) {
+    Serial.println("LUA (KY-026): " + String(snap.fireValue10) + " (< ngưỡng " + String(FIRE_ANALOG_THRESHOLD) + ")");
   }
 
   Serial.println("=========================");
@@ -815,6 +1090,25 @@ void startWebServer() {
     String res = String("{\"pin\":") + pin + ",\"level\":" + lv + "}";
     server.send(200, "application/json", res);
   });
+  // Bật/tắt cache DNS của đường 4G để so sánh thời gian tới byte đầu: /api/dns-cache?enable=0
+  server.on("/api/dns-cache", HTTP_GET, [](){
+    if (server.hasArg("enable")) dnsCacheSetEnabled(server.arg("enable").toInt() != 0);
+    String res = String("{\"enabled\":") + (dnsCacheEnabled() ? "true" : "false") + "}";
+    server.send(200, "application/json", res);
+  });
+  // Chọn đường chở HTTP 4G để so sánh độ trễ: /api/cell-transport?modem=1 (TLS/HTTP trên modem)
+  server.on("/api/cell-transport", HTTP_GET, [](){
+    if (server.hasArg("modem")) cellularSetHttpTransport(server.arg("modem").toInt() != 0);
+    String res = String("{\"transport\":\"") + cellularHttpTransportName() + "\"}";
+    server.send(200, "application/json", res);
+  });
+  // Đo thông lượng 4G (kết quả trong /api/status, cell_bench_*): /api/cell-bench?kb=256
+  server.on("/api/cell-bench", HTTP_GET, [](){
+    uint32_t kb = server.hasArg("kb") ? (uint32_t)server.arg("kb").toInt() : 256;
+    bool started = cellularBenchmarkStart(kb * 1024);
+    String res = String("{\"started\":") + (started ? "true" : "false") + "}";
+    server.send(started ? 202 : 409, "application/json", res);
+  });
   // Common browser requests
   server.on("/favicon.ico", HTTP_GET, [](){ server.send(204); });
   server.on("/apple-touch-icon.png", HTTP_GET, [](){ server.send(204); });
@@ -917,11 +1211,12 @@ String renderHtml() {
   }
   html += "</div>";
 
+  SensorSnapshot snap = sensorSnapshot.read();
   html += "<div class='grid'>";
-  html += "<div class='card'><h3>Nhiệt Độ</h3><div>" + String(temperature, 1) + " °C</div></div>";
-  html += "<div class='card'><h3>Chất Lượng Không Khí (MQ-135)</h3><div>" + String(smokeValue) + "</div></div>";
-  html += "<div class='card'><h3>Lửa (KY-026)</h3><div>" + String(fireValue10) + "</div></div>";
-  html += String("<div class='card'><h3>Cảnh Báo</h3><div class='") + (alertActive ? "warn'>CẢNH BÁO" : "ok'>Bình thường") + "</div></div>";
+  html += "<div class='card'><h3>Nhiệt Độ</h3><div>" + String(snap.temperature, 1) + " °C</div></div>";
+  html += "<div class='card'><h3>Chất Lượng Không Khí (MQ-135)</h3><div>" + String(snap.smokeValue) + "</div></div>";
+  html += "<div class='card'><h3>Lửa (KY-026)</h3><div>" + String(snap.fireValue10) + "</div></div>";
+  html += String("<div class='card'><h3>Cảnh Báo</h3><div class='") + (snap.alertActive ? "warn'>CẢNH BÁO" : "ok'>Bình thường") + "</div></div>";
   html += "</div>";
 
   // Admin actions (ẩn WiFi Setup khỏi trang chính)
@@ -987,35 +1282,361 @@ void handleApiStatus() {
   String json;
   {
     JsonDocument doc;
+    SensorSnapshot snap = sensorSnapshot.read();
     // Không gửi timestamp trong API status, chỉ gửi dữ liệu cảm biến
     // doc["timestamp"] = getCurrentTimestamp();
-    doc["temperature"] = temperature;
-    doc["smoke_value"] = smokeValue;
+    doc["temperature"] = snap.temperature;
+    JsonArray probes = doc["probe_temps"].to<JsonArray>();
+    JsonArray roms = doc["probe_roms"].to<JsonArray>();
+    for (uint8_t i = 0; i < snap.probeCount; i++) {
+      if (isnan(snap.probeTemps[i])) probes.add<JsonVariant>();
+      else probes.add(snap.probeTemps[i]);
+      char rom[17];
+      tempProbesRomString(i, rom, sizeof(rom));
+      roms.add(String(rom));
+    }
+    doc["smoke_value"] = snap.smokeValue;
     // MQ-135: không có preheat gating, bỏ trường cũ
-    doc["fire_value"] = fireValue10; // KY-026 10-bit
+    doc["fire_value"] = snap.fireValue10; // KY-026 10-bit
     // Debug states
-    doc["temp_alert"] = tempAlertFlag;
-    doc["smoke_alert"] = smokeAlertFlag;
-    doc["fire_alert"] = fireAlertFlag;
+    doc["temp_alert"] = snap.tempAlert;
+    doc["temp_rise_alert"] = snap.tempRiseAlert;
+    if (isnan(snap.tempRiseRate)) doc["temp_rise_rate"] = nullptr;
+    else doc["temp_rise_rate"] = snap.tempRiseRate;
+    doc["smoke_alert"] = snap.smokeAlert;
+    doc["fire_alert"] = snap.fireAlert;
+    doc["alert_active"] = snap.alertActive;
+    doc["risk_score"] = snap.riskScore;
+    doc["risk_level"] = riskLevelName((RiskLevel)snap.riskLevel);
+    doc["snapshot_version"] = sensorSnapshot.version();
+    doc["snapshot_age_ms"] = millis() - snap.sampledAtMs;
     doc["buzzer_is_on"] = buzzerIsOn;
     doc["relay_pin"] = RELAY_PIN;
     doc["relay_active_low_runtime"] = relayActiveLowRuntime;
     doc["relay_level"] = (int)digitalRead(RELAY_PIN);
+    // Bộ lấy mẫu ADC nền: samples/uptime cho biết tần số thực tế
+    AdcSamplerStats adcStats = adcSamplerGetStats();
+    doc["adc_samples"] = adcStats.samples;
+    doc["adc_overruns"] = adcStats.overruns;
+    doc["adc_late_ticks"] = adcStats.lateTicks;
+    // Đường báo cháy nhanh: độ trễ ISR → relay và ISR → pipeline cảnh báo
+    FireFastPathStats fireStats = fireFastPathGetStats();
+    doc["fire_do_active"] = fireStats.inputActive;
+    doc["fire_isr_events"] = fireStats.events;
+    doc["fire_relay_latency_us"] = fireStats.lastRelayUs;
+    doc["fire_relay_latency_max_us"] = fireStats.maxRelayUs;
+    doc["fire_pipeline_latency_us"] = fireStats.lastPipelineUs;
+    doc["fire_pipeline_latency_max_us"] = fireStats.maxPipelineUs;
+    // Hàng đợi store-and-forward trên flash
+    TelemetryLogStats logStats = tlogGetStats();
+    doc["upload_queue_depth"] = logStats.depth;
+    doc["upload_queue_segments"] = logStats.segments;
+    doc["upload_queue_appended"] = logStats.appended;
+    doc["upload_queue_drained"] = logStats.drained;
+    doc["upload_queue_dropped"] = logStats.dropped;
+    doc["upload_queue_crc_errors"] = logStats.crcErrors;
+    doc["upload_queue_stale_acks"] = logStats.staleAcks;
+    doc["upload_drain_rate_per_min"] = logStats.drainRatePerMin;
+    // Chi phí upload: ngoại suy theo ngày từ thời gian chạy để so sánh gửi lẻ và gửi lô
+    float uptimeDays = millis() / 86400000.0f;
+    portENTER_CRITICAL(&uploadStatsMux);
+    UploadStats up = uploadStats;
+    portEXIT_CRITICAL(&uploadStatsMux);
+    doc["upload_requests"] = up.requests;
+    doc["upload_failures"] = up.failures;
+    doc["upload_bytes"] = up.bytes;
+    doc["upload_records"] = up.records;
+    doc["upload_requests_per_day"] = uptimeDays > 0 ? up.requests / uptimeDays : 0;
+    doc["upload_bytes_per_day"] = uptimeDays > 0 ? up.bytes / uptimeDays : 0;
+    doc["upload_batch_last"] = up.lastBatchSize;
+    doc["upload_batch_limit"] = up.batchLimit;
+    // Đường ống upload hai mức: độ trễ từ lúc cảnh báo vào queue tới lúc bắt đầu gửi
+    UploadQueueStats queueStats = uploadQueueGetStats();
+    doc["upload_urgent_queue_depth"] = queueStats.urgentDepth;
+    doc["upload_urgent_posted"] = queueStats.urgentPosted;
+    doc["upload_urgent_spilled"] = queueStats.urgentSpilled;
+    doc["upload_normal_queue_depth"] = queueStats.normalDepth;
+    doc["upload_normal_posted"] = queueStats.normalPosted;
+    doc["upload_normal_dropped"] = queueStats.normalDropped;
+    doc["upload_alert_direct"] = queueStats.alertDirect;
+    doc["upload_alert_lost"] = queueStats.alertLost;
+    doc["upload_urgent_latency_us"] = queueStats.urgentLatency.lastUs;
+    doc["upload_urgent_latency_max_us"] = queueStats.urgentLatency.maxUs;
+    doc["upload_urgent_latency_avg_us"] = queueStats.urgentLatency.avgUs;
+    doc["upload_flush_latency_us"] = queueStats.flushLatency.lastUs;
+    doc["upload_flush_latency_max_us"] = queueStats.flushLatency.maxUs;
+    doc["upload_flush_latency_avg_us"] = queueStats.flushLatency.avgUs;
+    // OTA tải tiếp được: checkpoint đang chờ (tải tiếp ở lần OTA sau cùng phiên bản)
+    OtaResumeStats otaStats = otaResumeGetStats();
+    doc["ota_resume_pending"] = otaStats.pending;
+    doc["ota_resume_offset"] = otaStats.offset;
+    doc["ota_resume_total"] = otaStats.total;
+    doc["ota_resume_from"] = otaStats.resumedFrom;
+    doc["ota_resume_chunks"] = otaStats.chunks;
+    doc["ota_resume_rewinds"] = otaStats.rewinds;
+    // Lượt OTA gần nhất: so sánh bản build OTA_PIPELINE 1 (đọc/ghi chồng nhau) với 0 (tuần tự)
+    OtaPipelineStats otaPipe = otaPipelineGetStats();
+    doc["ota_pipelined"] = otaPipe.pipelined;
+    doc["ota_transfer_running"] = otaPipe.running;
+    doc["ota_transfer_ms"] = otaPipe.transferMs;
+    doc["ota_transfer_bytes"] = otaPipe.bytes;
+    doc["ota_transfer_bytes_per_s"] = otaPipe.bytesPerSec;
+    doc["ota_flash_ms"] = otaPipe.flashMs;
+    doc["ota_flash_writes"] = otaPipe.flashWrites;
+    doc["ota_flash_stall_ms"] = otaPipe.stallMs;
+    // Phiên HTTP keep-alive qua 4G: tỉ lệ dùng lại socket và độ trễ mỗi request
+    CellularStatus cellStatus = cellularGetStatus();
+    doc["cell_csq"] = cellStatus.csq;
+    doc["cell_registered"] = cellStatus.registered;
+    doc["cell_reg_status"] = cellStatus.regStatus;
+    doc["cell_pdp_active"] = cellStatus.pdpActive;
+    doc["cell_access_tech"] = cellStatus.accessTech;
+    doc["cell_ip"] = cellStatus.ip;
+    doc["cell_status_age_ms"] = cellStatus.valid ? millis() - cellStatus.sampledAtMs : 0;
+    doc["cell_monitor_sample_ms"] = cellStatus.sampleMs;
+    doc["cell_monitor_failures"] = cellStatus.sampleFailures;
+    CellularBootTiming bootTiming = cellularGetBootTiming();
+    doc["cell_boot_at_ms"] = bootTiming.atMs;
+    doc["cell_boot_init_ms"] = bootTiming.initMs;
+    doc["cell_boot_sim_ms"] = bootTiming.simMs;
+    doc["cell_boot_register_ms"] = bootTiming.registerMs;
+    doc["cell_boot_data_ms"] = bootTiming.dataMs;
+    doc["cell_boot_total_ms"] = bootTiming.totalMs;
+    doc["cell_boot_first_send_ms"] = bootTiming.firstSendMs;
+    doc["cell_boot_powered_on"] = bootTiming.poweredOn;
+    doc["cell_boot_restarted"] = bootTiming.restarted;
+    doc["cell_boot_pin_scan"] = bootTiming.pinScan;
+    doc["cell_boot_warm_data"] = bootTiming.warmData;
+    // UART tới modem: baud thương lượng (AT+IPR), RTS/CTS, lỗi nhận
+    CellularUartStats uartStats = cellularUartGetStats();
+    doc["cell_uart_baud"] = uartStats.baud;
+    doc["cell_uart_baud_ceiling"] = uartStats.baudCeiling;
+    doc["cell_uart_flow_control"] = uartStats.flowControl;
+    doc["cell_uart_overruns"] = uartStats.overruns;
+    doc["cell_uart_frame_errors"] = uartStats.frameErrors;
+    doc["cell_uart_downgrades"] = uartStats.downgrades;
+    doc["cell_uart_negotiate_failures"] = uartStats.negotiateFailures;
+    CellularSessionStats cellStats = cellularSessionGetStats();
+    doc["cell_http_session_open"] = cellStats.open;
+    doc["cell_http_requests"] = cellStats.requests;
+    doc["cell_http_sockets_opened"] = cellStats.opened;
+    doc["cell_http_sockets_reused"] = cellStats.reused;
+    doc["cell_http_stale_recovered"] = cellStats.staleRecovered;
+    doc["cell_http_closed_by_peer"] = cellStats.closedByPeer;
+    doc["cell_http_idle_closed"] = cellStats.idleClosed;
+    doc["cell_http_latency_ms"] = cellStats.lastLatencyMs;
+    doc["cell_http_latency_max_ms"] = cellStats.maxLatencyMs;
+    doc["cell_http_bytes_sent"] = cellStats.bytesSent;
+    doc["cell_http_bytes_received"] = cellStats.bytesReceived;
+    doc["cell_upload_bytes_per_s"] = cellStats.lastUploadBytesPerSec;
+    doc["cell_ota_bytes_per_s"] = cellStats.lastOtaBytesPerSec;
+    doc["cell_http_attempts"] = cellStats.attempts;
+    doc["cell_http_retries"] = cellStats.retries;
+    doc["cell_http_deadline_expired"] = cellStats.deadlineExpired;
+    doc["cell_http_preempted"] = cellStats.preempted;
+    doc["cell_breaker_open"] = cellStats.breakerOpen;
+    doc["cell_breaker_trips"] = cellStats.breakerTrips;
+    doc["cell_breaker_rejected"] = cellStats.breakerRejected;
+    doc["cell_ttfb_ms"] = cellStats.lastTtfbMs;
+    doc["cell_ttfb_dns_cache_avg_ms"] = cellStats.ttfbDnsCacheAvgMs;
+    doc["cell_ttfb_dns_cache_count"] = cellStats.ttfbDnsCacheCount;
+    doc["cell_ttfb_dns_live_avg_ms"] = cellStats.ttfbDnsLiveAvgMs;
+    doc["cell_ttfb_dns_live_count"] = cellStats.ttfbDnsLiveCount;
+    DnsCacheStats dnsStats = dnsCacheGetStats();
+    doc["dns_cache_enabled"] = dnsStats.enabled;
+    doc["dns_cache_hits"] = dnsStats.hits;
+    doc["dns_cache_misses"] = dnsStats.misses;
+    doc["dns_cache_resolves"] = dnsStats.resolves;
+    doc["dns_cache_resolve_failures"] = dnsStats.resolveFailures;
+    doc["dns_cache_refreshes"] = dnsStats.refreshes;
+    doc["dns_cache_connect_failures"] = dnsStats.connectFailures;
+    // HTTP(S) trên stack của modem (+CHTTPS*): phiên giữ qua nhiều request
+    doc["cell_http_transport"] = cellularHttpTransportName();
+    ModemHttpStats mhStats = modemHttpGetStats();
+    doc["modem_http_requests"] = mhStats.requests;
+    doc["modem_http_sessions_opened"] = mhStats.sessionsOpened;
+    doc["modem_http_sessions_reused"] = mhStats.sessionsReused;
+    doc["modem_http_peer_closed"] = mhStats.peerClosed;
+    doc["modem_http_stale_recovered"] = mhStats.staleRecovered;
+    doc["modem_http_errors"] = mhStats.errors;
+    doc["modem_http_bytes_sent"] = mhStats.bytesSent;
+    doc["modem_http_bytes_received"] = mhStats.bytesReceived;
+    // PPPoS (CELL_DATA_MODE_PPP) và lượt đo thông lượng gần nhất
+    doc["cell_data_mode"] = CELL_DATA_MODE == CELL_DATA_MODE_PPP ? "ppp" : "at";
+    CellPppStats pppStats = cellPppGetStats();
+    doc["cell_ppp_up"] = pppStats.up;
+    doc["cell_ppp_connects"] = pppStats.connects;
+    doc["cell_ppp_drops"] = pppStats.drops;
+    doc["cell_ppp_connect_ms"] = pppStats.lastConnectMs;
+    doc["cell_ppp_rx_bytes"] = pppStats.rxBytes;
+    doc["cell_ppp_tx_bytes"] = pppStats.txBytes;
+    CellularBenchResult bench = cellularBenchmarkGet();
+    doc["cell_bench_running"] = bench.running;
+    if (bench.done) {
+      doc["cell_bench_data_mode"] = bench.dataMode;
+      doc["cell_bench_transport"] = bench.transport;
+      doc["cell_bench_download_bytes"] = bench.downloadBytes;
+      doc["cell_bench_download_ms"] = bench.downloadMs;
+      doc["cell_bench_download_kbps"] = bench.downloadKbps;
+      doc["cell_bench_download_status"] = bench.downloadStatus;
+      doc["cell_bench_upload_bytes"] = bench.uploadBytes;
+      doc["cell_bench_upload_ms"] = bench.uploadMs;
+      doc["cell_bench_upload_kbps"] = bench.uploadKbps;
+      doc["cell_bench_upload_status"] = bench.uploadStatus;
+    }
+    // Socket khẩn mux CELL_ALERT_MUX: giữ sẵn bằng heartbeat, độ trễ POST cảnh báo
+    CellularAlertStats alertLinkStats = cellularAlertGetStats();
+    doc["cell_alert_open"] = alertLinkStats.open;
+    doc["cell_alert_posts"] = alertLinkStats.posts;
+    doc["cell_alert_failures"] = alertLinkStats.failures;
+    doc["cell_alert_connects"] = alertLinkStats.connects;
+    doc["cell_alert_stale_recovered"] = alertLinkStats.staleRecovered;
+    doc["cell_alert_heartbeats"] = alertLinkStats.heartbeats;
+    doc["cell_alert_heartbeat_failures"] = alertLinkStats.heartbeatFailures;
+    doc["cell_alert_latency_ms"] = alertLinkStats.lastLatencyMs;
+    doc["cell_alert_latency_max_ms"] = alertLinkStats.maxLatencyMs;
+    AtEngineStats atStats = atEngineGetStats();
+    doc["at_rx_bytes"] = atStats.rxBytes;
+    doc["at_lines"] = atStats.lines;
+    doc["at_truncated_lines"] = atStats.truncatedLines;
+    doc["at_passthrough_overflows"] = atStats.passthroughOverflows;
+    doc["at_commands"] = atStats.commands;
+    doc["at_errors"] = atStats.errors;
+    doc["at_timeouts"] = atStats.timeouts;
+    doc["at_rejected"] = atStats.rejected;
+    doc["at_queue_high_water"] = atStats.queueHighWater;
+    doc["at_latency_ms"] = atStats.lastLatencyMs;
+    doc["at_latency_max_ms"] = atStats.maxLatencyMs;
+    for (uint8_t u = AT_URC_NONE + 1; u < AT_URC_COUNT; u++) {
+      doc[String("at_urc_") + atUrcName((AtUrc)u)] = atStats.urcs[u];
+    }
+    // Máy trạng thái cảnh báo: số sự kiện mới và số lần bật lại bị gộp (flap) mỗi kênh
+    JsonObject alertChannels = doc["alert_channels"].to<JsonObject>();
+    for (uint8_t i = 0; i < ALERT_CH_COUNT; i++) {
+      AlertChannelStats as = alertFsmGetStats((AlertChannelId)i);
+      JsonObject ac = alertChannels[alertReasonName(1 << i)].to<JsonObject>();
+      ac["active"] = as.active;
+      ac["events"] = as.events;
+      ac["coalesced"] = as.coalesced;
+    }
+    // Lịch lấy mẫu từng kênh: jitter so với hạn và số lần vượt ngân sách/bỏ lỡ chu kỳ
+    JsonArray channels = doc["sensor_channels"].to<JsonArray>();
+    for (uint8_t i = 0; i < sensorSchedulerChannelCount(); i++) {
+      SensorChannelStats cs;
+      if (!sensorSchedulerGetStats(i, cs)) continue;
+      JsonObject ch = channels.add<JsonObject>();
+      ch["name"] = cs.name;
+      ch["period_ms"] = cs.periodMs;
+      ch["runs"] = cs.runs;
+      ch["overruns"] = cs.overruns;
+      ch["missed"] = cs.missed;
+      ch["jitter_avg_us"] = cs.avgJitterUs;
+      ch["jitter_max_us"] = cs.maxJitterUs;
+      ch["exec_last_us"] = cs.lastExecUs;
+      ch["exec_max_us"] = cs.maxExecUs;
+    }
     doc["device_id"] = DEVICE_ID;
     serializeJson(doc, json);
   }
   server.send(200, "application/json", json);
 }
 
+static int16_t toCenti(float v) {
+  if (isnan(v)) return TLOG_NULL_CENTI;
+  float c = roundf(v * 100.0f);
+  if (c > INT16_MAX) return INT16_MAX;
+  if (c <= INT16_MIN) return INT16_MIN + 1;
+  return (int16_t)c;
+}
+
 /**
- * @brief Đặt lịch upload dữ liệu định kỳ (60 giây/lần) thông qua task upload.
+ * @brief Đóng gói snapshot thành bản ghi nhị phân kích thước cố định (seq/CRC gán khi append, hoặc
+ * alertTask cấp seq trước khi gửi khẩn).
  */
-void tryBackendUpload() {
-  // CẤM UPLOAD TRƯỚC KHI NETWORK TASK HOÀN TẤT
-  if (!networkTaskCompleted) {
-    return;  // Tất cả các request upload bị cấm cho đến khi network setup xong
+TelemetryRecord makeTelemetryRecord(const SensorSnapshot& snap, TelemetryKind kind) {
+  TelemetryRecord rec;
+  memset(&rec, 0, sizeof(rec));
+  rec.uptimeMs = snap.sampledAtMs;
+  rec.bootId = tlogBootId();
+  rec.kind = kind;
+  if (snap.tempAlert) rec.flags |= TLOG_FLAG_TEMP_ALERT;
+  if (snap.smokeAlert) rec.flags |= TLOG_FLAG_SMOKE_ALERT;
+  if (snap.fireAlert) rec.flags |= TLOG_FLAG_FIRE_ALERT;
+  if (snap.tempRiseAlert) rec.flags |= TLOG_FLAG_TEMP_RISE_ALERT;
+  if (snap.alertActive) rec.flags |= TLOG_FLAG_ALERT_ACTIVE;
+  rec.temperatureCenti = toCenti(snap.temperature);
+  rec.tempRiseCenti = toCenti(snap.tempRiseRate);
+  rec.probeCount = snap.probeCount;
+  for (uint8_t i = 0; i < MAX_TEMP_PROBES; i++) rec.probeCenti[i] = toCenti(snap.probeTemps[i]);
+  rec.smokeValue = snap.smokeValue;
+  rec.fireValue10 = snap.fireValue10;
+  rec.riskScore = snap.riskScore;
+  rec.riskLevel = snap.riskLevel;
+  return rec;
+}
+
+/**
+ * @brief Điền các trường của một bản ghi vào object JSON (dùng chung cho gửi lẻ và gửi lô).
+ *
+ * Không gửi timestamp tuyệt đối (thiết bị không sync NTP). Bản ghi cùng lần boot kèm `age_ms` để
+ * server lùi thời gian về đúng lúc lấy mẫu khi gửi bù sau mất mạng; `seq` + `boot_id` để server khử trùng.
+ */
+static void fillReadingJson(JsonObject doc, const TelemetryRecord& rec) {
+  doc["temperature"] = rec.temperatureCenti / 100.0f;
+  // Nhiệt độ từng đầu dò theo thứ tự ROM đã cache; đầu dò lỗi gửi null
+  JsonArray probes = doc["probe_temps"].to<JsonArray>();
+  for (uint8_t i = 0; i < rec.probeCount && i < MAX_TEMP_PROBES; i++) {
+    if (rec.probeCenti[i] == TLOG_NULL_CENTI) probes.add<JsonVariant>();
+    else probes.add(rec.probeCenti[i] / 100.0f);
+  }
+  doc["smoke_value"] = rec.smokeValue;
+  doc["fire_value"] = rec.fireValue10; // KY-026 10-bit
+  doc["temp_alert"] = (bool)(rec.flags & TLOG_FLAG_TEMP_ALERT);
+  doc["smoke_alert"] = (bool)(rec.flags & TLOG_FLAG_SMOKE_ALERT);
+  doc["fire_alert"] = (bool)(rec.flags & TLOG_FLAG_FIRE_ALERT);
+  doc["temp_rise_alert"] = (bool)(rec.flags & TLOG_FLAG_TEMP_RISE_ALERT);
+  if (rec.tempRiseCenti == TLOG_NULL_CENTI) doc["temp_rise_rate"] = nullptr;
+  else doc["temp_rise_rate"] = rec.tempRiseCenti / 100.0f;
+  doc["risk_score"] = rec.riskScore;
+  doc["risk_level"] = riskLevelName((RiskLevel)rec.riskLevel);
+  if (rec.seq) {
+    doc["seq"] = rec.seq;
+    doc["boot_id"] = tlogBootKey(rec.bootId);
   }
+  if (rec.bootId == tlogBootId()) doc["age_ms"] = (uint32_t)(millis() - rec.uptimeMs);
+}
+
+/**
+ * @brief Dựng JSON payload cho /api/ingest từ một bản ghi telemetry.
+ */
+String buildReadingBody(const TelemetryRecord& rec) {
+  JsonDocument doc;
+  fillReadingJson(doc.to<JsonObject>(), rec);
+  doc["device_id"] = DEVICE_ID;
+  String body;
+  serializeJson(doc, body);
+  return body;
+}
+
+/**
+ * @brief Dựng JSON payload cho /api/ingest/batch: `device_id` một lần, các bản ghi trong `readings`.
+ */
+String buildBatchBody(const TelemetryRecord* recs, uint32_t count) {
+  JsonDocument doc;
+  doc["device_id"] = DEVICE_ID;
+  JsonArray readings = doc["readings"].to<JsonArray>();
+  for (uint32_t i = 0; i < count; i++) fillReadingJson(readings.add<JsonObject>(), recs[i]);
+  String body;
+  serializeJson(doc, body);
+  return body;
+}
 
+/**
+ * @brief Ghi bản ghi định kỳ (60 giây/lần) vào hàng đợi flash; uploadTask sẽ xả khi có mạng.
+ *
+ * Không còn chờ networkTask: mất mạng lúc boot hay giữa chừng đều không làm thủng lịch sử.
+ */
+void tryBackendUpload() {
   static unsigned long lastUpload = 0;
   const unsigned long interval = 60000; // mỗi 60s
   unsigned long now = millis();
@@ -1023,78 +1644,38 @@ void tryBackendUpload() {
   lastUpload = now;
 
   esp_task_wdt_reset(); // Reset watchdog before prepare
-  JsonDocument doc;
-  // Không gửi timestamp, để server tự tạo
-  doc["temperature"] = temperature;
-  doc["smoke_value"] = smokeValue;
-  // MQ-135: không có preheat gating, bỏ trường cũ
-  doc["fire_value"] = fireValue10; // KY-026 10-bit
-  doc["temp_alert"] = tempAlertFlag;
-  doc["smoke_alert"] = smokeAlertFlag;
-  doc["fire_alert"] = fireAlertFlag;
-  doc["device_id"] = DEVICE_ID;
-  String body;
-  serializeJson(doc, body);
-
-  // USE ASYNC UPLOAD: Đặt flag để upload task xử lý
-  // Cách này tránh block main loop
-  if (xSemaphoreTake(uploadMutex, 100)) {
-    uploadBody = body;
-    xSemaphoreGive(uploadMutex);
+  TelemetryRecord rec = makeTelemetryRecord(sensorSnapshot.read(), TLOG_KIND_PERIODIC);
+  if (!uploadQueuePostNormal(rec, false)) {
+    Serial.println("[UPLOAD] Hàng đợi NORMAL đầy, bỏ bản ghi định kỳ");
   }
-  uploadPending = true; // Upload task sẽ xử lý này
 }
 
 /**
- * @brief Đặt lịch upload ngay lập tức (không khẩn cấp) thông qua task upload.
+ * @brief Đặt lịch upload ngay lập tức (không khẩn cấp): đưa bản ghi vào queue NORMAL (uploadTask ghi
+ * xuống hàng đợi flash) và yêu cầu gửi lô ngay. Chỉ chạm SPIFFS khi queue NORMAL đầy (ghi thẳng xuống
+ * log thay vì bỏ cảnh báo).
  */
 void uploadImmediate() {
-  // USE ASYNC UPLOAD: Đặt flag để upload task xử lý ngay
   Serial.println("[UPLOAD] Bắt đầu upload immediate...");
-
-  JsonDocument doc;
-  // Không gửi timestamp, để server tự tạo
-  doc["temperature"] = temperature;
-  doc["smoke_value"] = smokeValue;
-  // MQ-135: không có preheat gating, bỏ trường cũ
-  doc["fire_value"] = fireValue10; // KY-026 10-bit
-  doc["temp_alert"] = tempAlertFlag;
-  doc["smoke_alert"] = smokeAlertFlag;
-  doc["fire_alert"] = fireAlertFlag;
-  doc["device_id"] = DEVICE_ID;
-  String body;
-  serializeJson(doc, body);
-
-  // Protect uploadBody assignment with mutex
-  if (xSemaphoreTake(uploadMutex, 100)) {
-    uploadBody = body;
-    xSemaphoreGive(uploadMutex);
+  TelemetryRecord rec = makeTelemetryRecord(sensorSnapshot.read(), TLOG_KIND_ALERT);
+  // Cảnh báo không chờ gom lô: flush đánh thức uploadTask gửi ngay
+  if (!uploadQueuePostAlert(rec)) {
+    Serial.println("[UPLOAD] Ghi flash lỗi, mất bản ghi cảnh báo");
   }
-  uploadPending = true; // Bắt đầu upload (async via uploadTask)
 }
 
 /**
- * @brief Đặt lịch upload khẩn, yêu cầu task upload dùng đường truyền timeout ngắn.
+ * @brief Đặt lịch upload khẩn: đưa bản sao bản ghi vào queue URGENT, alertTask thức dậy gửi ngay
+ * qua socket khẩn, không chờ lô thường.
+ *
+ * Không chặn và không ghi flash trên đường này (sensorTask gọi) trừ khi cả queue URGENT lẫn NORMAL đầy.
  */
 void uploadImmediateCritical() {
   // Gửi khẩn: dùng path timeout ngắn, không retry
   Serial.println("[UPLOAD][URGENT] Bắt đầu upload immediate (CRITICAL)...");
-  JsonDocument doc;
-  doc["temperature"] = temperature;
-  doc["smoke_value"] = smokeValue;
-  doc["fire_value"] = fireValue10; // KY-026 10-bit
-  doc["temp_alert"] = tempAlertFlag;
-  doc["smoke_alert"] = smokeAlertFlag;
-  doc["fire_alert"] = fireAlertFlag;
-  doc["device_id"] = DEVICE_ID;
-  String body;
-  serializeJson(doc, body);
-
-  if (xSemaphoreTake(uploadMutex, 100)) {
-    uploadBody = body;
-    xSemaphoreGive(uploadMutex);
+  if (!uploadQueuePostUrgent(makeTelemetryRecord(sensorSnapshot.read(), TLOG_KIND_URGENT))) {
+    Serial.println("[UPLOAD][URGENT] Queue đầy và ghi flash lỗi, mất bản ghi khẩn");
   }
-  urgentUploadPending = true;
 }
 
 /**
@@ -1115,7 +1696,11 @@ void testSensors() {
     Serial.println("- Data kết nối với GPIO 4");
     Serial.println("- Có điện trở pull-up 4.7kΩ giữa Data và VCC");
   } else {
+    // Test thủ công: chờ chuyển đổi đồng bộ rồi trả bus về chế độ async
+    tempSensor.setWaitForConversion(true);
     tempSensor.requestTemperatures();
+    tempSensor.setWaitForConversion(false);
+    tempProbesResetConversion();
     float testTemp = tempSensor.getTempCByIndex(0);
     Serial.print("Nhiệt độ đọc được: ");
     Serial.print(testTemp);
@@ -1146,38 +1731,6 @@ void testSensors() {
   Serial.println("=== KẾT THÚC TEST ===");
 }
 
-/**
- * @brief Bộ lọc median đơn giản để loại bỏ nhiễu trong chuỗi mẫu analog.
- */
-int medianFilter(int values[], int size) {
-  // Sắp xếp mảng
-  for (int i = 0; i < size - 1; i++) {
-    for (int j = i + 1; j < size; j++) {
-      if (values[i] > values[j]) {
-        int temp = values[i];
-        values[i] = values[j];
-        values[j] = temp;
-      }
-    }
-  }
-  // Trả về giá trị ở giữa
-  return values[size / 2];
-}
-
-/**
- * @brief Tính trung bình trượt cho MQ-135 để làm mượt giá trị đo cuối cùng.
- */
-int movingAverage(int newValue) {
-  smokeHistory[smokeHistoryIndex] = newValue;
-  smokeHistoryIndex = (smokeHistoryIndex + 1) % MOVING_AVERAGE_SIZE;
-
-  long sum = 0;
-  for (int i = 0; i < MOVING_AVERAGE_SIZE; i++) {
-    sum += smokeHistory[i];
-  }
-  return (int)(sum / MOVING_AVERAGE_SIZE);
-}
-
 /**
  * @brief (Không dùng) Giữ placeholder đồng bộ NTP – backend phụ trách timestamp.
  */
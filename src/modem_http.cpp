@@ -0,0 +1,656 @@
+#include "modem_http.h"
+#include <stdarg.h>
+
+/**
+ * @file modem_http.cpp
+ * @brief HTTP(S) qua phiên +CHTTPS* của modem (xem modem_http.h).
+ *
+ * Trình tự AT (SIM7600):
+ *   AT+CHTTPSSTART                          → OK
+ *   AT+CHTTPSOPSE="<host>",<port>,<1|2>     → OK, +CHTTPSOPSE: 0        (1 = HTTP, 2 = HTTPS)
+ *   AT+CHTTPSSEND=<len> → '>' → <byte>      → OK, +CHTTPSSEND: 0        (lặp tới hết request)
+ *   AT+CHTTPSRECV=<max>                     → OK, [+CHTTPSRECV: DATA,<n> <n byte>], +CHTTPSRECV: 0
+ *   AT+CHTTPSCLSE / AT+CHTTPSSTOP           → OK
+ * URC: "+CHTTPS: RECV EVENT" khi có dữ liệu, "+CHTTPSNOTIFY: PEER CLOSED" khi server đóng.
+ */
+
+enum WaitResult { WAIT_OK, WAIT_MATCH, WAIT_ERROR, WAIT_TIMEOUT };
+
+static Stream* io = NULL;
+static void (*lockFn)() = NULL;
+static void (*unlockFn)() = NULL;
+
+static bool serviceStarted = false;
+static bool sessionOpen = false;
+static char sessionHost[64];
+static uint16_t sessionPort = 0;
+static bool sessionTls = false;
+static volatile bool peerClosed = false;   // URC PEER CLOSED (từ task RX hoặc đọc thấy trong stream)
+static volatile bool recvEvent = false;    // URC RECV EVENT: có dữ liệu chờ AT+CHTTPSRECV
+static ModemHttpStats stats = {};
+// Bộ đệm chung cho request gửi đi và từng đoạn nhận về; caller đã tuần tự hóa (cellularHttpMutex)
+static uint8_t chunkBuf[MODEM_HTTP_CHUNK];
+
+static void lock() {
+  if (lockFn) lockFn();
+}
+
+static void unlock() {
+  if (unlockFn) unlockFn();
+}
+
+static bool timeLeft(uint32_t deadline) {
+  return (int32_t)(deadline - millis()) > 0;
+}
+
+static bool startsWith(const char* s, const char* prefix) {
+  return strncmp(s, prefix, strlen(prefix)) == 0;
+}
+
+/**
+ * @brief URC lẫn trong phản hồi: cập nhật cờ. Trả true nếu là URC của phiên HTTPS.
+ */
+static bool handleUrcLine(const char* line) {
+  if (startsWith(line, "+CHTTPSNOTIFY:")) {
+    if (strstr(line, "PEER CLOSED") != NULL) peerClosed = true;
+    return true;
+  }
+  if (startsWith(line, "+CHTTPS: RECV EVENT")) {
+    recvEvent = true;
+    return true;
+  }
+  return false;
+}
+
+static int readByte(uint32_t deadline) {
+  while (!io->available()) {
+    if (!timeLeft(deadline)) return -1;
+    delay(1);
+  }
+  return io->read();
+}
+
+/**
+ * @brief Đọc một dòng không rỗng (bỏ '\r'); dòng dài quá bị cắt.
+ */
+static bool readLine(char* buf, size_t size, uint32_t deadline) {
+  size_t n = 0;
+  for (;;) {
+    int c = readByte(deadline);
+    if (c < 0) return false;
+    if (c == '\r') continue;
+    if (c == '\n') {
+      if (n == 0) continue;
+      buf[n] = '\0';
+      return true;
+    }
+    if (n + 1 < size) buf[n++] = (char)c;
+  }
+}
+
+/**
+ * @brief Đọc đúng `len` byte thô (payload sau "+CHTTPSRECV: DATA,<len>").
+ */
+static bool readRaw(uint8_t* buf, size_t len, uint32_t deadline) {
+  for (size_t i = 0; i < len; i++) {
+    int c = readByte(deadline);
+    if (c < 0) return false;
+    buf[i] = (uint8_t)c;
+  }
+  return true;
+}
+
+/**
+ * @brief Xả phần còn sót của giao dịch trước (URC, "+CHTTPSCLSE: 0" đến muộn) trước khi gửi lệnh mới.
+ */
+static void drainInput() {
+  char line[64];
+  size_t n = 0;
+  while (io->available()) {
+    int c = io->read();
+    if (c < 0) break;
+    if (c == '\n') {
+      line[n] = '\0';
+      if (n > 0) handleUrcLine(line);
+      n = 0;
+    } else if (c != '\r' && n + 1 < sizeof(line)) {
+      line[n++] = (char)c;
+    }
+  }
+}
+
+static void sendCmd(const char* fmt, ...) {
+  char cmd[128];
+  va_list args;
+  va_start(args, fmt);
+  int len = vsnprintf(cmd, sizeof(cmd), fmt, args);
+  va_end(args);
+  if (len < 0) return;
+  if ((size_t)len >= sizeof(cmd)) len = sizeof(cmd) - 1;
+  drainInput();
+  io->write((const uint8_t*)"AT", 2);
+  io->write((const uint8_t*)cmd, len);
+  io->write((const uint8_t*)"\r", 1);
+}
+
+/**
+ * @brief Chờ kết quả lệnh vừa gửi.
+ * @param want NULL: xong khi có OK. Khác NULL: xong khi có dòng bắt đầu bằng `want` (OK trước đó bỏ qua),
+ *             dòng đó chép vào `line`.
+ */
+static WaitResult waitFor(const char* want, uint32_t timeoutMs, char* line, size_t lineSize) {
+  char buf[96];
+  uint32_t deadline = millis() + timeoutMs;
+  while (readLine(buf, sizeof(buf), deadline)) {
+    if (handleUrcLine(buf)) continue;
+    if (want && startsWith(buf, want)) {
+      if (line) {
+        strncpy(line, buf, lineSize - 1);
+        line[lineSize - 1] = '\0';
+      }
+      return WAIT_MATCH;
+    }
+    if (strcmp(buf, "OK") == 0) {
+      if (!want) return WAIT_OK;
+      continue;
+    }
+    if (strcmp(buf, "ERROR") == 0 || startsWith(buf, "+CME ERROR")) return WAIT_ERROR;
+  }
+  return WAIT_TIMEOUT;
+}
+
+// Mã kết quả sau tiền tố, ví dụ "+CHTTPSOPSE: 0" → 0
+static int resultCode(const char* line, const char* prefix) {
+  return atoi(line + strlen(prefix));
+}
+
+/**
+ * @brief Dấu nhắc '>' của AT+CHTTPSSEND (không có xuống dòng sau nó).
+ */
+static bool waitPrompt(uint32_t timeoutMs) {
+  uint32_t deadline = millis() + timeoutMs;
+  char line[64];
+  size_t n = 0;
+  for (;;) {
+    int c = readByte(deadline);
+    if (c < 0) return false;
+    if (c == '>' && n == 0) return true;
+    if (c == '\r') continue;
+    if (c == '\n') {
+      line[n] = '\0';
+      n = 0;
+      if (handleUrcLine(line)) continue;
+      if (strcmp(line, "ERROR") == 0 || startsWith(line, "+CME ERROR")) return false;
+      continue;
+    }
+    if (n + 1 < sizeof(line)) line[n++] = (char)c;
+  }
+}
+
+static bool startService() {
+  if (serviceStarted) return true;
+  lock();
+  // Cấu hình TLS trước START: bật SNI cho server dùng chung IP (firmware thiếu lệnh nào thì bỏ qua)
+  static const char* const CFG[] = { "\"sslversion\",3", "\"sni\",1", "\"timeout\",60", "\"keepidle\",60" };
+  for (size_t i = 0; i < sizeof(CFG) / sizeof(CFG[0]); i++) {
+    sendCmd("+CHTTPSCFG=%s", CFG[i]);
+    waitFor(NULL, 2000, NULL, 0);
+  }
+  sendCmd("+CHTTPSSTART");
+  WaitResult r = waitFor(NULL, 8000, NULL, 0);
+  if (r == WAIT_ERROR) {
+    // Dịch vụ còn chạy từ trước (ESP32 khởi động lại, modem thì không): dừng rồi mở lại
+    sendCmd("+CHTTPSSTOP");
+    waitFor(NULL, 5000, NULL, 0);
+    sendCmd("+CHTTPSSTART");
+    r = waitFor(NULL, 8000, NULL, 0);
+  }
+  unlock();
+  serviceStarted = r == WAIT_OK;
+  if (!serviceStarted) Serial.println("[MHTTP] CHTTPSSTART lỗi");
+  return serviceStarted;
+}
+
+static void closeSession() {
+  if (!sessionOpen) return;
+  lock();
+  sendCmd("+CHTTPSCLSE");
+  waitFor(NULL, 3000, NULL, 0);
+  unlock();
+  sessionOpen = false;
+}
+
+static bool openSession(const ModemHttpRequest& req) {
+  char line[48];
+  peerClosed = false;
+  recvEvent = false;
+  lock();
+  sendCmd("+CHTTPSOPSE=\"%s\",%u,%d", req.host, req.port, req.tls ? 2 : 1);
+  WaitResult r = waitFor("+CHTTPSOPSE:", MODEM_HTTP_OPEN_TIMEOUT_MS, line, sizeof(line));
+  unlock();
+  if (r != WAIT_MATCH || resultCode(line, "+CHTTPSOPSE:") != 0) {
+    Serial.printf("[MHTTP] Mở phiên %s:%u lỗi (%s)\n", req.host, req.port, r == WAIT_MATCH ? line : "no reply");
+    // Lỗi mở phiên thường do dịch vụ hỏng: lần sau START lại từ đầu
+    lock();
+    sendCmd("+CHTTPSSTOP");
+    waitFor(NULL, 3000, NULL, 0);
+    unlock();
+    serviceStarted = false;
+    return false;
+  }
+  strncpy(sessionHost, req.host, sizeof(sessionHost) - 1);
+  sessionHost[sizeof(sessionHost) - 1] = '\0';
+  sessionPort = req.port;
+  sessionTls = req.tls;
+  sessionOpen = true;
+  stats.sessionsOpened++;
+  return true;
+}
+
+/**
+ * @brief Gửi `len` byte trên phiên, mỗi AT+CHTTPSSEND tối đa MODEM_HTTP_CHUNK byte.
+ */
+static bool sendBytes(const uint8_t* data, size_t len) {
+  char line[32];
+  size_t off = 0;
+  while (off < len) {
+    size_t n = len - off;
+    if (n > MODEM_HTTP_CHUNK) n = MODEM_HTTP_CHUNK;
+    lock();
+    sendCmd("+CHTTPSSEND=%u", (unsigned)n);
+    bool ok = waitPrompt(3000);
+    if (ok) {
+      io->write(data + off, n);
+      ok = waitFor("+CHTTPSSEND:", 10000, line, sizeof(line)) == WAIT_MATCH &&
+           resultCode(line, "+CHTTPSSEND:") == 0;
+    }
+    unlock();
+    if (!ok) return false;
+    off += n;
+    stats.bytesSent += n;
+  }
+  return true;
+}
+
+/**
+ * @brief Một lượt AT+CHTTPSRECV vào `buf`.
+ * @return Số byte nhận (0 = chưa có dữ liệu), -1 nếu lỗi/phiên đã đóng.
+ */
+static int recvChunk(uint8_t* buf, size_t size, uint32_t deadline) {
+  char line[48];
+  int got = 0;
+  int result = -1;
+  lock();
+  sendCmd("+CHTTPSRECV=%u", (unsigned)size);
+  while (readLine(line, sizeof(line), deadline)) {
+    if (handleUrcLine(line) || strcmp(line, "OK") == 0) continue;
+    if (startsWith(line, "+CHTTPSRECV: DATA,")) {
+      int n = atoi(line + 18);
+      if (n < 0 || (size_t)n > size || !readRaw(buf, n, deadline)) break;
+      got = n;
+      continue;  // Còn "+CHTTPSRECV: 0" kết thúc
+    }
+    if (startsWith(line, "+CHTTPSRECV:")) {
+      if (resultCode(line, "+CHTTPSRECV:") == 0) result = got;
+      break;
+    }
+    if (strcmp(line, "ERROR") == 0 || startsWith(line, "+CME ERROR")) break;
+  }
+  unlock();
+  return result;
+}
+
+// --------------------------------------------------------------------
+// Phân tích response HTTP/1.x theo luồng (dữ liệu tới từng đoạn tùy ý)
+// --------------------------------------------------------------------
+enum ParseState : uint8_t {
+  PS_STATUS,
+  PS_HEADER,
+  PS_BODY,           // Còn `remaining` byte theo Content-Length
+  PS_CHUNK_SIZE,
+  PS_CHUNK_DATA,
+  PS_CHUNK_END,      // "\r\n" sau dữ liệu của một chunk
+  PS_TRAILER,
+  PS_UNTIL_CLOSE,    // Không có độ dài: body tới khi server đóng phiên
+  PS_DONE,
+  PS_ERROR,
+  PS_ABORTED
+};
+
+struct HttpParser {
+  ParseState state;
+  char line[MODEM_HTTP_LINE_MAX];
+  size_t lineLen;
+  bool chunked;
+  bool http10;
+  bool connClose;
+  bool connKeepAlive;
+  bool noBody;        // HEAD: không có body dù có Content-Length
+  uint32_t remaining;
+  ModemHttpResponse* resp;
+  ModemHttpSink sink;
+  void* ctx;
+};
+
+static bool parserDeliver(HttpParser& p, const uint8_t* data, size_t len) {
+  if (len == 0) return true;
+  p.resp->bodyBytes += len;
+  if (p.sink && !p.sink(data, len, p.ctx)) {
+    p.state = PS_ABORTED;
+    return false;
+  }
+  return true;
+}
+
+static void parserHeader(HttpParser& p, char* line) {
+  for (char* c = line; *c && *c != ':'; c++) *c = (char)tolower((unsigned char)*c);
+  char* value = strchr(line, ':');
+  if (!value) return;
+  *value++ = '\0';
+  while (*value == ' ' || *value == '\t') value++;
+  for (char* c = value; *c; c++) *c = (char)tolower((unsigned char)*c);
+
+  if (strcmp(line, "content-length") == 0) {
+    p.resp->contentLength = (int32_t)strtol(value, NULL, 10);
+  } else if (strcmp(line, "transfer-encoding") == 0) {
+    p.chunked = strstr(value, "chunked") != NULL;
+  } else if (strcmp(line, "connection") == 0) {
+    p.connClose = strstr(value, "close") != NULL;
+    p.connKeepAlive = strstr(value, "keep-alive") != NULL;
+  } else if (strcmp(line, "content-range") == 0) {
+    // "bytes <start>-<end>/<total>"
+    const char* s = strstr(value, "bytes ");
+    if (s) p.resp->rangeStart = (int32_t)strtol(s + 6, NULL, 10);
+    const char* slash = strchr(value, '/');
+    if (slash && slash[1] != '*') p.resp->rangeTotal = (int32_t)strtol(slash + 1, NULL, 10);
+  }
+}
+
+/**
+ * @brief Hết header: quyết định cách đọc body.
+ */
+static void parserHeadersDone(HttpParser& p) {
+  int status = p.resp->status;
+  if (status >= 100 && status < 200) {
+    p.state = PS_STATUS;  // 100 Continue: response thật theo sau
+    return;
+  }
+  p.resp->keepAlive = p.http10 ? p.connKeepAlive : !p.connClose;
+  if (p.noBody || status == 204 || status == 304) {
+    p.state = PS_DONE;
+  } else if (p.chunked) {
+    p.state = PS_CHUNK_SIZE;
+  } else if (p.resp->contentLength >= 0) {
+    p.remaining = (uint32_t)p.resp->contentLength;
+    p.state = p.remaining > 0 ? PS_BODY : PS_DONE;
+  } else {
+    p.resp->keepAlive = false;
+    p.state = PS_UNTIL_CLOSE;
+  }
+}
+
+static void parserLine(HttpParser& p) {
+  p.line[p.lineLen] = '\0';
+  p.lineLen = 0;
+  switch (p.state) {
+    case PS_STATUS: {
+      if (p.line[0] == '\0') return;  // Dòng trống sau 100 Continue
+      if (!startsWith(p.line, "HTTP/1.")) {
+        p.state = PS_ERROR;
+        return;
+      }
+      p.http10 = p.line[7] == '0';
+      const char* sp = strchr(p.line, ' ');
+      p.resp->status = sp ? atoi(sp + 1) : 0;
+      if (p.resp->status < 100 || p.resp->status > 999) {
+        p.state = PS_ERROR;
+        return;
+      }
+      p.chunked = false;
+      p.connClose = false;
+      p.connKeepAlive = false;
+      p.resp->contentLength = -1;
+      p.state = PS_HEADER;
+      return;
+    }
+    case PS_HEADER:
+      if (p.line[0] == '\0') parserHeadersDone(p);
+      else parserHeader(p, p.line);
+      return;
+    case PS_CHUNK_SIZE: {
+      char* end;
+      unsigned long size = strtoul(p.line, &end, 16);
+      if (end == p.line) {
+        p.state = PS_ERROR;
+        return;
+      }
+      p.remaining = (uint32_t)size;
+      p.state = size > 0 ? PS_CHUNK_DATA : PS_TRAILER;
+      return;
+    }
+    case PS_CHUNK_END:
+      p.state = p.line[0] == '\0' ? PS_CHUNK_SIZE : PS_ERROR;
+      return;
+    case PS_TRAILER:
+      if (p.line[0] == '\0') p.state = PS_DONE;
+      return;
+    default:
+      return;
+  }
+}
+
+/**
+ * @brief Nạp một đoạn byte response. Trả false khi response sai định dạng hoặc sink hủy.
+ */
+static bool parserFeed(HttpParser& p, const uint8_t* data, size_t len) {
+  size_t i = 0;
+  while (i < len) {
+    switch (p.state) {
+      case PS_BODY:
+      case PS_CHUNK_DATA: {
+        size_t n = len - i;
+        if (n > p.remaining) n = p.remaining;
+        if (!parserDeliver(p, data + i, n)) return false;
+        i += n;
+        p.remaining -= n;
+        if (p.remaining == 0) p.state = p.state == PS_BODY ? PS_DONE : PS_CHUNK_END;
+        break;
+      }
+      case PS_UNTIL_CLOSE:
+        if (!parserDeliver(p, data + i, len - i)) return false;
+        i = len;
+        break;
+      case PS_DONE:
+        return true;  // Byte thừa sau response: bỏ
+      case PS_ERROR:
+      case PS_ABORTED:
+        return false;
+      default: {
+        char c = (char)data[i++];
+        if (c == '\n') {
+          parserLine(p);
+        } else if (c != '\r' && p.lineLen + 1 < sizeof(p.line)) {
+          p.line[p.lineLen++] = c;  // Dòng dài quá (cookie...) bị cắt, chỉ phần đầu được phân tích
+        }
+        break;
+      }
+    }
+  }
+  return p.state != PS_ERROR && p.state != PS_ABORTED;
+}
+
+// --------------------------------------------------------------------
+// API
+// --------------------------------------------------------------------
+void modemHttpBegin(Stream& stream, void (*lockCb)(), void (*unlockCb)()) {
+  io = &stream;
+  lockFn = lockCb;
+  unlockFn = unlockCb;
+}
+
+/**
+ * @brief Dựng dòng request + header vào chunkBuf. Trả độ dài, 0 nếu không vừa.
+ */
+static size_t buildHead(const ModemHttpRequest& req) {
+  bool defaultPort = req.port == (req.tls ? 443 : 80);
+  char hostPort[8] = "";
+  if (!defaultPort) snprintf(hostPort, sizeof(hostPort), ":%u", req.port);
+  int n = snprintf((char*)chunkBuf, sizeof(chunkBuf),
+                   "%s %s HTTP/1.1\r\nHost: %s%s\r\nConnection: keep-alive\r\n%s",
+                   req.method, req.path, req.host, hostPort, req.headers ? req.headers : "");
+  if (n < 0 || (size_t)n >= sizeof(chunkBuf)) return 0;
+  size_t len = n;
+  if (req.body) {
+    n = snprintf((char*)chunkBuf + len, sizeof(chunkBuf) - len, "Content-Type: %s\r\nContent-Length: %u\r\n\r\n",
+                 req.contentType ? req.contentType : "application/octet-stream", (unsigned)req.length);
+  } else {
+    n = snprintf((char*)chunkBuf + len, sizeof(chunkBuf) - len, "\r\n");
+  }
+  if (n < 0 || (size_t)n >= sizeof(chunkBuf) - len) return 0;
+  return len + n;
+}
+
+/**
+ * @brief Gửi request đã dựng: phần body đầu đi chung lượt SEND với header (request nhỏ chỉ tốn một lượt).
+ */
+static bool sendRequest(size_t headLen, const ModemHttpRequest& req, size_t inlineBody) {
+  if (!sendBytes(chunkBuf, headLen + inlineBody)) return false;
+  if (req.body && req.length > inlineBody) return sendBytes(req.body + inlineBody, req.length - inlineBody);
+  return true;
+}
+
+/**
+ * @brief Chờ dữ liệu tiếp: URC RECV EVENT, phiên bị đóng hoặc hết MODEM_HTTP_POLL_MS.
+ */
+static void waitData(uint32_t deadline) {
+  uint32_t until = millis() + MODEM_HTTP_POLL_MS;
+  while (!recvEvent && !peerClosed && timeLeft(until) && timeLeft(deadline)) delay(2);
+  recvEvent = false;
+}
+
+int modemHttpRequest(const ModemHttpRequest& req, ModemHttpResponse& resp, ModemHttpSink sink, void* ctx) {
+  memset(&resp, 0, sizeof(resp));
+  resp.contentLength = -1;
+  resp.rangeStart = -1;
+  resp.rangeTotal = -1;
+  if (io == NULL) return MODEM_HTTP_ERR_CONNECT;
+  stats.requests++;
+  uint32_t startMs = millis();
+
+  bool sameTarget = sessionOpen && !peerClosed && sessionPort == req.port && sessionTls == req.tls &&
+                    strcmp(sessionHost, req.host) == 0;
+  if (sessionOpen && !sameTarget) {
+    if (peerClosed) stats.peerClosed++;
+    closeSession();
+  }
+
+  // Lượt 2 chỉ khi phiên giữ sẵn đã chết mà chưa nhận được byte nào: server chưa xử lý request
+  for (int pass = 0; pass < 2; pass++) {
+    if (!startService()) {
+      stats.errors++;
+      return MODEM_HTTP_ERR_CONNECT;
+    }
+    bool reused = sessionOpen;
+    if (!reused && !openSession(req)) {
+      stats.errors++;
+      return MODEM_HTTP_ERR_CONNECT;
+    }
+
+    // Dựng lại mỗi lượt: chunkBuf cũng là bộ đệm nhận
+    size_t headLen = buildHead(req);
+    if (headLen == 0) {
+      Serial.println("[MHTTP] Header request quá dài");
+      stats.errors++;
+      return MODEM_HTTP_ERR_API;
+    }
+    size_t inlineBody = 0;
+    if (req.body) {
+      inlineBody = min(req.length, sizeof(chunkBuf) - headLen);
+      memcpy(chunkBuf + headLen, req.body, inlineBody);
+    }
+    bool sent = sendRequest(headLen, req, inlineBody);
+    HttpParser p = {};
+    p.state = PS_STATUS;
+    p.noBody = strcmp(req.method, "HEAD") == 0;
+    p.resp = &resp;
+    p.sink = sink;
+    p.ctx = ctx;
+    resp.contentLength = -1;
+    uint32_t received = 0;
+    int err = 0;
+    uint32_t deadline = millis() + req.timeoutMs;
+
+    while (sent && p.state != PS_DONE) {
+      int n = recvChunk(chunkBuf, sizeof(chunkBuf), deadline);
+      if (n > 0) {
+        if (received == 0) resp.ttfbMs = millis() - startMs;
+        received += n;
+        stats.bytesReceived += n;
+        if (!parserFeed(p, chunkBuf, n)) {
+          err = p.state == PS_ABORTED ? MODEM_HTTP_ERR_ABORTED : MODEM_HTTP_ERR_RESPONSE;
+          break;
+        }
+        continue;
+      }
+      if (n < 0 && !peerClosed) {
+        err = timeLeft(deadline) ? MODEM_HTTP_ERR_RESPONSE : MODEM_HTTP_ERR_TIMEOUT;
+        break;
+      }
+      if (peerClosed) {
+        // Server đóng phiên: chỉ hợp lệ nếu body đọc tới khi đóng
+        if (p.state == PS_UNTIL_CLOSE) p.state = PS_DONE;
+        else err = MODEM_HTTP_ERR_RESPONSE;
+        break;
+      }
+      if (!timeLeft(deadline)) {
+        err = MODEM_HTTP_ERR_TIMEOUT;
+        break;
+      }
+      waitData(deadline);
+    }
+
+    if (sent && err == 0) {
+      resp.reused = reused;
+      if (reused) stats.sessionsReused++;
+      if (peerClosed) stats.peerClosed++;
+      if (!resp.keepAlive || peerClosed) closeSession();
+      return resp.status;
+    }
+
+    closeSession();
+    if (reused && received == 0 && (!sent || peerClosed)) {
+      Serial.println("[MHTTP] Phiên giữ sẵn đã đóng, mở phiên mới và gửi lại");
+      stats.staleRecovered++;
+      continue;
+    }
+    stats.errors++;
+    return sent ? err : MODEM_HTTP_ERR_CONNECT;
+  }
+  stats.errors++;
+  return MODEM_HTTP_ERR_CONNECT;
+}
+
+void modemHttpClose() {
+  if (io == NULL) return;
+  closeSession();
+  if (!serviceStarted) return;
+  lock();
+  sendCmd("+CHTTPSSTOP");
+  waitFor(NULL, 3000, NULL, 0);
+  unlock();
+  serviceStarted = false;
+}
+
+void modemHttpInvalidate() {
+  sessionOpen = false;
+  serviceStarted = false;
+  peerClosed = false;
+}
+
+void modemHttpOnUrc(const char* line) {
+  handleUrcLine(line);
+}
+
+ModemHttpStats modemHttpGetStats() {
+  return stats;
+}
@@ -0,0 +1,95 @@
+#ifndef MODEM_HTTP_H
+#define MODEM_HTTP_H
+
+/**
+ * @file modem_http.h
+ * @brief HTTP(S) client chạy trên stack của modem SIMCOM: dùng phiên +CHTTPS* như một ống TCP/TLS thô,
+ * ESP32 tự dựng request và tự phân tích response (status, header, Content-Length/chunked).
+ *
+ * - TLS do modem làm; phiên (AT+CHTTPSOPSE) được giữ qua nhiều request khi server cho keep-alive,
+ *   nên chỉ request đầu mới tốn bắt tay TCP/TLS. Server đóng (+CHTTPSNOTIFY: PEER CLOSED) thì mở lại.
+ * - Body response đi thẳng vào sink theo từng đoạn AT+CHTTPSRECV, không giới hạn kích thước.
+ * - Chỉ nói chuyện qua một Stream (atEngineStream trên máy thật, modem giả lập theo kịch bản trên
+ *   máy host) và hai hàm khóa/nhả UART; mỗi giao dịch AT giữ khóa riêng.
+ * - Không tự retry: mã lỗi âm theo quy ước ArduinoHttpClient để bộ thực thi của cellular quyết định.
+ */
+
+#include <Arduino.h>
+#include "config.h"
+
+// Mã lỗi (trùng giá trị với HTTP_ERROR_* của ArduinoHttpClient)
+#define MODEM_HTTP_ERR_CONNECT -1        // START/OPSE/SEND lỗi
+#define MODEM_HTTP_ERR_API -2            // Request dựng không được (header quá dài)
+#define MODEM_HTTP_ERR_TIMEOUT -3
+#define MODEM_HTTP_ERR_RESPONSE -4       // Response sai định dạng hoặc bị cắt
+#define MODEM_HTTP_ERR_ABORTED -5        // Sink từ chối dữ liệu
+
+struct ModemHttpRequest {
+  const char* method;          // "GET", "POST"...
+  const char* host;
+  uint16_t port;
+  bool tls;
+  const char* path;
+  const char* headers;         // Header thêm, mỗi dòng kết thúc "\r\n"; NULL nếu không có
+  const uint8_t* body;         // NULL nếu không có body
+  size_t length;
+  const char* contentType;     // Bỏ qua khi không có body
+  uint32_t timeoutMs;          // Từ lúc gửi xong tới khi nhận trọn response
+};
+
+struct ModemHttpResponse {
+  int status;
+  int32_t contentLength;       // -1 nếu không có (chunked hoặc tới khi đóng)
+  int32_t rangeStart;          // Từ Content-Range, -1 nếu không có
+  int32_t rangeTotal;          // Tổng kích thước ở Content-Range, -1 nếu không có
+  bool keepAlive;              // Phiên còn dùng được sau response này
+  uint32_t bodyBytes;
+  uint32_t ttfbMs;             // Từ lúc bắt đầu request tới byte response đầu tiên
+  bool reused;                 // Chạy trên phiên giữ sẵn
+};
+
+/**
+ * @brief Nhận một đoạn body. Trả false để hủy request (phiên bị đóng).
+ */
+typedef bool (*ModemHttpSink)(const uint8_t* data, size_t len, void* ctx);
+
+struct ModemHttpStats {
+  uint32_t requests;
+  uint32_t sessionsOpened;
+  uint32_t sessionsReused;
+  uint32_t peerClosed;
+  uint32_t staleRecovered;     // Phiên giữ sẵn hóa ra đã chết lúc gửi, đã mở lại và gửi lại
+  uint32_t errors;
+  uint32_t bytesSent;
+  uint32_t bytesReceived;
+};
+
+/**
+ * @brief Gắn stream tới modem và hàm khóa/nhả UART cho từng giao dịch AT.
+ */
+void modemHttpBegin(Stream& io, void (*lock)(), void (*unlock)());
+
+/**
+ * @brief Gửi một request và đọc response; body đi vào `sink` (NULL = bỏ qua body).
+ * @return Mã HTTP (>0) hoặc MODEM_HTTP_ERR_*.
+ */
+int modemHttpRequest(const ModemHttpRequest& req, ModemHttpResponse& resp, ModemHttpSink sink, void* ctx);
+
+/**
+ * @brief Đóng phiên đang giữ (AT+CHTTPSCLSE) và dừng dịch vụ (AT+CHTTPSSTOP).
+ */
+void modemHttpClose();
+
+/**
+ * @brief Data context vừa mất/dựng lại: quên phiên và dịch vụ mà không gửi lệnh AT.
+ */
+void modemHttpInvalidate();
+
+/**
+ * @brief Báo URC +CHTTPSNOTIFY / +CHTTPS: RECV EVENT (gọi từ handler URC).
+ */
+void modemHttpOnUrc(const char* line);
+
+ModemHttpStats modemHttpGetStats();
+
+#endif
@@ -0,0 +1,225 @@
+#include "ota_pipeline.h"
+#include "ota_resume.h"
+#include "seqlock.h"
+#include <esp_task_wdt.h>
+
+/**
+ * @file ota_pipeline.cpp
+ * @brief Buffer đôi giữa task đọc mạng và task ghi flash (xem ota_pipeline.h).
+ */
+
+#define OTA_PIPE_WAIT_MS 100    // Chờ buffer/flash theo từng lát để còn reset watchdog
+#define OTA_PIPE_SYNC_BYTES 512 // OTA_PIPELINE 0: kích thước đọc/ghi như đường cũ
+
+static_assert(OTA_PIPE_BUF_BYTES % 4096 == 0, "OTA_PIPE_BUF_BYTES phải là bội số của sector flash 4096");
+static_assert(OTA_CHUNK_BYTES % OTA_PIPE_BUF_BYTES == 0, "Buffer không được vắt qua ranh giới checkpoint");
+
+struct OtaPipeBuffer {
+  uint8_t* data;
+  size_t len;
+};
+
+static Seqlock<OtaPipelineStats> lastSnapshot;  // Chỉ task đang tải (mỗi lúc một lượt) ghi
+static OtaPipelineStats run = {};
+static unsigned long runStart = 0;
+static OtaPipeBuffer* current = NULL;           // Buffer phía mạng đang đổ vào
+static volatile bool flashFailed = false;
+
+/**
+ * @brief Kết thúc lượt tải: chốt số đo để /api/status so sánh hai chế độ.
+ */
+static void finishRun() {
+  if (!run.running) return;
+  run.running = false;
+  run.transferMs = millis() - runStart;
+  run.bytesPerSec = run.transferMs ? (uint32_t)((uint64_t)run.bytes * 1000 / run.transferMs) : 0;
+  lastSnapshot.publish(run);
+  Serial.printf("[OTA] %s: %lu byte / %lu ms (%lu B/s), flash %lu ms / %lu lần ghi, chờ flash %lu ms\n",
+                run.pipelined ? "pipeline" : "tuần tự", (unsigned long)run.bytes, (unsigned long)run.transferMs,
+                (unsigned long)run.bytesPerSec, (unsigned long)run.flashMs, (unsigned long)run.flashWrites,
+                (unsigned long)run.stallMs);
+}
+
+static void flashWrite(OtaPipeBuffer* b) {
+  if (flashFailed || b->len == 0) return;
+  unsigned long t0 = millis();
+  if (!otaResumeWrite(b->data, b->len)) flashFailed = true;
+  run.flashMs += millis() - t0;
+  run.flashWrites++;
+}
+
+#if OTA_PIPELINE
+
+static OtaPipeBuffer buffers[OTA_PIPE_BUFFERS];
+static QueueHandle_t freeQueue = NULL;
+static QueueHandle_t fullQueue = NULL;
+static SemaphoreHandle_t flashStopped = NULL;
+
+/**
+ * @brief Task ghi flash: lấy buffer đầy, ghi, trả về hàng buffer trống. NULL trong queue là lệnh dừng.
+ */
+static void otaFlashTask(void* param) {
+  OtaPipeBuffer* b = NULL;
+  while (xQueueReceive(fullQueue, &b, portMAX_DELAY) == pdTRUE && b != NULL) {
+    flashWrite(b);
+    b->len = 0;
+    xQueueSend(freeQueue, &b, portMAX_DELAY);
+  }
+  xSemaphoreGive(flashStopped);
+  vTaskDelete(NULL);
+}
+
+bool otaPipelineStart() {
+  memset(&run, 0, sizeof(run));
+  run.pipelined = true;
+  run.running = true;
+  flashFailed = false;
+  current = NULL;
+
+  freeQueue = xQueueCreate(OTA_PIPE_BUFFERS, sizeof(OtaPipeBuffer*));
+  fullQueue = xQueueCreate(OTA_PIPE_BUFFERS + 1, sizeof(OtaPipeBuffer*));  // +1 chỗ cho lệnh dừng
+  flashStopped = xSemaphoreCreateBinary();
+  bool ok = freeQueue != NULL && fullQueue != NULL && flashStopped != NULL;
+  for (int i = 0; i < OTA_PIPE_BUFFERS; i++) {
+    buffers[i].len = 0;
+    buffers[i].data = ok ? (uint8_t*)malloc(OTA_PIPE_BUF_BYTES) : NULL;
+    if (buffers[i].data == NULL) {
+      ok = false;
+      continue;
+    }
+    OtaPipeBuffer* b = &buffers[i];
+    xQueueSend(freeQueue, &b, 0);
+  }
+  if (ok && xTaskCreatePinnedToCore(otaFlashTask, "otaFlash", 4096, NULL, OTA_FLASH_TASK_PRIORITY, NULL,
+                                    OTA_FLASH_TASK_CORE) != pdPASS) {
+    ok = false;
+  }
+  if (!ok) {
+    Serial.println("[OTA] Không cấp được buffer/task cho đường ống OTA");
+    if (flashStopped != NULL) xSemaphoreGive(flashStopped);  // Chưa có task: otaPipelineStop() không phải chờ
+    run.running = false;
+    otaPipelineStop();
+    return false;
+  }
+  runStart = millis();
+  return true;
+}
+
+uint8_t* otaPipelineAcquire(size_t& room) {
+  if (current == NULL) {
+    unsigned long t0 = millis();
+    while (!flashFailed && xQueueReceive(freeQueue, &current, pdMS_TO_TICKS(OTA_PIPE_WAIT_MS)) != pdTRUE) {
+      esp_task_wdt_reset();
+    }
+    run.stallMs += millis() - t0;
+    if (current == NULL) return NULL;
+  }
+  if (flashFailed) return NULL;
+  room = OTA_PIPE_BUF_BYTES - current->len;
+  return current->data + current->len;
+}
+
+void otaPipelineProduce(size_t n) {
+  if (current == NULL || n == 0) return;
+  current->len += n;
+  run.bytes += n;
+  if (current->len == OTA_PIPE_BUF_BYTES) {
+    xQueueSend(fullQueue, &current, portMAX_DELAY);
+    current = NULL;
+  }
+}
+
+bool otaPipelineDrain() {
+  if (current != NULL) {
+    if (current->len > 0) {
+      xQueueSend(fullQueue, &current, portMAX_DELAY);
+    } else {
+      xQueueSend(freeQueue, &current, portMAX_DELAY);
+    }
+    current = NULL;
+  }
+  // Task flash đã ghi xong khi mọi buffer về lại hàng trống
+  while (uxQueueMessagesWaiting(freeQueue) < OTA_PIPE_BUFFERS) {
+    vTaskDelay(pdMS_TO_TICKS(2));
+    esp_task_wdt_reset();
+  }
+  return !flashFailed;
+}
+
+void otaPipelineStop() {
+  if (fullQueue != NULL && flashStopped != NULL) {
+    OtaPipeBuffer* stop = NULL;
+    xQueueSend(fullQueue, &stop, portMAX_DELAY);
+    while (xSemaphoreTake(flashStopped, pdMS_TO_TICKS(OTA_PIPE_WAIT_MS)) != pdTRUE) esp_task_wdt_reset();
+  }
+  if (freeQueue != NULL) vQueueDelete(freeQueue);
+  if (fullQueue != NULL) vQueueDelete(fullQueue);
+  if (flashStopped != NULL) vSemaphoreDelete(flashStopped);
+  freeQueue = NULL;
+  fullQueue = NULL;
+  flashStopped = NULL;
+  for (int i = 0; i < OTA_PIPE_BUFFERS; i++) {
+    free(buffers[i].data);
+    buffers[i].data = NULL;
+  }
+  current = NULL;
+  finishRun();
+}
+
+#else
+
+static OtaPipeBuffer syncBuffer = { NULL, 0 };
+
+bool otaPipelineStart() {
+  memset(&run, 0, sizeof(run));
+  run.running = true;
+  flashFailed = false;
+  syncBuffer.len = 0;
+  syncBuffer.data = (uint8_t*)malloc(OTA_PIPE_SYNC_BYTES);
+  current = &syncBuffer;
+  if (syncBuffer.data == NULL) {
+    run.running = false;
+    otaPipelineStop();
+    return false;
+  }
+  runStart = millis();
+  return true;
+}
+
+uint8_t* otaPipelineAcquire(size_t& room) {
+  if (flashFailed || current == NULL) return NULL;
+  room = OTA_PIPE_SYNC_BYTES;
+  return current->data;
+}
+
+void otaPipelineProduce(size_t n) {
+  if (current == NULL || n == 0) return;
+  current->len = n;
+  run.bytes += n;
+  flashWrite(current);  // Ghi ngay trên task gọi: mạng đứng chờ flash
+  current->len = 0;
+}
+
+bool otaPipelineDrain() {
+  return !flashFailed;
+}
+
+void otaPipelineStop() {
+  free(syncBuffer.data);
+  syncBuffer.data = NULL;
+  current = NULL;
+  finishRun();
+}
+
+#endif
+
+bool otaPipelineFailed() {
+  return flashFailed;
+}
+
+OtaPipelineStats otaPipelineGetStats() {
+  OtaPipelineStats out = lastSnapshot.read();
+  out.pipelined = OTA_PIPELINE;
+  out.running = run.running;
+  return out;
+}
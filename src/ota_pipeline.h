@@ -0,0 +1,69 @@
+#ifndef OTA_PIPELINE_H
+#define OTA_PIPELINE_H
+
+/**
+ * @file ota_pipeline.h
+ * @brief Đường ống tải/ghi OTA: task đọc mạng đổ body thẳng vào buffer OTA_PIPE_BUF_BYTES, task flash
+ * ghi buffer đầy vào phân vùng (qua ota_resume) trong lúc buffer kia đang được đọc tiếp.
+ *
+ * - OTA_PIPE_BUFFERS buffer xoay vòng giữa hai queue (trống/đầy): hết buffer trống thì phía mạng chờ
+ *   (backpressure), không đọc thêm khi flash chưa kịp ghi.
+ * - Buffer là bội số sector 4096 và mỗi response bắt đầu ở ranh giới chunk, nên flash luôn ghi trọn sector
+ *   (trừ phần lẻ cuối ảnh hoặc response bỏ dở).
+ * - OTA_PIPELINE 0: đọc 512 byte rồi ghi ngay trên task gọi như trước, để đo so sánh thời gian tải.
+ *
+ * Trình tự cho mỗi response: otaPipelineAcquire() → đọc socket vào chỗ trống → otaPipelineProduce(), lặp tới
+ * hết body → otaPipelineDrain() → otaResumeCommit() (hoặc otaResumeRewind() nếu bỏ dở).
+ */
+
+#include <Arduino.h>
+#include "config.h"
+
+struct OtaPipelineStats {
+  bool pipelined;         // Bản build dùng task flash riêng (OTA_PIPELINE)
+  bool running;
+  uint32_t transferMs;    // Lượt gần nhất: từ otaPipelineStart() tới otaPipelineStop()
+  uint32_t bytes;         // Byte body đã nhận trong lượt
+  uint32_t bytesPerSec;
+  uint32_t flashMs;       // Tổng thời gian xóa/ghi flash
+  uint32_t stallMs;       // Phía mạng phải chờ buffer trống (flash chậm hơn mạng)
+  uint32_t flashWrites;
+};
+
+/**
+ * @brief Cấp buffer và task ghi flash cho một lượt tải. Gọi sau otaResumeBegin().
+ * @return false nếu không đủ RAM hoặc không tạo được task.
+ */
+bool otaPipelineStart();
+
+/**
+ * @brief Chỗ trống để đọc socket thẳng vào; chờ khi mọi buffer đang đợi ghi.
+ * @param room Nhận số byte còn trống (> 0).
+ * @return NULL nếu ghi flash đã lỗi.
+ */
+uint8_t* otaPipelineAcquire(size_t& room);
+
+/**
+ * @brief Đã đọc `n` byte vào chỗ vừa lấy; buffer đầy thì chuyển cho task flash.
+ */
+void otaPipelineProduce(size_t n);
+
+/**
+ * @brief Hết body của response: gửi buffer dở rồi chờ task flash ghi xong mọi buffer.
+ * @return false nếu có lỗi ghi flash.
+ */
+bool otaPipelineDrain();
+
+/**
+ * @brief Ghi flash đã lỗi trong lượt này (cờ chỉ xóa ở otaPipelineStart()): caller bỏ cả lượt, không thử lại.
+ */
+bool otaPipelineFailed();
+
+/**
+ * @brief Kết thúc lượt: dừng task flash, trả RAM, chốt số đo.
+ */
+void otaPipelineStop();
+
+OtaPipelineStats otaPipelineGetStats();
+
+#endif
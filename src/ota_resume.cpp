@@ -0,0 +1,236 @@
+#include "ota_resume.h"
+#include <Preferences.h>
+#include <esp_ota_ops.h>
+#include <esp_partition.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * @file ota_resume.cpp
+ * @brief Ghi ảnh OTA theo chunk và checkpoint NVS (xem ota_resume.h).
+ */
+
+#define OTA_SECTOR_BYTES 4096
+
+static_assert(OTA_CHUNK_BYTES % OTA_SECTOR_BYTES == 0, "OTA_CHUNK_BYTES phải là bội số của sector flash 4096");
+static_assert(OTA_RANGE_BYTES % OTA_CHUNK_BYTES == 0, "OTA_RANGE_BYTES phải là bội số của OTA_CHUNK_BYTES");
+
+static const esp_partition_t* part = NULL;
+static bool active = false;
+static bool loaded = false;           // Đã đọc checkpoint NVS (cho otaResumeGetStats khi chưa có lượt tải)
+static uint32_t offset = 0;           // Checkpoint: byte [0, offset) đã ghi xong
+static uint32_t total = 0;
+static uint32_t pos = 0;              // Vị trí ghi kế tiếp (offset + phần chunk đang đọc)
+static uint32_t erasedUntil = 0;      // Sector từ offset tới đây đã xóa trong chunk hiện tại
+static uint32_t requestEnd = 0;       // Response hiện tại ghi tới đây (không kể), otaResumeAccept đặt
+static OtaResumeStats stats = {};
+
+static void saveCheckpoint() {
+  Preferences prefs;
+  if (!prefs.begin(OTA_NVS_NAMESPACE, false)) return;
+  prefs.putUInt("total", total);
+  prefs.putUInt("done", offset);
+  prefs.end();
+}
+
+static void loadCheckpoint() {
+  loaded = true;
+  Preferences prefs;
+  if (!prefs.begin(OTA_NVS_NAMESPACE, true)) return;
+  stats.offset = prefs.getUInt("done", 0);
+  stats.total = prefs.getUInt("total", 0);
+  stats.pending = prefs.isKey("id") && stats.offset > 0;
+  prefs.end();
+}
+
+static void restartFromZero() {
+  offset = 0;
+  pos = 0;
+  erasedUntil = 0;
+}
+
+bool otaResumeBegin(const char* imageId) {
+  part = esp_ota_get_next_update_partition(NULL);
+  if (part == NULL) {
+    Serial.println("[OTA] Không có phân vùng OTA để ghi");
+    return false;
+  }
+  restartFromZero();
+  total = 0;
+
+  Preferences prefs;
+  if (prefs.begin(OTA_NVS_NAMESPACE, false)) {
+    String id = prefs.getString("id", "");
+    uint32_t addr = prefs.getUInt("part", 0);
+    uint32_t done = prefs.getUInt("done", 0);
+    uint32_t size = prefs.getUInt("total", 0);
+    if (id == imageId && addr == part->address && size > 0 && size <= part->size && done < size &&
+        done % OTA_CHUNK_BYTES == 0) {
+      offset = done;
+      pos = done;
+      erasedUntil = done;
+      total = size;
+    } else {
+      // Ảnh khác, phân vùng khác (đã boot sang ảnh vừa ghi) hoặc checkpoint hỏng: làm lại từ đầu
+      prefs.clear();
+      prefs.putString("id", imageId);
+      prefs.putUInt("part", part->address);
+    }
+    prefs.end();
+  }
+
+  active = true;
+  loaded = true;
+  stats.pending = offset > 0;
+  stats.offset = offset;
+  stats.total = total;
+  stats.resumedFrom = offset;
+  if (offset > 0) {
+    Serial.printf("[OTA] Tải tiếp %s từ byte %lu/%lu\n", imageId, (unsigned long)offset, (unsigned long)total);
+  } else {
+    Serial.printf("[OTA] Tải %s vào phân vùng %s\n", imageId, part->label);
+  }
+  return true;
+}
+
+void otaResumeRangeHeader(char* out, size_t outSize) {
+  snprintf(out, outSize, "bytes=%lu-%lu", (unsigned long)offset, (unsigned long)(offset + OTA_RANGE_BYTES - 1));
+}
+
+bool otaParseContentRange(const char* value, uint32_t& start, uint32_t& end, uint32_t& size) {
+  if (value == NULL || strncmp(value, "bytes ", 6) != 0) return false;
+  char* p = NULL;
+  start = strtoul(value + 6, &p, 10);
+  if (p == NULL || *p != '-') return false;
+  end = strtoul(p + 1, &p, 10);
+  if (p == NULL || *p != '/') return false;
+  size = strtoul(p + 1, &p, 10);
+  return *p == '\0' && start <= end && end < size;
+}
+
+long otaResumeAccept(int status, const char* contentRange, long contentLength) {
+  if (!active) return -1;
+  uint32_t start = 0, end = 0, size = 0;
+
+  if (status == 206) {
+    if (!otaParseContentRange(contentRange, start, end, size) || start != offset) {
+      Serial.printf("[OTA] Content-Range không khớp: '%s' (cần từ %lu)\n", contentRange ? contentRange : "",
+                    (unsigned long)offset);
+      return -1;
+    }
+  } else if (status == 200 && contentLength > 0) {
+    // Server bỏ qua Range: body là cả file, ghi lại từ byte 0 (checkpoint vẫn theo từng chunk)
+    if (offset > 0) Serial.println("[OTA] Server không hỗ trợ Range, tải lại từ đầu");
+    restartFromZero();
+    size = (uint32_t)contentLength;
+    start = 0;
+    end = size - 1;
+  } else {
+    if (status == 416) {
+      Serial.println("[OTA] 416: checkpoint vượt quá ảnh trên server, xóa checkpoint");
+      otaResumeClear();
+    }
+    return -1;
+  }
+
+  if (size > part->size) {
+    Serial.printf("[OTA] Ảnh %lu byte lớn hơn phân vùng %lu byte\n", (unsigned long)size, (unsigned long)part->size);
+    return -1;
+  }
+  if (total != size) {
+    if (total != 0 && offset > 0) {
+      // Cùng đường dẫn nhưng file trên server đã đổi: phần đã ghi không dùng được, chunk sau xin lại từ 0
+      Serial.println("[OTA] Kích thước ảnh đã đổi, tải lại từ đầu");
+      restartFromZero();
+      total = 0;
+      saveCheckpoint();
+      stats.offset = 0;
+      return -1;
+    }
+    total = size;
+    stats.total = size;
+    saveCheckpoint();
+  }
+  requestEnd = end + 1;
+  return (long)(end - start + 1);
+}
+
+bool otaResumeWrite(const uint8_t* data, size_t n) {
+  if (!active || pos + n > requestEnd) return false;
+  while (n > 0) {
+    // Cắt tại ranh giới chunk để checkpoint luôn nằm ở bội số của OTA_CHUNK_BYTES
+    uint32_t boundary = offset + OTA_CHUNK_BYTES;
+    size_t piece = n;
+    if (pos + piece > boundary) piece = boundary - pos;
+    if (pos + piece > erasedUntil) {
+      uint32_t to = (uint32_t)((pos + piece + OTA_SECTOR_BYTES - 1) / OTA_SECTOR_BYTES * OTA_SECTOR_BYTES);
+      if (to > part->size) to = part->size;
+      if (esp_partition_erase_range(part, erasedUntil, to - erasedUntil) != ESP_OK) {
+        Serial.printf("[OTA] Xóa flash lỗi tại %lu\n", (unsigned long)erasedUntil);
+        return false;
+      }
+      erasedUntil = to;
+    }
+    if (esp_partition_write(part, pos, data, piece) != ESP_OK) {
+      Serial.printf("[OTA] Ghi flash lỗi tại %lu\n", (unsigned long)pos);
+      return false;
+    }
+    pos += (uint32_t)piece;
+    data += piece;
+    n -= piece;
+    if (pos == boundary) otaResumeCommit();
+  }
+  return true;
+}
+
+void otaResumeCommit() {
+  if (!active || pos == offset) return;
+  offset = pos;
+  saveCheckpoint();
+  stats.offset = offset;
+  stats.pending = offset < total;
+  stats.chunks++;
+}
+
+void otaResumeRewind() {
+  if (!active || pos == offset) return;
+  Serial.printf("[OTA] Chunk bỏ dở tại %lu, lần sau tải lại từ %lu\n", (unsigned long)pos, (unsigned long)offset);
+  pos = offset;
+  erasedUntil = offset;  // Sector đã ghi dở phải xóa lại trước khi ghi
+  stats.rewinds++;
+}
+
+bool otaResumeDone() {
+  return active && total > 0 && offset >= total;
+}
+
+bool otaResumeFinish() {
+  if (!otaResumeDone()) return false;
+  // esp_ota_set_boot_partition kiểm header và SHA-256 của ảnh trước khi ghi otadata
+  esp_err_t err = esp_ota_set_boot_partition(part);
+  otaResumeClear();
+  if (err != ESP_OK) {
+    Serial.printf("[OTA] Ảnh không hợp lệ (%s), bỏ\n", esp_err_to_name(err));
+    return false;
+  }
+  Serial.printf("[OTA] Ảnh %lu byte hợp lệ, boot lần sau từ %s\n", (unsigned long)stats.total, part->label);
+  return true;
+}
+
+void otaResumeClear() {
+  Preferences prefs;
+  if (prefs.begin(OTA_NVS_NAMESPACE, false)) {
+    prefs.clear();
+    prefs.end();
+  }
+  active = false;
+  restartFromZero();
+  total = 0;
+  stats.pending = false;
+  stats.offset = 0;
+}
+
+OtaResumeStats otaResumeGetStats() {
+  if (!loaded) loadCheckpoint();
+  return stats;
+}
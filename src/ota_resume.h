@@ -0,0 +1,89 @@
+#ifndef OTA_RESUME_H
+#define OTA_RESUME_H
+
+/**
+ * @file ota_resume.h
+ * @brief OTA tải tiếp được: ảnh firmware tải theo từng khoảng Range OTA_RANGE_BYTES, ghi thẳng vào phân vùng
+ * OTA không chạy (esp_partition), mỗi OTA_CHUNK_BYTES ghi xong thì lưu checkpoint NVS (ảnh nào, dài bao
+ * nhiêu, đã ghi tới đâu). Rớt mạng hay khởi động lại giữa chừng thì lần tải sau cùng ảnh bắt đầu từ checkpoint.
+ *
+ * Trình tự cho một lượt tải (WiFi hay 4G như nhau):
+ *   otaResumeBegin(id) → lặp tới otaResumeDone(): gửi GET với otaResumeRangeHeader(), otaResumeAccept()
+ *   trên status/header, đọc đúng số byte trả về vào otaResumeWrite(), đọc đủ thì otaResumeCommit(),
+ *   lỗi giữa chừng thì otaResumeRewind() → otaResumeFinish().
+ *
+ * - Không dùng lớp Update: Update.begin() luôn ghi lại từ đầu phân vùng nên không tiếp được sau reboot.
+ * - Phân vùng chỉ được chọn để boot khi đủ byte và esp_ota_set_boot_partition() kiểm ảnh (header,
+ *   SHA-256) thành công; ảnh dở dang không bao giờ được boot.
+ * - Mỗi lúc một lượt OTA (không khóa). Khi chạy qua ota_pipeline, otaResumeWrite() chạy trên task flash;
+ *   các hàm còn lại chỉ gọi sau otaPipelineDrain().
+ */
+
+#include <Arduino.h>
+#include "config.h"
+
+struct OtaResumeStats {
+  bool pending;              // Có checkpoint chưa xong (tải tiếp được)
+  uint32_t offset;           // Byte đã ghi và đã checkpoint
+  uint32_t total;            // Kích thước ảnh, 0 = chưa biết
+  uint32_t resumedFrom;      // Lượt gần nhất bắt đầu từ byte này (0 = tải từ đầu)
+  uint32_t chunks;           // Chunk đã ghi xong (từ lúc boot)
+  uint32_t rewinds;          // Chunk bỏ dở phải tải lại
+};
+
+/**
+ * @brief Bắt đầu (hoặc tiếp) lượt tải ảnh `imageId` (đường dẫn tải, ví dụ "/api/firmware/download/1.0.3").
+ * Checkpoint của ảnh khác hoặc phân vùng khác bị bỏ.
+ * @return false nếu không có phân vùng OTA để ghi.
+ */
+bool otaResumeBegin(const char* imageId);
+
+/**
+ * @brief Header Range cho request kế tiếp: "bytes=<offset>-<offset+OTA_RANGE_BYTES-1>".
+ */
+void otaResumeRangeHeader(char* out, size_t outSize);
+
+/**
+ * @brief Kiểm tra response trước khi đọc body.
+ * @param status 206 cần `contentRange` ("bytes a-b/total") khớp offset; 200 (server bỏ qua Range) thì ghi
+ * lại cả file từ byte 0.
+ * @param contentLength Content-Length của response, -1 nếu không có.
+ * @return Số byte body cần đọc cho chunk này, -1 nếu response không dùng được (416 thì checkpoint bị xóa).
+ */
+long otaResumeAccept(int status, const char* contentRange, long contentLength);
+
+/**
+ * @brief Ghi tiếp `n` byte body (xóa sector flash trước khi ghi vào); tự checkpoint mỗi khi ghi đủ một chunk.
+ */
+bool otaResumeWrite(const uint8_t* data, size_t n);
+
+/**
+ * @brief Đã đọc đủ body của response: checkpoint cả phần lẻ cuối ảnh.
+ */
+void otaResumeCommit();
+
+/**
+ * @brief Response bỏ dở: lần ghi sau bắt đầu lại từ checkpoint.
+ */
+void otaResumeRewind();
+
+bool otaResumeDone();
+
+/**
+ * @brief Đủ byte: kiểm ảnh, chọn phân vùng để boot lần sau, xóa checkpoint.
+ */
+bool otaResumeFinish();
+
+/**
+ * @brief Bỏ lượt tải và checkpoint.
+ */
+void otaResumeClear();
+
+OtaResumeStats otaResumeGetStats();
+
+/**
+ * @brief Tách "bytes <start>-<end>/<total>" của header Content-Range.
+ */
+bool otaParseContentRange(const char* value, uint32_t& start, uint32_t& end, uint32_t& total);
+
+#endif
@@ -0,0 +1,74 @@
+#include "risk_fusion.h"
+#include <math.h>
+
+/**
+ * @file risk_fusion.cpp
+ * @brief Chuẩn hóa từng kênh, cộng trọng số và ánh xạ điểm → mức rủi ro.
+ */
+
+/**
+ * @brief Ánh xạ tuyến tính x trong [lo, hi] về [0, 1], cắt hai đầu.
+ */
+static float ramp(float x, float lo, float hi) {
+  if (isnan(x) || x <= lo) return 0.0f;
+  if (x >= hi) return 1.0f;
+  return (x - lo) / (hi - lo);
+}
+
+/**
+ * @brief Mức theo điểm: lên mức khi chạm ngưỡng bật, mức đang giữ chỉ rời khi tụt quá RISK_LEVEL_HYST_SCORE.
+ */
+static RiskLevel levelForScore(uint8_t score, RiskLevel previous) {
+  static const int enterScore[] = { 0, RISK_LEVEL_WATCH_SCORE, RISK_LEVEL_WARNING_SCORE, RISK_LEVEL_CRITICAL_SCORE };
+  for (int level = RISK_CRITICAL; level > RISK_NORMAL; level--) {
+    int margin = level <= previous ? RISK_LEVEL_HYST_SCORE : 0;
+    if (score >= enterScore[level] - margin) return (RiskLevel)level;
+  }
+  return RISK_NORMAL;
+}
+
+RiskAssessment riskEvaluate(const RiskInputs& in) {
+  RiskAssessment out;
+  bool tempValid = in.temperature > -100.0f;  // DEVICE_DISCONNECTED_C = -127
+  bool warm = tempValid && in.temperature >= TEMP_WARM_THRESHOLD;
+
+  // Pin đã nóng thì hạ ngưỡng khí để bắt xì khí sớm hơn
+  out.smokeThreshold = warm ? (int)(SMOKE_THRESHOLD * TEMP_SMOKE_THRESHOLD_MULTIPLIER) : SMOKE_THRESHOLD;
+
+  float temp = tempValid ? ramp(in.temperature, TEMP_WARM_THRESHOLD, TEMP_THRESHOLD) : 0.0f;
+  float rise = ramp(in.tempRiseRate, 0.0f, TEMP_RISE_LIMIT_C_PER_MIN);
+  float smoke = ramp((float)in.smokeValue, out.smokeThreshold * 0.5f, (float)out.smokeThreshold);
+  float smokeRise = ramp(in.smokeRiseRate, 0.0f, SMOKE_RISE_LIMIT_PER_MIN);
+  float fire = in.fireDigital ? 1.0f
+                              : ramp((float)(FIRE_ANALOG_THRESHOLD * 2 - in.fireValue10),
+                                     (float)FIRE_ANALOG_THRESHOLD, (float)FIRE_ANALOG_THRESHOLD * 2);
+
+  out.crossHotGas = warm && smokeRise > 0.0f && (smoke > 0.0f || smokeRise >= 0.5f);
+
+  float score = RISK_WEIGHT_TEMP * temp + RISK_WEIGHT_TEMP_RISE * rise + RISK_WEIGHT_SMOKE * smoke +
+                RISK_WEIGHT_SMOKE_RISE * smokeRise + RISK_WEIGHT_FIRE * fire;
+  if (out.crossHotGas) score += RISK_CROSS_HOT_GAS_BONUS;
+  if (score > 100.0f) score = 100.0f;
+  out.score = (uint8_t)lroundf(score);
+
+  // Vượt ngưỡng tuyệt đối của bất kỳ kênh nào luôn là CRITICAL, không phụ thuộc trọng số. Đang CRITICAL thì
+  // so với ngưỡng tắt (ngưỡng bật lùi ALERT_HYST_*) để nhiễu quanh ngưỡng không làm mức dao động
+  bool held = in.previous >= RISK_CRITICAL;
+  float tempLimit = TEMP_THRESHOLD - (held ? ALERT_HYST_TEMP_C : 0.0f);
+  float riseLimit = TEMP_RISE_LIMIT_C_PER_MIN - (held ? ALERT_HYST_TEMP_RISE : 0.0f);
+  int smokeLimit = out.smokeThreshold - (held ? ALERT_HYST_SMOKE : 0);
+  int fireLimit = FIRE_ANALOG_THRESHOLD + (held ? ALERT_HYST_FIRE : 0);
+  bool hardAlert = (tempValid && in.temperature > tempLimit) || in.smokeValue > smokeLimit || in.fireDigital ||
+                   in.fireValue10 < fireLimit || (!isnan(in.tempRiseRate) && in.tempRiseRate > riseLimit);
+  out.level = hardAlert ? RISK_CRITICAL : levelForScore(out.score, in.previous);
+  return out;
+}
+
+const char* riskLevelName(RiskLevel level) {
+  switch (level) {
+    case RISK_WATCH: return "watch";
+    case RISK_WARNING: return "warning";
+    case RISK_CRITICAL: return "critical";
+    default: return "normal";
+  }
+}
@@ -0,0 +1,53 @@
+#ifndef RISK_FUSION_H
+#define RISK_FUSION_H
+
+/**
+ * @file risk_fusion.h
+ * @brief Gộp nhiệt độ, tốc độ tăng nhiệt, MQ-135 (mức + xu hướng) và KY-026 thành một điểm rủi ro.
+ *
+ * Mỗi kênh được chuẩn hóa về 0..1 rồi nhân trọng số (RISK_WEIGHT_* trong config.h); thêm điểm
+ * cộng khi các điều kiện chéo cùng xuất hiện (pin nóng + khí tăng = dấu hiệu xì khí sớm).
+ * Hàm đánh giá thuần túy, không cấp phát, không giữ trạng thái: caller đưa lại mức của lượt trước để
+ * mức chỉ hạ khi đã qua ngưỡng tắt (ngưỡng tuyệt đối dùng cùng biên ALERT_HYST_* với alert_fsm, điểm dùng
+ * RISK_LEVEL_HYST_SCORE), tránh đường upload nhảy qua lại giữa khẩn và thường quanh một ngưỡng.
+ */
+
+#include <stdint.h>
+#include "config.h"
+
+// Mức nghiêm trọng, tăng dần; upload gấp chỉ dùng cho RISK_CRITICAL
+enum RiskLevel : uint8_t {
+  RISK_NORMAL = 0,
+  RISK_WATCH = 1,     // Có dấu hiệu bất thường, chỉ ghi nhận
+  RISK_WARNING = 2,   // Bật còi, upload sớm qua đường thường
+  RISK_CRITICAL = 3   // Bật còi, upload gấp qua đường critical
+};
+
+struct RiskInputs {
+  float temperature;      // °C, đầu dò nóng nhất (DEVICE_DISCONNECTED_C nếu không có)
+  float tempRiseRate;     // °C/phút, NAN nếu chưa đủ cửa sổ
+  int smokeValue;         // MQ-135 sau lọc (0..4095)
+  float smokeRiseRate;    // Đơn vị ADC/phút, NAN nếu chưa đủ cửa sổ
+  int fireValue10;        // KY-026 10-bit, thấp = gần lửa
+  bool fireDigital;       // DO KY-026 đang báo (fire_fastpath)
+  RiskLevel previous;     // Mức của lượt đánh giá trước (hysteresis)
+};
+
+struct RiskAssessment {
+  uint8_t score;               // 0..100
+  RiskLevel level;
+  int smokeThreshold;          // Ngưỡng MQ-135 thực tế (hạ theo TEMP_SMOKE_THRESHOLD_MULTIPLIER khi nóng)
+  bool crossHotGas;            // Điều kiện chéo pin nóng + khí tăng đang đúng
+};
+
+/**
+ * @brief Tính điểm và mức rủi ro cho một lượt đánh giá.
+ */
+RiskAssessment riskEvaluate(const RiskInputs& in);
+
+/**
+ * @brief Tên mức rủi ro dạng chữ thường ("normal", "watch", "warning", "critical") cho JSON/backend.
+ */
+const char* riskLevelName(RiskLevel level);
+
+#endif
@@ -0,0 +1,108 @@
+#include "sensor_scheduler.h"
+#include <esp_timer.h>
+
+/**
+ * @file sensor_scheduler.cpp
+ * @brief Hiện thực bảng kênh cố định + chọn hạn sớm nhất (số kênh nhỏ nên quét tuyến tính là đủ).
+ */
+
+struct SensorChannel {
+  SensorChannelFn fn;
+  void* ctx;
+  int64_t dueUs;          // Thời điểm hẹn chạy kế tiếp (esp_timer, µs)
+  SensorChannelStats stats;
+};
+
+static SensorChannel channels[SENSOR_SCHED_MAX_CHANNELS];
+static uint8_t channelCount = 0;
+static portMUX_TYPE statsMux = portMUX_INITIALIZER_UNLOCKED;  // Bảo vệ stats khi web đọc
+
+int sensorSchedulerRegister(const char* name, uint32_t periodMs, uint32_t budgetUs,
+                            SensorChannelFn fn, void* ctx) {
+  if (channelCount >= SENSOR_SCHED_MAX_CHANNELS || fn == NULL || periodMs == 0) return -1;
+  SensorChannel& ch = channels[channelCount];
+  memset(&ch, 0, sizeof(ch));
+  ch.fn = fn;
+  ch.ctx = ctx;
+  ch.dueUs = esp_timer_get_time();
+  ch.stats.name = name;
+  ch.stats.periodMs = periodMs;
+  ch.stats.budgetUs = budgetUs;
+  return channelCount++;
+}
+
+/**
+ * @brief Chạy một kênh, cập nhật thống kê và tính hạn kế tiếp.
+ *
+ * Hạn kế tiếp tính từ hạn cũ (không từ thời điểm chạy) để jitter không cộng dồn thành trôi chu kỳ.
+ * Nếu đã trễ quá một chu kỳ thì bỏ qua các chu kỳ lỡ và đếm vào `missed`.
+ */
+static void runChannel(SensorChannel& ch, int64_t nowUs) {
+  uint32_t jitterUs = (uint32_t)(nowUs - ch.dueUs);
+  uint32_t nextMs = ch.fn(ch.ctx);
+  int64_t endUs = esp_timer_get_time();
+  uint32_t execUs = (uint32_t)(endUs - nowUs);
+
+  int64_t stepUs = (int64_t)(nextMs ? nextMs : ch.stats.periodMs) * 1000;
+  uint32_t missed = 0;
+  ch.dueUs += stepUs;
+  if (ch.dueUs <= endUs) {
+    int64_t behind = endUs - ch.dueUs;
+    missed = (uint32_t)(behind / stepUs) + 1;
+    ch.dueUs += (int64_t)missed * stepUs;
+  }
+
+  portENTER_CRITICAL(&statsMux);
+  SensorChannelStats& st = ch.stats;
+  st.runs++;
+  st.missed += missed;
+  st.lastJitterUs = jitterUs;
+  if (jitterUs > st.maxJitterUs) st.maxJitterUs = jitterUs;
+  st.avgJitterUs = (st.runs == 1) ? jitterUs : st.avgJitterUs + ((int32_t)jitterUs - (int32_t)st.avgJitterUs) / 8;
+  st.lastExecUs = execUs;
+  if (execUs > st.maxExecUs) st.maxExecUs = execUs;
+  if (st.budgetUs && execUs > st.budgetUs) st.overruns++;
+  portEXIT_CRITICAL(&statsMux);
+}
+
+uint32_t sensorSchedulerRunDue() {
+  // Chạy lần lượt các kênh tới hạn, hạn sớm nhất trước
+  while (true) {
+    int64_t nowUs = esp_timer_get_time();
+    int earliest = -1;
+    for (uint8_t i = 0; i < channelCount; i++) {
+      if (channels[i].dueUs <= nowUs && (earliest < 0 || channels[i].dueUs < channels[earliest].dueUs)) {
+        earliest = i;
+      }
+    }
+    if (earliest < 0) break;
+    runChannel(channels[earliest], nowUs);
+  }
+
+  int64_t nowUs = esp_timer_get_time();
+  int64_t nextUs = INT64_MAX;
+  for (uint8_t i = 0; i < channelCount; i++) {
+    if (channels[i].dueUs < nextUs) nextUs = channels[i].dueUs;
+  }
+  if (nextUs == INT64_MAX) return 100;
+  int64_t waitMs = (nextUs - nowUs + 999) / 1000;
+  return waitMs < 1 ? 1 : (uint32_t)waitMs;
+}
+
+void sensorSchedulerTrigger(int index) {
+  if (index < 0 || index >= channelCount) return;
+  int64_t nowUs = esp_timer_get_time();
+  if (channels[index].dueUs > nowUs) channels[index].dueUs = nowUs;
+}
+
+uint8_t sensorSchedulerChannelCount() {
+  return channelCount;
+}
+
+bool sensorSchedulerGetStats(uint8_t index, SensorChannelStats& out) {
+  if (index >= channelCount) return false;
+  portENTER_CRITICAL(&statsMux);
+  out = channels[index].stats;
+  portEXIT_CRITICAL(&statsMux);
+  return true;
+}
@@ -0,0 +1,66 @@
+#ifndef SENSOR_SCHEDULER_H
+#define SENSOR_SCHEDULER_H
+
+/**
+ * @file sensor_scheduler.h
+ * @brief Bộ lập lịch hợp tác cho các kênh cảm biến, mỗi kênh có chu kỳ và ngân sách riêng.
+ *
+ * Chạy bên trong sensorTask: mỗi vòng gọi sensorSchedulerRunDue() để chạy các kênh đã tới hạn
+ * (hạn sớm nhất trước), rồi ngủ đúng tới hạn kế tiếp. Mỗi kênh tự giữ bộ lọc của mình trong
+ * callback; scheduler chỉ lo thời điểm chạy và thống kê jitter/overrun.
+ */
+
+#include <Arduino.h>
+#include "config.h"
+
+/**
+ * @brief Callback của một kênh.
+ * @return Số ms tới lần chạy kế tiếp; 0 = dùng chu kỳ đã đăng ký (cho phép kênh 2 pha như DS18B20).
+ */
+typedef uint32_t (*SensorChannelFn)(void* ctx);
+
+// Thống kê của một kênh (bản sao, đọc an toàn từ task khác)
+struct SensorChannelStats {
+  const char* name;
+  uint32_t periodMs;
+  uint32_t budgetUs;      // Thời gian chạy tối đa mong muốn mỗi lần
+  uint32_t runs;
+  uint32_t overruns;      // Số lần chạy vượt budgetUs
+  uint32_t missed;        // Số chu kỳ bị bỏ lỡ hoàn toàn (trễ hơn một chu kỳ)
+  uint32_t lastJitterUs;  // Độ trễ so với thời điểm hẹn của lần chạy gần nhất
+  uint32_t maxJitterUs;
+  uint32_t avgJitterUs;   // Trung bình mũ (alpha = 1/8)
+  uint32_t lastExecUs;
+  uint32_t maxExecUs;
+};
+
+/**
+ * @brief Đăng ký một kênh; lần chạy đầu tiên ngay ở vòng kế tiếp.
+ * @return Chỉ số kênh, hoặc -1 nếu hết chỗ (SENSOR_SCHED_MAX_CHANNELS).
+ */
+int sensorSchedulerRegister(const char* name, uint32_t periodMs, uint32_t budgetUs,
+                            SensorChannelFn fn, void* ctx);
+
+/**
+ * @brief Chạy mọi kênh đã tới hạn.
+ * @return Số ms tới hạn gần nhất (để caller ngủ), tối thiểu 1.
+ */
+uint32_t sensorSchedulerRunDue();
+
+/**
+ * @brief Đưa kênh `index` về hạn ngay lập tức (vd. sau ngắt báo cháy), không đổi nhịp các kênh khác.
+ */
+void sensorSchedulerTrigger(int index);
+
+/**
+ * @brief Số kênh đã đăng ký.
+ */
+uint8_t sensorSchedulerChannelCount();
+
+/**
+ * @brief Sao chép thống kê của kênh `index`.
+ * @return false nếu chỉ số không hợp lệ.
+ */
+bool sensorSchedulerGetStats(uint8_t index, SensorChannelStats& out);
+
+#endif
@@ -0,0 +1,33 @@
+#ifndef SENSOR_SNAPSHOT_H
+#define SENSOR_SNAPSHOT_H
+
+/**
+ * @file sensor_snapshot.h
+ * @brief Bản chụp bất biến của toàn bộ số liệu cảm biến và cờ cảnh báo.
+ *
+ * sensorTask là nơi duy nhất ghi snapshot (qua Seqlock). Web UI, API, upload và networkTask
+ * chỉ đọc bản sao, không đụng trực tiếp vào biến của task lấy mẫu.
+ */
+
+#include <stdint.h>
+#include "config.h"
+#include "seqlock.h"
+
+struct SensorSnapshot {
+  uint32_t sampledAtMs;   // millis() lúc publish
+  float temperature;      // °C, đầu dò DS18B20 nóng nhất
+  uint8_t probeCount;     // Số đầu dò đang quản lý
+  float probeTemps[MAX_TEMP_PROBES];  // °C từng đầu dò, NAN nếu lỗi
+  float tempRiseRate;     // °C/phút lớn nhất trong các đầu dò, NAN nếu chưa đủ cửa sổ
+  int smokeValue;         // MQ-135 sau lọc (0..4095)
+  int fireValue10;        // KY-026 10-bit (0..1023)
+  uint8_t riskScore;      // Điểm rủi ro gộp 0..100 (risk_fusion)
+  uint8_t riskLevel;      // RiskLevel
+  bool tempAlert;
+  bool tempRiseAlert;     // Tốc độ tăng nhiệt vượt TEMP_RISE_LIMIT_C_PER_MIN
+  bool smokeAlert;
+  bool fireAlert;
+  bool alertActive;       // Trạng thái cảnh báo tổng (còi/LED)
+};
+
+#endif
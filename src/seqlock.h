@@ -0,0 +1,55 @@
+#ifndef SEQLOCK_H
+#define SEQLOCK_H
+
+/**
+ * @file seqlock.h
+ * @brief Seqlock một writer / nhiều reader để phát hành snapshot giữa các task FreeRTOS.
+ *
+ * Writer không bao giờ chờ reader; reader không khóa writer mà chỉ đọc lại khi phát hiện
+ * writer đang ghi dở (số thứ tự lẻ hoặc thay đổi trong lúc copy), nên không thể thấy giá trị rách.
+ * T phải là kiểu copy được bằng memcpy (struct POD).
+ *
+ * Lưu ý: writer nên chạy ở priority cao hơn reader cùng core để reader không quay vòng
+ * trong khi writer bị chiếm CPU giữa chừng.
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include <atomic>
+
+template <typename T>
+class Seqlock {
+ public:
+  Seqlock() { memset(&data_, 0, sizeof(T)); }
+
+  // Chỉ được gọi từ một task writer duy nhất
+  void publish(const T& value) {
+    uint32_t s = seq_.load(std::memory_order_relaxed);
+    seq_.store(s + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    memcpy(&data_, &value, sizeof(T));
+    seq_.store(s + 2, std::memory_order_release);
+  }
+
+  // Gọi được từ mọi task; trả về bản sao nhất quán của lần publish gần nhất
+  T read() const {
+    T out;
+    uint32_t before, after;
+    do {
+      before = seq_.load(std::memory_order_acquire);
+      memcpy(&out, &data_, sizeof(T));
+      std::atomic_thread_fence(std::memory_order_acquire);
+      after = seq_.load(std::memory_order_relaxed);
+    } while ((before & 1) || before != after);
+    return out;
+  }
+
+  // Số lần đã publish (0 = chưa có dữ liệu)
+  uint32_t version() const { return seq_.load(std::memory_order_acquire) / 2; }
+
+ private:
+  T data_;
+  std::atomic<uint32_t> seq_{0};
+};
+
+#endif
@@ -0,0 +1,96 @@
+#include "telemetry_codec.h"
+
+/**
+ * @file telemetry_codec.cpp
+ * @brief Bộ ghi varint/zigzag vào buffer cố định và mã hóa frame v2 (xem telemetry_codec.h).
+ */
+
+struct FrameWriter {
+  uint8_t* p;
+  uint8_t* end;
+  bool overflow;
+};
+
+static void putByte(FrameWriter& w, uint8_t b) {
+  if (w.p >= w.end) {
+    w.overflow = true;
+    return;
+  }
+  *w.p++ = b;
+}
+
+static void putVarint(FrameWriter& w, uint32_t v) {
+  while (v >= 0x80) {
+    putByte(w, (uint8_t)(v | 0x80));
+    v >>= 7;
+  }
+  putByte(w, (uint8_t)v);
+}
+
+static void putZigzag(FrameWriter& w, int32_t v) {
+  putVarint(w, ((uint32_t)v << 1) ^ (uint32_t)(v >> 31));
+}
+
+size_t telemetryEncodeFrame(const char* deviceId, const TelemetryRecord* recs, uint32_t count,
+                            uint32_t nowMs, uint16_t currentBootId, uint16_t epoch, uint8_t* out, size_t capacity) {
+  size_t idLen = strlen(deviceId);
+  if (idLen > TELEMETRY_FRAME_DEVICE_ID_MAX) return 0;
+
+  FrameWriter w = { out, out + capacity, false };
+  putByte(w, TELEMETRY_FRAME_VERSION);
+  putByte(w, (uint8_t)idLen);
+  for (size_t i = 0; i < idLen; i++) putByte(w, (uint8_t)deviceId[i]);
+  putVarint(w, epoch);
+  putVarint(w, count);
+
+  // Trạng thái tham chiếu cho delta, bộ giải mã giữ đúng trạng thái này
+  uint32_t prevSeq = 0;
+  int32_t prevBoot = 0;
+  uint32_t prevAge = 0;
+  int32_t prevTemp = 0;
+  int32_t prevRise = 0;
+  int32_t prevSmoke = 0;
+  int32_t prevFire = 0;
+  int32_t prevProbe[MAX_TEMP_PROBES] = {};
+  uint8_t prevProbeCount = 0;
+
+  for (uint32_t r = 0; r < count && !w.overflow; r++) {
+    const TelemetryRecord& rec = recs[r];
+    bool hasAge = (rec.bootId == currentBootId);
+    uint8_t probeCount = rec.probeCount > MAX_TEMP_PROBES ? MAX_TEMP_PROBES : rec.probeCount;
+
+    putByte(w, (uint8_t)((rec.flags & 0x1F) | ((rec.kind & 0x03) << 5) | (hasAge ? 0x80 : 0)));
+    putByte(w, (uint8_t)((probeCount & 0x0F) | ((rec.riskLevel & 0x03) << 4)));
+    putByte(w, rec.riskScore);
+
+    // Hiệu số tính trên uint32 rồi ép int32: đúng cả khi seq/age quay vòng
+    putZigzag(w, (int32_t)(rec.seq - prevSeq));
+    prevSeq = rec.seq;
+    putZigzag(w, (int32_t)rec.bootId - prevBoot);
+    prevBoot = rec.bootId;
+    if (hasAge) {
+      uint32_t age = nowMs - rec.uptimeMs;
+      putZigzag(w, (int32_t)(age - prevAge));
+      prevAge = age;
+    }
+
+    putZigzag(w, rec.temperatureCenti - prevTemp);
+    prevTemp = rec.temperatureCenti;
+    putZigzag(w, rec.tempRiseCenti - prevRise);
+    prevRise = rec.tempRiseCenti;
+
+    for (uint8_t i = 0; i < probeCount; i++) {
+      int32_t ref = (i < prevProbeCount) ? prevProbe[i] : rec.temperatureCenti;
+      putZigzag(w, rec.probeCenti[i] - ref);
+      prevProbe[i] = rec.probeCenti[i];
+    }
+    prevProbeCount = probeCount;
+
+    putZigzag(w, (int32_t)rec.smokeValue - prevSmoke);
+    prevSmoke = rec.smokeValue;
+    putZigzag(w, (int32_t)rec.fireValue10 - prevFire);
+    prevFire = rec.fireValue10;
+  }
+
+  return w.overflow ? 0 : (size_t)(w.p - out);
+}
@@ -0,0 +1,58 @@
+#ifndef TELEMETRY_CODEC_H
+#define TELEMETRY_CODEC_H
+
+/**
+ * @file telemetry_codec.h
+ * @brief Mã hóa TelemetryRecord thành frame nhị phân có phiên bản (varint + delta), thay cho JSON
+ * khi gửi qua 4G. Bộ mã hóa không cấp phát: ghi thẳng vào buffer của caller.
+ *
+ * Frame v2 (mọi số nguyên nhiều byte là varint LEB128; "zz" = zigzag cho số có dấu):
+ *
+ *   u8      version (= TELEMETRY_FRAME_VERSION)
+ *   u8      độ dài device_id, theo sau là các byte device_id
+ *   varint  epoch NVS (tlogEpoch())
+ *   varint  số bản ghi
+ *   bản ghi lặp lại:
+ *     u8      bit0-4 TelemetryFlag, bit5-6 TelemetryKind, bit7 có age_ms
+ *     u8      bit0-3 probeCount, bit4-5 riskLevel
+ *     u8      riskScore
+ *     zz      seq          - seq bản ghi trước (bản ghi đầu: so với 0)
+ *     zz      bootId       - bootId bản ghi trước (bản ghi đầu: so với 0)
+ *     zz      age_ms       - age_ms bản ghi trước có age (chỉ khi bit7; lần đầu so với 0)
+ *     zz      temperatureCenti - bản ghi trước
+ *     zz      tempRiseCenti    - bản ghi trước
+ *     zz      probeCenti[i]    - probeCenti[i] bản ghi trước (i ngoài probeCount trước: so với temperatureCenti)
+ *     zz      smokeValue   - bản ghi trước
+ *     zz      fireValue10  - bản ghi trước
+ *
+ * Backend khử trùng theo (device_id, boot_id, seq) với boot_id = epoch << 16 | bootId (tlogBootKey()):
+ * seq chỉ duy nhất trong một boot_id, kể cả khi NVS bị xóa và seq đếm lại từ 1. Frame v1 (không có
+ * epoch/bootId) vẫn được backend nhận.
+ * seq 0 nghĩa là bản ghi không có seq (cảnh báo khẩn gửi thẳng, chưa qua telemetry_log): bộ giải mã trả
+ * null như đường JSON bỏ trường "seq", để backend không khử trùng các cảnh báo khẩn với nhau.
+ * TLOG_NULL_CENTI được mã hóa như mọi giá trị int16 khác nên null đi qua nguyên vẹn. Bộ giải mã phía
+ * backend ở battery_backend/backend/app/codec.py, chọn theo Content-Type TELEMETRY_FRAME_CONTENT_TYPE.
+ */
+
+#include <Arduino.h>
+#include "telemetry_log.h"
+
+#define TELEMETRY_FRAME_VERSION 2
+#define TELEMETRY_FRAME_CONTENT_TYPE "application/vnd.battery-telemetry"
+
+// Cận trên kích thước: header (version + len + 32 byte id + varint epoch + varint count) và từng bản ghi
+// (3 byte cố định + 2 varint 32-bit + (5 + MAX_TEMP_PROBES) delta 17-bit tối đa 3 byte)
+#define TELEMETRY_FRAME_DEVICE_ID_MAX 32
+#define TELEMETRY_FRAME_HEADER_MAX_BYTES (2 + TELEMETRY_FRAME_DEVICE_ID_MAX + 3 + 5)
+#define TELEMETRY_FRAME_RECORD_MAX_BYTES (3 + 2 * 5 + 3 * (5 + MAX_TEMP_PROBES))
+
+/**
+ * @brief Mã hóa `count` bản ghi thành một frame.
+ * @param nowMs millis() lúc gửi; bản ghi có bootId == currentBootId kèm age_ms = nowMs - uptimeMs.
+ * @param epoch tlogEpoch(), ghi một lần ở header.
+ * @return Số byte đã ghi, 0 nếu `capacity` không đủ hoặc device_id quá dài.
+ */
+size_t telemetryEncodeFrame(const char* deviceId, const TelemetryRecord* recs, uint32_t count,
+                            uint32_t nowMs, uint16_t currentBootId, uint16_t epoch, uint8_t* out, size_t capacity);
+
+#endif
@@ -0,0 +1,336 @@
+#include "telemetry_log.h"
+#include <SPIFFS.h>
+#include <Preferences.h>
+#include <esp_rom_crc.h>
+
+/**
+ * @file telemetry_log.cpp
+ * @brief Hiện thực ring log segment trên SPIFFS.
+ *
+ * Chi phí ghi: mỗi bản ghi là một lần append + close (SPIFFS ghi 1 trang 256 B + metadata);
+ * NVS chỉ bị ghi khi xoay segment và mỗi TLOG_CURSOR_COMMIT_EVERY bản ghi đã gửi.
+ * SPIFFS tự cân bằng hao mòn trên toàn phân vùng nên xoay segment không dồn ghi vào một block.
+ */
+
+static const char* TLOG_NVS_NAMESPACE = "tlog";
+static const size_t TLOG_RECORD_SIZE = sizeof(TelemetryRecord);
+
+static SemaphoreHandle_t tlogMutex = NULL;
+static uint32_t headSeg = 0;        // Segment đang append
+static uint32_t headCount = 0;      // Số bản ghi (kể cả hỏng) trong segment head
+static bool headSealed = false;     // Segment head có mảnh ghi dở: không append nối tiếp nữa
+static uint32_t tailSeg = 0;        // Segment đang đọc
+static uint32_t tailIndex = 0;      // Bản ghi kế tiếp cần đọc trong segment tail
+static uint32_t nextSeq = 1;
+static uint32_t depth = 0;
+static uint32_t acksSinceCommit = 0;
+static uint16_t bootId = 0;
+static uint16_t epoch = 0;
+
+static TelemetryLogStats stats = {};
+static uint32_t rateWindowStart = 0;
+static uint32_t rateWindowCount = 0;
+
+static void segPath(uint32_t seg, char* buf, size_t len) {
+  snprintf(buf, len, "/tlog/%08lx.seg", (unsigned long)seg);
+}
+
+static uint32_t segRecordCount(uint32_t seg) {
+  char path[24];
+  segPath(seg, path, sizeof(path));
+  File f = SPIFFS.open(path, FILE_READ);
+  if (!f) return 0;
+  uint32_t n = f.size() / TLOG_RECORD_SIZE;
+  f.close();
+  return n;
+}
+
+static uint32_t recordCrc(const TelemetryRecord& rec) {
+  return esp_rom_crc32_le(0, (const uint8_t*)&rec, offsetof(TelemetryRecord, crc));
+}
+
+static bool readRecord(uint32_t seg, uint32_t index, TelemetryRecord& out) {
+  char path[24];
+  segPath(seg, path, sizeof(path));
+  File f = SPIFFS.open(path, FILE_READ);
+  if (!f) return false;
+  bool ok = f.seek(index * TLOG_RECORD_SIZE) && f.read((uint8_t*)&out, TLOG_RECORD_SIZE) == TLOG_RECORD_SIZE;
+  f.close();
+  return ok;
+}
+
+static void commitPointers(bool withCursor) {
+  Preferences prefs;
+  if (!prefs.begin(TLOG_NVS_NAMESPACE, false)) return;
+  prefs.putULong("head", headSeg);
+  prefs.putULong("tail", tailSeg);
+  prefs.putULong("seq", nextSeq);
+  if (withCursor) prefs.putULong("rd", tailIndex);
+  prefs.end();
+  acksSinceCommit = 0;
+}
+
+static void deleteTailSegment() {
+  char path[24];
+  segPath(tailSeg, path, sizeof(path));
+  SPIFFS.remove(path);
+  tailSeg++;
+  tailIndex = 0;
+}
+
+uint16_t tlogBootId() {
+  return bootId;
+}
+
+uint16_t tlogEpoch() {
+  return epoch;
+}
+
+uint32_t tlogBootKey(uint16_t recordBootId) {
+  return ((uint32_t)epoch << 16) | recordBootId;
+}
+
+bool tlogBegin() {
+  if (tlogMutex == NULL) tlogMutex = xSemaphoreCreateMutex();
+
+  Preferences prefs;
+  if (prefs.begin(TLOG_NVS_NAMESPACE, false)) {
+    headSeg = prefs.getULong("head", 0);
+    tailSeg = prefs.getULong("tail", 0);
+    tailIndex = prefs.getULong("rd", 0);
+    nextSeq = prefs.getULong("seq", 1);
+    bootId = prefs.getUShort("boot", 0) + 1;
+    prefs.putUShort("boot", bootId);
+    epoch = prefs.getUShort("epoch", 0);
+    if (epoch == 0) {
+      epoch = (uint16_t)(esp_random() % 0xFFFF) + 1;
+      prefs.putUShort("epoch", epoch);
+    }
+    prefs.end();
+  }
+  if (tailSeg > headSeg) tailSeg = headSeg;
+
+  // Mất điện ngay sau khi tạo segment mới nhưng trước khi kịp ghi NVS: nhận segment đó làm head
+  char path[24];
+  segPath(headSeg + 1, path, sizeof(path));
+  if (SPIFFS.exists(path)) headSeg++;
+
+  // Kiểm tra segment head: file lẻ byte hoặc bản ghi cuối sai CRC = ghi dở lúc mất điện
+  char headPath[24];
+  segPath(headSeg, headPath, sizeof(headPath));
+  File f = SPIFFS.open(headPath, FILE_READ);
+  size_t headBytes = f ? f.size() : 0;
+  if (f) f.close();
+  headCount = headBytes / TLOG_RECORD_SIZE;
+  bool torn = (headBytes % TLOG_RECORD_SIZE) != 0;
+  if (headCount > 0) {
+    TelemetryRecord last;
+    if (readRecord(headSeg, headCount - 1, last) && last.crc == recordCrc(last)) {
+      if (last.seq >= nextSeq) nextSeq = last.seq + 1;
+      if (nextSeq == 0) nextSeq = 1;
+    } else {
+      torn = true;
+    }
+  }
+  headSealed = torn;  // Không append tiếp sau bản ghi hỏng: xoay ngay lần sau
+
+  // Đếm lại depth từ kích thước file (tối đa TLOG_MAX_SEGMENTS lần stat)
+  depth = 0;
+  for (uint32_t seg = tailSeg; seg <= headSeg; seg++) {
+    uint32_t n = (seg == headSeg) ? headBytes / TLOG_RECORD_SIZE : segRecordCount(seg);
+    if (seg == tailSeg) n = (n > tailIndex) ? n - tailIndex : 0;
+    depth += n;
+  }
+  stats.segments = headSeg - tailSeg + 1;
+  rateWindowStart = millis();
+
+  Serial.printf("[TLOG] Boot #%u (epoch %04x), segment %lu..%lu, %lu bản ghi chờ gửi%s\n", bootId, epoch,
+                (unsigned long)tailSeg, (unsigned long)headSeg, (unsigned long)depth,
+                torn ? " (phát hiện bản ghi ghi dở, mở segment mới)" : "");
+  return true;
+}
+
+bool tlogAppend(TelemetryRecord& rec) {
+  if (tlogMutex == NULL || !xSemaphoreTake(tlogMutex, pdMS_TO_TICKS(200))) return false;
+
+  bool rotated = false;
+  if (headCount >= TLOG_RECORDS_PER_SEGMENT || headSealed) {
+    headSeg++;
+    headCount = 0;
+    headSealed = false;
+    rotated = true;
+    // Log đầy: bỏ segment cũ nhất
+    while (headSeg - tailSeg + 1 > TLOG_MAX_SEGMENTS) {
+      uint32_t n = segRecordCount(tailSeg);
+      uint32_t lost = (n > tailIndex) ? n - tailIndex : 0;
+      depth = (depth > lost) ? depth - lost : 0;
+      stats.dropped += lost;
+      deleteTailSegment();
+    }
+  }
+
+  bool newSeq = (rec.seq == 0);
+  if (newSeq) rec.seq = nextSeq;
+  rec.bootId = bootId;
+  rec.crc = recordCrc(rec);
+
+  char path[24];
+  segPath(headSeg, path, sizeof(path));
+  File f = SPIFFS.open(path, FILE_APPEND);
+  bool ok = f && f.write((const uint8_t*)&rec, TLOG_RECORD_SIZE) == TLOG_RECORD_SIZE;
+  if (f) f.close();
+
+  if (ok) {
+    if (newSeq && ++nextSeq == 0) nextSeq = 1;  // seq 0 = không có seq (xem telemetry_codec.h)
+    headCount++;
+    depth++;
+    stats.appended++;
+  } else {
+    // Ghi lỗi (thường do SPIFFS đầy): ép xoay segment để lần sau không nối sau mảnh hỏng
+    headSealed = true;
+    if (newSeq) rec.seq = 0;  // seq chưa được cấp: lần append lại không được giữ nó
+  }
+  if (rotated) commitPointers(false);
+  stats.segments = headSeg - tailSeg + 1;
+
+  xSemaphoreGive(tlogMutex);
+  return ok;
+}
+
+uint32_t tlogReserveSeq() {
+  if (tlogMutex == NULL || !xSemaphoreTake(tlogMutex, pdMS_TO_TICKS(200))) return 0;
+  uint32_t seq = nextSeq;
+  if (++nextSeq == 0) nextSeq = 1;
+  xSemaphoreGive(tlogMutex);
+  return seq;
+}
+
+/**
+ * @brief Phần thân của tlogPeek(), gọi khi đang giữ tlogMutex.
+ */
+static bool peekLocked(TelemetryRecord& out) {
+  bool found = false;
+  while (depth > 0) {
+    uint32_t count = (tailSeg == headSeg) ? headCount : segRecordCount(tailSeg);
+    if (tailIndex >= count) {
+      if (tailSeg == headSeg) break;
+      deleteTailSegment();
+      commitPointers(true);
+      continue;
+    }
+    if (readRecord(tailSeg, tailIndex, out) && out.crc == recordCrc(out)) {
+      found = true;
+      break;
+    }
+    // Bản ghi hỏng: bỏ qua, không chặn phần còn lại của log
+    stats.crcErrors++;
+    tailIndex++;
+    depth--;
+  }
+  stats.segments = headSeg - tailSeg + 1;
+  return found;
+}
+
+bool tlogPeek(TelemetryRecord& out) {
+  if (tlogMutex == NULL || !xSemaphoreTake(tlogMutex, pdMS_TO_TICKS(200))) return false;
+  bool found = peekLocked(out);
+  xSemaphoreGive(tlogMutex);
+  return found;
+}
+
+uint32_t tlogPeekBatch(TelemetryRecord* out, uint32_t maxCount, TelemetryLogCursor* from) {
+  if (maxCount == 0) return 0;
+  if (tlogMutex == NULL || !xSemaphoreTake(tlogMutex, pdMS_TO_TICKS(200))) return 0;
+  if (!peekLocked(out[0])) {
+    xSemaphoreGive(tlogMutex);
+    return 0;
+  }
+  if (from != NULL) {
+    from->seg = tailSeg;
+    from->index = tailIndex;
+  }
+
+  // peekLocked đã bỏ qua bản ghi hỏng ở đầu; từ đây đọc tuần tự, mỗi segment mở file một lần
+  uint32_t n = 1;
+  uint32_t seg = tailSeg;
+  uint32_t index = tailIndex + 1;
+  while (n < maxCount && n < depth) {
+    uint32_t count = (seg == headSeg) ? headCount : segRecordCount(seg);
+    if (index >= count) {
+      if (seg == headSeg) break;
+      seg++;
+      index = 0;
+      continue;
+    }
+    char path[24];
+    segPath(seg, path, sizeof(path));
+    File f = SPIFFS.open(path, FILE_READ);
+    if (!f || !f.seek(index * TLOG_RECORD_SIZE)) {
+      if (f) f.close();
+      break;
+    }
+    bool corrupt = false;
+    while (n < maxCount && n < depth && index < count) {
+      if (f.read((uint8_t*)&out[n], TLOG_RECORD_SIZE) != TLOG_RECORD_SIZE || out[n].crc != recordCrc(out[n])) {
+        corrupt = true;  // Dừng lô tại bản ghi hỏng; tlogPeek lần sau sẽ bỏ qua nó khi nó ở đầu log
+        break;
+      }
+      n++;
+      index++;
+    }
+    f.close();
+    if (corrupt) break;
+  }
+  xSemaphoreGive(tlogMutex);
+  return n;
+}
+
+bool tlogAck(const TelemetryLogCursor& from, uint32_t count) {
+  if (tlogMutex == NULL || !xSemaphoreTake(tlogMutex, portMAX_DELAY)) return false;
+  if (from.seg != tailSeg || from.index != tailIndex) {
+    // Segment tail bị xóa khi log đầy trong lúc gửi: tiến theo count sẽ bỏ qua bản ghi chưa gửi
+    stats.staleAcks++;
+    xSemaphoreGive(tlogMutex);
+    return false;
+  }
+  if (count > depth) count = depth;
+  tailIndex += count;
+  depth -= count;
+  // Lô có thể vắt qua nhiều segment: xóa các segment đã gửi hết
+  bool rotated = false;
+  while (tailSeg != headSeg) {
+    uint32_t n = segRecordCount(tailSeg);
+    if (tailIndex < n) break;
+    uint32_t rest = tailIndex - n;
+    deleteTailSegment();
+    tailIndex = rest;
+    rotated = true;
+  }
+  if (rotated) stats.segments = headSeg - tailSeg + 1;
+  stats.drained += count;
+  rateWindowCount += count;
+  acksSinceCommit += count;
+  if (rotated || acksSinceCommit >= TLOG_CURSOR_COMMIT_EVERY) commitPointers(true);
+  xSemaphoreGive(tlogMutex);
+  return true;
+}
+
+uint32_t tlogDepth() {
+  return depth;
+}
+
+TelemetryLogStats tlogGetStats() {
+  TelemetryLogStats out = {};
+  if (tlogMutex == NULL || !xSemaphoreTake(tlogMutex, pdMS_TO_TICKS(100))) return out;
+  uint32_t now = millis();
+  uint32_t elapsed = now - rateWindowStart;
+  if (elapsed >= 60000) {
+    stats.drainRatePerMin = rateWindowCount * 60000.0f / elapsed;
+    rateWindowStart = now;
+    rateWindowCount = 0;
+  }
+  stats.depth = depth;
+  out = stats;
+  xSemaphoreGive(tlogMutex);
+  return out;
+}
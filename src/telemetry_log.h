@@ -0,0 +1,145 @@
+#ifndef TELEMETRY_LOG_H
+#define TELEMETRY_LOG_H
+
+/**
+ * @file telemetry_log.h
+ * @brief Hàng đợi store-and-forward trên SPIFFS: ring log append-only gồm các bản ghi nhị phân
+ * kích thước cố định có CRC32.
+ *
+ * - Log chia thành các segment file "/tlog/<seq>.seg", mỗi segment TLOG_RECORDS_PER_SEGMENT bản ghi.
+ *   Chỉ append vào segment đầu (head); segment cuối (tail) bị xóa nguyên file khi đã gửi hết.
+ * - Vượt TLOG_MAX_SEGMENTS thì xóa segment cũ nhất (mất dữ liệu cũ nhất, có đếm `dropped`).
+ * - Con trỏ head/tail và vị trí đọc lưu trong NVS; vị trí đọc chỉ ghi mỗi TLOG_CURSOR_COMMIT_EVERY
+ *   bản ghi nên mất điện có thể gửi lại tối đa chừng ấy bản ghi (at-least-once, backend khử
+ *   trùng theo tlogBootKey() + seq).
+ * - Bản ghi ghi dở lúc mất điện bị loại nhờ CRC; lần append kế tiếp mở segment mới.
+ */
+
+#include <Arduino.h>
+#include "config.h"
+
+// Loại bản ghi
+enum TelemetryKind : uint8_t {
+  TLOG_KIND_PERIODIC = 0,   // Upload định kỳ
+  TLOG_KIND_ALERT = 1,      // Cảnh báo mức WARNING (đường thường)
+  TLOG_KIND_URGENT = 2      // Cảnh báo CRITICAL gửi khẩn thất bại, lưu lại để gửi sau
+};
+
+// Bit trong TelemetryRecord::flags
+enum TelemetryFlag : uint8_t {
+  TLOG_FLAG_TEMP_ALERT = 1 << 0,
+  TLOG_FLAG_SMOKE_ALERT = 1 << 1,
+  TLOG_FLAG_FIRE_ALERT = 1 << 2,
+  TLOG_FLAG_TEMP_RISE_ALERT = 1 << 3,
+  TLOG_FLAG_ALERT_ACTIVE = 1 << 4
+};
+
+#define TLOG_NULL_CENTI INT16_MIN  // Giá trị null cho các trường centi-độ
+
+// Bản ghi kích thước cố định, little-endian như bộ nhớ ESP32
+struct TelemetryRecord {
+  uint32_t seq;                          // Số thứ tự tăng dần, gán bởi tlogAppend()/tlogReserveSeq(); 0 = chưa có
+  uint32_t uptimeMs;                     // millis() lúc lấy mẫu
+  uint16_t bootId;                       // Bộ đếm boot, để biết uptimeMs còn so được với millis() không
+  uint8_t kind;                          // TelemetryKind
+  uint8_t flags;                         // TelemetryFlag
+  int16_t temperatureCenti;              // °C x100, đầu dò nóng nhất
+  int16_t tempRiseCenti;                 // °C/phút x100, TLOG_NULL_CENTI nếu chưa có
+  int16_t probeCenti[MAX_TEMP_PROBES];   // °C x100 từng đầu dò, TLOG_NULL_CENTI nếu lỗi
+  uint16_t smokeValue;
+  uint16_t fireValue10;
+  uint8_t probeCount;
+  uint8_t riskScore;
+  uint8_t riskLevel;
+  uint8_t reserved;
+  uint32_t crc;                          // CRC32 của mọi byte phía trước
+};
+static_assert(sizeof(TelemetryRecord) % 4 == 0, "TelemetryRecord phải căn 4 byte");
+
+// Vị trí bản ghi đầu của một lô đã peek; tlogAck() chỉ xác nhận khi tail vẫn ở đúng vị trí này
+struct TelemetryLogCursor {
+  uint32_t seg;
+  uint32_t index;
+};
+
+struct TelemetryLogStats {
+  uint32_t depth;            // Số bản ghi chưa gửi
+  uint32_t segments;         // Số segment file đang có
+  uint32_t appended;         // Từ lúc boot
+  uint32_t drained;          // Từ lúc boot
+  uint32_t dropped;          // Bản ghi cũ bị xóa khi log đầy
+  uint32_t crcErrors;        // Bản ghi hỏng bị bỏ qua khi đọc
+  uint32_t staleAcks;        // Lô đã gửi nhưng không xác nhận được vì tail dời (sẽ gửi lại)
+  float drainRatePerMin;     // Tốc độ gửi đo trên cửa sổ 60 s gần nhất
+};
+
+/**
+ * @brief Khôi phục con trỏ từ NVS và kiểm tra segment đầu (gọi sau SPIFFS.begin()).
+ */
+bool tlogBegin();
+
+/**
+ * @brief Bộ đếm boot hiện tại (ghi vào TelemetryRecord::bootId).
+ */
+uint16_t tlogBootId();
+
+/**
+ * @brief Số ngẫu nhiên khác 0 sinh khi NVS chưa có (flash mới hoặc NVS bị xóa, lúc seq và bootId
+ * cùng đếm lại từ đầu).
+ */
+uint16_t tlogEpoch();
+
+/**
+ * @brief Khóa khử trùng gửi kèm seq: epoch << 16 | bootId của bản ghi. seq không lặp lại trong một khóa,
+ * nên backend khử trùng theo (device_id, khóa, seq) mà không phải đoán lúc thiết bị reset NVS.
+ */
+uint32_t tlogBootKey(uint16_t recordBootId);
+
+/**
+ * @brief Gán seq (nếu bản ghi chưa có) + CRC rồi append bản ghi; thread-safe.
+ *
+ * Bản ghi đã lấy seq bằng tlogReserveSeq() giữ nguyên seq để lần gửi lại khử trùng được với lần gửi đầu.
+ */
+bool tlogAppend(TelemetryRecord& rec);
+
+/**
+ * @brief Cấp seq cho bản ghi gửi thẳng không qua log (cảnh báo khẩn) để backend khử trùng khi gửi lại.
+ *
+ * Không ghi NVS: sau khi khởi động lại seq này có thể được cấp lại, nhưng với bootId khác nên khóa
+ * (tlogBootKey(), seq) vẫn không trùng.
+ * @return seq mới, 0 nếu không lấy được mutex.
+ */
+uint32_t tlogReserveSeq();
+
+/**
+ * @brief Đọc bản ghi cũ nhất chưa gửi (không xóa). Bỏ qua bản ghi sai CRC.
+ * @return false nếu log rỗng.
+ */
+bool tlogPeek(TelemetryRecord& out);
+
+/**
+ * @brief Đọc tối đa `maxCount` bản ghi cũ nhất liên tiếp (không xóa), có thể vắt qua nhiều segment.
+ *
+ * Lô dừng sớm tại bản ghi sai CRC nên số bản ghi trả về luôn khớp với tlogAck(n).
+ * @param from Nhận vị trí bản ghi đầu lô để truyền lại cho tlogAck(), có thể NULL.
+ * @return Số bản ghi đã đọc vào `out`, 0 nếu log rỗng.
+ */
+uint32_t tlogPeekBatch(TelemetryRecord* out, uint32_t maxCount, TelemetryLogCursor* from = NULL);
+
+/**
+ * @brief Xác nhận đã gửi `count` bản ghi bắt đầu tại `from` (lấy từ tlogPeekBatch).
+ *
+ * Mutex được nhả trong lúc gửi; nếu tlogAppend() trên log đầy đã xóa segment tail thì tail không còn
+ * ở `from` và lần xác nhận bị bỏ (lô gửi lại, backend khử trùng) thay vì trượt qua bản ghi chưa gửi.
+ * @return false nếu tail đã dời.
+ */
+bool tlogAck(const TelemetryLogCursor& from, uint32_t count);
+
+/**
+ * @brief Số bản ghi chưa gửi.
+ */
+uint32_t tlogDepth();
+
+TelemetryLogStats tlogGetStats();
+
+#endif
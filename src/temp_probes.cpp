@@ -0,0 +1,165 @@
+#include "temp_probes.h"
+#include <Preferences.h>
+
+/**
+ * @file temp_probes.cpp
+ * @brief Hiện thực dò, cache ROM trong NVS và đọc bất đồng bộ nhiều DS18B20.
+ */
+
+OneWire oneWire(TEMP_SENSOR_PIN);
+DallasTemperature tempSensor(&oneWire);
+
+// Danh sách ROM theo thứ tự cố định (index = số thứ tự đầu dò báo về backend)
+static DeviceAddress probeRoms[MAX_TEMP_PROBES];
+static uint8_t probeCount = 0;
+
+// Máy trạng thái chuyển đổi nhiệt độ (không chặn caller)
+enum TempConversionState {
+  TEMP_CONV_IDLE = 0,     // Chưa yêu cầu chuyển đổi
+  TEMP_CONV_PENDING = 1   // Đã gửi lệnh Convert T, chờ đủ thời gian để đọc scratchpad
+};
+static TempConversionState tempConvState = TEMP_CONV_IDLE;
+static unsigned long tempConvStartedAt = 0;
+static unsigned long tempConvWaitMs = 750;   // Tính lại theo độ phân giải lớn nhất trên bus
+
+static const char* PROBE_NVS_NAMESPACE = "tprobes";
+
+/**
+ * @brief Tìm ROM trong danh sách đã cache, trả về -1 nếu chưa có.
+ */
+static int findProbe(const uint8_t* rom) {
+  for (uint8_t i = 0; i < probeCount; i++) {
+    if (memcmp(probeRoms[i], rom, sizeof(DeviceAddress)) == 0) return i;
+  }
+  return -1;
+}
+
+/**
+ * @brief Nạp danh sách ROM đã lưu; bỏ qua dữ liệu hỏng (sai CRC ROM hoặc sai kích thước).
+ */
+static void loadProbeRoms() {
+  Preferences prefs;
+  probeCount = 0;
+  if (!prefs.begin(PROBE_NVS_NAMESPACE, true)) return;
+  size_t len = prefs.getBytesLength("roms");
+  if (len > 0 && len % sizeof(DeviceAddress) == 0 && len <= sizeof(probeRoms)) {
+    prefs.getBytes("roms", probeRoms, len);
+    uint8_t n = len / sizeof(DeviceAddress);
+    for (uint8_t i = 0; i < n; i++) {
+      if (tempSensor.validAddress(probeRoms[i])) {
+        if (i != probeCount) memcpy(probeRoms[probeCount], probeRoms[i], sizeof(DeviceAddress));
+        probeCount++;
+      }
+    }
+  }
+  prefs.end();
+}
+
+static void saveProbeRoms() {
+  Preferences prefs;
+  if (!prefs.begin(PROBE_NVS_NAMESPACE, false)) return;
+  prefs.putBytes("roms", probeRoms, probeCount * sizeof(DeviceAddress));
+  prefs.end();
+}
+
+/**
+ * @brief Dò bus một lần và hợp nhất với danh sách NVS.
+ *
+ * Đầu dò đã biết giữ nguyên chỉ số; đầu dò mới được thêm vào cuối. Đầu dò đã lưu nhưng không
+ * phản hồi vẫn giữ chỗ (báo NAN) để kỹ thuật viên thấy ngay cell nào mất đo.
+ */
+uint8_t tempProbesBegin() {
+  tempSensor.begin();
+  tempSensor.setWaitForConversion(false);
+  loadProbeRoms();
+
+  bool changed = false;
+  uint8_t found = tempSensor.getDeviceCount();
+  for (uint8_t i = 0; i < found; i++) {
+    DeviceAddress rom;
+    if (!tempSensor.getAddress(rom, i)) continue;
+    if (findProbe(rom) >= 0) continue;
+    if (probeCount >= MAX_TEMP_PROBES) {
+      Serial.println("[TEMP] Vượt quá MAX_TEMP_PROBES, bỏ qua đầu dò mới");
+      break;
+    }
+    memcpy(probeRoms[probeCount++], rom, sizeof(DeviceAddress));
+    changed = true;
+  }
+  if (changed) saveProbeRoms();
+
+  for (uint8_t i = 0; i < probeCount; i++) {
+    tempProbesSetResolution(i, TEMP_SENSOR_RESOLUTION);
+  }
+  tempConvWaitMs = tempSensor.millisToWaitForConversion(tempSensor.getResolution());
+
+  Serial.printf("[TEMP] %u đầu dò trên bus, %u đầu dò được quản lý%s\n",
+                found, probeCount, changed ? " (đã cập nhật NVS)" : "");
+  for (uint8_t i = 0; i < probeCount; i++) {
+    char rom[17];
+    tempProbesRomString(i, rom, sizeof(rom));
+    Serial.printf("[TEMP]  #%u ROM %s\n", i, rom);
+  }
+  return probeCount;
+}
+
+uint8_t tempProbesCount() {
+  return probeCount;
+}
+
+/**
+ * @brief Đặt độ phân giải cho một đầu dò và cập nhật thời gian chờ chuyển đổi.
+ *
+ * Thời gian chờ lấy theo độ phân giải lớn nhất trên bus vì mọi đầu dò dùng chung một lệnh Convert T.
+ */
+bool tempProbesSetResolution(uint8_t index, uint8_t bits) {
+  if (index >= probeCount || bits < 9 || bits > 12) return false;
+  if (!tempSensor.setResolution(probeRoms[index], bits)) return false;
+  tempConvWaitMs = tempSensor.millisToWaitForConversion(tempSensor.getResolution());
+  return true;
+}
+
+/**
+ * @brief Pha 1: gửi một Convert T chung cho mọi đầu dò (không chờ) và chuyển sang PENDING.
+ */
+uint32_t tempProbesStartConversion() {
+  tempSensor.requestTemperatures();
+  tempConvStartedAt = millis();
+  tempConvState = TEMP_CONV_PENDING;
+  return tempConvWaitMs;
+}
+
+/**
+ * @brief Pha 2: khi đã đủ tempConvWaitMs thì đọc scratchpad từng đầu dò theo ROM và quay lại IDLE.
+ */
+bool tempProbesCollect(float* out) {
+  if (tempConvState != TEMP_CONV_PENDING) return false;
+  if (millis() - tempConvStartedAt < tempConvWaitMs) return false;
+  for (uint8_t i = 0; i < MAX_TEMP_PROBES; i++) {
+    if (i >= probeCount) {
+      out[i] = NAN;
+      continue;
+    }
+    float t = tempSensor.getTempC(probeRoms[i]);
+    out[i] = (t == DEVICE_DISCONNECTED_C) ? NAN : t;
+  }
+  tempConvState = TEMP_CONV_IDLE;
+  return true;
+}
+
+bool tempProbesConversionPending() {
+  return tempConvState == TEMP_CONV_PENDING;
+}
+
+void tempProbesResetConversion() {
+  tempConvState = TEMP_CONV_IDLE;
+}
+
+void tempProbesRomString(uint8_t index, char* buf, size_t len) {
+  if (len == 0) return;
+  buf[0] = '\0';
+  if (index >= probeCount || len < 17) return;
+  for (uint8_t b = 0; b < 8; b++) {
+    snprintf(buf + b * 2, len - b * 2, "%02X", probeRoms[index][b]);
+  }
+}
@@ -0,0 +1,69 @@
+#ifndef TEMP_PROBES_H
+#define TEMP_PROBES_H
+
+/**
+ * @file temp_probes.h
+ * @brief Quản lý nhiều đầu dò DS18B20 trên cùng bus 1-Wire (mỗi cell/ngăn pin một đầu dò).
+ *
+ * - Dò bus một lần lúc boot, đối chiếu với danh sách ROM đã lưu trong NVS để giữ thứ tự ổn định
+ *   (đầu dò #k luôn là cùng một cell, kể cả khi có đầu dò hỏng hoặc thêm mới).
+ * - Mỗi chu kỳ chỉ gửi một lệnh Convert T chung (Skip ROM) rồi đọc từng đầu dò theo địa chỉ,
+ *   không search lại bus nên thời gian đọc tăng tuyến tính theo số đầu dò.
+ * - Chuyển đổi chạy bất đồng bộ theo hai pha (start/collect) do kênh "ds18b20" của
+ *   sensor_scheduler gọi, không bao giờ chờ ~750 ms.
+ */
+
+#include <Arduino.h>
+#include <OneWire.h>
+#include <DallasTemperature.h>
+#include "config.h"
+
+// Bus 1-Wire dùng chung, khởi tạo trong temp_probes.cpp
+extern DallasTemperature tempSensor;
+
+/**
+ * @brief Khởi tạo bus, đối chiếu ROM với NVS, đặt độ phân giải và bật chế độ async.
+ * @return Số đầu dò được quản lý (gồm cả đầu dò đã lưu nhưng hiện không phản hồi).
+ */
+uint8_t tempProbesBegin();
+
+/**
+ * @brief Số đầu dò đang quản lý (tối đa MAX_TEMP_PROBES).
+ */
+uint8_t tempProbesCount();
+
+/**
+ * @brief Đặt độ phân giải cho đầu dò theo chỉ số trong danh sách đã cache.
+ * @return false nếu chỉ số/độ phân giải không hợp lệ hoặc đầu dò không phản hồi.
+ */
+bool tempProbesSetResolution(uint8_t index, uint8_t bits);
+
+/**
+ * @brief Gửi lệnh Convert T chung cho mọi đầu dò, trả về ngay.
+ * @return Số ms cần chờ trước khi gọi tempProbesCollect() (theo độ phân giải lớn nhất).
+ */
+uint32_t tempProbesStartConversion();
+
+/**
+ * @brief Thu kết quả lượt chuyển đổi đang chờ nếu đã đủ thời gian.
+ * @param out Mảng MAX_TEMP_PROBES phần tử; đầu dò lỗi/mất kết nối nhận NAN.
+ * @return true nếu vừa thu được một lượt kết quả mới vào `out`.
+ */
+bool tempProbesCollect(float* out);
+
+/**
+ * @brief Có lượt chuyển đổi đang chờ thu kết quả hay không.
+ */
+bool tempProbesConversionPending();
+
+/**
+ * @brief Hủy lượt chuyển đổi đang chờ (dùng sau khi test thủ công chiếm bus).
+ */
+void tempProbesResetConversion();
+
+/**
+ * @brief Ghi địa chỉ ROM dạng hex (16 ký tự) của đầu dò vào `buf` (tối thiểu 17 byte).
+ */
+void tempProbesRomString(uint8_t index, char* buf, size_t len);
+
+#endif
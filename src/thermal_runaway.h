@@ -0,0 +1,82 @@
+#ifndef THERMAL_RUNAWAY_H
+#define THERMAL_RUNAWAY_H
+
+/**
+ * @file thermal_runaway.h
+ * @brief Ước lượng tốc độ tăng nhiệt (dT/dt) bằng hồi quy tuyến tính trên cửa sổ trượt N mẫu.
+ *
+ * Mẫu lấy đều chu kỳ (kênh ds18b20 của sensor_scheduler) nên trục thời gian là chỉ số 0..N-1 và
+ * độ dốc bình phương tối thiểu chỉ cần hai tổng chạy S = Σy, T = Σk·y. Khi cửa sổ trượt một
+ * mẫu (bỏ y0, thêm y mới):
+ *   T' = T - (S - y0) + (N-1)·y
+ *   S' = S - y0 + y
+ * nên mỗi mẫu là O(1). Nhiệt độ được lưu theo centi-độ trong số nguyên 64-bit nên các tổng chạy
+ * chính xác tuyệt đối, không trôi theo thời gian như cộng/trừ float.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <math.h>
+
+template <size_t N>
+class SlopeEstimator {
+  static_assert(N >= 3, "SlopeEstimator: N >= 3");
+
+ public:
+  /**
+   * @brief Thêm mẫu °C; NAN (đầu dò lỗi) xóa cửa sổ vì khoảng trống làm sai trục thời gian.
+   */
+  void push(float celsius) {
+    if (isnan(celsius)) {
+      reset();
+      return;
+    }
+    int32_t y = (int32_t)lroundf(celsius * 100.0f);
+    if (count_ < N) {
+      sumT_ += (int64_t)count_ * y;
+      sumS_ += y;
+      buf_[(head_ + count_) % N] = y;
+      count_++;
+      return;
+    }
+    int32_t y0 = buf_[head_];
+    sumT_ += -(sumS_ - y0) + (int64_t)(N - 1) * y;
+    sumS_ += (int64_t)y - y0;
+    buf_[head_] = y;
+    head_ = (head_ + 1) % N;
+  }
+
+  void reset() {
+    head_ = 0;
+    count_ = 0;
+    sumS_ = 0;
+    sumT_ = 0;
+  }
+
+  // Đã đủ N mẫu liên tục để ước lượng
+  bool ready() const { return count_ == N; }
+
+  /**
+   * @brief Độ dốc theo °C mỗi phút với chu kỳ mẫu `periodMs`; 0 nếu chưa đủ cửa sổ.
+   *
+   * slope = (N·T - ΣkΣy) / (N·Σk² - (Σk)²), với Σk = N(N-1)/2, N·Σk² - (Σk)² = N²(N²-1)/12.
+   */
+  float ratePerMinute(uint32_t periodMs) const {
+    if (!ready() || periodMs == 0) return 0.0f;
+    const int64_t n = (int64_t)N;
+    const int64_t sumK = n * (n - 1) / 2;
+    const int64_t denom = n * n * (n * n - 1) / 12;
+    int64_t num = n * sumT_ - sumK * sumS_;
+    // num/denom là centi-độ mỗi mẫu
+    return (float)((double)num / (double)denom) / 100.0f * (60000.0f / (float)periodMs);
+  }
+
+ private:
+  int32_t buf_[N];
+  size_t head_ = 0;
+  size_t count_ = 0;
+  int64_t sumS_ = 0;
+  int64_t sumT_ = 0;
+};
+
+#endif
@@ -0,0 +1,185 @@
+#include "upload_queue.h"
+#include <esp_timer.h>
+
+/**
+ * @file upload_queue.cpp
+ * @brief Queue URGENT và NORMAL (FreeRTOS), yêu cầu flush cho mức NORMAL và thống kê độ trễ.
+ */
+
+static QueueHandle_t urgentQueue = NULL;
+static QueueHandle_t normalQueue = NULL;   // Bản ghi thường chờ uploadTask ghi xuống log flash
+static TaskHandle_t consumerTask = NULL;
+static TaskHandle_t urgentConsumerTask = NULL;
+static volatile bool flushPending = false;
+static int64_t flushRequestedUs = 0;     // Lần yêu cầu flush đầu tiên chưa được phục vụ
+
+static UploadQueueStats stats = {};
+static portMUX_TYPE statsMux = portMUX_INITIALIZER_UNLOCKED;
+
+static void notifyConsumer(uint32_t bits) {
+  TaskHandle_t task = (bits == UPLOAD_NOTIFY_URGENT && urgentConsumerTask != NULL) ? urgentConsumerTask : consumerTask;
+  if (task != NULL) xTaskNotify(task, bits, eSetBits);
+}
+
+static void recordLatency(UploadLatencyStats& s, int64_t sinceUs) {
+  int64_t d = esp_timer_get_time() - sinceUs;
+  uint32_t us = d < 0 ? 0 : (d > (int64_t)UINT32_MAX ? UINT32_MAX : (uint32_t)d);
+  portENTER_CRITICAL(&statsMux);
+  s.lastUs = us;
+  if (us > s.maxUs) s.maxUs = us;
+  s.avgUs = (s.samples == 0) ? us : (uint32_t)(s.avgUs + ((int32_t)us - (int32_t)s.avgUs) / 8);
+  s.samples++;
+  portEXIT_CRITICAL(&statsMux);
+}
+
+bool uploadQueueBegin() {
+  if (urgentQueue == NULL) urgentQueue = xQueueCreate(UPLOAD_URGENT_QUEUE_DEPTH, sizeof(UploadMessage));
+  if (normalQueue == NULL) normalQueue = xQueueCreate(UPLOAD_NORMAL_QUEUE_DEPTH, sizeof(TelemetryRecord));
+  return urgentQueue != NULL && normalQueue != NULL;
+}
+
+void uploadQueueSetConsumer(TaskHandle_t task) {
+  consumerTask = task;
+}
+
+void uploadQueueSetUrgentConsumer(TaskHandle_t task) {
+  urgentConsumerTask = task;
+}
+
+static void requestFlush() {
+  portENTER_CRITICAL(&statsMux);
+  if (!flushPending) {
+    flushRequestedUs = esp_timer_get_time();
+    flushPending = true;
+  }
+  portEXIT_CRITICAL(&statsMux);
+  notifyConsumer(UPLOAD_NOTIFY_NORMAL);
+}
+
+/**
+ * @brief Ghi bản ghi cảnh báo xuống log; tlogAppend() chờ mutex tối đa 200 ms nên thử lại vài lần trước
+ * khi coi là lỗi flash (đếm `alertLost`).
+ */
+static bool appendAlert(const TelemetryRecord& rec) {
+  TelemetryRecord copy = rec;
+  bool ok = false;
+  for (uint8_t attempt = 0; attempt < 3 && !ok; attempt++) ok = tlogAppend(copy);
+  portENTER_CRITICAL(&statsMux);
+  if (ok) stats.normalPosted++;
+  else stats.alertLost++;
+  portEXIT_CRITICAL(&statsMux);
+  return ok;
+}
+
+static bool appendAlertDirect(const TelemetryRecord& rec) {
+  if (!appendAlert(rec)) return false;
+  portENTER_CRITICAL(&statsMux);
+  stats.alertDirect++;
+  portEXIT_CRITICAL(&statsMux);
+  requestFlush();
+  return true;
+}
+
+bool uploadQueuePostUrgent(const TelemetryRecord& rec) {
+  UploadMessage msg;
+  msg.rec = rec;
+  msg.enqueuedUs = esp_timer_get_time();
+  if (urgentQueue != NULL && xQueueSend(urgentQueue, &msg, 0) == pdTRUE) {
+    portENTER_CRITICAL(&statsMux);
+    stats.urgentPosted++;
+    portEXIT_CRITICAL(&statsMux);
+    notifyConsumer(UPLOAD_NOTIFY_URGENT);
+    return true;
+  }
+  // Queue đầy: không ghi đè bản ghi khẩn đang chờ, chuyển bản ghi mới sang mức NORMAL
+  portENTER_CRITICAL(&statsMux);
+  stats.urgentSpilled++;
+  portEXIT_CRITICAL(&statsMux);
+  msg.rec.kind = TLOG_KIND_URGENT;
+  return uploadQueuePostAlert(msg.rec);
+}
+
+bool uploadQueuePostAlert(const TelemetryRecord& rec) {
+  if (normalQueue != NULL && xQueueSend(normalQueue, &rec, 0) == pdTRUE) {
+    requestFlush();
+    return true;
+  }
+  // Queue RAM đầy: chặn caller trong lúc ghi SPIFFS (hiếm) thay vì bỏ cảnh báo
+  return appendAlertDirect(rec);
+}
+
+bool uploadQueueSaveUrgent(const TelemetryRecord& rec) {
+  TelemetryRecord copy = rec;
+  copy.kind = TLOG_KIND_URGENT;
+  return appendAlertDirect(copy);
+}
+
+bool uploadQueuePostNormal(const TelemetryRecord& rec, bool flush) {
+  bool ok = normalQueue != NULL && xQueueSend(normalQueue, &rec, 0) == pdTRUE;
+  if (!ok) {
+    portENTER_CRITICAL(&statsMux);
+    stats.normalDropped++;
+    portEXIT_CRITICAL(&statsMux);
+  }
+  if (flush) requestFlush();
+  else notifyConsumer(UPLOAD_NOTIFY_NORMAL);
+  return ok;
+}
+
+uint32_t uploadQueueMoveToLog() {
+  uint32_t moved = 0;
+  TelemetryRecord rec;
+  while (normalQueue != NULL && xQueueReceive(normalQueue, &rec, 0) == pdTRUE) {
+    bool ok;
+    if (rec.kind == TLOG_KIND_PERIODIC) {
+      ok = tlogAppend(rec);
+      portENTER_CRITICAL(&statsMux);
+      if (ok) stats.normalPosted++;
+      else stats.normalDropped++;
+      portEXIT_CRITICAL(&statsMux);
+    } else {
+      ok = appendAlert(rec);
+    }
+    if (ok) moved++;
+  }
+  return moved;
+}
+
+bool uploadQueueTakeUrgent(UploadMessage& out) {
+  if (urgentQueue == NULL || xQueueReceive(urgentQueue, &out, 0) != pdTRUE) return false;
+  recordLatency(stats.urgentLatency, out.enqueuedUs);
+  return true;
+}
+
+bool uploadQueueUrgentPending() {
+  return urgentQueue != NULL && uxQueueMessagesWaiting(urgentQueue) > 0;
+}
+
+bool uploadQueueFlushPending() {
+  return flushPending;
+}
+
+void uploadQueueFlushStarted() {
+  portENTER_CRITICAL(&statsMux);
+  bool was = flushPending;
+  int64_t since = flushRequestedUs;
+  flushPending = false;
+  portEXIT_CRITICAL(&statsMux);
+  if (was) recordLatency(stats.flushLatency, since);
+}
+
+uint32_t uploadQueueWait(uint32_t timeoutMs) {
+  uint32_t bits = 0;
+  TickType_t ticks = (timeoutMs == portMAX_DELAY) ? portMAX_DELAY : pdMS_TO_TICKS(timeoutMs);
+  xTaskNotifyWait(0, UINT32_MAX, &bits, ticks);
+  return bits;
+}
+
+UploadQueueStats uploadQueueGetStats() {
+  portENTER_CRITICAL(&statsMux);
+  UploadQueueStats out = stats;
+  portEXIT_CRITICAL(&statsMux);
+  out.urgentDepth = urgentQueue != NULL ? uxQueueMessagesWaiting(urgentQueue) : 0;
+  out.normalDepth = normalQueue != NULL ? uxQueueMessagesWaiting(normalQueue) : 0;
+  return out;
+}
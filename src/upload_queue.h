@@ -0,0 +1,130 @@
+#ifndef UPLOAD_QUEUE_H
+#define UPLOAD_QUEUE_H
+
+/**
+ * @file upload_queue.h
+ * @brief Đường ống upload hai mức ưu tiên, đánh thức uploadTask bằng task notification.
+ *
+ * - Mức URGENT: FreeRTOS queue trong RAM, mỗi phần tử là bản sao TelemetryRecord (queue sở hữu dữ liệu,
+ *   không có slot dùng chung nên không ghi đè nhau). Task đăng ký bằng uploadQueueSetUrgentConsumer()
+ *   (alertTask) rút mức này, không phải chờ lô thường của uploadTask đang gửi hay backoff.
+ * - Mức NORMAL: telemetry_log trên flash (bản ghi định kỳ, cảnh báo WARNING, bản ghi khẩn gửi lỗi).
+ *   Bên gửi (kể cả sensorTask) chỉ đẩy bản ghi vào một queue RAM, không chặn; uploadTask chuyển chúng
+ *   xuống log bằng uploadQueueMoveToLog(), nên I/O SPIFFS và mutex của log không nằm trên đường cảm
+ *   biến. Bản ghi thường chờ gom lô; `flush` yêu cầu gửi lô ngay.
+ * - Mỗi lần đưa vào đặt bit notification tương ứng cho task tiêu thụ của mức đó: task ngủ trong
+ *   uploadQueueWait() và thức dậy ngay, không còn vòng delay(500).
+ * - Bản ghi định kỳ bị bỏ khi queue NORMAL đầy (`normalDropped`). Bản ghi cảnh báo (WARNING, khẩn tràn
+ *   queue URGENT) đi qua uploadQueuePostAlert(): queue NORMAL đầy thì ghi thẳng xuống log, chặn caller
+ *   trong lúc ghi SPIFFS (`alertDirect`, hiếm). Bản ghi khẩn gửi lỗi được alertTask ghi thẳng xuống log
+ *   bằng uploadQueueSaveUrgent(). Cảnh báo chỉ mất khi chính flash ghi lỗi, có đếm `alertLost`.
+ */
+
+#include <Arduino.h>
+#include "config.h"
+#include "telemetry_log.h"
+
+// Bit notification gửi tới task tiêu thụ
+#define UPLOAD_NOTIFY_URGENT (1UL << 0)
+#define UPLOAD_NOTIFY_NORMAL (1UL << 1)
+
+struct UploadMessage {
+  TelemetryRecord rec;
+  int64_t enqueuedUs;   // esp_timer lúc đưa vào queue, để đo độ trễ tới lúc bắt đầu gửi
+};
+
+struct UploadLatencyStats {
+  uint32_t samples;
+  uint32_t lastUs;
+  uint32_t maxUs;
+  uint32_t avgUs;       // Trung bình trượt (EMA 1/8)
+};
+
+struct UploadQueueStats {
+  uint32_t urgentDepth;
+  uint32_t urgentPosted;
+  uint32_t urgentSpilled;      // Queue URGENT đầy, đã chuyển sang mức NORMAL
+  uint32_t normalDepth;        // Bản ghi thường đang chờ trong RAM, chưa xuống log
+  uint32_t normalPosted;       // Đã ghi xuống log flash
+  uint32_t normalDropped;      // Bản ghi định kỳ bị bỏ: queue NORMAL đầy hoặc ghi log lỗi
+  uint32_t alertDirect;        // Bản ghi cảnh báo ghi thẳng xuống log (queue NORMAL đầy hoặc gửi khẩn lỗi)
+  uint32_t alertLost;          // Bản ghi cảnh báo mất vì ghi log flash lỗi
+  UploadLatencyStats urgentLatency;   // Cảnh báo CRITICAL → bắt đầu gửi
+  UploadLatencyStats flushLatency;    // Cảnh báo WARNING (flush) → bắt đầu gửi lô
+};
+
+/**
+ * @brief Tạo queue URGENT (gọi trong setup trước khi tạo task).
+ */
+bool uploadQueueBegin();
+
+/**
+ * @brief Đăng ký task nhận notification (uploadTask tự gọi khi khởi động).
+ */
+void uploadQueueSetConsumer(TaskHandle_t task);
+
+/**
+ * @brief Đăng ký task riêng nhận UPLOAD_NOTIFY_URGENT (chưa đăng ký thì bit này gửi cho task ở trên).
+ */
+void uploadQueueSetUrgentConsumer(TaskHandle_t task);
+
+/**
+ * @brief Đưa bản ghi khẩn vào queue URGENT, không chặn. Queue đầy thì chuyển sang uploadQueuePostAlert()
+ * với kind URGENT.
+ * @return false nếu bản ghi mất (queue URGENT đầy và ghi log flash lỗi).
+ */
+bool uploadQueuePostUrgent(const TelemetryRecord& rec);
+
+/**
+ * @brief Đưa bản ghi cảnh báo vào mức NORMAL và yêu cầu flush, không bỏ vì queue đầy: queue NORMAL
+ * đầy thì ghi thẳng xuống telemetry_log (chặn tới khi SPIFFS ghi xong).
+ * @return false nếu ghi log flash lỗi (bản ghi mất, có đếm `alertLost`).
+ */
+bool uploadQueuePostAlert(const TelemetryRecord& rec);
+
+/**
+ * @brief Ghi thẳng bản ghi khẩn chưa gửi được xuống telemetry_log (kind URGENT) và yêu cầu flush.
+ * Chặn trong lúc ghi SPIFFS nên chỉ gọi từ alertTask.
+ * @return false nếu ghi log lỗi; caller giữ bản ghi và thử lại.
+ */
+bool uploadQueueSaveUrgent(const TelemetryRecord& rec);
+
+/**
+ * @brief Đưa bản ghi vào queue NORMAL trong RAM (không chặn) và đánh thức uploadTask.
+ * @param flush true: gửi lô ngay, không chờ gom.
+ * @return false nếu queue đầy (bản ghi bị bỏ, có đếm `normalDropped`). Cảnh báo dùng uploadQueuePostAlert().
+ */
+bool uploadQueuePostNormal(const TelemetryRecord& rec, bool flush);
+
+/**
+ * @brief Ghi mọi bản ghi đang chờ trong queue NORMAL xuống telemetry_log. Chỉ uploadTask gọi.
+ * @return Số bản ghi đã ghi.
+ */
+uint32_t uploadQueueMoveToLog();
+
+/**
+ * @brief Lấy một bản ghi khẩn (không chặn) và ghi nhận độ trễ tới lúc bắt đầu gửi.
+ */
+bool uploadQueueTakeUrgent(UploadMessage& out);
+
+bool uploadQueueUrgentPending();
+
+/**
+ * @brief Có yêu cầu flush đang chờ không.
+ */
+bool uploadQueueFlushPending();
+
+/**
+ * @brief Xóa yêu cầu flush khi bắt đầu gửi lô và ghi nhận độ trễ từ lúc yêu cầu.
+ */
+void uploadQueueFlushStarted();
+
+/**
+ * @brief Ngủ tới khi có notification hoặc hết `timeoutMs` (portMAX_DELAY = chờ mãi).
+ * @return Các bit UPLOAD_NOTIFY_* đã nhận, 0 nếu hết giờ.
+ */
+uint32_t uploadQueueWait(uint32_t timeoutMs);
+
+UploadQueueStats uploadQueueGetStats();
+
+#endif
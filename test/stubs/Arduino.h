@@ -0,0 +1,374 @@
+#ifndef HOST_ARDUINO_H
+#define HOST_ARDUINO_H
+
+/**
+ * @file Arduino.h
+ * @brief Arduino + FreeRTOS tối thiểu để chạy các module thuần logic của src/ trên máy host (env:native).
+ *
+ * - Đồng hồ giả: millis()/micros() chỉ tiến khi test gọi hostAdvanceMs() hoặc code gọi delay(), nên mọi
+ *   phép đo độ trễ trong test là thời gian mô phỏng, lặp lại được.
+ * - hostDelayHook(): thiết bị giả lập (modem, bus 1-Wire) chạy "song song" mỗi lần code chờ.
+ * - FreeRTOS một luồng: khóa luôn lấy được, queue là deque, task không tự chạy (test gọi thân task).
+ * - Chỉ header, mọi hàm inline, để nhiều file test/src cùng include mà không trùng symbol.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <math.h>
+#include <string>
+#include <deque>
+#include <map>
+#include <vector>
+#include <algorithm>
+
+using std::min;
+using std::max;
+
+#define IRAM_ATTR
+
+// --------------------------------------------------------------------
+// Đồng hồ giả
+// --------------------------------------------------------------------
+typedef void (*HostDelayHook)(uint32_t ms);
+
+inline uint64_t& hostClockUs() {
+  static uint64_t us = 0;
+  return us;
+}
+
+inline HostDelayHook& hostDelayHook() {
+  static HostDelayHook hook = NULL;
+  return hook;
+}
+
+inline void hostAdvanceUs(uint64_t us) { hostClockUs() += us; }
+inline void hostAdvanceMs(uint32_t ms) { hostClockUs() += (uint64_t)ms * 1000; }
+
+inline unsigned long millis() { return (unsigned long)(hostClockUs() / 1000); }
+inline unsigned long micros() { return (unsigned long)hostClockUs(); }
+
+inline void delay(unsigned long ms) {
+  hostAdvanceMs(ms);
+  if (hostDelayHook() != NULL) hostDelayHook()((uint32_t)ms);
+}
+
+inline void delayMicroseconds(unsigned int us) { hostAdvanceUs(us); }
+inline void yield() {}
+
+// --------------------------------------------------------------------
+// GPIO / ADC: mức chân và nguồn mẫu analog do test đặt
+// --------------------------------------------------------------------
+#define HIGH 0x1
+#define LOW 0x0
+#define INPUT 0x01
+#define OUTPUT 0x03
+#define INPUT_PULLUP 0x05
+
+typedef uint16_t (*HostAnalogSource)(uint8_t pin);
+
+inline int* hostPinLevels() {
+  static int levels[64];
+  return levels;
+}
+
+inline HostAnalogSource& hostAnalogSource() {
+  static HostAnalogSource source = NULL;
+  return source;
+}
+
+inline void pinMode(uint8_t, uint8_t) {}
+inline void digitalWrite(uint8_t pin, uint8_t level) { hostPinLevels()[pin & 63] = level; }
+inline int digitalRead(uint8_t pin) { return hostPinLevels()[pin & 63]; }
+inline uint16_t analogRead(uint8_t pin) { return hostAnalogSource() ? hostAnalogSource()(pin) : 0; }
+
+// RNG phần cứng giả: dãy LCG cố định để test lặp lại được
+inline uint32_t& hostRandomState() {
+  static uint32_t state = 1;
+  return state;
+}
+
+inline uint32_t esp_random() {
+  hostRandomState() = hostRandomState() * 1664525u + 1013904223u;
+  return hostRandomState();
+}
+
+// --------------------------------------------------------------------
+// String / Print / Stream
+// --------------------------------------------------------------------
+class String {
+ public:
+  String() {}
+  String(const char* s) : s_(s ? s : "") {}
+  String(const std::string& s) : s_(s) {}
+  String(int v) : s_(std::to_string(v)) {}
+  String(unsigned int v) : s_(std::to_string(v)) {}
+  String(long v) : s_(std::to_string(v)) {}
+  String(unsigned long v) : s_(std::to_string(v)) {}
+
+  const char* c_str() const { return s_.c_str(); }
+  unsigned int length() const { return (unsigned int)s_.size(); }
+  bool isEmpty() const { return s_.empty(); }
+  char operator[](unsigned int i) const { return s_[i]; }
+  bool operator==(const String& o) const { return s_ == o.s_; }
+  bool operator==(const char* o) const { return s_ == (o ? o : ""); }
+  bool operator!=(const char* o) const { return !(*this == o); }
+  String& operator+=(const String& o) { s_ += o.s_; return *this; }
+  String& operator+=(const char* o) { s_ += o; return *this; }
+  String& operator+=(char c) { s_ += c; return *this; }
+  friend String operator+(const String& a, const String& b) { return String(a.s_ + b.s_); }
+  bool startsWith(const char* p) const { return s_.compare(0, strlen(p), p) == 0; }
+  bool equalsIgnoreCase(const String& o) const { return strcasecmp(s_.c_str(), o.s_.c_str()) == 0; }
+  int indexOf(char c, unsigned int from = 0) const {
+    size_t r = s_.find(c, from);
+    return r == std::string::npos ? -1 : (int)r;
+  }
+  String substring(unsigned int from) const { return from >= s_.size() ? String() : String(s_.substr(from)); }
+  String substring(unsigned int from, unsigned int to) const {
+    return from >= s_.size() ? String() : String(s_.substr(from, to - from));
+  }
+  long toInt() const { return atol(s_.c_str()); }
+  void trim() {
+    size_t a = s_.find_first_not_of(" \t\r\n");
+    size_t b = s_.find_last_not_of(" \t\r\n");
+    s_ = (a == std::string::npos) ? std::string() : s_.substr(a, b - a + 1);
+  }
+
+ private:
+  std::string s_;
+};
+
+class Print {
+ public:
+  virtual ~Print() {}
+  virtual size_t write(uint8_t c) = 0;
+  virtual size_t write(const uint8_t* data, size_t n) {
+    size_t i = 0;
+    while (i < n && write(data[i])) i++;
+    return i;
+  }
+  size_t write(const char* s) { return write((const uint8_t*)s, strlen(s)); }
+  size_t print(const char* s) { return write(s); }
+  size_t print(const String& s) { return write(s.c_str()); }
+  size_t print(char c) { return write((uint8_t)c); }
+  size_t print(int v) { return printf("%d", v); }
+  size_t print(unsigned int v) { return printf("%u", v); }
+  size_t print(long v) { return printf("%ld", v); }
+  size_t print(unsigned long v) { return printf("%lu", v); }
+  size_t print(double v, int digits = 2) { return printf("%.*f", digits, v); }
+  size_t println() { return write("\r\n"); }
+  template <typename T>
+  size_t println(const T& v) { return print(v) + println(); }
+  size_t printf(const char* fmt, ...) __attribute__((format(printf, 2, 3))) {
+    char buf[256];
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(buf, sizeof(buf), fmt, ap);
+    va_end(ap);
+    if (n < 0) return 0;
+    return write((const uint8_t*)buf, strlen(buf));
+  }
+};
+
+class Stream : public Print {
+ public:
+  virtual int available() = 0;
+  virtual int read() = 0;
+  virtual int peek() = 0;
+  virtual void flush() {}
+  void setTimeout(unsigned long ms) { timeoutMs_ = ms; }
+  size_t readBytes(uint8_t* buf, size_t n) {
+    size_t got = 0;
+    unsigned long start = millis();
+    while (got < n) {
+      int c = read();
+      if (c < 0) {
+        if (millis() - start >= timeoutMs_) break;
+        delay(1);
+        continue;
+      }
+      buf[got++] = (uint8_t)c;
+    }
+    return got;
+  }
+  size_t readBytes(char* buf, size_t n) { return readBytes((uint8_t*)buf, n); }
+
+ protected:
+  unsigned long timeoutMs_ = 1000;
+};
+
+/**
+ * @brief Serial giả: bỏ log mặc định để output của test gọn; đặt hostSerialEcho() = true khi cần xem log.
+ */
+inline bool& hostSerialEcho() {
+  static bool echo = false;
+  return echo;
+}
+
+class HostSerial : public Stream {
+ public:
+  size_t write(uint8_t c) override {
+    if (hostSerialEcho()) fputc(c, stdout);
+    return 1;
+  }
+  size_t write(const uint8_t* data, size_t n) override {
+    if (hostSerialEcho()) fwrite(data, 1, n, stdout);
+    return n;
+  }
+  using Print::write;
+  int available() override { return 0; }
+  int read() override { return -1; }
+  int peek() override { return -1; }
+  void begin(unsigned long) {}
+};
+
+static HostSerial Serial __attribute__((unused));
+
+// --------------------------------------------------------------------
+// FreeRTOS một luồng
+// --------------------------------------------------------------------
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef void* TaskHandle_t;
+typedef void (*TaskFunction_t)(void*);
+
+#define pdTRUE 1
+#define pdFALSE 0
+#define pdPASS 1
+#define pdFAIL 0
+#define errQUEUE_FULL 0
+#define portMAX_DELAY 0xffffffffUL
+#define portTICK_PERIOD_MS 1
+#define pdMS_TO_TICKS(ms) ((TickType_t)(ms))
+#define tskNO_AFFINITY 0x7fffffff
+
+struct HostSemaphore {
+  int count;
+  int max;
+};
+
+struct HostQueue {
+  size_t itemSize;
+  size_t capacity;
+  std::deque<std::vector<uint8_t> > items;
+};
+
+typedef HostSemaphore* SemaphoreHandle_t;
+typedef HostQueue* QueueHandle_t;
+
+inline SemaphoreHandle_t xSemaphoreCreateMutex() { return new HostSemaphore{ 1, 1 }; }
+inline SemaphoreHandle_t xSemaphoreCreateRecursiveMutex() { return new HostSemaphore{ 1, 1 }; }
+inline SemaphoreHandle_t xSemaphoreCreateBinary() { return new HostSemaphore{ 0, 1 }; }
+inline void vSemaphoreDelete(SemaphoreHandle_t s) { delete s; }
+
+// Một luồng: khóa đang bị giữ thì không ai nhả được trong lúc chờ, trả pdFALSE ngay
+inline BaseType_t xSemaphoreTake(SemaphoreHandle_t s, TickType_t) {
+  if (s == NULL || s->count == 0) return pdFALSE;
+  s->count--;
+  return pdTRUE;
+}
+
+inline BaseType_t xSemaphoreGive(SemaphoreHandle_t s) {
+  if (s == NULL || s->count >= s->max) return pdFALSE;
+  s->count++;
+  return pdTRUE;
+}
+
+inline QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t itemSize) {
+  HostQueue* q = new HostQueue;
+  q->itemSize = itemSize;
+  q->capacity = length;
+  return q;
+}
+
+inline void vQueueDelete(QueueHandle_t q) { delete q; }
+
+inline BaseType_t xQueueSend(QueueHandle_t q, const void* item, TickType_t) {
+  if (q == NULL || q->items.size() >= q->capacity) return errQUEUE_FULL;
+  const uint8_t* p = (const uint8_t*)item;
+  q->items.push_back(std::vector<uint8_t>(p, p + q->itemSize));
+  return pdTRUE;
+}
+
+inline BaseType_t xQueueSendToBack(QueueHandle_t q, const void* item, TickType_t wait) {
+  return xQueueSend(q, item, wait);
+}
+
+inline BaseType_t xQueueReceive(QueueHandle_t q, void* out, TickType_t) {
+  if (q == NULL || q->items.empty()) return pdFALSE;
+  memcpy(out, q->items.front().data(), q->itemSize);
+  q->items.pop_front();
+  return pdTRUE;
+}
+
+inline UBaseType_t uxQueueMessagesWaiting(QueueHandle_t q) { return q ? (UBaseType_t)q->items.size() : 0; }
+
+inline TickType_t xTaskGetTickCount() { return (TickType_t)millis(); }
+inline void vTaskDelay(TickType_t ticks) { delay(ticks); }
+
+inline BaseType_t xTaskDelayUntil(TickType_t* lastWake, TickType_t period) {
+  *lastWake += period;
+  TickType_t now = xTaskGetTickCount();
+  if ((int32_t)(*lastWake - now) <= 0) return pdFALSE;
+  delay(*lastWake - now);
+  return pdTRUE;
+}
+
+inline TaskHandle_t xTaskGetCurrentTaskHandle() {
+  static int self;
+  return &self;
+}
+
+// Task không tự chạy trên host: test gọi thẳng thân task hoặc các hàm nó dùng
+inline BaseType_t xTaskCreatePinnedToCore(TaskFunction_t, const char*, uint32_t, void*, UBaseType_t,
+                                          TaskHandle_t* handle, BaseType_t) {
+  static int fakeTask;
+  if (handle != NULL) *handle = &fakeTask;
+  return pdPASS;
+}
+
+inline void vTaskDelete(TaskHandle_t) {}
+
+inline std::map<TaskHandle_t, uint32_t>& hostTaskNotifications() {
+  static std::map<TaskHandle_t, uint32_t> values;
+  return values;
+}
+
+enum eNotifyAction { eNoAction = 0, eSetBits, eIncrement };
+
+inline BaseType_t xTaskNotify(TaskHandle_t task, uint32_t value, eNotifyAction action) {
+  uint32_t& v = hostTaskNotifications()[task];
+  if (action == eSetBits) v |= value;
+  else if (action == eIncrement) v++;
+  return pdPASS;
+}
+
+inline BaseType_t xTaskNotifyGive(TaskHandle_t task) { return xTaskNotify(task, 0, eIncrement); }
+
+inline BaseType_t xTaskNotifyWait(uint32_t, uint32_t clearOnExit, uint32_t* value, TickType_t) {
+  uint32_t& v = hostTaskNotifications()[xTaskGetCurrentTaskHandle()];
+  if (value != NULL) *value = v;
+  bool pending = v != 0;
+  v &= ~clearOnExit;
+  return pending ? pdTRUE : pdFALSE;
+}
+
+inline uint32_t ulTaskNotifyTake(BaseType_t clear, TickType_t) {
+  uint32_t& v = hostTaskNotifications()[xTaskGetCurrentTaskHandle()];
+  uint32_t out = v;
+  v = clear ? 0 : (v ? v - 1 : 0);
+  return out;
+}
+
+struct portMUX_TYPE {
+  int owner;
+};
+#define portMUX_INITIALIZER_UNLOCKED { 0 }
+inline void portENTER_CRITICAL(portMUX_TYPE*) {}
+inline void portEXIT_CRITICAL(portMUX_TYPE*) {}
+
+#endif
@@ -0,0 +1,203 @@
+#ifndef HOST_DALLAS_TEMPERATURE_H
+#define HOST_DALLAS_TEMPERATURE_H
+
+/**
+ * @file DallasTemperature.h
+ * @brief DallasTemperature giả cho env:native: bus 1-Wire mô phỏng có độ trễ như bus thật.
+ *
+ * Mỗi thao tác bus đẩy đồng hồ giả (hostAdvanceUs) đúng thời gian nó chiếm bus ở tốc độ chuẩn
+ * (khe bit ~70 µs, reset ~1 ms), nên test đo được caller bị chặn bao lâu. Đầu dò mô phỏng nằm trong
+ * hostOneWireBus(): test thêm/bớt đầu dò, đổi nhiệt độ hoặc rút đầu dò giữa chừng.
+ */
+
+#include <OneWire.h>
+
+typedef uint8_t DeviceAddress[8];
+
+#define DEVICE_DISCONNECTED_C -127
+
+// Thời gian chiếm bus (µs) ở tốc độ chuẩn
+#define HOST_ONEWIRE_RESET_US 960
+#define HOST_ONEWIRE_BIT_US 70
+#define HOST_ONEWIRE_SEARCH_BITS_PER_DEVICE (64 * 3)   // Mỗi bit ROM: đọc bit, đọc bù, ghi hướng
+
+struct HostDs18b20 {
+  DeviceAddress rom;
+  float tempC;
+  uint8_t resolution;
+  bool present;
+};
+
+struct HostOneWireStats {
+  uint32_t resets;
+  uint32_t convertCommands;
+  uint32_t scratchpadReads;
+  uint32_t searches;
+  uint64_t busyUs;              // Tổng thời gian chiếm bus (kể cả chờ chuyển đổi khi chặn)
+};
+
+inline std::vector<HostDs18b20>& hostOneWireBus() {
+  static std::vector<HostDs18b20> bus;
+  return bus;
+}
+
+inline HostOneWireStats& hostOneWireStats() {
+  static HostOneWireStats stats;
+  return stats;
+}
+
+inline void hostOneWireClear() {
+  hostOneWireBus().clear();
+  memset(&hostOneWireStats(), 0, sizeof(HostOneWireStats));
+}
+
+/**
+ * @brief Thêm đầu dò với ROM family 0x28, số serial `serial` và byte CRC đúng.
+ */
+inline HostDs18b20& hostOneWireAddProbe(uint32_t serial, float tempC) {
+  HostDs18b20 probe;
+  memset(&probe, 0, sizeof(probe));
+  probe.rom[0] = 0x28;
+  for (int i = 0; i < 4; i++) probe.rom[1 + i] = (uint8_t)(serial >> (8 * i));
+  uint8_t crc = 0;
+  for (int i = 0; i < 7; i++) {
+    uint8_t in = probe.rom[i];
+    for (int b = 0; b < 8; b++) {
+      uint8_t mix = (crc ^ in) & 0x01;
+      crc >>= 1;
+      if (mix) crc ^= 0x8C;
+      in >>= 1;
+    }
+  }
+  probe.rom[7] = crc;
+  probe.tempC = tempC;
+  probe.resolution = 12;
+  probe.present = true;
+  hostOneWireBus().push_back(probe);
+  return hostOneWireBus().back();
+}
+
+inline void hostOneWireBusy(uint32_t bits) {
+  uint64_t us = HOST_ONEWIRE_RESET_US + (uint64_t)bits * HOST_ONEWIRE_BIT_US;
+  hostOneWireStats().resets++;
+  hostOneWireStats().busyUs += us;
+  hostAdvanceUs(us);
+}
+
+class DallasTemperature {
+ public:
+  explicit DallasTemperature(OneWire*) : waitForConversion_(true) {}
+
+  void begin() {
+    hostOneWireStats().searches++;
+    hostOneWireBusy(HOST_ONEWIRE_SEARCH_BITS_PER_DEVICE * (uint32_t)presentCount());
+  }
+
+  void setWaitForConversion(bool wait) { waitForConversion_ = wait; }
+
+  uint8_t getDeviceCount() { return presentCount(); }
+
+  // Thư viện thật search lại bus từ đầu tới thiết bị thứ `index`
+  bool getAddress(uint8_t* rom, uint8_t index) {
+    hostOneWireStats().searches++;
+    uint8_t seen = 0;
+    for (size_t i = 0; i < hostOneWireBus().size(); i++) {
+      if (!hostOneWireBus()[i].present) continue;
+      hostOneWireBusy(HOST_ONEWIRE_SEARCH_BITS_PER_DEVICE);
+      if (seen++ == index) {
+        memcpy(rom, hostOneWireBus()[i].rom, 8);
+        return true;
+      }
+    }
+    return false;
+  }
+
+  bool validAddress(const uint8_t* rom) {
+    uint8_t crc = 0;
+    for (int i = 0; i < 7; i++) {
+      uint8_t in = rom[i];
+      for (int b = 0; b < 8; b++) {
+        uint8_t mix = (crc ^ in) & 0x01;
+        crc >>= 1;
+        if (mix) crc ^= 0x8C;
+        in >>= 1;
+      }
+    }
+    return crc == rom[7];
+  }
+
+  bool setResolution(const uint8_t* rom, uint8_t bits) {
+    HostDs18b20* probe = find(rom);
+    hostOneWireBusy(8 + 64 + 8 + 24);  // Match ROM + Write Scratchpad
+    if (probe == NULL) return false;
+    probe->resolution = bits;
+    return true;
+  }
+
+  // Độ phân giải lớn nhất trên bus
+  uint8_t getResolution() {
+    uint8_t bits = 9;
+    for (size_t i = 0; i < hostOneWireBus().size(); i++) {
+      if (hostOneWireBus()[i].present && hostOneWireBus()[i].resolution > bits) bits = hostOneWireBus()[i].resolution;
+    }
+    return bits;
+  }
+
+  int16_t millisToWaitForConversion(uint8_t bits) {
+    switch (bits) {
+      case 9: return 94;
+      case 10: return 188;
+      case 11: return 375;
+      default: return 750;
+    }
+  }
+
+  // Skip ROM + Convert T; chế độ chặn thì chờ luôn thời gian chuyển đổi
+  void requestTemperatures() {
+    hostOneWireStats().convertCommands++;
+    hostOneWireBusy(8 + 8);
+    if (waitForConversion_) {
+      uint32_t ms = millisToWaitForConversion(getResolution());
+      hostOneWireStats().busyUs += (uint64_t)ms * 1000;
+      hostAdvanceMs(ms);
+    }
+  }
+
+  // Match ROM + Read Scratchpad (9 byte)
+  float getTempC(const uint8_t* rom) {
+    hostOneWireStats().scratchpadReads++;
+    hostOneWireBusy(8 + 64 + 8 + 72);
+    HostDs18b20* probe = find(rom);
+    if (probe == NULL) return DEVICE_DISCONNECTED_C;
+    // Làm tròn theo độ phân giải như cảm biến thật (bước 0.5 / 0.25 / 0.125 / 0.0625 °C)
+    float step = 0.5f / (float)(1 << (probe->resolution - 9));
+    return floorf(probe->tempC / step) * step;
+  }
+
+  float getTempCByIndex(uint8_t index) {
+    DeviceAddress rom;
+    if (!getAddress(rom, index)) return DEVICE_DISCONNECTED_C;
+    return getTempC(rom);
+  }
+
+ private:
+  bool waitForConversion_;
+
+  static uint8_t presentCount() {
+    uint8_t n = 0;
+    for (size_t i = 0; i < hostOneWireBus().size(); i++) {
+      if (hostOneWireBus()[i].present) n++;
+    }
+    return n;
+  }
+
+  static HostDs18b20* find(const uint8_t* rom) {
+    for (size_t i = 0; i < hostOneWireBus().size(); i++) {
+      HostDs18b20& probe = hostOneWireBus()[i];
+      if (probe.present && memcmp(probe.rom, rom, 8) == 0) return &probe;
+    }
+    return NULL;
+  }
+};
+
+#endif
@@ -0,0 +1,20 @@
+#ifndef HOST_ONEWIRE_H
+#define HOST_ONEWIRE_H
+
+/**
+ * @file OneWire.h
+ * @brief OneWire giả cho env:native: chỉ giữ chân GPIO, bus thật được mô phỏng trong DallasTemperature.h.
+ */
+
+#include <Arduino.h>
+
+class OneWire {
+ public:
+  explicit OneWire(uint8_t pin) : pin_(pin) {}
+  uint8_t pin() const { return pin_; }
+
+ private:
+  uint8_t pin_;
+};
+
+#endif
@@ -0,0 +1,95 @@
+#ifndef HOST_PREFERENCES_H
+#define HOST_PREFERENCES_H
+
+/**
+ * @file Preferences.h
+ * @brief NVS giả trong RAM cho test host: mỗi namespace là một map key → byte, sống tới hết tiến trình.
+ * hostNvsClear() xóa toàn bộ để giả lập flash mới (hoặc "xóa NVS" khi nạp lại firmware).
+ * hostNvsWrites() đếm số lần put* (mỗi lần là một lần ghi flash trên chip thật).
+ */
+
+#include <Arduino.h>
+
+typedef std::map<std::string, std::vector<uint8_t> > HostNvsNamespace;
+
+inline std::map<std::string, HostNvsNamespace>& hostNvs() {
+  static std::map<std::string, HostNvsNamespace> store;
+  return store;
+}
+
+inline void hostNvsClear() { hostNvs().clear(); }
+
+inline uint32_t& hostNvsWrites() {
+  static uint32_t writes = 0;
+  return writes;
+}
+
+class Preferences {
+ public:
+  bool begin(const char* name, bool readOnly = false) {
+    ns_ = &hostNvs()[name];
+    readOnly_ = readOnly;
+    return true;
+  }
+  void end() { ns_ = NULL; }
+  bool clear() {
+    if (ns_ == NULL || readOnly_) return false;
+    ns_->clear();
+    return true;
+  }
+  bool remove(const char* key) { return ns_ != NULL && !readOnly_ && ns_->erase(key) > 0; }
+  bool isKey(const char* key) { return ns_ != NULL && ns_->count(key) > 0; }
+
+  size_t putBytes(const char* key, const void* value, size_t len) {
+    if (ns_ == NULL || readOnly_) return 0;
+    const uint8_t* p = (const uint8_t*)value;
+    hostNvsWrites()++;
+    (*ns_)[key] = std::vector<uint8_t>(p, p + len);
+    return len;
+  }
+  size_t getBytesLength(const char* key) {
+    const std::vector<uint8_t>* v = find(key);
+    return v ? v->size() : 0;
+  }
+  size_t getBytes(const char* key, void* buf, size_t maxLen) {
+    const std::vector<uint8_t>* v = find(key);
+    if (v == NULL || v->size() > maxLen) return 0;
+    memcpy(buf, v->data(), v->size());
+    return v->size();
+  }
+
+  size_t putUChar(const char* key, uint8_t value) { return putBytes(key, &value, sizeof(value)); }
+  size_t putUShort(const char* key, uint16_t value) { return putBytes(key, &value, sizeof(value)); }
+  size_t putUInt(const char* key, uint32_t value) { return putBytes(key, &value, sizeof(value)); }
+  size_t putULong(const char* key, uint32_t value) { return putBytes(key, &value, sizeof(value)); }
+  uint8_t getUChar(const char* key, uint8_t def = 0) { return getScalar(key, def); }
+  uint16_t getUShort(const char* key, uint16_t def = 0) { return getScalar(key, def); }
+  uint32_t getUInt(const char* key, uint32_t def = 0) { return getScalar(key, def); }
+  uint32_t getULong(const char* key, uint32_t def = 0) { return getScalar(key, def); }
+
+  size_t putString(const char* key, const char* value) { return putBytes(key, value, strlen(value) + 1); }
+  String getString(const char* key, const String& def = String()) {
+    const std::vector<uint8_t>* v = find(key);
+    return v ? String((const char*)v->data()) : def;
+  }
+
+ private:
+  const std::vector<uint8_t>* find(const char* key) {
+    if (ns_ == NULL) return NULL;
+    HostNvsNamespace::const_iterator it = ns_->find(key);
+    return it == ns_->end() ? NULL : &it->second;
+  }
+  template <typename T>
+  T getScalar(const char* key, T def) {
+    const std::vector<uint8_t>* v = find(key);
+    if (v == NULL || v->size() != sizeof(T)) return def;
+    T out;
+    memcpy(&out, v->data(), sizeof(T));
+    return out;
+  }
+
+  HostNvsNamespace* ns_ = NULL;
+  bool readOnly_ = false;
+};
+
+#endif
@@ -0,0 +1,97 @@
+#ifndef HOST_SPIFFS_H
+#define HOST_SPIFFS_H
+
+/**
+ * @file SPIFFS.h
+ * @brief SPIFFS giả trong RAM cho test host: đủ open/read/write/seek/size/remove/exists như telemetry_log
+ * dùng, kèm bộ đếm thao tác để harness ước lượng chi phí flash.
+ */
+
+#include <Arduino.h>
+
+#define FILE_READ "r"
+#define FILE_WRITE "w"
+#define FILE_APPEND "a"
+
+struct HostFsStats {
+  uint32_t opens;
+  uint32_t writes;
+  uint32_t bytesWritten;
+  uint32_t reads;
+  uint32_t removes;
+};
+
+inline std::map<std::string, std::vector<uint8_t> >& hostFsFiles() {
+  static std::map<std::string, std::vector<uint8_t> > files;
+  return files;
+}
+
+inline HostFsStats& hostFsStats() {
+  static HostFsStats stats;
+  return stats;
+}
+
+inline void hostFsClear() {
+  hostFsFiles().clear();
+  memset(&hostFsStats(), 0, sizeof(HostFsStats));
+}
+
+class File {
+ public:
+  File() {}
+  File(std::vector<uint8_t>* data, size_t pos) : data_(data), pos_(pos) {}
+  explicit operator bool() const { return data_ != NULL; }
+  size_t size() const { return data_ ? data_->size() : 0; }
+  bool seek(uint32_t pos) {
+    if (data_ == NULL || pos > data_->size()) return false;
+    pos_ = pos;
+    return true;
+  }
+  size_t read(uint8_t* buf, size_t n) {
+    if (data_ == NULL) return 0;
+    size_t got = std::min(n, data_->size() - pos_);
+    memcpy(buf, data_->data() + pos_, got);
+    pos_ += got;
+    hostFsStats().reads++;
+    return got;
+  }
+  size_t write(const uint8_t* buf, size_t n) {
+    if (data_ == NULL) return 0;
+    if (pos_ + n > data_->size()) data_->resize(pos_ + n);
+    memcpy(data_->data() + pos_, buf, n);
+    pos_ += n;
+    hostFsStats().writes++;
+    hostFsStats().bytesWritten += n;
+    return n;
+  }
+  void close() { data_ = NULL; }
+
+ private:
+  std::vector<uint8_t>* data_ = NULL;
+  size_t pos_ = 0;
+};
+
+class HostSpiffs {
+ public:
+  bool begin(bool = false) { return true; }
+  File open(const char* path, const char* mode) {
+    std::map<std::string, std::vector<uint8_t> >& files = hostFsFiles();
+    hostFsStats().opens++;
+    if (mode[0] == 'r') {
+      std::map<std::string, std::vector<uint8_t> >::iterator it = files.find(path);
+      return it == files.end() ? File() : File(&it->second, 0);
+    }
+    std::vector<uint8_t>& data = files[path];
+    if (mode[0] == 'w') data.clear();
+    return File(&data, data.size());
+  }
+  bool exists(const char* path) { return hostFsFiles().count(path) > 0; }
+  bool remove(const char* path) {
+    hostFsStats().removes++;
+    return hostFsFiles().erase(path) > 0;
+  }
+};
+
+static HostSpiffs SPIFFS __attribute__((unused));
+
+#endif
@@ -0,0 +1,31 @@
+#ifndef HOST_ESP_OTA_OPS_H
+#define HOST_ESP_OTA_OPS_H
+
+/**
+ * @file esp_ota_ops.h
+ * @brief esp_ota_* giả cho test host: phân vùng OTA kế tiếp là hostOtaPartition(); chọn phân vùng boot chỉ
+ * ghi lại phân vùng và trả hostOtaBootResult() (test đặt lỗi kiểm ảnh).
+ */
+
+#include <esp_partition.h>
+
+inline esp_err_t& hostOtaBootResult() {
+  static esp_err_t result = ESP_OK;
+  return result;
+}
+
+inline const esp_partition_t*& hostOtaBootPartition() {
+  static const esp_partition_t* part = NULL;
+  return part;
+}
+
+inline const esp_partition_t* esp_ota_get_next_update_partition(const esp_partition_t*) {
+  return &hostOtaPartition();
+}
+
+inline esp_err_t esp_ota_set_boot_partition(const esp_partition_t* part) {
+  if (hostOtaBootResult() == ESP_OK) hostOtaBootPartition() = part;
+  return hostOtaBootResult();
+}
+
+#endif
@@ -0,0 +1,78 @@
+#ifndef HOST_ESP_PARTITION_H
+#define HOST_ESP_PARTITION_H
+
+/**
+ * @file esp_partition.h
+ * @brief Phân vùng flash giả trong RAM cho test host, giữ đúng tính chất NOR flash: xóa theo sector 4096 về
+ * 0xFF, ghi chỉ kéo bit 1 → 0. Ghi đè lên byte chưa xóa không báo lỗi (như chip thật) mà được đếm vào
+ * `dirtyWrites` để test bắt được chỗ quên xóa sector.
+ */
+
+#include <esp_err.h>
+#include <string.h>
+#include <vector>
+
+#define HOST_FLASH_SECTOR_BYTES 4096
+
+struct esp_partition_t {
+  uint32_t address;
+  uint32_t size;
+  char label[17];
+};
+
+struct HostFlashStats {
+  uint32_t erases;          // Số sector đã xóa
+  uint32_t writes;
+  uint32_t bytesWritten;
+  uint32_t dirtyWrites;     // Byte ghi vào chỗ chưa xóa cần bit 0 → 1 (dữ liệu hỏng trên chip thật)
+};
+
+inline std::vector<uint8_t>& hostFlashData() {
+  static std::vector<uint8_t> data;
+  return data;
+}
+
+inline HostFlashStats& hostFlashStats() {
+  static HostFlashStats stats;
+  return stats;
+}
+
+/**
+ * @brief Phân vùng OTA kế tiếp (ota_1) trả về từ esp_ota_get_next_update_partition().
+ */
+inline esp_partition_t& hostOtaPartition() {
+  static esp_partition_t part = { 0x1A0000, 0x160000, "ota_1" };
+  return part;
+}
+
+/**
+ * @brief Flash mới: toàn bộ phân vùng là byte rác khác 0xFF (chưa xóa), bộ đếm về 0.
+ */
+inline void hostFlashReset() {
+  hostFlashData().assign(hostOtaPartition().size, 0x00);
+  memset(&hostFlashStats(), 0, sizeof(HostFlashStats));
+}
+
+inline esp_err_t esp_partition_erase_range(const esp_partition_t* part, size_t offset, size_t size) {
+  if (part == NULL || offset % HOST_FLASH_SECTOR_BYTES || size % HOST_FLASH_SECTOR_BYTES) return ESP_ERR_INVALID_ARG;
+  if (offset + size > part->size) return ESP_ERR_INVALID_SIZE;
+  memset(hostFlashData().data() + offset, 0xFF, size);
+  hostFlashStats().erases += size / HOST_FLASH_SECTOR_BYTES;
+  return ESP_OK;
+}
+
+inline esp_err_t esp_partition_write(const esp_partition_t* part, size_t offset, const void* src, size_t size) {
+  if (part == NULL) return ESP_ERR_INVALID_ARG;
+  if (offset + size > part->size) return ESP_ERR_INVALID_SIZE;
+  const uint8_t* p = (const uint8_t*)src;
+  uint8_t* flash = hostFlashData().data() + offset;
+  for (size_t i = 0; i < size; i++) {
+    if ((p[i] & ~flash[i]) != 0) hostFlashStats().dirtyWrites++;
+    flash[i] &= p[i];
+  }
+  hostFlashStats().writes++;
+  hostFlashStats().bytesWritten += size;
+  return ESP_OK;
+}
+
+#endif
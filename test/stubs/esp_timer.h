@@ -0,0 +1,13 @@
+#ifndef HOST_ESP_TIMER_H
+#define HOST_ESP_TIMER_H
+
+/**
+ * @file esp_timer.h
+ * @brief esp_timer_get_time() theo đồng hồ giả của Arduino.h (µs).
+ */
+
+#include <Arduino.h>
+
+inline int64_t esp_timer_get_time() { return (int64_t)hostClockUs(); }
+
+#endif
@@ -0,0 +1,114 @@
+/**
+ * @file test_main.cpp
+ * @brief Test SpscRing của adc_sampler trên host: đúng thứ tự/không mất mẫu khi producer và consumer
+ * chạy trên hai luồng thật, sức chứa khi consumer bị chặn, và benchmark luồng ADC tổng hợp.
+ */
+
+#include <unity.h>
+#include <chrono>
+#include <thread>
+#include "adc_sampler.h"
+
+void setUp(void) {}
+void tearDown(void) {}
+
+static void test_ring_rejects_when_full_and_pops_exact_blocks(void) {
+  SpscRing<uint16_t, 8> ring;
+  uint16_t out[8];
+  TEST_ASSERT_FALSE(ring.popExact(out, 1));
+  for (uint16_t i = 0; i < 8; i++) TEST_ASSERT_TRUE(ring.push(i));
+  TEST_ASSERT_FALSE(ring.push(99));      // Đầy: mẫu mới bị bỏ, không ghi đè
+  TEST_ASSERT_EQUAL_size_t(8, ring.size());
+
+  TEST_ASSERT_TRUE(ring.popExact(out, 5));
+  TEST_ASSERT_EQUAL_UINT16(0, out[0]);
+  TEST_ASSERT_EQUAL_UINT16(4, out[4]);
+  TEST_ASSERT_FALSE(ring.popExact(out, 4));   // Chỉ còn 3: không lấy gì
+  TEST_ASSERT_EQUAL_size_t(3, ring.size());
+
+  // Vòng qua cuối buffer
+  for (uint16_t i = 100; i < 105; i++) TEST_ASSERT_TRUE(ring.push(i));
+  TEST_ASSERT_TRUE(ring.popExact(out, 8));
+  const uint16_t expected[8] = {5, 6, 7, 100, 101, 102, 103, 104};
+  for (int i = 0; i < 8; i++) TEST_ASSERT_EQUAL_UINT16(expected[i], out[i]);
+}
+
+/**
+ * Consumer (sensorTask) bị chặn: ring ADC_RING_SIZE mẫu giữ được ADC_RING_SIZE / ADC_SAMPLE_RATE_HZ
+ * giây, phần vượt quá được đếm là overrun chứ không làm hỏng dữ liệu cũ.
+ */
+static void test_ring_absorbs_stalled_consumer_up_to_capacity(void) {
+  static SpscRing<uint16_t, ADC_RING_SIZE> ring;
+  const uint32_t stallSamples = ADC_SAMPLE_RATE_HZ * 3;  // sensorTask đứng 3 s
+  uint32_t overruns = 0;
+  for (uint32_t i = 0; i < stallSamples; i++) {
+    if (!ring.push((uint16_t)i)) overruns++;
+  }
+  TEST_ASSERT_EQUAL_UINT32(stallSamples - ADC_RING_SIZE, overruns);
+
+  uint16_t block[ADC_SAMPLES];
+  uint32_t expected = 0;
+  while (ring.popExact(block, ADC_SAMPLES)) {
+    for (size_t i = 0; i < ADC_SAMPLES; i++) TEST_ASSERT_EQUAL_UINT16(expected++, block[i]);
+  }
+  TEST_ASSERT_EQUAL_UINT32(ADC_RING_SIZE, expected);
+}
+
+/**
+ * Luồng ADC tổng hợp: producer đẩy dãy tăng dần nhanh hết mức (chờ khi đầy), consumer rút từng block
+ * ADC_SAMPLES trên luồng khác. Mọi mẫu phải tới đúng thứ tự, không trùng, không mất.
+ */
+static void test_synthetic_stream_two_threads(void) {
+  static SpscRing<uint16_t, ADC_RING_SIZE> ring;
+  const uint32_t total = 4000000;
+
+  std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+  std::thread producer([&]() {
+    for (uint32_t i = 0; i < total; i++) {
+      while (!ring.push((uint16_t)i)) std::this_thread::yield();
+    }
+  });
+
+  uint16_t block[ADC_SAMPLES];
+  uint32_t received = 0;
+  uint32_t mismatches = 0;
+  uint32_t blocks = 0;
+  double popNsTotal = 0;
+  while (received < total) {
+    std::chrono::steady_clock::time_point p0 = std::chrono::steady_clock::now();
+    bool ok = ring.popExact(block, ADC_SAMPLES);
+    double popNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - p0).count();
+    if (!ok) {
+      std::this_thread::yield();
+      continue;
+    }
+    popNsTotal += popNs;
+    for (size_t i = 0; i < ADC_SAMPLES; i++) {
+      if (block[i] != (uint16_t)(received + i)) mismatches++;
+    }
+    received += ADC_SAMPLES;
+    blocks++;
+  }
+  producer.join();
+  double elapsedS = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+  TEST_ASSERT_EQUAL_UINT32(0, mismatches);
+  TEST_ASSERT_EQUAL_UINT32(total, received);
+  TEST_ASSERT_EQUAL_size_t(0, ring.size());
+
+  // Cách cũ: readSensors() tự lấy ADC_SAMPLES mẫu mỗi kênh với delayMicroseconds(100) giữa các mẫu
+  double oldBlockUs = 2.0 * ADC_SAMPLES * 100.0;
+  char msg[200];
+  snprintf(msg, sizeof msg, "[BENCH] %u mẫu qua ring: %.1f M mẫu/s, rút block %d mẫu trung bình %.0f ns "
+           "(cách cũ chặn >= %.0f us mỗi lượt đọc 2 kênh)",
+           total, total / elapsedS / 1e6, ADC_SAMPLES, popNsTotal / blocks, oldBlockUs);
+  TEST_MESSAGE(msg);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_ring_rejects_when_full_and_pops_exact_blocks);
+  RUN_TEST(test_ring_absorbs_stalled_consumer_up_to_capacity);
+  RUN_TEST(test_synthetic_stream_two_threads);
+  return UNITY_END();
+}
@@ -0,0 +1,209 @@
+/**
+ * @file test_main.cpp
+ * @brief Phát lại vết cảm biến nhiễu qua alert_fsm: đếm số lần relay đảo trạng thái và số upload khẩn,
+ * so với cách so ngưỡng trực tiếp cũ; kiểm tra độ trễ bật, thời gian bật/tắt tối thiểu và cửa sổ gộp.
+ */
+
+#include <unity.h>
+#include <math.h>
+#include "alert_fsm.h"
+
+static uint32_t rngState = 1;
+static uint32_t nowMs = 0;
+
+static float noise(float amp) {
+  rngState = rngState * 1664525u + 1013904223u;
+  return amp * (2.0f * (float)(rngState >> 8) / 16777215.0f - 1.0f);
+}
+
+static void clearInputs(float* values, float* thresholds) {
+  for (int i = 0; i < ALERT_CH_COUNT; i++) {
+    values[i] = NAN;
+    thresholds[i] = 0.0f;
+  }
+}
+
+/**
+ * @brief Đưa mọi kênh về OFF và ra khỏi cửa sổ gộp (trạng thái FSM là toàn cục, dùng chung giữa các test).
+ */
+static void settleFsm() {
+  float values[ALERT_CH_COUNT];
+  float thresholds[ALERT_CH_COUNT];
+  clearInputs(values, thresholds);
+  for (int i = 0; i < 200; i++) {
+    nowMs += 1000;
+    alertFsmEvaluate(values, thresholds, nowMs);
+  }
+  nowMs += ALERT_COALESCE_MS;
+}
+
+void setUp(void) {
+  rngState = 7;
+  settleFsm();
+}
+
+void tearDown(void) {}
+
+struct TraceCounts {
+  uint32_t relayToggles;
+  uint32_t urgentUploads;
+};
+
+/**
+ * @brief Một kênh, mỗi ALERT_CHANNEL_PERIOD_MS một mẫu như kênh "alert" của sensor_scheduler.
+ * Đếm cho cả FSM và cách cũ (relay = giá trị vượt ngưỡng, upload khẩn ở mỗi cạnh lên).
+ */
+template <typename Trace>
+static void replay(AlertChannelId ch, float threshold, Trace trace, uint32_t durationMs, TraceCounts& fsmOut,
+                   TraceCounts& directOut) {
+  float values[ALERT_CH_COUNT];
+  float thresholds[ALERT_CH_COUNT];
+  clearInputs(values, thresholds);
+  thresholds[ch] = threshold;
+  bool fsmOn = false;
+  bool directOn = false;
+  fsmOut.relayToggles = fsmOut.urgentUploads = 0;
+  directOut.relayToggles = directOut.urgentUploads = 0;
+  uint32_t start = nowMs;
+  for (uint32_t t = 0; t < durationMs; t += ALERT_CHANNEL_PERIOD_MS) {
+    nowMs = start + t;
+    values[ch] = trace(t);
+    AlertFsmResult res = alertFsmEvaluate(values, thresholds, nowMs);
+    bool on = res.activeMask & (1 << ch);
+    if (on != fsmOn) fsmOut.relayToggles++;
+    if (res.raisedMask & (1 << ch)) fsmOut.urgentUploads++;
+    fsmOn = on;
+
+    bool direct = ch == ALERT_CH_FIRE ? values[ch] < threshold : values[ch] > threshold;
+    if (direct != directOn) {
+      directOut.relayToggles++;
+      if (direct) directOut.urgentUploads++;
+    }
+    directOn = direct;
+  }
+}
+
+// Một giờ nhiễu MQ-135 quanh ngưỡng: ±60 nhanh + dao động chậm ±40 chu kỳ 5 phút
+static float smokeNoiseAtThreshold(uint32_t t) {
+  return SMOKE_THRESHOLD + noise(60.0f) + 40.0f * sinf(2.0f * (float)M_PI * t / 300000.0f);
+}
+
+static void test_noisy_smoke_trace_does_not_flap(void) {
+  TraceCounts fsm, direct;
+  replay(ALERT_CH_SMOKE, SMOKE_THRESHOLD, smokeNoiseAtThreshold, 3600000, fsm, direct);
+  char msg[160];
+  snprintf(msg, sizeof msg, "[REPLAY] 1 giờ MQ-135 quanh ngưỡng: so trực tiếp %u lần đảo relay / %u upload khẩn, "
+           "FSM %u / %u", direct.relayToggles, direct.urgentUploads, fsm.relayToggles, fsm.urgentUploads);
+  TEST_MESSAGE(msg);
+  TEST_ASSERT_GREATER_THAN(1000, direct.relayToggles);
+  TEST_ASSERT_LESS_OR_EQUAL(2, fsm.relayToggles);
+  TEST_ASSERT_EQUAL_UINT32(1, fsm.urgentUploads);
+}
+
+// Nhiễu nhỏ ngay dưới ngưỡng có xung lẻ vượt ngưỡng ngắn hơn thời gian xác nhận bật
+static float smokeBelowWithGlitches(uint32_t t) {
+  float v = SMOKE_THRESHOLD - 150.0f + noise(30.0f);
+  if ((t / ALERT_CHANNEL_PERIOD_MS) % 97 == 0) v = SMOKE_THRESHOLD + 400.0f;
+  return v;
+}
+
+static void test_short_glitches_are_debounced(void) {
+  TraceCounts fsm, direct;
+  replay(ALERT_CH_SMOKE, SMOKE_THRESHOLD, smokeBelowWithGlitches, 600000, fsm, direct);
+  TEST_ASSERT_GREATER_THAN(50, direct.urgentUploads);
+  TEST_ASSERT_EQUAL_UINT32(0, fsm.relayToggles);
+  TEST_ASSERT_EQUAL_UINT32(0, fsm.urgentUploads);
+}
+
+// Sự kiện thật: khói vượt xa ngưỡng từ giây 60 tới giây 180
+static float smokeRealEvent(uint32_t t) {
+  float v = SMOKE_THRESHOLD - 500.0f + noise(40.0f);
+  if (t >= 60000 && t < 180000) v = SMOKE_THRESHOLD + 800.0f + noise(40.0f);
+  return v;
+}
+
+static void test_real_event_raises_once_and_clears(void) {
+  float values[ALERT_CH_COUNT];
+  float thresholds[ALERT_CH_COUNT];
+  clearInputs(values, thresholds);
+  thresholds[ALERT_CH_SMOKE] = SMOKE_THRESHOLD;
+  uint32_t start = nowMs;
+  int32_t onAt = -1;
+  int32_t offAt = -1;
+  uint32_t raises = 0;
+  for (uint32_t t = 0; t < 300000; t += ALERT_CHANNEL_PERIOD_MS) {
+    nowMs = start + t;
+    values[ALERT_CH_SMOKE] = smokeRealEvent(t);
+    AlertFsmResult res = alertFsmEvaluate(values, thresholds, nowMs);
+    if (res.raisedMask & ALERT_REASON_SMOKE) {
+      raises++;
+      if (onAt < 0) onAt = t;
+    }
+    if ((res.clearedMask & ALERT_REASON_SMOKE) && offAt < 0) offAt = t;
+  }
+  TEST_ASSERT_EQUAL_UINT32(1, raises);
+  // Xác nhận bật 1 s; tắt sau khi hết vượt ngưỡng 5 s (clearDelay của SMOKE)
+  TEST_ASSERT_EQUAL_INT32(61000, onAt);
+  TEST_ASSERT_EQUAL_INT32(185000, offAt);
+}
+
+static void test_fire_sets_immediately_and_holds_min_on(void) {
+  float values[ALERT_CH_COUNT];
+  float thresholds[ALERT_CH_COUNT];
+  clearInputs(values, thresholds);
+  thresholds[ALERT_CH_FIRE] = FIRE_ANALOG_THRESHOLD;
+  values[ALERT_CH_FIRE] = 900.0f;
+  alertFsmEvaluate(values, thresholds, nowMs);
+
+  values[ALERT_CH_FIRE] = 0.0f;  // DO kích từ ISR
+  nowMs += ALERT_CHANNEL_PERIOD_MS;
+  AlertFsmResult res = alertFsmEvaluate(values, thresholds, nowMs);
+  TEST_ASSERT_TRUE(res.raisedMask & ALERT_REASON_FIRE);
+
+  // Xung lửa đã hết nhưng relay giữ ít nhất minOn 5 s + clearDelay 2 s
+  values[ALERT_CH_FIRE] = 900.0f;
+  uint32_t onSince = nowMs;
+  uint32_t clearedAfter = 0;
+  for (int i = 0; i < 200 && clearedAfter == 0; i++) {
+    nowMs += ALERT_CHANNEL_PERIOD_MS;
+    res = alertFsmEvaluate(values, thresholds, nowMs);
+    if (res.clearedMask & ALERT_REASON_FIRE) clearedAfter = nowMs - onSince;
+  }
+  TEST_ASSERT_EQUAL_UINT32(7000, clearedAfter);
+}
+
+static void test_reassert_within_coalesce_window_is_not_new_event(void) {
+  float values[ALERT_CH_COUNT];
+  float thresholds[ALERT_CH_COUNT];
+  clearInputs(values, thresholds);
+  thresholds[ALERT_CH_FIRE] = FIRE_ANALOG_THRESHOLD;
+  AlertChannelStats before = alertFsmGetStats(ALERT_CH_FIRE);
+
+  uint32_t raises = 0;
+  // Hai lần bật cách nhau 30 s (trong cửa sổ gộp), rồi lần thứ ba sau cửa sổ gộp
+  const uint32_t pulses[3] = {0, 30000, 30000 + ALERT_COALESCE_MS + 20000};
+  uint32_t start = nowMs;
+  for (uint32_t t = 0; t < pulses[2] + 20000; t += ALERT_CHANNEL_PERIOD_MS) {
+    bool fire = false;
+    for (int p = 0; p < 3; p++) {
+      if (t >= pulses[p] && t < pulses[p] + 1000) fire = true;
+    }
+    values[ALERT_CH_FIRE] = fire ? 100.0f : 900.0f;
+    nowMs = start + t;
+    if (alertFsmEvaluate(values, thresholds, nowMs).raisedMask & ALERT_REASON_FIRE) raises++;
+  }
+  AlertChannelStats after = alertFsmGetStats(ALERT_CH_FIRE);
+  TEST_ASSERT_EQUAL_UINT32(2, raises);
+  TEST_ASSERT_EQUAL_UINT32(2, after.events - before.events);
+  TEST_ASSERT_EQUAL_UINT32(1, after.coalesced - before.coalesced);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_noisy_smoke_trace_does_not_flap);
+  RUN_TEST(test_short_glitches_are_debounced);
+  RUN_TEST(test_real_event_raises_once_and_clears);
+  RUN_TEST(test_fire_sets_immediately_and_holds_min_on);
+  RUN_TEST(test_reassert_within_coalesce_window_is_not_new_event);
+  return UNITY_END();
+}
@@ -0,0 +1,278 @@
+/**
+ * @file test_main.cpp
+ * @brief Test at_parser với modem giả lập theo kịch bản (phản hồi cắt thành mảnh UART ngẫu nhiên, URC
+ * chen giữa lệnh, payload socket nhị phân) và fuzz bằng byte ngẫu nhiên.
+ */
+
+#include <unity.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include "at_parser.h"
+
+static uint32_t rngState = 1;
+
+static uint32_t nextRandom(uint32_t n) {
+  rngState = rngState * 1664525u + 1013904223u;
+  return (rngState >> 8) % n;
+}
+
+void setUp(void) { rngState = 99; }
+void tearDown(void) {}
+
+// ---- Modem giả lập ----
+
+struct EmittedLine {
+  std::string text;
+  AtLineKind kind;
+  AtUrc urc;
+};
+
+/**
+ * @brief Phía host của at_engine: ghi nhận URC, chuyển dòng còn lại cho lệnh đang chạy.
+ */
+struct HostSession {
+  AtParser parser;
+  AtCommandState cmd;
+  bool cmdActive;
+  std::vector<EmittedLine> lines;
+  std::vector<AtUrc> urcs;
+  const char* haltOn;
+};
+
+static void sessionSink(void* ctx, const char* line, AtLineKind kind, AtUrc urc) {
+  HostSession* s = (HostSession*)ctx;
+  EmittedLine e = { line, kind, urc };
+  s->lines.push_back(e);
+  TEST_ASSERT_TRUE(strlen(line) < AT_LINE_MAX);
+  if (kind == AT_LINE_URC) {
+    s->urcs.push_back(urc);
+  } else if (s->cmdActive && atCommandOnLine(s->cmd, line, kind)) {
+    s->cmdActive = false;
+  }
+  if (s->haltOn && strcmp(line, s->haltOn) == 0) s->parser.halt = true;
+}
+
+static void sessionBegin(HostSession& s) {
+  atParserReset(s.parser);
+  s.cmdActive = false;
+  s.lines.clear();
+  s.urcs.clear();
+  s.haltOn = NULL;
+}
+
+static void sessionSend(HostSession& s, const char* tx, const char* finalPrefix) {
+  atParserNoteTx(s.parser, (const uint8_t*)tx, strlen(tx));
+  atCommandStart(s.cmd, finalPrefix);
+  s.cmdActive = true;
+}
+
+/**
+ * @brief Modem trả `rx` thành các mảnh UART dài ngẫu nhiên 1..maxChunk byte.
+ * @return Tổng số byte parser đã nhận (nhỏ hơn rx.size() nếu sink dừng parser).
+ */
+static size_t modemReply(HostSession& s, const std::string& rx, uint32_t maxChunk) {
+  size_t pos = 0;
+  while (pos < rx.size()) {
+    size_t chunk = 1 + nextRandom(maxChunk);
+    if (chunk > rx.size() - pos) chunk = rx.size() - pos;
+    size_t used = atParserFeed(s.parser, (const uint8_t*)rx.data() + pos, chunk, sessionSink, &s);
+    pos += used;
+    if (used < chunk) break;
+  }
+  return pos;
+}
+
+// Mỗi kịch bản chạy với nhiều cách cắt mảnh: kết quả phải như nhau
+static const uint32_t CHUNKINGS[] = {1, 2, 3, 7, 64, 4096};
+
+static void test_cpin_reply_is_response_not_urc(void) {
+  for (size_t k = 0; k < sizeof(CHUNKINGS) / sizeof(CHUNKINGS[0]); k++) {
+    HostSession s;
+    sessionBegin(s);
+    sessionSend(s, "AT+CPIN?\r", NULL);
+    modemReply(s, "\r\n+CPIN: READY\r\n\r\nOK\r\n", CHUNKINGS[k]);
+    TEST_ASSERT_EQUAL(AT_OK, s.cmd.status);
+    TEST_ASSERT_EQUAL_STRING("+CPIN: READY", s.cmd.response);
+    TEST_ASSERT_EQUAL_size_t(0, s.urcs.size());
+
+    // Cùng dòng khi không có lệnh nào chờ: SIM lỏng → URC
+    sessionSend(s, "ATE0\r", NULL);
+    modemReply(s, "\r\nOK\r\n\r\n+CPIN: NOT READY\r\n", CHUNKINGS[k]);
+    TEST_ASSERT_EQUAL_size_t(1, s.urcs.size());
+    TEST_ASSERT_EQUAL(AT_URC_CPIN, s.urcs[0]);
+  }
+}
+
+static void test_netopen_waits_for_final_result_with_urc_in_between(void) {
+  for (size_t k = 0; k < sizeof(CHUNKINGS) / sizeof(CHUNKINGS[0]); k++) {
+    HostSession s;
+    sessionBegin(s);
+    sessionSend(s, "AT+NETOPEN\r", "+NETOPEN:");
+    modemReply(s, "\r\nOK\r\n", CHUNKINGS[k]);
+    TEST_ASSERT_EQUAL(AT_PENDING, s.cmd.status);  // "OK" chỉ là đã nhận lệnh
+    modemReply(s, "\r\n+CGREG: 1\r\n\r\n+NETOPEN: 0\r\n", CHUNKINGS[k]);
+    TEST_ASSERT_EQUAL(AT_OK, s.cmd.status);
+    TEST_ASSERT_EQUAL_STRING("+NETOPEN: 0", s.cmd.response);
+    TEST_ASSERT_EQUAL_size_t(1, s.urcs.size());
+    TEST_ASSERT_EQUAL(AT_URC_CREG, s.urcs[0]);
+  }
+}
+
+static void test_netclose_error_and_unsolicited_netclose(void) {
+  HostSession s;
+  sessionBegin(s);
+  sessionSend(s, "AT+NETCLOSE\r", "+NETCLOSE:");
+  modemReply(s, "\r\n+NETCLOSE: 2\r\n\r\nERROR\r\n", 5);
+  TEST_ASSERT_EQUAL(AT_ERROR, s.cmd.status);
+  TEST_ASSERT_EQUAL_size_t(0, s.urcs.size());
+
+  // Mạng đóng giữa chừng khi lệnh khác đang chạy
+  sessionSend(s, "AT+CSQ\r", NULL);
+  modemReply(s, "\r\n+CSQ: 20,99\r\n\r\n+NETCLOSE: 0\r\n\r\n+CIPEVENT: NETWORK CLOSED UNEXPECTEDLY\r\n\r\nOK\r\n", 3);
+  TEST_ASSERT_EQUAL(AT_OK, s.cmd.status);
+  TEST_ASSERT_EQUAL_STRING("+CSQ: 20,99", s.cmd.response);
+  TEST_ASSERT_EQUAL_size_t(2, s.urcs.size());
+  TEST_ASSERT_EQUAL(AT_URC_NETCLOSE, s.urcs[0]);
+  TEST_ASSERT_EQUAL(AT_URC_CIPEVENT, s.urcs[1]);
+}
+
+static void test_cme_error_code(void) {
+  HostSession s;
+  sessionBegin(s);
+  sessionSend(s, "AT+CGDCONT?\r", NULL);
+  modemReply(s, "\r\n+CME ERROR: 10\r\n", 4);
+  TEST_ASSERT_EQUAL(AT_ERROR, s.cmd.status);
+  TEST_ASSERT_EQUAL_INT(10, s.cmd.cmeError);
+}
+
+static void test_socket_payload_is_not_parsed_as_lines(void) {
+  // Payload chứa đúng những chuỗi URC nguy hiểm nhất
+  const std::string payload = "\r\nRDY\r\n+CIPEVENT: X\r\nOK\r\n";
+  char header[48];
+  snprintf(header, sizeof header, "\r\n+CIPRXGET: 2,0,%u,0\r\n", (unsigned)payload.size());
+  for (size_t k = 0; k < sizeof(CHUNKINGS) / sizeof(CHUNKINGS[0]); k++) {
+    HostSession s;
+    sessionBegin(s);
+    sessionSend(s, "AT+CIPRXGET=2,0,1460\r", NULL);
+    modemReply(s, std::string(header) + payload + "\r\nOK\r\n", CHUNKINGS[k]);
+    TEST_ASSERT_EQUAL(AT_OK, s.cmd.status);
+    TEST_ASSERT_EQUAL_size_t(0, s.urcs.size());
+    TEST_ASSERT_EQUAL_size_t(2, s.lines.size());   // Header + OK
+
+    // Tương tự cho HTTPS của modem
+    sessionSend(s, "AT+CHTTPSRECV=300\r", NULL);
+    char httpsHeader[48];
+    snprintf(httpsHeader, sizeof httpsHeader, "\r\n+CHTTPSRECV: DATA,%u\r\n", (unsigned)payload.size());
+    modemReply(s, std::string(httpsHeader) + payload + "\r\nOK\r\n", CHUNKINGS[k]);
+    TEST_ASSERT_EQUAL(AT_OK, s.cmd.status);
+    TEST_ASSERT_EQUAL_size_t(0, s.urcs.size());
+  }
+}
+
+static void test_tx_payload_does_not_change_command_prefix(void) {
+  HostSession s;
+  sessionBegin(s);
+  const char* cmd = "AT+CIPSEND=0,9\r";
+  atParserNoteTx(s.parser, (const uint8_t*)cmd, strlen(cmd));
+  const char* payload = "AT+CPIN?\r";   // Dữ liệu người dùng trông như lệnh AT
+  atParserNoteTx(s.parser, (const uint8_t*)payload, strlen(payload));
+  TEST_ASSERT_EQUAL_STRING("+CIPSEND", s.parser.cmdPrefix);
+
+  // "+CPIN:" lúc này không phải phản hồi của lệnh nào → URC
+  modemReply(s, "\r\n+CPIN: NOT READY\r\n", 64);
+  TEST_ASSERT_EQUAL_size_t(1, s.urcs.size());
+}
+
+static void test_halt_stops_at_connect(void) {
+  HostSession s;
+  sessionBegin(s);
+  s.haltOn = "CONNECT 115200";
+  sessionSend(s, "ATD*99#\r", NULL);
+  const std::string rx = "\r\nCONNECT 115200\r\n~\x7D\x23\xC0\x21";  // Sau CONNECT là khung PPP
+  size_t used = modemReply(s, rx, 4096);
+  TEST_ASSERT_EQUAL_size_t(rx.find('~'), used);
+}
+
+static void test_long_line_is_truncated_without_overflow(void) {
+  HostSession s;
+  sessionBegin(s);
+  std::string longLine(AT_LINE_MAX * 3, 'Z');
+  modemReply(s, "\r\n" + longLine + "\r\nOK\r\n", 7);
+  TEST_ASSERT_EQUAL_size_t(2, s.lines.size());
+  TEST_ASSERT_EQUAL_size_t(AT_LINE_MAX - 1, s.lines[0].text.size());
+  TEST_ASSERT_EQUAL_UINT32(1, s.parser.truncatedLines);
+  TEST_ASSERT_EQUAL(AT_LINE_OK, s.lines[1].kind);
+}
+
+// ---- Fuzz ----
+
+static const char* const FUZZ_TOKENS[] = {
+  "\r\n", "\r", "\n", "OK", "ERROR", "+CME ERROR: ", "RDY", "+CIPRXGET: 2,0,", "+CIPRXGET: 1,0",
+  "+CHTTPSRECV: DATA,", "+NETCLOSE: ", "+CPIN: ", "+CIPEVENT: ", "+IPCLOSE: ", ",", "9", "12", "4000000000",
+  "-5", "AT+CIPSEND=0,", "AT+CPIN?", "AT+NETOPEN", "AT+CHTTPSSEND=", "\x00", "\xFF",
+};
+
+static std::string fuzzBytes(size_t tokens) {
+  std::string out;
+  for (size_t i = 0; i < tokens; i++) {
+    if (nextRandom(4) == 0) {
+      out.push_back((char)nextRandom(256));
+    } else {
+      const char* t = FUZZ_TOKENS[nextRandom(sizeof(FUZZ_TOKENS) / sizeof(FUZZ_TOKENS[0]))];
+      out.append(t, t[0] == '\0' ? 1 : strlen(t));
+    }
+  }
+  return out;
+}
+
+/**
+ * Byte ngẫu nhiên (thiên về các token nguy hiểm) ở cả RX lẫn TX: không tràn buffer (chạy kèm
+ * -fsanitize=address,undefined khi debug), mọi dòng và phản hồi luôn kết thúc bằng '\0' trong giới hạn,
+ * và cách cắt mảnh UART không làm thay đổi dãy dòng parser trả ra.
+ */
+static void test_fuzz_random_streams(void) {
+  for (int iter = 0; iter < 20000; iter++) {
+    std::string tx = fuzzBytes(1 + nextRandom(6));
+    std::string rx = fuzzBytes(1 + nextRandom(40));
+
+    HostSession whole;
+    sessionBegin(whole);
+    atParserNoteTx(whole.parser, (const uint8_t*)tx.data(), tx.size());
+    atCommandStart(whole.cmd, nextRandom(2) ? "+NETOPEN:" : NULL);
+    whole.cmdActive = true;
+    atParserFeed(whole.parser, (const uint8_t*)rx.data(), rx.size(), sessionSink, &whole);
+
+    HostSession split;
+    sessionBegin(split);
+    atParserNoteTx(split.parser, (const uint8_t*)tx.data(), tx.size());
+    atCommandStart(split.cmd, whole.cmd.finalPrefix);
+    split.cmdActive = true;
+    modemReply(split, rx, 1 + nextRandom(16));
+
+    TEST_ASSERT_EQUAL_size_t(whole.lines.size(), split.lines.size());
+    for (size_t i = 0; i < whole.lines.size(); i++) {
+      TEST_ASSERT_TRUE(whole.lines[i].text == split.lines[i].text);
+      TEST_ASSERT_EQUAL(whole.lines[i].kind, split.lines[i].kind);
+      TEST_ASSERT_TRUE(whole.lines[i].urc < AT_URC_COUNT);
+    }
+    TEST_ASSERT_EQUAL(whole.cmd.status, split.cmd.status);
+    TEST_ASSERT_TRUE(whole.cmd.responseLen < AT_RESPONSE_MAX);
+    TEST_ASSERT_EQUAL_size_t(whole.cmd.responseLen, strlen(whole.cmd.response));
+    TEST_ASSERT_TRUE(strlen(whole.parser.cmdPrefix) < AT_CMD_PREFIX_MAX);
+  }
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_cpin_reply_is_response_not_urc);
+  RUN_TEST(test_netopen_waits_for_final_result_with_urc_in_between);
+  RUN_TEST(test_netclose_error_and_unsolicited_netclose);
+  RUN_TEST(test_cme_error_code);
+  RUN_TEST(test_socket_payload_is_not_parsed_as_lines);
+  RUN_TEST(test_tx_payload_does_not_change_command_prefix);
+  RUN_TEST(test_halt_stops_at_connect);
+  RUN_TEST(test_long_line_is_truncated_without_overflow);
+  RUN_TEST(test_fuzz_random_streams);
+  return UNITY_END();
+}
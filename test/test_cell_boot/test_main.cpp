@@ -0,0 +1,222 @@
+/**
+ * @file test_main.cpp
+ * @brief Test tham số bring-up modem lưu NVS (cell_boot) trên NVS giả: mặc định khi chưa có, đọc lại sau khi
+ * khởi động lại, bỏ bản ghi khác phiên bản/kích thước, và không ghi flash khi tham số không đổi. Thương
+ * lượng baud chạy với link giả: nấc nào có trong `linkOk` thì AT+IPR + kiểm tra link thành công.
+ */
+
+#include <unity.h>
+#include <Preferences.h>
+#include <set>
+#include <vector>
+#include "cell_boot.h"
+
+static CellBootCache learned() {
+  CellBootCache c;
+  cellBootCacheLoad(c);
+  c.rxPin = 26;  // Chân đảo so với config.h, tìm được khi dò chân
+  c.txPin = 27;
+  c.baud = 921600;
+  c.baudCeiling = 921600;
+  strcpy(c.plmn, "45204");
+  strcpy(c.apn, CELL_APN);
+  return c;
+}
+
+static void putRaw(const void* data, size_t len) {
+  Preferences prefs;
+  prefs.begin(CELL_NVS_NAMESPACE, false);
+  prefs.putBytes("boot", data, len);
+  prefs.end();
+}
+
+static void assertDefaults(const CellBootCache& c) {
+  TEST_ASSERT_EQUAL_UINT8(CELL_BOOT_CACHE_VERSION, c.version);
+  TEST_ASSERT_EQUAL_INT8(CELL_RX_PIN, c.rxPin);
+  TEST_ASSERT_EQUAL_INT8(CELL_TX_PIN, c.txPin);
+  TEST_ASSERT_EQUAL_UINT32(CELL_BAUD, c.baud);
+  TEST_ASSERT_EQUAL_UINT32(CELL_BAUD_MAX, c.baudCeiling);
+  TEST_ASSERT_EQUAL_STRING("", c.plmn);
+  TEST_ASSERT_EQUAL_STRING("", c.apn);
+}
+
+// ---- Link UART giả cho thương lượng baud ----
+
+static std::set<uint32_t> linkOk;
+static std::vector<uint32_t> attempts;
+
+static bool fakeSwitch(CellBootCache& cache, uint32_t baud) {
+  attempts.push_back(baud);
+  if (linkOk.count(baud) == 0) return false;  // Lỗi nhận ở nấc này, modem quay về cache.baud
+  cache.baud = baud;
+  return true;
+}
+
+static CellBootCache freshModem() {
+  CellBootCache c;
+  cellBootCacheLoad(c);
+  c.baud = CELL_BAUD;  // Modem vừa bật nguồn
+  return c;
+}
+
+static void assertAttempts(const std::vector<uint32_t>& expected) {
+  TEST_ASSERT_EQUAL_UINT32(expected.size(), attempts.size());
+  for (size_t i = 0; i < expected.size(); i++) TEST_ASSERT_EQUAL_UINT32(expected[i], attempts[i]);
+}
+
+void setUp(void) {
+  hostNvsClear();
+  linkOk = std::set<uint32_t>(CELL_BAUD_STEPS, CELL_BAUD_STEPS + CELL_BAUD_STEP_COUNT);
+  attempts.clear();
+}
+
+void tearDown(void) {}
+
+void test_empty_nvs_gives_config_defaults() {
+  CellBootCache c;
+  cellBootCacheLoad(c);
+  assertDefaults(c);
+}
+
+void test_saved_parameters_survive_reboot() {
+  CellBootCache current;
+  cellBootCacheLoad(current);
+  CellBootCache next = learned();
+  TEST_ASSERT_TRUE(cellBootCacheSave(current, next));
+  TEST_ASSERT_EQUAL_MEMORY(&next, &current, sizeof(next));
+
+  CellBootCache reloaded;
+  cellBootCacheLoad(reloaded);  // Lần khởi động sau
+  TEST_ASSERT_EQUAL_MEMORY(&next, &reloaded, sizeof(next));
+}
+
+void test_unchanged_parameters_are_not_rewritten() {
+  CellBootCache current;
+  cellBootCacheLoad(current);
+  TEST_ASSERT_TRUE(cellBootCacheSave(current, learned()));
+
+  // Mỗi lần reconnect bring-up lưu lại tham số: không đổi thì không ghi flash
+  uint32_t writes = hostNvsWrites();
+  for (int i = 0; i < 10; i++) TEST_ASSERT_FALSE(cellBootCacheSave(current, learned()));
+  TEST_ASSERT_EQUAL_UINT32(writes, hostNvsWrites());
+
+  CellBootCache next = learned();
+  next.baudCeiling = 460800;  // Monitor hạ trần
+  TEST_ASSERT_TRUE(cellBootCacheSave(current, next));
+  TEST_ASSERT_EQUAL_UINT32(writes + 1, hostNvsWrites());
+}
+
+void test_other_version_is_ignored() {
+  CellBootCache old = learned();
+  old.version = CELL_BOOT_CACHE_VERSION - 1;
+  putRaw(&old, sizeof(old));
+  CellBootCache c;
+  cellBootCacheLoad(c);
+  assertDefaults(c);
+}
+
+void test_other_size_is_ignored() {
+  CellBootCache old = learned();
+  putRaw(&old, offsetof(CellBootCache, apn));  // Bản ghi của firmware cũ chưa có APN
+  CellBootCache c;
+  cellBootCacheLoad(c);
+  assertDefaults(c);
+}
+
+void test_zero_baud_is_ignored() {
+  CellBootCache bad = learned();
+  bad.baud = 0;
+  putRaw(&bad, sizeof(bad));
+  CellBootCache c;
+  cellBootCacheLoad(c);
+  assertDefaults(c);
+}
+
+void test_negotiate_goes_straight_to_ceiling() {
+  CellBootCache c = freshModem();
+  cellBaudNegotiate(c, fakeSwitch);
+  assertAttempts({ CELL_BAUD_MAX });
+  TEST_ASSERT_EQUAL_UINT32(CELL_BAUD_MAX, c.baud);
+  TEST_ASSERT_EQUAL_UINT32(CELL_BAUD_MAX, c.baudCeiling);
+}
+
+void test_failed_step_lowers_ceiling_and_falls_back() {
+  linkOk.erase(921600);  // Dây dài: 921600 mất byte
+  CellBootCache c = freshModem();
+  cellBaudNegotiate(c, fakeSwitch);
+  assertAttempts({ 921600, 460800 });
+  TEST_ASSERT_EQUAL_UINT32(460800, c.baud);
+  TEST_ASSERT_EQUAL_UINT32(460800, c.baudCeiling);
+
+  // Trần đã hạ được lưu: lần bật modem sau không thử lại 921600
+  CellBootCache current;
+  cellBootCacheLoad(current);
+  cellBootCacheSave(current, c);
+  attempts.clear();
+  CellBootCache next = freshModem();
+  TEST_ASSERT_EQUAL_UINT32(460800, next.baudCeiling);
+  cellBaudNegotiate(next, fakeSwitch);
+  assertAttempts({ 460800 });
+  TEST_ASSERT_EQUAL_UINT32(460800, next.baud);
+}
+
+void test_all_high_steps_fail_stays_at_default() {
+  linkOk.clear();
+  CellBootCache c = freshModem();
+  cellBaudNegotiate(c, fakeSwitch);
+  assertAttempts({ 921600, 460800, 230400 });  // Không gửi AT+IPR cho nấc modem đang chạy
+  TEST_ASSERT_EQUAL_UINT32(CELL_BAUD, c.baud);
+  TEST_ASSERT_EQUAL_UINT32(CELL_BAUD, c.baudCeiling);
+}
+
+void test_modem_already_at_step_sends_nothing() {
+  CellBootCache c = freshModem();
+  c.baud = CELL_BAUD_MAX;  // ESP32 reset, modem vẫn chạy ở baud đã đổi
+  cellBaudNegotiate(c, fakeSwitch);
+  assertAttempts({});
+  TEST_ASSERT_EQUAL_UINT32(CELL_BAUD_MAX, c.baud);
+}
+
+void test_monitor_downgrade_applies_on_next_bring_up() {
+  // Monitor thấy lỗi nhận ở 921600: cellularBeginLocked đặt trần cellBaudStepBelow(921600)
+  CellBootCache c = freshModem();
+  c.baud = 921600;
+  c.baudCeiling = cellBaudStepBelow(c.baud);
+  cellBaudNegotiate(c, fakeSwitch);
+  assertAttempts({ 460800 });
+  TEST_ASSERT_EQUAL_UINT32(460800, c.baud);
+  TEST_ASSERT_EQUAL_UINT32(460800, c.baudCeiling);
+}
+
+void test_step_below() {
+  TEST_ASSERT_EQUAL_UINT32(460800, cellBaudStepBelow(921600));
+  TEST_ASSERT_EQUAL_UINT32(230400, cellBaudStepBelow(460800));
+  TEST_ASSERT_EQUAL_UINT32(115200, cellBaudStepBelow(230400));
+  TEST_ASSERT_EQUAL_UINT32(CELL_BAUD, cellBaudStepBelow(115200));
+}
+
+void test_ceiling_out_of_range_is_clamped() {
+  CellBootCache c = freshModem();
+  c.baudCeiling = 9600;  // Dưới CELL_BAUD: vẫn giữ CELL_BAUD
+  cellBaudNegotiate(c, fakeSwitch);
+  assertAttempts({});
+  TEST_ASSERT_EQUAL_UINT32(CELL_BAUD, c.baud);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_empty_nvs_gives_config_defaults);
+  RUN_TEST(test_saved_parameters_survive_reboot);
+  RUN_TEST(test_unchanged_parameters_are_not_rewritten);
+  RUN_TEST(test_other_version_is_ignored);
+  RUN_TEST(test_other_size_is_ignored);
+  RUN_TEST(test_zero_baud_is_ignored);
+  RUN_TEST(test_negotiate_goes_straight_to_ceiling);
+  RUN_TEST(test_failed_step_lowers_ceiling_and_falls_back);
+  RUN_TEST(test_all_high_steps_fail_stays_at_default);
+  RUN_TEST(test_modem_already_at_step_sends_nothing);
+  RUN_TEST(test_monitor_downgrade_applies_on_next_bring_up);
+  RUN_TEST(test_step_below);
+  RUN_TEST(test_ceiling_out_of_range_is_clamped);
+  return UNITY_END();
+}
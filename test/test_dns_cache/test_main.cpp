@@ -0,0 +1,231 @@
+/**
+ * @file test_main.cpp
+ * @brief Test cache DNS của socket 4G với AT+CDNSGIP giả: trúng/trượt theo TTL, làm mới nền giữ đường gửi
+ * trên cache, chuyển địa chỉ khi kết nối lỗi, thay bản ghi lâu không dùng, và thời gian tới byte đầu
+ * (mô phỏng) khi bật/tắt cache.
+ *
+ * Modem giả chạy theo đồng hồ giả của stub: AT+CDNSGIP hoặc AT+CIPOPEN bằng tên miền tốn DNS_MS
+ * (modem hỏi DNS của nhà mạng), mở TCP tốn một RTT, request tới byte đầu thêm một RTT.
+ */
+
+#include <unity.h>
+#include <map>
+#include <string>
+#include "dns_cache.h"
+
+static const uint32_t RTT_MS = 120;  // LTE tới backend
+static const uint32_t DNS_MS = 450;  // Một lượt phân giải qua DNS nhà mạng
+static const char* BACKEND = "api.battery.example";
+
+// ---- Modem giả ----
+
+static std::map<std::string, std::string> replies;  // host → dòng +CDNSGIP:, không có thì trả một IP
+static std::map<std::string, bool> deadAddrs;       // IP mà CIPOPEN lỗi
+static uint32_t queries = 0;
+static std::map<std::string, uint32_t> queriesByHost;
+static bool queryFails = false;
+
+static bool fakeQuery(const char* host, char* line, size_t lineSize) {
+  queries++;
+  queriesByHost[host]++;
+  hostAdvanceMs(DNS_MS);
+  if (queryFails) return false;
+  std::string reply = replies.count(host) ? replies[host] : "+CDNSGIP: 1,\"" + std::string(host) + "\",\"10.0.0.1\"";
+  snprintf(line, lineSize, "%s", reply.c_str());
+  return true;
+}
+
+static bool cipopen(const char* hostOrIp, bool byName) {
+  if (byName) hostAdvanceMs(DNS_MS);
+  hostAdvanceMs(RTT_MS);  // SYN/SYN-ACK
+  return deadAddrs.count(hostOrIp) == 0;
+}
+
+/**
+ * @brief Như CellularSocket::connect(): IP trong cache trước, lỗi thì báo cache rồi mở bằng tên miền.
+ */
+static bool connectLikeFirmware(const char* host) {
+  char ip[16];
+  if (dnsCacheLookup(host, ip, sizeof(ip))) {
+    if (cipopen(ip, false)) return true;
+    dnsCacheReportFailure(host, ip);
+  }
+  return cipopen(host, true);
+}
+
+static uint32_t lookupCount(const char* host, char* ip) {
+  uint32_t before = queries;
+  TEST_ASSERT_TRUE(dnsCacheLookup(host, ip, 16));
+  return queries - before;
+}
+
+void setUp(void) {
+  dnsCacheBegin(fakeQuery);
+  dnsCacheSetEnabled(true);
+  replies.clear();
+  deadAddrs.clear();
+  queryFails = false;
+  hostAdvanceMs(DNS_CACHE_TTL_MS);  // Bản ghi của test trước hết hạn
+}
+
+void tearDown(void) {}
+
+void test_miss_then_hits_until_ttl() {
+  char ip[16];
+  DnsCacheStats before = dnsCacheGetStats();
+  TEST_ASSERT_EQUAL_UINT32(1, lookupCount(BACKEND, ip));
+  TEST_ASSERT_EQUAL_STRING("10.0.0.1", ip);
+  for (int i = 0; i < 5; i++) {
+    hostAdvanceMs(60000);
+    TEST_ASSERT_EQUAL_UINT32(0, lookupCount(BACKEND, ip));
+  }
+  DnsCacheStats after = dnsCacheGetStats();
+  TEST_ASSERT_EQUAL_UINT32(before.misses + 1, after.misses);
+  TEST_ASSERT_EQUAL_UINT32(before.hits + 5, after.hits);
+
+  hostAdvanceMs(DNS_CACHE_TTL_MS);
+  TEST_ASSERT_EQUAL_UINT32(1, lookupCount(BACKEND, ip));  // Hết TTL: phân giải lại
+}
+
+void test_refresh_keeps_send_path_on_cache() {
+  char ip[16];
+  TEST_ASSERT_EQUAL_UINT32(1, lookupCount(BACKEND, ip));
+  uint32_t before = queries;
+  hostAdvanceMs(DNS_CACHE_REFRESH_MS - 1000);
+  dnsCacheRefresh();
+  TEST_ASSERT_EQUAL_UINT32(before, queries);  // Chưa tới hạn làm mới
+
+  uint32_t refreshes = dnsCacheGetStats().refreshes;
+  hostAdvanceMs(1000);
+  replies[BACKEND] = "+CDNSGIP: 1,\"api.battery.example\",\"10.0.0.9\"";
+  dnsCacheRefresh();
+  TEST_ASSERT_EQUAL_UINT32(before + 1, queries);
+  TEST_ASSERT_EQUAL_UINT32(refreshes + 1, dnsCacheGetStats().refreshes);
+
+  // Quá TTL của lần phân giải đầu nhưng bản làm mới còn hạn: đường gửi không phải chờ DNS
+  hostAdvanceMs(DNS_CACHE_TTL_MS - DNS_CACHE_REFRESH_MS + 1000);
+  TEST_ASSERT_EQUAL_UINT32(0, lookupCount(BACKEND, ip));
+  TEST_ASSERT_EQUAL_STRING("10.0.0.9", ip);
+}
+
+void test_failed_refresh_keeps_old_entry() {
+  char ip[16];
+  TEST_ASSERT_EQUAL_UINT32(1, lookupCount(BACKEND, ip));
+  hostAdvanceMs(DNS_CACHE_REFRESH_MS);
+  queryFails = true;
+  uint32_t failures = dnsCacheGetStats().resolveFailures;
+  dnsCacheRefresh();
+  TEST_ASSERT_EQUAL_UINT32(failures + 1, dnsCacheGetStats().resolveFailures);
+  TEST_ASSERT_EQUAL_UINT32(0, lookupCount(BACKEND, ip));
+  TEST_ASSERT_EQUAL_STRING("10.0.0.1", ip);
+}
+
+void test_connect_failure_moves_to_next_address() {
+  replies[BACKEND] = "+CDNSGIP: 1,\"api.battery.example\",\"10.0.0.1\",\"10.0.0.2\"";
+  deadAddrs["10.0.0.1"] = true;
+  DnsCacheStats before = dnsCacheGetStats();
+
+  TEST_ASSERT_TRUE(connectLikeFirmware(BACKEND));  // 10.0.0.1 lỗi, mở lại bằng tên miền
+  TEST_ASSERT_EQUAL_UINT32(before.connectFailures + 1, dnsCacheGetStats().connectFailures);
+  char ip[16];
+  TEST_ASSERT_EQUAL_UINT32(0, lookupCount(BACKEND, ip));
+  TEST_ASSERT_EQUAL_STRING("10.0.0.2", ip);
+
+  // Hết địa chỉ: bỏ bản ghi, lần sau phân giải lại
+  dnsCacheReportFailure(BACKEND, "10.0.0.2");
+  TEST_ASSERT_EQUAL_UINT32(1, lookupCount(BACKEND, ip));
+
+  // Báo lỗi cho địa chỉ đã không còn dùng thì không đụng tới bản ghi
+  dnsCacheReportFailure(BACKEND, "10.0.0.2");
+  TEST_ASSERT_EQUAL_UINT32(0, lookupCount(BACKEND, ip));
+  TEST_ASSERT_EQUAL_STRING("10.0.0.1", ip);
+}
+
+void test_bypass_cases_fall_back_to_modem_dns() {
+  char ip[16];
+  uint32_t before = queries;
+  TEST_ASSERT_FALSE(dnsCacheLookup("203.0.113.5", ip, sizeof(ip)));  // Đã là IP
+  dnsCacheSetEnabled(false);
+  TEST_ASSERT_FALSE(dnsCacheLookup(BACKEND, ip, sizeof(ip)));
+  TEST_ASSERT_EQUAL_UINT32(before, queries);
+
+  dnsCacheSetEnabled(true);
+  uint32_t failures = dnsCacheGetStats().resolveFailures;
+  replies[BACKEND] = "+CDNSGIP: 0,10";
+  TEST_ASSERT_FALSE(dnsCacheLookup(BACKEND, ip, sizeof(ip)));
+  replies[BACKEND] = "+CDNSGIP: 1,\"api.battery.example\"";  // Không có địa chỉ
+  TEST_ASSERT_FALSE(dnsCacheLookup(BACKEND, ip, sizeof(ip)));
+  queryFails = true;
+  TEST_ASSERT_FALSE(dnsCacheLookup(BACKEND, ip, sizeof(ip)));
+  TEST_ASSERT_EQUAL_UINT32(failures + 3, dnsCacheGetStats().resolveFailures);
+
+  dnsCacheBegin(NULL);  // Chưa gắn modem
+  queryFails = false;
+  TEST_ASSERT_FALSE(dnsCacheLookup(BACKEND, ip, sizeof(ip)));
+}
+
+void test_full_table_replaces_least_recently_used() {
+  char host[DNS_CACHE_ENTRIES + 1][24];
+  char ip[16];
+  for (int i = 0; i <= DNS_CACHE_ENTRIES; i++) snprintf(host[i], sizeof(host[i]), "h%d.example", i);
+  for (int i = 0; i < DNS_CACHE_ENTRIES; i++) {
+    TEST_ASSERT_EQUAL_UINT32(1, lookupCount(host[i], ip));
+    hostAdvanceMs(1000);
+  }
+  TEST_ASSERT_EQUAL_UINT32(0, lookupCount(host[0], ip));  // host[1] giờ là bản ghi lâu không dùng nhất
+  hostAdvanceMs(1000);
+  TEST_ASSERT_EQUAL_UINT32(1, lookupCount(host[DNS_CACHE_ENTRIES], ip));
+
+  TEST_ASSERT_EQUAL_UINT32(0, lookupCount(host[0], ip));
+  for (int i = 2; i <= DNS_CACHE_ENTRIES; i++) TEST_ASSERT_EQUAL_UINT32(0, lookupCount(host[i], ip));
+  TEST_ASSERT_EQUAL_UINT32(1, lookupCount(host[1], ip));
+}
+
+/**
+ * @brief Trung bình thời gian tới byte đầu của `n` lần upload định kỳ, mỗi lần một socket mới; task theo dõi
+ * modem gọi dnsCacheRefresh() giữa các lần như trên thiết bị.
+ */
+static uint32_t averageTtfbMs(const char* host, int n, uint32_t periodMs) {
+  uint64_t sum = 0;
+  for (int i = 0; i < n; i++) {
+    dnsCacheRefresh();
+    uint32_t t0 = millis();
+    TEST_ASSERT_TRUE(connectLikeFirmware(host));
+    hostAdvanceMs(RTT_MS);  // Request → byte đầu của response
+    sum += millis() - t0;
+    hostAdvanceMs(periodMs);
+  }
+  return (uint32_t)(sum / n);
+}
+
+void test_ttfb_with_and_without_cache() {
+  const char* host = "ingest.battery.example";  // Chưa có trong cache
+  const int uploads = 60;
+  const uint32_t period = 60000;
+  dnsCacheSetEnabled(false);
+  uint32_t without = averageTtfbMs(host, uploads, period);
+  dnsCacheSetEnabled(true);
+  uint32_t with = averageTtfbMs(host, uploads, period);
+
+  // Tắt cache: modem phân giải ở mọi lần CIPOPEN
+  TEST_ASSERT_EQUAL_UINT32(DNS_MS + 2 * RTT_MS, without);
+  // Bật cache: chỉ lần đầu chờ DNS (AT+CDNSGIP rồi mở bằng IP), các lần làm mới chạy ngoài đường gửi
+  TEST_ASSERT_EQUAL_UINT32(2 * RTT_MS + DNS_MS / uploads, with);
+  TEST_ASSERT_EQUAL_UINT32(1 + (uploads - 1) * period / DNS_CACHE_REFRESH_MS, queriesByHost[host]);
+  char line[80];
+  snprintf(line, sizeof(line), "TTFB trung bình: không cache %lu ms, có cache %lu ms", (unsigned long)without,
+           (unsigned long)with);
+  TEST_MESSAGE(line);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_miss_then_hits_until_ttl);
+  RUN_TEST(test_refresh_keeps_send_path_on_cache);
+  RUN_TEST(test_failed_refresh_keeps_old_entry);
+  RUN_TEST(test_connect_failure_moves_to_next_address);
+  RUN_TEST(test_bypass_cases_fall_back_to_modem_dns);
+  RUN_TEST(test_full_table_replaces_least_recently_used);
+  RUN_TEST(test_ttfb_with_and_without_cache);
+  return UNITY_END();
+}
@@ -0,0 +1,261 @@
+/**
+ * @file test_main.cpp
+ * @brief Test src/filters.h trên host: sorting network so với std::sort cho từng N, các stage lọc,
+ * FilterChain, và benchmark so với medianFilter()/movingAverage() cũ (bubble sort + cộng cả cửa sổ).
+ */
+
+#include <unity.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <chrono>
+#include "filters.h"
+#include "config.h"
+
+static uint32_t rngState = 1;
+
+static int32_t nextRandom(int32_t lo, int32_t hi) {
+  rngState = rngState * 1664525u + 1013904223u;
+  return lo + (int32_t)((rngState >> 8) % (uint32_t)(hi - lo + 1));
+}
+
+void setUp(void) { rngState = 12345; }
+void tearDown(void) {}
+
+// ---- SortingNetwork ----
+
+template <size_t N>
+static void checkNetwork() {
+  int32_t a[N];
+  int32_t expected[N];
+  for (int round = 0; round < 300; round++) {
+    // Vòng chẵn: dải hẹp để có nhiều giá trị trùng; vòng lẻ: cả dải int32
+    for (size_t i = 0; i < N; i++) {
+      a[i] = (round & 1) ? (int32_t)(nextRandom(-32768, 32767) * 65536 + nextRandom(0, 65535)) : nextRandom(0, 3);
+      expected[i] = a[i];
+    }
+    std::sort(expected, expected + N);
+    SortingNetwork<N>::sort(a);
+    for (size_t i = 0; i < N; i++) {
+      if (a[i] != expected[i]) {
+        char msg[80];
+        snprintf(msg, sizeof msg, "N=%u round=%d khác std::sort tại %u", (unsigned)N, round, (unsigned)i);
+        TEST_FAIL_MESSAGE(msg);
+      }
+    }
+  }
+}
+
+template <size_t N>
+struct CheckNetworksUpTo {
+  static void run() {
+    CheckNetworksUpTo<N - 1>::run();
+    checkNetwork<N>();
+  }
+};
+
+template <>
+struct CheckNetworksUpTo<0> {
+  static void run() {}
+};
+
+static void test_sorting_network_matches_std_sort_for_each_n(void) {
+  CheckNetworksUpTo<33>::run();
+  checkNetwork<64>();
+}
+
+static void test_median_of_leaves_input_untouched(void) {
+  int32_t values[5] = {9, 1, 7, 3, 5};
+  TEST_ASSERT_EQUAL_INT32(5, medianOf<5>(values));
+  TEST_ASSERT_EQUAL_INT32(9, values[0]);
+  TEST_ASSERT_EQUAL_INT32(5, values[4]);
+}
+
+// ---- Các stage ----
+
+static void test_moving_average_primes_and_tracks_window(void) {
+  MovingAverageFilter<4> f;
+  TEST_ASSERT_EQUAL_INT32(100, f.push(100));  // Mồi cả cửa sổ, không kéo về 0
+  TEST_ASSERT_EQUAL_INT32(125, f.push(200));
+  TEST_ASSERT_EQUAL_INT32(150, f.push(200));
+  TEST_ASSERT_EQUAL_INT32(175, f.push(200));
+  TEST_ASSERT_EQUAL_INT32(200, f.push(200));
+
+  // Tổng chạy phải khớp cộng lại cả cửa sổ sau nhiều mẫu
+  MovingAverageFilter<10> g;
+  int32_t window[10];
+  for (int i = 0; i < 1000; i++) {
+    int32_t x = nextRandom(0, 4095);
+    int32_t out = g.push(x);
+    if (i == 0) {
+      for (int k = 0; k < 10; k++) window[k] = x;
+    }
+    window[i % 10] = x;
+    int64_t sum = 0;
+    for (int k = 0; k < 10; k++) sum += window[k];
+    TEST_ASSERT_EQUAL_INT32((int32_t)(sum / 10), out);
+  }
+
+  g.reset();
+  TEST_ASSERT_EQUAL_INT32(7, g.push(7));
+}
+
+static void test_ema_primes_and_converges(void) {
+  EmaFilter<3> f;
+  TEST_ASSERT_EQUAL_INT32(1000, f.push(1000));
+  TEST_ASSERT_EQUAL_INT32(1000, f.push(1000));
+
+  // Bước 1000 → 2000: sau một mẫu đi được ~1/8, sau đủ lâu về đúng 2000 (không lệch do làm tròn)
+  int32_t first = f.push(2000);
+  TEST_ASSERT_TRUE(first > 1100 && first < 1150);
+  int32_t out = first;
+  for (int i = 0; i < 200; i++) out = f.push(2000);
+  TEST_ASSERT_EQUAL_INT32(2000, out);
+
+  for (int i = 0; i < 200; i++) out = f.push(-500);
+  TEST_ASSERT_EQUAL_INT32(-500, out);
+
+  f.reset();
+  TEST_ASSERT_EQUAL_INT32(42, f.push(42));
+}
+
+static void test_hampel_replaces_spikes_only(void) {
+  HampelFilter<5> f;
+  const int32_t clean[] = {1000, 1004, 998, 1002, 1001, 999, 1003};
+  for (size_t i = 0; i < sizeof(clean) / sizeof(clean[0]); i++) {
+    TEST_ASSERT_EQUAL_INT32(clean[i], f.push(clean[i]));  // Mẫu bình thường đi qua nguyên vẹn
+  }
+  int32_t spiked = f.push(3500);
+  TEST_ASSERT_TRUE(spiked >= 998 && spiked <= 1004);
+  TEST_ASSERT_EQUAL_INT32(1000, f.push(1000));
+
+  // Tín hiệu phẳng (MAD = 0): dao động trong MinDev không bị coi là outlier
+  HampelFilter<5, 30, 8> flat;
+  for (int i = 0; i < 5; i++) flat.push(500);
+  TEST_ASSERT_EQUAL_INT32(506, flat.push(506));
+  TEST_ASSERT_EQUAL_INT32(500, flat.push(520));
+
+  // Bước thật (không phải xung) được giữ lại sau nửa cửa sổ
+  HampelFilter<5> step;
+  for (int i = 0; i < 5; i++) step.push(100);
+  int32_t out = 0;
+  for (int i = 0; i < 3; i++) out = step.push(900);
+  TEST_ASSERT_EQUAL_INT32(900, out);
+}
+
+static void test_filter_chain_composes_in_order(void) {
+  FilterChain<HampelFilter<5>, MovingAverageFilter<4>> chain;
+  HampelFilter<5> h;
+  MovingAverageFilter<4> m;
+  for (int i = 0; i < 500; i++) {
+    int32_t x = nextRandom(0, 100) == 0 ? 4095 : nextRandom(900, 1100);
+    TEST_ASSERT_EQUAL_INT32(m.push(h.push(x)), chain.push(x));
+  }
+
+  chain.reset();
+  TEST_ASSERT_EQUAL_INT32(333, chain.push(333));
+
+  FilterChain<> empty;
+  TEST_ASSERT_EQUAL_INT32(-7, empty.push(-7));
+}
+
+// ---- Benchmark so với bản cũ (trước FilterChain) ----
+
+static int oldSmokeHistory[MOVING_AVERAGE_SIZE];
+static int oldSmokeHistoryIndex = 0;
+
+static int oldMedianFilter(int values[], int size) {
+  for (int i = 0; i < size - 1; i++) {
+    for (int j = i + 1; j < size; j++) {
+      if (values[i] > values[j]) {
+        int temp = values[i];
+        values[i] = values[j];
+        values[j] = temp;
+      }
+    }
+  }
+  return values[size / 2];
+}
+
+static int oldMovingAverage(int newValue) {
+  oldSmokeHistory[oldSmokeHistoryIndex] = newValue;
+  oldSmokeHistoryIndex = (oldSmokeHistoryIndex + 1) % MOVING_AVERAGE_SIZE;
+  long sum = 0;
+  for (int i = 0; i < MOVING_AVERAGE_SIZE; i++) sum += oldSmokeHistory[i];
+  return (int)(sum / MOVING_AVERAGE_SIZE);
+}
+
+template <typename TimePoint>
+static double nsPerBlock(TimePoint from, TimePoint to, int blocks) {
+  return std::chrono::duration<double, std::nano>(to - from).count() / blocks;
+}
+
+static void test_benchmark_against_old_filters(void) {
+  const int blocks = 20000;
+  static int32_t stream[20000][ADC_SAMPLES];
+  for (int b = 0; b < blocks; b++) {
+    for (int i = 0; i < ADC_SAMPLES; i++) {
+      stream[b][i] = nextRandom(0, 50) == 0 ? 4095 : 1800 + nextRandom(-60, 60);
+    }
+  }
+
+  // Kết quả phải khớp bản cũ: median từng block, và trung bình trượt khi cửa sổ cũ đã đầy
+  MovingAverageFilter<MOVING_AVERAGE_SIZE> avg;
+  volatile int32_t sink = 0;
+  for (int b = 0; b < blocks; b++) {
+    int oldBlock[ADC_SAMPLES];
+    for (int i = 0; i < ADC_SAMPLES; i++) oldBlock[i] = stream[b][i];
+    int oldMed = oldMedianFilter(oldBlock, ADC_SAMPLES);
+    int32_t newMed = medianOf<ADC_SAMPLES>(stream[b]);
+    TEST_ASSERT_EQUAL_INT32(oldMed, newMed);
+    int oldAvg = oldMovingAverage(oldMed);
+    int32_t newAvg = avg.push(newMed);
+    if (b >= MOVING_AVERAGE_SIZE - 1) TEST_ASSERT_EQUAL_INT32(oldAvg, newAvg);
+  }
+
+  typedef std::chrono::steady_clock Clock;
+  // Median block riêng (bubble sort vs sorting network)
+  Clock::time_point t0 = Clock::now();
+  for (int b = 0; b < blocks; b++) {
+    int oldBlock[ADC_SAMPLES];
+    for (int i = 0; i < ADC_SAMPLES; i++) oldBlock[i] = stream[b][i];
+    sink = sink + oldMedianFilter(oldBlock, ADC_SAMPLES);
+  }
+  Clock::time_point t1 = Clock::now();
+  for (int b = 0; b < blocks; b++) {
+    sink = sink + medianOf<ADC_SAMPLES>(stream[b]);
+  }
+  Clock::time_point t2 = Clock::now();
+  // Cả đường kênh khói: cũ median + trung bình, mới median + Hampel + trung bình
+  for (int b = 0; b < blocks; b++) {
+    int oldBlock[ADC_SAMPLES];
+    for (int i = 0; i < ADC_SAMPLES; i++) oldBlock[i] = stream[b][i];
+    sink = sink + oldMovingAverage(oldMedianFilter(oldBlock, ADC_SAMPLES));
+  }
+  Clock::time_point t3 = Clock::now();
+  FilterChain<HampelFilter<MEDIAN_FILTER_SIZE>, MovingAverageFilter<MOVING_AVERAGE_SIZE>> smoke;
+  for (int b = 0; b < blocks; b++) {
+    sink = sink + smoke.push(medianOf<ADC_SAMPLES>(stream[b]));
+  }
+  Clock::time_point t4 = Clock::now();
+
+  char msg[200];
+  snprintf(msg, sizeof msg, "[BENCH] median %d mẫu: bubble %.0f ns, network %.0f ns",
+           ADC_SAMPLES, nsPerBlock(t0, t1, blocks), nsPerBlock(t1, t2, blocks));
+  TEST_MESSAGE(msg);
+  snprintf(msg, sizeof msg, "[BENCH] kênh khói: cũ (median + avg) %.0f ns, mới (median + Hampel + avg) %.0f ns",
+           nsPerBlock(t2, t3, blocks), nsPerBlock(t3, t4, blocks));
+  TEST_MESSAGE(msg);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_sorting_network_matches_std_sort_for_each_n);
+  RUN_TEST(test_median_of_leaves_input_untouched);
+  RUN_TEST(test_moving_average_primes_and_tracks_window);
+  RUN_TEST(test_ema_primes_and_converges);
+  RUN_TEST(test_hampel_replaces_spikes_only);
+  RUN_TEST(test_filter_chain_composes_in_order);
+  RUN_TEST(test_benchmark_against_old_filters);
+  return UNITY_END();
+}
@@ -0,0 +1,590 @@
+/**
+ * @file test_main.cpp
+ * @brief Test modem_http với modem SIM7600 giả lập theo kịch bản +CHTTPS* và một server HTTP/1.1 đứng sau
+ * nó: giữ phiên qua nhiều request, body Content-Length/chunked/tới khi đóng dài hơn một lượt RECV,
+ * server đóng phiên, phiên giữ sẵn đã chết, dịch vụ còn chạy từ trước, sink hủy và hết giờ.
+ *
+ * Modem giả chạy theo đồng hồ giả của stub: mỗi phản hồi tới sau độ trễ xử lý cộng thời gian truyền UART
+ * 115200 baud, response của server tới sau một RTT, nên ttfbMs đo được là thời gian mô phỏng.
+ */
+
+#include <unity.h>
+#include <string>
+#include <vector>
+#include "modem_http.h"
+
+static uint32_t rngState = 1;
+
+static uint32_t nextRandom(uint32_t n) {
+  rngState = rngState * 1664525u + 1013904223u;
+  return (rngState >> 8) % n;
+}
+
+// ---- Modem + server giả lập ----
+
+static const uint32_t UART_US_PER_BYTE = 87;   // 115200 baud, 8N1
+static const uint32_t CMD_LATENCY_MS = 5;      // Modem xử lý một lệnh AT
+static const uint32_t RTT_MS = 120;            // LTE tới backend
+static const uint32_t TLS_HANDSHAKE_MS = 3 * RTT_MS + 200;  // TCP + TLS 1.2 + xử lý trên modem
+
+struct TimedBytes {
+  uint64_t readyUs;
+  std::string bytes;
+};
+
+/**
+ * @brief Response server trả cho một request; `closeAfter` = server đóng phiên sau khi gửi xong.
+ */
+struct ServerReply {
+  std::string bytes;
+  bool closeAfter;
+  bool silent;        // Không trả gì (request treo)
+};
+
+typedef ServerReply (*ServerHandler)(const std::string& request);
+
+class HostModem : public Stream {
+ public:
+  ServerHandler handler;
+  bool serviceRunning;      // CHTTPSSTART đã chạy (kể cả từ trước khi ESP32 khởi động lại)
+  bool sessionOpen;
+  bool sessionDead;         // Server đã đóng phiên mà modem không báo URC
+  uint32_t opens;
+  uint32_t starts;
+  uint32_t sends;
+  uint32_t recvs;
+  uint32_t segmentMax;      // Server gửi response thành các đoạn TCP tối đa bấy nhiêu byte
+  std::vector<std::string> commands;
+  std::vector<std::string> requests;
+
+  HostModem() { reset(); }
+
+  void reset() {
+    handler = NULL;
+    serviceRunning = false;
+    sessionOpen = false;
+    sessionDead = false;
+    opens = starts = sends = recvs = 0;
+    segmentMax = 1460;
+    commands.clear();
+    requests.clear();
+    rx_.clear();
+    rxPending_.clear();
+    serverOut_.clear();
+    cmdLine_.clear();
+    request_.clear();
+    sendRemaining_ = 0;
+  }
+
+  size_t write(uint8_t c) override {
+    if (sendRemaining_ > 0) {
+      request_ += (char)c;
+      if (--sendRemaining_ == 0) {
+        reply("\r\nOK\r\n\r\n+CHTTPSSEND: 0\r\n", CMD_LATENCY_MS);
+        serveCompleteRequests();
+      }
+      return 1;
+    }
+    if (c == '\r') {
+      handleCommand(cmdLine_);
+      cmdLine_.clear();
+    } else if (c != '\n') {
+      cmdLine_ += (char)c;
+    }
+    return 1;
+  }
+
+  size_t write(const uint8_t* data, size_t n) override {
+    for (size_t i = 0; i < n; i++) write(data[i]);
+    return n;
+  }
+  using Print::write;
+
+  int available() override {
+    pump();
+    return (int)rx_.size();
+  }
+
+  int read() override {
+    pump();
+    if (rx_.empty()) return -1;
+    uint8_t c = (uint8_t)rx_[0];
+    rx_.erase(0, 1);
+    return c;
+  }
+
+  int peek() override {
+    pump();
+    return rx_.empty() ? -1 : (uint8_t)rx_[0];
+  }
+
+  /**
+   * @brief Server đóng phiên ngay (URC PEER CLOSED tới sau `delayMs`).
+   */
+  void peerClose(uint32_t delayMs) {
+    sessionDead = true;
+    reply("\r\n+CHTTPSNOTIFY: PEER CLOSED\r\n", delayMs);
+  }
+
+ private:
+  std::string rx_;                        // Byte đã tới UART, chờ ESP32 đọc
+  std::vector<TimedBytes> rxPending_;     // Byte modem sẽ gửi, theo thứ tự thời điểm
+  std::vector<TimedBytes> serverOut_;     // Byte server gửi, nằm trong bộ đệm modem chờ AT+CHTTPSRECV
+  std::string cmdLine_;
+  std::string request_;                   // Byte request đã qua CHTTPSSEND, chưa đủ một request
+  size_t sendRemaining_;
+
+  void pump() {
+    size_t i = 0;
+    while (i < rxPending_.size() && rxPending_[i].readyUs <= hostClockUs()) rx_ += rxPending_[i++].bytes;
+    rxPending_.erase(rxPending_.begin(), rxPending_.begin() + i);
+  }
+
+  /**
+   * @brief Xếp byte modem gửi theo thời điểm tới ESP32; URC hẹn trước (RECV EVENT, PEER CLOSED) không chặn
+   * phản hồi lệnh đến sớm hơn, cùng thời điểm thì giữ thứ tự gửi.
+   */
+  void reply(const std::string& s, uint32_t delayMs) {
+    uint64_t at = hostClockUs() + (uint64_t)delayMs * 1000 + (uint64_t)s.size() * UART_US_PER_BYTE;
+    size_t i = rxPending_.size();
+    while (i > 0 && rxPending_[i - 1].readyUs > at) i--;
+    TimedBytes t = { at, s };
+    rxPending_.insert(rxPending_.begin() + i, t);
+  }
+
+  static bool startsWith(const std::string& s, const char* p) { return s.compare(0, strlen(p), p) == 0; }
+
+  void handleCommand(const std::string& cmd) {
+    commands.push_back(cmd);
+    if (startsWith(cmd, "AT+CHTTPSCFG=")) {
+      reply("\r\nOK\r\n", CMD_LATENCY_MS);
+    } else if (cmd == "AT+CHTTPSSTART") {
+      starts++;
+      reply(serviceRunning ? "\r\nERROR\r\n" : "\r\nOK\r\n", CMD_LATENCY_MS);
+      serviceRunning = true;
+    } else if (cmd == "AT+CHTTPSSTOP") {
+      serviceRunning = false;
+      sessionOpen = false;
+      reply("\r\nOK\r\n", CMD_LATENCY_MS);
+    } else if (startsWith(cmd, "AT+CHTTPSOPSE=")) {
+      if (!serviceRunning || sessionOpen) {
+        reply("\r\nERROR\r\n", CMD_LATENCY_MS);
+        return;
+      }
+      opens++;
+      sessionOpen = true;
+      sessionDead = false;
+      serverOut_.clear();
+      request_.clear();
+      reply("\r\nOK\r\n", CMD_LATENCY_MS);
+      reply("\r\n+CHTTPSOPSE: 0\r\n", TLS_HANDSHAKE_MS);
+    } else if (startsWith(cmd, "AT+CHTTPSSEND=")) {
+      sends++;
+      if (!sessionOpen || sessionDead) {
+        reply("\r\nERROR\r\n", CMD_LATENCY_MS);
+        return;
+      }
+      sendRemaining_ = (size_t)atoi(cmd.c_str() + 14);
+      reply(">", CMD_LATENCY_MS);
+    } else if (startsWith(cmd, "AT+CHTTPSRECV=")) {
+      recvs++;
+      handleRecv((size_t)atoi(cmd.c_str() + 14));
+    } else if (cmd == "AT+CHTTPSCLSE") {
+      sessionOpen = false;
+      sessionDead = false;
+      serverOut_.clear();
+      reply("\r\nOK\r\n", CMD_LATENCY_MS);
+    } else {
+      reply("\r\nERROR\r\n", CMD_LATENCY_MS);
+    }
+  }
+
+  void handleRecv(size_t max) {
+    std::string data;
+    while (!serverOut_.empty() && serverOut_[0].readyUs <= hostClockUs() && data.size() < max) {
+      std::string& seg = serverOut_[0].bytes;
+      size_t n = std::min(seg.size(), max - data.size());
+      data += seg.substr(0, n);
+      seg.erase(0, n);
+      if (seg.empty()) serverOut_.erase(serverOut_.begin());
+    }
+    std::string out = "\r\nOK\r\n";
+    if (!data.empty()) {
+      char head[40];
+      snprintf(head, sizeof head, "\r\n+CHTTPSRECV: DATA,%u\r\n", (unsigned)data.size());
+      out += head + data + "\r\n";
+    }
+    out += "\r\n+CHTTPSRECV: 0\r\n";
+    reply(out, CMD_LATENCY_MS);
+  }
+
+  /**
+   * @brief Server nhận đủ một request (header + Content-Length) thì trả response sau một RTT, chia đoạn.
+   */
+  void serveCompleteRequests() {
+    for (;;) {
+      size_t headEnd = request_.find("\r\n\r\n");
+      if (headEnd == std::string::npos) return;
+      size_t bodyLen = 0;
+      size_t cl = request_.find("Content-Length: ");
+      if (cl != std::string::npos && cl < headEnd) bodyLen = (size_t)atoi(request_.c_str() + cl + 16);
+      size_t total = headEnd + 4 + bodyLen;
+      if (request_.size() < total) return;
+      std::string req = request_.substr(0, total);
+      request_.erase(0, total);
+      requests.push_back(req);
+
+      ServerReply r = handler(req);
+      if (r.silent) continue;
+      uint64_t at = hostClockUs() + (uint64_t)RTT_MS * 1000;
+      for (size_t off = 0; off < r.bytes.size();) {
+        size_t n = std::min((size_t)(1 + nextRandom(segmentMax)), r.bytes.size() - off);
+        TimedBytes seg = { at, r.bytes.substr(off, n) };
+        serverOut_.push_back(seg);
+        off += n;
+        at += 2000;
+      }
+      reply("\r\n+CHTTPS: RECV EVENT\r\n", RTT_MS);
+      if (r.closeAfter) {
+        sessionDead = true;
+        reply("\r\n+CHTTPSNOTIFY: PEER CLOSED\r\n", (uint32_t)((at - hostClockUs()) / 1000) + 1);
+      }
+    }
+  }
+};
+
+static HostModem modem;
+
+// ---- Response mẫu ----
+
+static std::string bodyPattern(size_t len) {
+  std::string s(len, '\0');
+  for (size_t i = 0; i < len; i++) s[i] = (char)('a' + (i * 7 + i / 13) % 26);
+  return s;
+}
+
+static std::string replyBody;       // Body server trả cho handler hiện tại
+static bool replyClose = false;
+
+static ServerReply contentLengthHandler(const std::string&) {
+  char head[160];
+  snprintf(head, sizeof head, "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\nContent-Length: %u\r\n%s\r\n",
+           (unsigned)replyBody.size(), replyClose ? "Connection: close\r\n" : "");
+  ServerReply r = { head + replyBody, replyClose, false };
+  return r;
+}
+
+static ServerReply chunkedHandler(const std::string&) {
+  std::string out = "HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n";
+  for (size_t off = 0; off < replyBody.size();) {
+    size_t n = std::min((size_t)(1 + nextRandom(700)), replyBody.size() - off);
+    char size[16];
+    snprintf(size, sizeof size, "%x\r\n", (unsigned)n);
+    out += size + replyBody.substr(off, n) + "\r\n";
+    off += n;
+  }
+  out += "0\r\nX-Trailer: 1\r\n\r\n";
+  ServerReply r = { out, false, false };
+  return r;
+}
+
+static ServerReply untilCloseHandler(const std::string&) {
+  ServerReply r = { "HTTP/1.0 200 OK\r\nContent-Type: application/octet-stream\r\n\r\n" + replyBody, true, false };
+  return r;
+}
+
+static ServerReply silentHandler(const std::string&) {
+  ServerReply r = { "", false, true };
+  return r;
+}
+
+// HEAD: server gửi Content-Length nhưng không gửi body
+static ServerReply headHandler(const std::string&) {
+  ServerReply r = { "HTTP/1.1 200 OK\r\nContent-Length: 123456\r\n\r\n", false, false };
+  return r;
+}
+
+static ServerReply garbageHandler(const std::string&) {
+  ServerReply r = { "SSH-2.0-OpenSSH\r\n\r\n", false, false };
+  return r;
+}
+
+static ServerReply noContentHandler(const std::string&) {
+  ServerReply r = { "HTTP/1.1 204 No Content\r\n\r\n", false, false };
+  return r;
+}
+
+// ---- Phía ESP32 ----
+
+static bool collectSink(const uint8_t* data, size_t len, void* ctx) {
+  ((std::string*)ctx)->append((const char*)data, len);
+  return true;
+}
+
+static bool abortSink(const uint8_t*, size_t, void*) {
+  return false;
+}
+
+static ModemHttpRequest makeRequest(const char* method, const char* path, const std::string* body) {
+  ModemHttpRequest req;
+  memset(&req, 0, sizeof(req));
+  req.method = method;
+  req.host = "backend.example.com";
+  req.port = 443;
+  req.tls = true;
+  req.path = path;
+  req.headers = "X-Device-Id: pin-01\r\n";
+  req.body = body ? (const uint8_t*)body->data() : NULL;
+  req.length = body ? body->size() : 0;
+  req.contentType = "application/json";
+  req.timeoutMs = 10000;
+  return req;
+}
+
+void setUp(void) {
+  rngState = 42;
+  modem.reset();
+  modem.handler = contentLengthHandler;
+  replyBody = "{\"ok\":true}";
+  replyClose = false;
+  modemHttpInvalidate();
+  modemHttpBegin(modem, NULL, NULL);
+}
+
+void tearDown(void) {}
+
+static void test_post_parses_status_and_body(void) {
+  std::string payload = "{\"seq\":1,\"temperature\":25.3}";
+  ModemHttpRequest req = makeRequest("POST", "/api/ingest", &payload);
+  ModemHttpResponse resp;
+  std::string got;
+  int status = modemHttpRequest(req, resp, collectSink, &got);
+
+  TEST_ASSERT_EQUAL_INT(200, status);
+  TEST_ASSERT_EQUAL_STRING(replyBody.c_str(), got.c_str());
+  TEST_ASSERT_EQUAL_INT32((int32_t)replyBody.size(), resp.contentLength);
+  TEST_ASSERT_TRUE(resp.keepAlive);
+  TEST_ASSERT_FALSE(resp.reused);
+  TEST_ASSERT_EQUAL_UINT32(1, modem.opens);
+  TEST_ASSERT_EQUAL_size_t(1, modem.requests.size());
+  const std::string& sent = modem.requests[0];
+  TEST_ASSERT_TRUE(sent.compare(0, 28, "POST /api/ingest HTTP/1.1\r\nH") == 0);
+  TEST_ASSERT_TRUE(sent.find("Host: backend.example.com\r\n") != std::string::npos);
+  TEST_ASSERT_TRUE(sent.find("X-Device-Id: pin-01\r\n") != std::string::npos);
+  TEST_ASSERT_TRUE(sent.find("Content-Length: " + std::to_string(payload.size()) + "\r\n\r\n" + payload) !=
+                   std::string::npos);
+  // Request nhỏ: header và body chung một lượt SEND
+  TEST_ASSERT_EQUAL_UINT32(1, modem.sends);
+  // Mở phiên tốn bắt tay TLS, phản hồi tới sau RTT
+  TEST_ASSERT_GREATER_OR_EQUAL(TLS_HANDSHAKE_MS + RTT_MS, resp.ttfbMs);
+}
+
+/**
+ * Phiên giữ qua nhiều request: chỉ một OPSE, request sau không trả bắt tay TLS.
+ */
+static void test_session_is_reused_across_requests(void) {
+  std::string payload = "{\"seq\":2}";
+  ModemHttpStats before = modemHttpGetStats();
+  uint32_t ttfb[5];
+  for (int i = 0; i < 5; i++) {
+    ModemHttpRequest req = makeRequest("POST", "/api/ingest", &payload);
+    ModemHttpResponse resp;
+    TEST_ASSERT_EQUAL_INT(200, modemHttpRequest(req, resp, NULL, NULL));
+    TEST_ASSERT_EQUAL(i > 0, resp.reused);
+    ttfb[i] = resp.ttfbMs;
+  }
+  ModemHttpStats after = modemHttpGetStats();
+  TEST_ASSERT_EQUAL_UINT32(1, modem.opens);
+  TEST_ASSERT_EQUAL_UINT32(1, modem.starts);
+  TEST_ASSERT_EQUAL_UINT32(4, after.sessionsReused - before.sessionsReused);
+  TEST_ASSERT_EQUAL_UINT32(1, after.sessionsOpened - before.sessionsOpened);
+  for (int i = 1; i < 5; i++) TEST_ASSERT_LESS_THAN(ttfb[0] - TLS_HANDSHAKE_MS / 2, ttfb[i]);
+
+  char msg[120];
+  snprintf(msg, sizeof msg, "[BENCH] TTFB mô phỏng: request đầu %u ms (mở phiên), request giữ phiên %u ms",
+           ttfb[0], ttfb[4]);
+  TEST_MESSAGE(msg);
+}
+
+static void test_large_content_length_body_spans_many_recv(void) {
+  replyBody = bodyPattern(20000);
+  ModemHttpRequest req = makeRequest("GET", "/firmware.bin", NULL);
+  ModemHttpResponse resp;
+  std::string got;
+  TEST_ASSERT_EQUAL_INT(200, modemHttpRequest(req, resp, collectSink, &got));
+  TEST_ASSERT_EQUAL_size_t(replyBody.size(), got.size());
+  TEST_ASSERT_TRUE(got == replyBody);
+  TEST_ASSERT_EQUAL_UINT32(20000, resp.bodyBytes);
+  TEST_ASSERT_GREATER_OR_EQUAL(20000 / MODEM_HTTP_CHUNK, modem.recvs);
+  // GET không có body: không có Content-Type/Content-Length trong request
+  TEST_ASSERT_TRUE(modem.requests[0].find("Content-Length") == std::string::npos);
+}
+
+static void test_chunked_body_with_trailer(void) {
+  modem.handler = chunkedHandler;
+  for (int round = 0; round < 3; round++) {
+    replyBody = bodyPattern(3000 + round * 4111);
+    ModemHttpRequest req = makeRequest("GET", "/api/config", NULL);
+    ModemHttpResponse resp;
+    std::string got;
+    TEST_ASSERT_EQUAL_INT(200, modemHttpRequest(req, resp, collectSink, &got));
+    TEST_ASSERT_TRUE(got == replyBody);
+    TEST_ASSERT_EQUAL_INT32(-1, resp.contentLength);
+    TEST_ASSERT_TRUE(resp.keepAlive);
+  }
+  TEST_ASSERT_EQUAL_UINT32(1, modem.opens);  // Chunked kết thúc đúng chỗ: phiên vẫn dùng lại được
+}
+
+static void test_http10_body_until_close(void) {
+  modem.handler = untilCloseHandler;
+  replyBody = bodyPattern(2500);
+  ModemHttpRequest req = makeRequest("GET", "/legacy", NULL);
+  ModemHttpResponse resp;
+  std::string got;
+  TEST_ASSERT_EQUAL_INT(200, modemHttpRequest(req, resp, collectSink, &got));
+  TEST_ASSERT_TRUE(got == replyBody);
+  TEST_ASSERT_FALSE(resp.keepAlive);
+  TEST_ASSERT_FALSE(modem.sessionOpen);  // Đã CLSE
+
+  // Request sau mở phiên mới
+  modem.handler = contentLengthHandler;
+  replyBody = "{}";
+  TEST_ASSERT_EQUAL_INT(200, modemHttpRequest(req, resp, NULL, NULL));
+  TEST_ASSERT_EQUAL_UINT32(2, modem.opens);
+}
+
+static void test_connection_close_response_closes_session(void) {
+  replyClose = true;
+  ModemHttpRequest req = makeRequest("GET", "/api/ping", NULL);
+  ModemHttpResponse resp;
+  TEST_ASSERT_EQUAL_INT(200, modemHttpRequest(req, resp, NULL, NULL));
+  TEST_ASSERT_FALSE(resp.keepAlive);
+  replyClose = false;
+  TEST_ASSERT_EQUAL_INT(200, modemHttpRequest(req, resp, NULL, NULL));
+  TEST_ASSERT_FALSE(resp.reused);
+  TEST_ASSERT_EQUAL_UINT32(2, modem.opens);
+}
+
+/**
+ * Server đóng phiên lúc rảnh mà modem không báo: SEND trên phiên giữ sẵn lỗi, request được gửi lại
+ * một lần trên phiên mới.
+ */
+static void test_stale_session_is_reopened_and_request_resent(void) {
+  ModemHttpRequest req = makeRequest("GET", "/api/ping", NULL);
+  ModemHttpResponse resp;
+  TEST_ASSERT_EQUAL_INT(200, modemHttpRequest(req, resp, NULL, NULL));
+  modem.sessionDead = true;
+
+  ModemHttpStats before = modemHttpGetStats();
+  TEST_ASSERT_EQUAL_INT(200, modemHttpRequest(req, resp, NULL, NULL));
+  ModemHttpStats after = modemHttpGetStats();
+  TEST_ASSERT_EQUAL_UINT32(1, after.staleRecovered - before.staleRecovered);
+  TEST_ASSERT_EQUAL_UINT32(0, after.errors - before.errors);
+  TEST_ASSERT_EQUAL_UINT32(2, modem.opens);
+  TEST_ASSERT_EQUAL_size_t(2, modem.requests.size());
+}
+
+/**
+ * URC PEER CLOSED tới trong lúc rảnh: request sau không thử phiên cũ mà mở phiên mới ngay.
+ */
+static void test_peer_closed_urc_between_requests(void) {
+  ModemHttpRequest req = makeRequest("GET", "/api/ping", NULL);
+  ModemHttpResponse resp;
+  TEST_ASSERT_EQUAL_INT(200, modemHttpRequest(req, resp, NULL, NULL));
+  modem.peerClose(10);
+  hostAdvanceMs(100);
+  // Handler URC của cellular đọc dòng từ at_engine và chuyển cho modem_http
+  modemHttpOnUrc("+CHTTPSNOTIFY: PEER CLOSED");
+  uint32_t sendsBefore = modem.sends;
+  TEST_ASSERT_EQUAL_INT(200, modemHttpRequest(req, resp, NULL, NULL));
+  TEST_ASSERT_FALSE(resp.reused);
+  TEST_ASSERT_EQUAL_UINT32(2, modem.opens);
+  TEST_ASSERT_EQUAL_UINT32(sendsBefore + 1, modem.sends);  // Không có SEND hỏng trên phiên cũ
+}
+
+static void test_service_left_running_is_restarted(void) {
+  modem.serviceRunning = true;  // ESP32 khởi động lại, modem thì không
+  ModemHttpRequest req = makeRequest("GET", "/api/ping", NULL);
+  ModemHttpResponse resp;
+  TEST_ASSERT_EQUAL_INT(200, modemHttpRequest(req, resp, NULL, NULL));
+  TEST_ASSERT_EQUAL_UINT32(2, modem.starts);
+  bool sawStop = false;
+  for (size_t i = 0; i < modem.commands.size(); i++) {
+    if (modem.commands[i] == "AT+CHTTPSSTOP") sawStop = true;
+  }
+  TEST_ASSERT_TRUE(sawStop);
+}
+
+static void test_large_post_body_is_sent_in_chunks(void) {
+  std::string payload = bodyPattern(5000);
+  ModemHttpRequest req = makeRequest("POST", "/api/ingest/batch", &payload);
+  ModemHttpResponse resp;
+  TEST_ASSERT_EQUAL_INT(200, modemHttpRequest(req, resp, NULL, NULL));
+  TEST_ASSERT_EQUAL_size_t(1, modem.requests.size());
+  const std::string& sent = modem.requests[0];
+  TEST_ASSERT_TRUE(sent.size() > payload.size());
+  TEST_ASSERT_TRUE(sent.compare(sent.size() - payload.size(), payload.size(), payload) == 0);
+  uint32_t expectedSends = (uint32_t)((sent.size() + MODEM_HTTP_CHUNK - 1) / MODEM_HTTP_CHUNK);
+  TEST_ASSERT_EQUAL_UINT32(expectedSends, modem.sends);
+}
+
+static void test_head_and_204_have_no_body(void) {
+  ModemHttpRequest req = makeRequest("HEAD", "/firmware.bin", NULL);
+  ModemHttpResponse resp;
+  modem.handler = headHandler;
+  TEST_ASSERT_EQUAL_INT(200, modemHttpRequest(req, resp, NULL, NULL));
+  TEST_ASSERT_EQUAL_INT32(123456, resp.contentLength);
+  TEST_ASSERT_EQUAL_UINT32(0, resp.bodyBytes);
+
+  modem.handler = noContentHandler;
+  req = makeRequest("GET", "/api/ping", NULL);
+  TEST_ASSERT_EQUAL_INT(204, modemHttpRequest(req, resp, NULL, NULL));
+  TEST_ASSERT_TRUE(resp.reused);
+}
+
+static void test_sink_abort_closes_session(void) {
+  replyBody = bodyPattern(4000);
+  ModemHttpRequest req = makeRequest("GET", "/firmware.bin", NULL);
+  ModemHttpResponse resp;
+  TEST_ASSERT_EQUAL_INT(MODEM_HTTP_ERR_ABORTED, modemHttpRequest(req, resp, abortSink, NULL));
+  TEST_ASSERT_FALSE(modem.sessionOpen);
+}
+
+static void test_silent_server_times_out(void) {
+  modem.handler = silentHandler;
+  ModemHttpRequest req = makeRequest("GET", "/api/ping", NULL);
+  req.timeoutMs = 3000;
+  ModemHttpResponse resp;
+  uint32_t start = millis();
+  TEST_ASSERT_EQUAL_INT(MODEM_HTTP_ERR_TIMEOUT, modemHttpRequest(req, resp, NULL, NULL));
+  uint32_t elapsed = millis() - start;
+  TEST_ASSERT_GREATER_OR_EQUAL(3000, elapsed);
+  TEST_ASSERT_LESS_THAN(3000 + TLS_HANDSHAKE_MS + 1000, elapsed);
+  TEST_ASSERT_FALSE(modem.sessionOpen);
+}
+
+static void test_malformed_status_line_is_response_error(void) {
+  modem.handler = garbageHandler;
+  ModemHttpRequest req = makeRequest("GET", "/api/ping", NULL);
+  ModemHttpResponse resp;
+  TEST_ASSERT_EQUAL_INT(MODEM_HTTP_ERR_RESPONSE, modemHttpRequest(req, resp, NULL, NULL));
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_post_parses_status_and_body);
+  RUN_TEST(test_session_is_reused_across_requests);
+  RUN_TEST(test_large_content_length_body_spans_many_recv);
+  RUN_TEST(test_chunked_body_with_trailer);
+  RUN_TEST(test_http10_body_until_close);
+  RUN_TEST(test_connection_close_response_closes_session);
+  RUN_TEST(test_stale_session_is_reopened_and_request_resent);
+  RUN_TEST(test_peer_closed_urc_between_requests);
+  RUN_TEST(test_service_left_running_is_restarted);
+  RUN_TEST(test_large_post_body_is_sent_in_chunks);
+  RUN_TEST(test_head_and_204_have_no_body);
+  RUN_TEST(test_sink_abort_closes_session);
+  RUN_TEST(test_silent_server_times_out);
+  RUN_TEST(test_malformed_status_line_is_response_error);
+  return UNITY_END();
+}
@@ -0,0 +1,279 @@
+/**
+ * @file test_main.cpp
+ * @brief Test OTA tải tiếp được (ota_resume) trên phân vùng flash và NVS giả: tách Content-Range, kiểm
+ * response 206/200/416 và ảnh đổi kích thước, tải tiếp từ checkpoint sau khi rớt mạng và khởi động lại.
+ *
+ * Server giả cắt ảnh theo header Range như /api/firmware/download của backend. Cuối mỗi test so nguyên phân
+ * vùng với ảnh và kiểm không có lần ghi nào vào sector chưa xóa.
+ */
+
+#include <unity.h>
+#include <Preferences.h>
+#include <esp_ota_ops.h>
+#include "ota_resume.h"
+
+static const char* IMAGE_ID = "/api/firmware/download/1.0.3";
+static const uint32_t IMAGE_BYTES = 300000;  // Không chia hết cho chunk: có phần lẻ cuối ảnh
+static std::vector<uint8_t> image;
+
+static void makeImage(uint32_t size, uint8_t salt) {
+  image.resize(size);
+  for (uint32_t i = 0; i < size; i++) image[i] = (uint8_t)((i * 7 + (i >> 8)) ^ salt);
+}
+
+/**
+ * @brief Một response của server giả cho header Range hiện tại.
+ */
+struct FakeResponse {
+  int status;
+  char contentRange[48];
+  uint32_t start;
+  uint32_t length;
+};
+
+static FakeResponse serve(bool honourRange = true) {
+  FakeResponse r = {};
+  char range[48];
+  otaResumeRangeHeader(range, sizeof(range));
+  unsigned long first = 0, last = 0;
+  TEST_ASSERT_EQUAL_INT(2, sscanf(range, "bytes=%lu-%lu", &first, &last));
+  if (!honourRange) {
+    r.status = 200;
+    r.length = image.size();
+    return r;
+  }
+  if (first >= image.size()) {
+    r.status = 416;
+    return r;
+  }
+  if (last >= image.size()) last = image.size() - 1;
+  r.status = 206;
+  r.start = first;
+  r.length = last - first + 1;
+  snprintf(r.contentRange, sizeof(r.contentRange), "bytes %lu-%lu/%lu", first, last, (unsigned long)image.size());
+  return r;
+}
+
+/**
+ * @brief Đọc body theo từng đoạn như vòng đọc socket; `cutAfter` < length thì mất kết nối sau chừng ấy byte.
+ * @return true nếu đọc đủ body.
+ */
+static bool readBody(const FakeResponse& r, long expect, uint32_t cutAfter = UINT32_MAX) {
+  TEST_ASSERT_EQUAL_INT32((long)r.length, expect);
+  uint32_t n = r.length < cutAfter ? r.length : cutAfter;
+  for (uint32_t done = 0; done < n;) {
+    uint32_t piece = n - done < 1460 ? n - done : 1460;  // Một đoạn TCP
+    TEST_ASSERT_TRUE(otaResumeWrite(image.data() + r.start + done, piece));
+    done += piece;
+  }
+  if (n < r.length) {
+    otaResumeRewind();
+    return false;
+  }
+  otaResumeCommit();
+  return true;
+}
+
+static void downloadToEnd() {
+  while (!otaResumeDone()) {
+    FakeResponse r = serve();
+    TEST_ASSERT_EQUAL_INT(206, r.status);
+    TEST_ASSERT_TRUE(readBody(r, otaResumeAccept(r.status, r.contentRange, r.length)));
+  }
+}
+
+static void assertFlashHoldsImage() {
+  TEST_ASSERT_EQUAL_MEMORY(image.data(), hostFlashData().data(), image.size());
+  TEST_ASSERT_EQUAL_UINT32(0, hostFlashStats().dirtyWrites);
+}
+
+static uint32_t nvsCheckpoint() {
+  Preferences prefs;
+  prefs.begin(OTA_NVS_NAMESPACE, true);
+  uint32_t done = prefs.getUInt("done", 0);
+  prefs.end();
+  return done;
+}
+
+void setUp(void) {
+  hostNvsClear();
+  hostFlashReset();
+  hostOtaBootResult() = ESP_OK;
+  hostOtaBootPartition() = NULL;
+  makeImage(IMAGE_BYTES, 0);
+}
+
+void tearDown(void) {}
+
+void test_parse_content_range() {
+  uint32_t start, end, total;
+  TEST_ASSERT_TRUE(otaParseContentRange("bytes 131072-262143/300000", start, end, total));
+  TEST_ASSERT_EQUAL_UINT32(131072, start);
+  TEST_ASSERT_EQUAL_UINT32(262143, end);
+  TEST_ASSERT_EQUAL_UINT32(300000, total);
+  TEST_ASSERT_TRUE(otaParseContentRange("bytes 0-0/1", start, end, total));
+
+  TEST_ASSERT_FALSE(otaParseContentRange(NULL, start, end, total));
+  TEST_ASSERT_FALSE(otaParseContentRange("", start, end, total));
+  TEST_ASSERT_FALSE(otaParseContentRange("bytes */300000", start, end, total));       // Dạng của 416
+  TEST_ASSERT_FALSE(otaParseContentRange("items 0-9/10", start, end, total));
+  TEST_ASSERT_FALSE(otaParseContentRange("bytes 10-9/300000", start, end, total));    // end < start
+  TEST_ASSERT_FALSE(otaParseContentRange("bytes 0-300000/300000", start, end, total)); // end >= total
+  TEST_ASSERT_FALSE(otaParseContentRange("bytes 0-9/300000x", start, end, total));
+  TEST_ASSERT_FALSE(otaParseContentRange("bytes 0-9", start, end, total));
+}
+
+void test_range_download_writes_whole_image() {
+  TEST_ASSERT_TRUE(otaResumeBegin(IMAGE_ID));
+  char range[48];
+  otaResumeRangeHeader(range, sizeof(range));
+  TEST_ASSERT_EQUAL_STRING("bytes=0-131071", range);
+
+  downloadToEnd();
+  assertFlashHoldsImage();
+  OtaResumeStats st = otaResumeGetStats();
+  TEST_ASSERT_EQUAL_UINT32(IMAGE_BYTES, st.offset);
+  TEST_ASSERT_EQUAL_UINT32(IMAGE_BYTES / OTA_CHUNK_BYTES + 1, st.chunks);  // Chunk đầy + phần lẻ cuối
+
+  TEST_ASSERT_TRUE(otaResumeFinish());
+  TEST_ASSERT_TRUE(hostOtaBootPartition() == &hostOtaPartition());
+  TEST_ASSERT_EQUAL_UINT32(0, hostNvs()[OTA_NVS_NAMESPACE].size());  // Checkpoint đã xóa
+}
+
+void test_resume_from_checkpoint_after_cut_and_reboot() {
+  TEST_ASSERT_TRUE(otaResumeBegin(IMAGE_ID));
+  FakeResponse r = serve();
+  TEST_ASSERT_TRUE(readBody(r, otaResumeAccept(r.status, r.contentRange, r.length)));
+
+  // Khoảng thứ hai mất kết nối giữa chunk thứ hai: chunk đầu của khoảng đã checkpoint, phần dở bị bỏ
+  r = serve();
+  uint32_t cut = OTA_CHUNK_BYTES + 7232;
+  TEST_ASSERT_FALSE(readBody(r, otaResumeAccept(r.status, r.contentRange, r.length), cut));
+  uint32_t checkpoint = OTA_RANGE_BYTES + OTA_CHUNK_BYTES;
+  TEST_ASSERT_EQUAL_UINT32(checkpoint, nvsCheckpoint());
+  TEST_ASSERT_EQUAL_UINT32(1, otaResumeGetStats().rewinds);
+
+  // Khởi động lại: lượt tải sau của cùng ảnh bắt đầu từ checkpoint
+  TEST_ASSERT_TRUE(otaResumeBegin(IMAGE_ID));
+  OtaResumeStats st = otaResumeGetStats();
+  TEST_ASSERT_TRUE(st.pending);
+  TEST_ASSERT_EQUAL_UINT32(checkpoint, st.resumedFrom);
+  TEST_ASSERT_EQUAL_UINT32(IMAGE_BYTES, st.total);
+  char range[48];
+  otaResumeRangeHeader(range, sizeof(range));
+  TEST_ASSERT_EQUAL_STRING("bytes=163840-294911", range);
+
+  uint32_t bytesBefore = hostFlashStats().bytesWritten;
+  downloadToEnd();
+  TEST_ASSERT_EQUAL_UINT32(IMAGE_BYTES - checkpoint, hostFlashStats().bytesWritten - bytesBefore);
+  assertFlashHoldsImage();  // Sector ghi dở trước khi cắt đã được xóa lại
+  TEST_ASSERT_TRUE(otaResumeFinish());
+}
+
+void test_retry_after_cut_without_reboot() {
+  TEST_ASSERT_TRUE(otaResumeBegin(IMAGE_ID));
+  // Rớt mạng giữa sector thứ hai của chunk đầu, thử lại ngay trong cùng lượt (vòng retry WiFi/4G)
+  FakeResponse r = serve();
+  TEST_ASSERT_FALSE(readBody(r, otaResumeAccept(r.status, r.contentRange, r.length), 6000));
+  TEST_ASSERT_EQUAL_UINT32(0, otaResumeGetStats().offset);
+  downloadToEnd();
+  assertFlashHoldsImage();  // Phần dở được ghi lại từ checkpoint trong cùng lượt
+  TEST_ASSERT_TRUE(otaResumeFinish());
+}
+
+void test_server_ignoring_range_restarts_from_zero() {
+  TEST_ASSERT_TRUE(otaResumeBegin(IMAGE_ID));
+  FakeResponse r = serve();
+  TEST_ASSERT_TRUE(readBody(r, otaResumeAccept(r.status, r.contentRange, r.length)));
+  TEST_ASSERT_TRUE(otaResumeBegin(IMAGE_ID));
+  TEST_ASSERT_EQUAL_UINT32(OTA_RANGE_BYTES, otaResumeGetStats().resumedFrom);
+
+  // 200 cả file (proxy bỏ Range): ghi lại từ byte 0, vẫn checkpoint theo chunk
+  r = serve(false);
+  long expect = otaResumeAccept(r.status, NULL, r.length);
+  TEST_ASSERT_EQUAL_INT32(IMAGE_BYTES, expect);
+  TEST_ASSERT_TRUE(readBody(r, expect));
+  TEST_ASSERT_TRUE(otaResumeDone());
+  assertFlashHoldsImage();
+  TEST_ASSERT_TRUE(otaResumeFinish());
+}
+
+void test_416_clears_checkpoint() {
+  TEST_ASSERT_TRUE(otaResumeBegin(IMAGE_ID));
+  FakeResponse r = serve();
+  TEST_ASSERT_TRUE(readBody(r, otaResumeAccept(r.status, r.contentRange, r.length)));
+  TEST_ASSERT_TRUE(otaResumeGetStats().pending);
+
+  TEST_ASSERT_EQUAL_INT32(-1, otaResumeAccept(416, NULL, -1));
+  TEST_ASSERT_FALSE(otaResumeGetStats().pending);
+  TEST_ASSERT_EQUAL_UINT32(0, hostNvs()[OTA_NVS_NAMESPACE].size());
+  TEST_ASSERT_FALSE(otaResumeWrite(image.data(), 16));  // Lượt đã bỏ
+
+  TEST_ASSERT_TRUE(otaResumeBegin(IMAGE_ID));
+  TEST_ASSERT_EQUAL_UINT32(0, otaResumeGetStats().resumedFrom);
+}
+
+void test_image_size_change_restarts_from_zero() {
+  TEST_ASSERT_TRUE(otaResumeBegin(IMAGE_ID));
+  FakeResponse r = serve();
+  TEST_ASSERT_TRUE(readBody(r, otaResumeAccept(r.status, r.contentRange, r.length)));
+
+  // Cùng đường dẫn nhưng server đã thay file khác kích thước
+  makeImage(IMAGE_BYTES + 50000, 0x5A);
+  TEST_ASSERT_TRUE(otaResumeBegin(IMAGE_ID));
+  r = serve();
+  TEST_ASSERT_EQUAL_INT32(-1, otaResumeAccept(r.status, r.contentRange, r.length));
+  TEST_ASSERT_EQUAL_UINT32(0, nvsCheckpoint());
+  char range[48];
+  otaResumeRangeHeader(range, sizeof(range));
+  TEST_ASSERT_EQUAL_STRING("bytes=0-131071", range);
+
+  downloadToEnd();
+  assertFlashHoldsImage();
+  TEST_ASSERT_TRUE(otaResumeFinish());
+}
+
+void test_mismatched_content_range_is_rejected() {
+  TEST_ASSERT_TRUE(otaResumeBegin(IMAGE_ID));
+  TEST_ASSERT_EQUAL_INT32(-1, otaResumeAccept(206, "bytes 32768-163839/300000", 131072));
+  TEST_ASSERT_EQUAL_INT32(-1, otaResumeAccept(206, NULL, 131072));
+  TEST_ASSERT_EQUAL_INT32(-1, otaResumeAccept(500, NULL, -1));
+  // Body dài hơn khoảng đã nhận không được ghi quá requestEnd
+  TEST_ASSERT_EQUAL_INT32(131072, otaResumeAccept(206, "bytes 0-131071/300000", 131072));
+  std::vector<uint8_t> big(OTA_RANGE_BYTES + 1, 0xAB);
+  TEST_ASSERT_FALSE(otaResumeWrite(big.data(), big.size()));
+}
+
+void test_other_image_discards_checkpoint() {
+  TEST_ASSERT_TRUE(otaResumeBegin(IMAGE_ID));
+  FakeResponse r = serve();
+  TEST_ASSERT_TRUE(readBody(r, otaResumeAccept(r.status, r.contentRange, r.length)));
+
+  TEST_ASSERT_TRUE(otaResumeBegin("/api/firmware/download/1.0.4"));
+  TEST_ASSERT_EQUAL_UINT32(0, otaResumeGetStats().resumedFrom);
+  TEST_ASSERT_EQUAL_UINT32(0, nvsCheckpoint());
+}
+
+void test_invalid_image_is_not_booted() {
+  TEST_ASSERT_TRUE(otaResumeBegin(IMAGE_ID));
+  downloadToEnd();
+  hostOtaBootResult() = ESP_ERR_OTA_VALIDATE_FAILED;  // Header/SHA-256 sai
+  TEST_ASSERT_FALSE(otaResumeFinish());
+  TEST_ASSERT_TRUE(hostOtaBootPartition() == NULL);
+  TEST_ASSERT_FALSE(otaResumeGetStats().pending);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_parse_content_range);
+  RUN_TEST(test_range_download_writes_whole_image);
+  RUN_TEST(test_resume_from_checkpoint_after_cut_and_reboot);
+  RUN_TEST(test_retry_after_cut_without_reboot);
+  RUN_TEST(test_server_ignoring_range_restarts_from_zero);
+  RUN_TEST(test_416_clears_checkpoint);
+  RUN_TEST(test_image_size_change_restarts_from_zero);
+  RUN_TEST(test_mismatched_content_range_is_rejected);
+  RUN_TEST(test_other_image_discards_checkpoint);
+  RUN_TEST(test_invalid_image_is_not_booted);
+  return UNITY_END();
+}
@@ -0,0 +1,152 @@
+/**
+ * @file test_main.cpp
+ * @brief Test bộ mã hóa frame telemetry v2 với bộ giải mã backend (battery_backend/backend/app/codec.py).
+ *
+ * Frame mẫu GOLDEN_FRAME và URGENT_FRAME được codec.py giải mã trong battery_backend/backend/tests/test_codec.py; hai
+ * bên phải giữ cùng một dãy byte. Bản ghi mẫu phủ seq quay vòng, giá trị null, có/không age_ms (khác
+ * lần boot, uptime quay vòng) và số đầu dò thay đổi giữa các bản ghi.
+ */
+
+#include <unity.h>
+#include "telemetry_codec.h"
+
+static const uint16_t BOOT_ID = 7;
+static const uint32_t NOW_MS = 61000;
+static const uint16_t EPOCH = 0x5A3C;
+
+static const uint8_t GOLDEN_FRAME[] = {
+  0x02, 0x06, 0x70, 0x69, 0x6E, 0x2D, 0x30, 0x31, 0xBC, 0xB4, 0x01, 0x04,
+  0x80, 0x13, 0x0C, 0x03, 0x0E, 0xC0, 0xA9, 0x07, 0xCC, 0x27, 0xFF, 0xFF,
+  0x03, 0x00, 0xCB, 0xA7, 0x04, 0x57, 0xE0, 0x12, 0x88, 0x0E, 0x2A, 0x22,
+  0x37, 0x02, 0x01, 0x84, 0x01, 0xAC, 0x82, 0x04, 0x84, 0x01, 0xF6, 0xA7,
+  0x04, 0x13, 0x27, 0xD4, 0x34, 0x64, 0x02, 0x02, 0xAB, 0xA9, 0x07, 0xB7,
+  0x30, 0xD3, 0x02, 0xB7, 0x30, 0xF5, 0xA7, 0x04, 0x97, 0xF8, 0x03, 0xC8,
+  0xDC, 0x03, 0xB2, 0x2D, 0xDF, 0x0D, 0x80, 0x00, 0x00, 0x02, 0x00, 0xFC,
+  0xF8, 0x07, 0x97, 0xF8, 0x03, 0xD7, 0xFF, 0x03, 0xFD, 0x3F, 0xFE, 0x0F
+};
+
+// Cảnh báo CRITICAL gửi thẳng từ alertTask: chưa qua telemetry_log nên seq = 0 (makeTelemetryRecord)
+static const uint8_t URGENT_FRAME[] = {
+  0x02, 0x06, 0x70, 0x69, 0x6E, 0x2D, 0x30, 0x31, 0xBC, 0xB4, 0x01, 0x01,
+  0xD4, 0x32, 0x5C, 0x00, 0x0E, 0x64, 0x8C, 0x60, 0xC8, 0x06, 0x00, 0xD3,
+  0x02, 0xE8, 0x20, 0x50
+};
+
+static TelemetryRecord makeRecord(uint32_t seq, uint16_t bootId, uint32_t uptimeMs, uint8_t kind, uint8_t flags,
+                                  int16_t temp, int16_t rise, uint8_t probeCount, const int16_t* probes,
+                                  uint16_t smoke, uint16_t fire, uint8_t riskLevel, uint8_t riskScore) {
+  TelemetryRecord rec;
+  memset(&rec, 0, sizeof(rec));
+  rec.seq = seq;
+  rec.bootId = bootId;
+  rec.uptimeMs = uptimeMs;
+  rec.kind = kind;
+  rec.flags = flags;
+  rec.temperatureCenti = temp;
+  rec.tempRiseCenti = rise;
+  rec.probeCount = probeCount;
+  for (uint8_t i = 0; i < MAX_TEMP_PROBES; i++) rec.probeCenti[i] = i < probeCount ? probes[i] : TLOG_NULL_CENTI;
+  rec.smokeValue = smoke;
+  rec.fireValue10 = fire;
+  rec.riskLevel = riskLevel;
+  rec.riskScore = riskScore;
+  return rec;
+}
+
+static void buildGoldenRecords(TelemetryRecord* recs) {
+  const int16_t p0[] = {2534, TLOG_NULL_CENTI, 2490};
+  const int16_t p1[] = {2600, 2555};
+  const int16_t p2[] = {-500, TLOG_NULL_CENTI, TLOG_NULL_CENTI, 30000};
+  // seq 0xFFFFFFFE, cùng lần boot: age_ms = 60000
+  recs[0] = makeRecord(0xFFFFFFFEu, BOOT_ID, 1000, TLOG_KIND_PERIODIC, 0, 2534, TLOG_NULL_CENTI, 3, p0,
+                       1200, 900, 1, 12);
+  // Lần boot trước: không có age_ms
+  recs[1] = makeRecord(0xFFFFFFFFu, BOOT_ID - 1, 5000, TLOG_KIND_ALERT, TLOG_FLAG_SMOKE_ALERT | TLOG_FLAG_TEMP_RISE_ALERT,
+                       2600, 150, 2, p1, 1190, 880, 2, 55);
+  // seq quay vòng về 0 (backend đọc là không có seq); giá trị âm và cận trên
+  recs[2] = makeRecord(0, BOOT_ID, NOW_MS - 10, TLOG_KIND_URGENT, TLOG_FLAG_FIRE_ALERT | TLOG_FLAG_ALERT_ACTIVE,
+                       -500, -20, 4, p2, 4095, 0, 3, 100);
+  // Uptime lúc lấy mẫu lớn hơn nowMs (millis() quay vòng): age_ms = nowMs - uptimeMs theo uint32
+  recs[3] = makeRecord(1, BOOT_ID, 0xFFFFF000u, TLOG_KIND_PERIODIC, 0, TLOG_NULL_CENTI, TLOG_NULL_CENTI, 0, NULL,
+                       0, 1023, 0, 0);
+}
+
+void setUp(void) {}
+void tearDown(void) {}
+
+static void test_encoder_matches_golden_frame(void) {
+  TelemetryRecord recs[4];
+  buildGoldenRecords(recs);
+  uint8_t out[256];
+  size_t n = telemetryEncodeFrame("pin-01", recs, 4, NOW_MS, BOOT_ID, EPOCH, out, sizeof(out));
+  TEST_ASSERT_EQUAL_size_t(sizeof(GOLDEN_FRAME), n);
+  TEST_ASSERT_EQUAL_MEMORY(GOLDEN_FRAME, out, n);
+}
+
+/**
+ * Bản ghi khẩn không có seq: delta seq là 0 so với 0, backend (test_codec.py) giải mã thành null để
+ * không khử trùng hai cảnh báo khẩn khác nhau với nhau.
+ */
+static void test_urgent_record_without_seq_matches_golden_frame(void) {
+  const int16_t probes[] = {6150, 5980};
+  TelemetryRecord rec = makeRecord(0, BOOT_ID, NOW_MS - 50, TLOG_KIND_URGENT,
+                                   TLOG_FLAG_FIRE_ALERT | TLOG_FLAG_ALERT_ACTIVE, 6150, 420, 2, probes,
+                                   2100, 40, 3, 92);
+  uint8_t out[64];
+  size_t n = telemetryEncodeFrame("pin-01", &rec, 1, NOW_MS, BOOT_ID, EPOCH, out, sizeof(out));
+  TEST_ASSERT_EQUAL_size_t(sizeof(URGENT_FRAME), n);
+  TEST_ASSERT_EQUAL_MEMORY(URGENT_FRAME, out, n);
+  TEST_ASSERT_EQUAL_UINT8(0x00, out[15]);  // Header 12 byte + 3 byte cố định, rồi tới delta seq
+}
+
+static void test_short_buffer_returns_zero_at_every_size(void) {
+  TelemetryRecord recs[4];
+  buildGoldenRecords(recs);
+  uint8_t out[256];
+  for (size_t cap = 0; cap < sizeof(GOLDEN_FRAME); cap++) {
+    memset(out, 0xAA, sizeof(out));
+    TEST_ASSERT_EQUAL_size_t(0, telemetryEncodeFrame("pin-01", recs, 4, NOW_MS, BOOT_ID, EPOCH, out, cap));
+    TEST_ASSERT_EQUAL_UINT8(0xAA, out[cap]);  // Không ghi quá capacity
+  }
+}
+
+static void test_device_id_longer_than_limit_is_rejected(void) {
+  char id[TELEMETRY_FRAME_DEVICE_ID_MAX + 2];
+  memset(id, 'x', sizeof(id) - 1);
+  id[sizeof(id) - 1] = '\0';
+  TelemetryRecord rec;
+  memset(&rec, 0, sizeof(rec));
+  uint8_t out[256];
+  TEST_ASSERT_EQUAL_size_t(0, telemetryEncodeFrame(id, &rec, 1, NOW_MS, BOOT_ID, EPOCH, out, sizeof(out)));
+  id[TELEMETRY_FRAME_DEVICE_ID_MAX] = '\0';
+  TEST_ASSERT_GREATER_THAN(0, (long long)telemetryEncodeFrame(id, &rec, 1, NOW_MS, BOOT_ID, EPOCH, out, sizeof(out)));
+}
+
+/**
+ * Bản ghi xấu nhất (mọi delta đổi dấu cực đại) phải nằm trong TELEMETRY_FRAME_RECORD_MAX_BYTES mà
+ * main.cpp dùng để cấp buffer lô.
+ */
+static void test_worst_case_records_fit_size_bound(void) {
+  static TelemetryRecord recs[UPLOAD_BATCH_MAX_WIFI];
+  for (uint32_t r = 0; r < UPLOAD_BATCH_MAX_WIFI; r++) {
+    int16_t extreme = (r & 1) ? INT16_MAX : INT16_MIN;
+    int16_t probes[MAX_TEMP_PROBES];
+    for (uint8_t i = 0; i < MAX_TEMP_PROBES; i++) probes[i] = (i & 1) ? -extreme - 1 : extreme;
+    recs[r] = makeRecord((r & 1) ? 0x80000000u : 0, BOOT_ID, (r & 1) ? 0x80000000u : NOW_MS,
+                         TLOG_KIND_URGENT, 0x1F, extreme, extreme, MAX_TEMP_PROBES, probes,
+                         (r & 1) ? 0xFFFF : 0, (r & 1) ? 0xFFFF : 0, 3, 255);
+  }
+  static uint8_t out[TELEMETRY_FRAME_HEADER_MAX_BYTES + UPLOAD_BATCH_MAX_WIFI * TELEMETRY_FRAME_RECORD_MAX_BYTES];
+  size_t n = telemetryEncodeFrame("pin-01", recs, UPLOAD_BATCH_MAX_WIFI, NOW_MS, BOOT_ID, EPOCH, out, sizeof(out));
+  TEST_ASSERT_GREATER_THAN(0, (long long)n);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_encoder_matches_golden_frame);
+  RUN_TEST(test_urgent_record_without_seq_matches_golden_frame);
+  RUN_TEST(test_short_buffer_returns_zero_at_every_size);
+  RUN_TEST(test_device_id_longer_than_limit_is_rejected);
+  RUN_TEST(test_worst_case_records_fit_size_bound);
+  return UNITY_END();
+}
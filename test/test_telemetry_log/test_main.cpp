@@ -0,0 +1,225 @@
+/**
+ * @file test_main.cpp
+ * @brief Test ring log telemetry_log trên SPIFFS/NVS giả trong RAM: append và đọc theo thứ tự, xoay vòng khi
+ * log đầy, bỏ qua bản ghi sai CRC, xác nhận lô bị bỏ khi tail dời, và khôi phục sau khi khởi động lại
+ * (con trỏ trong NVS, bản ghi ghi dở lúc mất điện).
+ */
+
+#include <unity.h>
+#include <SPIFFS.h>
+#include <Preferences.h>
+#include "telemetry_log.h"
+
+static const uint32_t LOG_CAPACITY = (uint32_t)TLOG_MAX_SEGMENTS * TLOG_RECORDS_PER_SEGMENT;
+
+static TelemetryRecord makeRecord(uint16_t smoke) {
+  TelemetryRecord rec = {};
+  rec.kind = TLOG_KIND_PERIODIC;
+  rec.temperatureCenti = 2750;
+  rec.tempRiseCenti = TLOG_NULL_CENTI;
+  rec.smokeValue = smoke;
+  return rec;
+}
+
+static void appendRecords(uint32_t count) {
+  for (uint32_t i = 0; i < count; i++) {
+    TelemetryRecord rec = makeRecord((uint16_t)i);
+    TEST_ASSERT_TRUE(tlogAppend(rec));
+  }
+}
+
+/**
+ * @brief Đọc và xác nhận `count` bản ghi cũ nhất, kiểm tra seq liên tiếp từ `firstSeq`.
+ */
+static void drain(uint32_t count, uint32_t firstSeq) {
+  static TelemetryRecord batch[TLOG_RECORDS_PER_SEGMENT];
+  uint32_t expected = firstSeq;
+  while (count > 0) {
+    TelemetryLogCursor from;
+    uint32_t want = count < TLOG_RECORDS_PER_SEGMENT ? count : TLOG_RECORDS_PER_SEGMENT;
+    uint32_t n = tlogPeekBatch(batch, want, &from);
+    TEST_ASSERT_EQUAL_UINT32(want, n);
+    for (uint32_t i = 0; i < n; i++) TEST_ASSERT_EQUAL_UINT32(expected++, batch[i].seq);
+    TEST_ASSERT_TRUE(tlogAck(from, n));
+    count -= n;
+  }
+}
+
+/**
+ * @brief Giả lập khởi động lại: trạng thái trong RAM của telemetry_log được dựng lại từ SPIFFS và NVS.
+ */
+static void reboot() {
+  TEST_ASSERT_TRUE(tlogBegin());
+}
+
+static std::vector<uint8_t>& segmentFile(uint32_t seg) {
+  char path[24];
+  snprintf(path, sizeof(path), "/tlog/%08lx.seg", (unsigned long)seg);
+  TEST_ASSERT_TRUE(hostFsFiles().count(path) > 0);
+  return hostFsFiles()[path];
+}
+
+void setUp(void) {
+  hostFsClear();
+  hostNvsClear();
+  tlogBegin();
+}
+
+void tearDown(void) {}
+
+void test_append_then_drain_in_order() {
+  appendRecords(TLOG_RECORDS_PER_SEGMENT + 5);  // Vắt qua hai segment
+  TEST_ASSERT_EQUAL_UINT32(TLOG_RECORDS_PER_SEGMENT + 5, tlogDepth());
+  TEST_ASSERT_EQUAL_UINT32(2, tlogGetStats().segments);
+
+  TelemetryRecord first;
+  TEST_ASSERT_TRUE(tlogPeek(first));
+  TEST_ASSERT_EQUAL_UINT32(1, first.seq);
+  TEST_ASSERT_EQUAL_UINT16(tlogBootId(), first.bootId);
+  TEST_ASSERT_EQUAL_UINT16(0, first.smokeValue);
+
+  drain(TLOG_RECORDS_PER_SEGMENT + 5, 1);
+  TEST_ASSERT_EQUAL_UINT32(0, tlogDepth());
+  TEST_ASSERT_FALSE(tlogPeek(first));
+  TEST_ASSERT_EQUAL_UINT32(1, tlogGetStats().segments);  // Segment đã gửi hết bị xóa
+}
+
+void test_full_log_drops_oldest_segment() {
+  uint32_t droppedBefore = tlogGetStats().dropped;
+  appendRecords(LOG_CAPACITY + 1);  // Bản ghi cuối mở segment thứ TLOG_MAX_SEGMENTS + 1
+
+  TEST_ASSERT_EQUAL_UINT32(TLOG_RECORDS_PER_SEGMENT, tlogGetStats().dropped - droppedBefore);
+  TEST_ASSERT_EQUAL_UINT32(LOG_CAPACITY + 1 - TLOG_RECORDS_PER_SEGMENT, tlogDepth());
+  TEST_ASSERT_EQUAL_UINT32(TLOG_MAX_SEGMENTS, tlogGetStats().segments);
+  drain(tlogDepth(), TLOG_RECORDS_PER_SEGMENT + 1);
+}
+
+void test_corrupt_record_is_skipped_by_crc() {
+  appendRecords(4);
+  segmentFile(0)[sizeof(TelemetryRecord) + 10] ^= 0x40;  // Hỏng bản ghi seq 2
+  uint32_t crcBefore = tlogGetStats().crcErrors;
+
+  // Lô dừng trước bản ghi hỏng để số bản ghi trả về khớp tlogAck(n)
+  TelemetryRecord batch[4];
+  TelemetryLogCursor from;
+  TEST_ASSERT_EQUAL_UINT32(1, tlogPeekBatch(batch, 4, &from));
+  TEST_ASSERT_EQUAL_UINT32(1, batch[0].seq);
+  TEST_ASSERT_TRUE(tlogAck(from, 1));
+
+  // Bản ghi hỏng nằm đầu log: bị bỏ qua, không chặn phần còn lại
+  TEST_ASSERT_EQUAL_UINT32(2, tlogPeekBatch(batch, 4, &from));
+  TEST_ASSERT_EQUAL_UINT32(3, batch[0].seq);
+  TEST_ASSERT_EQUAL_UINT32(4, batch[1].seq);
+  TEST_ASSERT_EQUAL_UINT32(crcBefore + 1, tlogGetStats().crcErrors);
+  TEST_ASSERT_TRUE(tlogAck(from, 2));
+  TEST_ASSERT_EQUAL_UINT32(0, tlogDepth());
+}
+
+void test_ack_after_tail_moved_is_rejected() {
+  appendRecords(LOG_CAPACITY);
+  TelemetryRecord batch[8];
+  TelemetryLogCursor from;
+  TEST_ASSERT_EQUAL_UINT32(8, tlogPeekBatch(batch, 8, &from));
+  TEST_ASSERT_EQUAL_UINT32(1, batch[0].seq);
+
+  // Trong lúc lô đang gửi, log đầy xóa segment tail chứa chính lô đó
+  appendRecords(1);
+  uint32_t depth = tlogDepth();
+  uint32_t staleBefore = tlogGetStats().staleAcks;
+  TEST_ASSERT_FALSE(tlogAck(from, 8));
+  TEST_ASSERT_EQUAL_UINT32(staleBefore + 1, tlogGetStats().staleAcks);
+  TEST_ASSERT_EQUAL_UINT32(depth, tlogDepth());  // Không trượt qua bản ghi chưa gửi
+
+  TelemetryRecord oldest;
+  TEST_ASSERT_TRUE(tlogPeek(oldest));
+  TEST_ASSERT_EQUAL_UINT32(TLOG_RECORDS_PER_SEGMENT + 1, oldest.seq);
+}
+
+void test_reserved_seq_is_kept_on_append() {
+  uint32_t reserved = tlogReserveSeq();
+  TEST_ASSERT_EQUAL_UINT32(1, reserved);
+
+  TelemetryRecord normal = makeRecord(1);
+  TEST_ASSERT_TRUE(tlogAppend(normal));
+  TEST_ASSERT_EQUAL_UINT32(2, normal.seq);
+
+  // Bản ghi khẩn gửi lỗi vào log sau, vẫn mang seq đã cấp để backend khử trùng với lần gửi đầu
+  TelemetryRecord urgent = makeRecord(2);
+  urgent.kind = TLOG_KIND_URGENT;
+  urgent.seq = reserved;
+  TEST_ASSERT_TRUE(tlogAppend(urgent));
+  TEST_ASSERT_EQUAL_UINT32(reserved, urgent.seq);
+
+  TelemetryRecord next = makeRecord(3);
+  TEST_ASSERT_TRUE(tlogAppend(next));
+  TEST_ASSERT_EQUAL_UINT32(3, next.seq);
+}
+
+void test_reload_after_reboot_resumes_cursor_and_seq() {
+  uint16_t firstBoot = tlogBootId();
+  uint16_t epoch = tlogEpoch();
+  TEST_ASSERT_TRUE(epoch != 0);
+  appendRecords(20);
+  drain(TLOG_CURSOR_COMMIT_EVERY + 2, 1);  // Vị trí đọc ghi vào NVS tại bản ghi thứ TLOG_CURSOR_COMMIT_EVERY + 2
+
+  reboot();
+  TEST_ASSERT_EQUAL_UINT16(firstBoot + 1, tlogBootId());
+  TEST_ASSERT_EQUAL_UINT16(epoch, tlogEpoch());
+  TEST_ASSERT_EQUAL_UINT32(20 - TLOG_CURSOR_COMMIT_EVERY - 2, tlogDepth());
+
+  // Bản ghi đã gửi nhưng chưa kịp ghi vị trí đọc được gửi lại (at-least-once)
+  drain(2, TLOG_CURSOR_COMMIT_EVERY + 3);
+  reboot();
+  TEST_ASSERT_EQUAL_UINT32(20 - TLOG_CURSOR_COMMIT_EVERY - 2, tlogDepth());
+
+  TelemetryRecord rec = makeRecord(99);
+  TEST_ASSERT_TRUE(tlogAppend(rec));
+  TEST_ASSERT_EQUAL_UINT32(21, rec.seq);  // seq tiếp nối từ bản ghi cuối trong log
+  TEST_ASSERT_EQUAL_UINT16(firstBoot + 2, rec.bootId);
+}
+
+void test_torn_write_is_sealed_after_reboot() {
+  appendRecords(3);
+  std::vector<uint8_t>& head = segmentFile(0);
+  head.resize(head.size() + sizeof(TelemetryRecord) / 2, 0xA5);  // Mất điện giữa lúc ghi bản ghi thứ tư
+
+  reboot();
+  TEST_ASSERT_EQUAL_UINT32(3, tlogDepth());
+  TelemetryRecord rec = makeRecord(4);
+  TEST_ASSERT_TRUE(tlogAppend(rec));
+  TEST_ASSERT_EQUAL_UINT32(4, rec.seq);
+  TEST_ASSERT_EQUAL_UINT32(2, tlogGetStats().segments);  // Không nối sau mảnh ghi dở
+
+  drain(3, 1);
+  TelemetryRecord next;
+  TEST_ASSERT_TRUE(tlogPeek(next));
+  TEST_ASSERT_EQUAL_UINT32(4, next.seq);
+}
+
+void test_nvs_erase_picks_new_epoch() {
+  uint16_t epoch = tlogEpoch();
+  appendRecords(1);
+  hostFsClear();
+  hostNvsClear();  // Nạp lại firmware kèm xóa NVS: seq và bootId đếm lại từ đầu
+  reboot();
+  TEST_ASSERT_EQUAL_UINT16(1, tlogBootId());
+  TEST_ASSERT_TRUE(tlogEpoch() != 0);
+  TEST_ASSERT_TRUE(tlogEpoch() != epoch);
+  TelemetryRecord rec = makeRecord(1);
+  TEST_ASSERT_TRUE(tlogAppend(rec));
+  TEST_ASSERT_EQUAL_UINT32(1, rec.seq);
+  TEST_ASSERT_TRUE(tlogBootKey(rec.bootId) != (((uint32_t)epoch << 16) | 1));
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_append_then_drain_in_order);
+  RUN_TEST(test_full_log_drops_oldest_segment);
+  RUN_TEST(test_corrupt_record_is_skipped_by_crc);
+  RUN_TEST(test_ack_after_tail_moved_is_rejected);
+  RUN_TEST(test_reserved_seq_is_kept_on_append);
+  RUN_TEST(test_reload_after_reboot_resumes_cursor_and_seq);
+  RUN_TEST(test_torn_write_is_sealed_after_reboot);
+  RUN_TEST(test_nvs_erase_picks_new_epoch);
+  return UNITY_END();
+}
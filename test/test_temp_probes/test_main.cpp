@@ -0,0 +1,149 @@
+/**
+ * @file test_main.cpp
+ * @brief Test temp_probes trên bus 1-Wire giả có độ trễ: caller không còn bị chặn ~750 ms, thời gian
+ * đọc tăng tuyến tính theo số đầu dò, và thứ tự đầu dò giữ ổn định qua NVS.
+ */
+
+#include <unity.h>
+#include <Preferences.h>
+#include "temp_probes.h"
+
+// Một lượt Match ROM + Read Scratchpad trên bus giả
+static const uint64_t READ_ONE_PROBE_US = HOST_ONEWIRE_RESET_US + (8 + 64 + 8 + 72) * HOST_ONEWIRE_BIT_US;
+
+void setUp(void) {
+  hostClockUs() = 0;
+  hostNvsClear();
+  hostOneWireClear();
+  tempProbesResetConversion();
+}
+
+void tearDown(void) {}
+
+static void addProbes(uint8_t n) {
+  for (uint8_t i = 0; i < n; i++) hostOneWireAddProbe(0x1000 + i, 25.0f + i);
+}
+
+static void test_start_conversion_returns_without_waiting(void) {
+  addProbes(4);
+  TEST_ASSERT_EQUAL_UINT8(4, tempProbesBegin());
+
+  uint64_t t0 = hostClockUs();
+  uint32_t waitMs = tempProbesStartConversion();
+  uint64_t blockedUs = hostClockUs() - t0;
+
+  TEST_ASSERT_EQUAL_UINT32(750, waitMs);
+  TEST_ASSERT_LESS_THAN(3000, (long long)blockedUs);  // Chỉ một lệnh Skip ROM + Convert T
+  TEST_ASSERT_EQUAL_UINT32(1, hostOneWireStats().convertCommands);
+  TEST_ASSERT_TRUE(tempProbesConversionPending());
+}
+
+static void test_collect_before_conversion_done_touches_no_bus(void) {
+  addProbes(3);
+  tempProbesBegin();
+  tempProbesStartConversion();
+
+  float temps[MAX_TEMP_PROBES];
+  hostAdvanceMs(700);
+  uint64_t t0 = hostClockUs();
+  TEST_ASSERT_FALSE(tempProbesCollect(temps));
+  TEST_ASSERT_EQUAL_UINT32(0, hostOneWireStats().scratchpadReads);
+  TEST_ASSERT_EQUAL_UINT32(t0, hostClockUs());
+
+  hostAdvanceMs(50);
+  TEST_ASSERT_TRUE(tempProbesCollect(temps));
+  TEST_ASSERT_FALSE(tempProbesConversionPending());
+  TEST_ASSERT_FLOAT_WITHIN(0.07f, 25.0f, temps[0]);
+  TEST_ASSERT_FLOAT_WITHIN(0.07f, 27.0f, temps[2]);
+  TEST_ASSERT_FLOAT_IS_NAN(temps[3]);
+}
+
+/**
+ * So với cách đọc chặn cũ (requestTemperatures() chờ chuyển đổi rồi getTempCByIndex() search lại bus
+ * cho từng đầu dò): thời gian chiếm caller mỗi lượt cho 1..MAX_TEMP_PROBES đầu dò.
+ */
+static void test_read_latency_scales_linearly_vs_blocking_reads(void) {
+  OneWire legacyBus(TEMP_SENSOR_PIN);
+  DallasTemperature legacy(&legacyBus);
+  for (uint8_t n = 1; n <= MAX_TEMP_PROBES; n++) {
+    setUp();
+    addProbes(n);
+    tempProbesBegin();
+
+    uint64_t t0 = hostClockUs();
+    tempProbesStartConversion();
+    uint64_t startUs = hostClockUs() - t0;
+    hostAdvanceMs(750);
+    float temps[MAX_TEMP_PROBES];
+    t0 = hostClockUs();
+    TEST_ASSERT_TRUE(tempProbesCollect(temps));
+    uint64_t collectUs = hostClockUs() - t0;
+    TEST_ASSERT_EQUAL_UINT32(n * READ_ONE_PROBE_US, collectUs);
+
+    legacy.setWaitForConversion(true);
+    t0 = hostClockUs();
+    legacy.requestTemperatures();
+    for (uint8_t i = 0; i < n; i++) legacy.getTempCByIndex(i);
+    uint64_t legacyUs = hostClockUs() - t0;
+
+    char msg[120];
+    snprintf(msg, sizeof msg, "[BENCH] %u đầu dò: chặn caller %.1f ms (start %.1f + collect %.1f), cách cũ %.1f ms",
+             n, (startUs + collectUs) / 1000.0, startUs / 1000.0, collectUs / 1000.0, legacyUs / 1000.0);
+    TEST_MESSAGE(msg);
+    TEST_ASSERT_LESS_THAN((long long)legacyUs / 5, (long long)(startUs + collectUs));
+  }
+}
+
+static void test_probe_order_survives_reboot_and_missing_probe(void) {
+  hostOneWireAddProbe(0xA, 20.0f);
+  hostOneWireAddProbe(0xB, 21.0f);
+  hostOneWireAddProbe(0xC, 22.0f);
+  TEST_ASSERT_EQUAL_UINT8(3, tempProbesBegin());
+  char romA[17], romC[17];
+  tempProbesRomString(0, romA, sizeof(romA));
+  tempProbesRomString(2, romC, sizeof(romC));
+
+  // Khởi động lại: B mất, thêm D, bus liệt kê theo thứ tự khác
+  hostOneWireClear();
+  hostOneWireAddProbe(0xD, 23.0f);
+  hostOneWireAddProbe(0xC, 22.0f);
+  hostOneWireAddProbe(0xA, 20.0f);
+  TEST_ASSERT_EQUAL_UINT8(4, tempProbesBegin());
+
+  char rom[17];
+  tempProbesRomString(0, rom, sizeof(rom));
+  TEST_ASSERT_EQUAL_STRING(romA, rom);
+  tempProbesRomString(2, rom, sizeof(rom));
+  TEST_ASSERT_EQUAL_STRING(romC, rom);
+
+  tempProbesStartConversion();
+  hostAdvanceMs(750);
+  float temps[MAX_TEMP_PROBES];
+  TEST_ASSERT_TRUE(tempProbesCollect(temps));
+  TEST_ASSERT_FLOAT_WITHIN(0.07f, 20.0f, temps[0]);
+  TEST_ASSERT_FLOAT_IS_NAN(temps[1]);                 // B giữ chỗ, báo NAN
+  TEST_ASSERT_FLOAT_WITHIN(0.07f, 22.0f, temps[2]);
+  TEST_ASSERT_FLOAT_WITHIN(0.07f, 23.0f, temps[3]);   // D thêm vào cuối
+}
+
+static void test_resolution_shortens_conversion_wait(void) {
+  addProbes(2);
+  tempProbesBegin();
+  TEST_ASSERT_TRUE(tempProbesSetResolution(0, 9));
+  TEST_ASSERT_EQUAL_UINT32(750, tempProbesStartConversion());  // Đầu dò 1 vẫn 12 bit
+  tempProbesResetConversion();
+  TEST_ASSERT_TRUE(tempProbesSetResolution(1, 9));
+  TEST_ASSERT_EQUAL_UINT32(94, tempProbesStartConversion());
+  TEST_ASSERT_FALSE(tempProbesSetResolution(0, 13));
+  TEST_ASSERT_FALSE(tempProbesSetResolution(5, 10));
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_start_conversion_returns_without_waiting);
+  RUN_TEST(test_collect_before_conversion_done_touches_no_bus);
+  RUN_TEST(test_read_latency_scales_linearly_vs_blocking_reads);
+  RUN_TEST(test_probe_order_survives_reboot_and_missing_probe);
+  RUN_TEST(test_resolution_shortens_conversion_wait);
+  return UNITY_END();
+}
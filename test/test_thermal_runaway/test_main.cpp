@@ -0,0 +1,211 @@
+/**
+ * @file test_main.cpp
+ * @brief Phát lại đường cong nhiệt qua SlopeEstimator và kênh TEMP_RISE của alert_fsm (bộ phát hiện
+ * thermal runaway): độ chính xác của tổng chạy, sạc bình thường không báo, runaway được báo sớm hơn
+ * ngưỡng nhiệt tuyệt đối bao lâu.
+ */
+
+#include <unity.h>
+#include <math.h>
+#include "thermal_runaway.h"
+#include "alert_fsm.h"
+
+static uint32_t rngState = 1;
+
+// Nhiễu đều trong [-amp, amp]
+static float noise(float amp) {
+  rngState = rngState * 1664525u + 1013904223u;
+  return amp * (2.0f * (float)(rngState >> 8) / 16777215.0f - 1.0f);
+}
+
+// DS18B20 12-bit: bước 0.0625 °C
+static float quantize(float c) {
+  return floorf(c / 0.0625f) * 0.0625f;
+}
+
+static uint32_t nowMs = 0;
+
+/**
+ * @brief Cho alert_fsm chạy không có dữ liệu đủ lâu để mọi kênh về OFF và ra khỏi cửa sổ gộp.
+ */
+static void settleFsm() {
+  float values[ALERT_CH_COUNT];
+  float thresholds[ALERT_CH_COUNT];
+  for (int i = 0; i < ALERT_CH_COUNT; i++) {
+    values[i] = NAN;
+    thresholds[i] = 0.0f;
+  }
+  for (int i = 0; i < 200; i++) {
+    nowMs += 1000;
+    alertFsmEvaluate(values, thresholds, nowMs);
+  }
+  nowMs += ALERT_COALESCE_MS;
+}
+
+void setUp(void) {
+  rngState = 2024;
+  settleFsm();
+}
+
+void tearDown(void) {}
+
+struct ReplayResult {
+  uint32_t raises;           // Số lần kênh TEMP_RISE bật thành sự kiện mới
+  float firstRaiseMin;       // Phút (từ đầu phát lại) lần bật đầu tiên, NAN nếu không bật
+  float tempAtRaise;         // Nhiệt độ đầu dò lúc đó
+  float firstOverTempMin;    // Phút đầu dò vượt TEMP_THRESHOLD, NAN nếu không vượt
+  float maxRate;             // °C/phút lớn nhất ước lượng được
+};
+
+/**
+ * @brief Lấy mẫu `curve` mỗi TEMP_CHANNEL_PERIOD_MS như kênh ds18b20, đẩy qua SlopeEstimator rồi
+ * alertFsmEvaluate() với ngưỡng TEMP_RISE_LIMIT_C_PER_MIN như checkAlerts().
+ */
+template <typename Curve>
+static ReplayResult replay(Curve curve, float minutes, float noiseAmp) {
+  SlopeEstimator<TEMP_RISE_WINDOW_SAMPLES> slope;
+  ReplayResult res = { 0, NAN, NAN, NAN, -1000.0f };
+  uint32_t startMs = nowMs;
+  uint32_t steps = (uint32_t)(minutes * 60000.0f / TEMP_CHANNEL_PERIOD_MS);
+  for (uint32_t k = 0; k < steps; k++) {
+    float tMin = k * TEMP_CHANNEL_PERIOD_MS / 60000.0f;
+    float raw = curve(tMin);
+    float sample = isnan(raw) ? NAN : quantize(raw + noise(noiseAmp));
+    slope.push(sample);
+
+    float values[ALERT_CH_COUNT];
+    float thresholds[ALERT_CH_COUNT];
+    for (int i = 0; i < ALERT_CH_COUNT; i++) {
+      values[i] = NAN;
+      thresholds[i] = 0.0f;
+    }
+    values[ALERT_CH_TEMP_RISE] = slope.ready() ? slope.ratePerMinute(TEMP_CHANNEL_PERIOD_MS) : NAN;
+    thresholds[ALERT_CH_TEMP_RISE] = TEMP_RISE_LIMIT_C_PER_MIN;
+    if (!isnan(values[ALERT_CH_TEMP_RISE]) && values[ALERT_CH_TEMP_RISE] > res.maxRate) {
+      res.maxRate = values[ALERT_CH_TEMP_RISE];
+    }
+
+    nowMs = startMs + k * TEMP_CHANNEL_PERIOD_MS;
+    AlertFsmResult fsm = alertFsmEvaluate(values, thresholds, nowMs);
+    if (fsm.raisedMask & ALERT_REASON_TEMP_RISE) {
+      if (res.raises == 0) {
+        res.firstRaiseMin = tMin;
+        res.tempAtRaise = sample;
+      }
+      res.raises++;
+    }
+    if (isnan(res.firstOverTempMin) && sample > TEMP_THRESHOLD) res.firstOverTempMin = tMin;
+  }
+  return res;
+}
+
+// ---- SlopeEstimator ----
+
+static void test_slope_matches_ideal_ramp(void) {
+  SlopeEstimator<TEMP_RISE_WINDOW_SAMPLES> slope;
+  for (int k = 0; k < TEMP_RISE_WINDOW_SAMPLES - 1; k++) {
+    slope.push(30.0f + 0.05f * k);
+    TEST_ASSERT_FALSE(slope.ready());
+    TEST_ASSERT_EQUAL_FLOAT(0.0f, slope.ratePerMinute(TEMP_CHANNEL_PERIOD_MS));
+  }
+  slope.push(30.0f + 0.05f * (TEMP_RISE_WINDOW_SAMPLES - 1));
+  TEST_ASSERT_TRUE(slope.ready());
+  // 0.05 °C mỗi mẫu 2 s = 1.5 °C/phút
+  TEST_ASSERT_FLOAT_WITHIN(0.001f, 1.5f, slope.ratePerMinute(TEMP_CHANNEL_PERIOD_MS));
+}
+
+/**
+ * Tổng chạy O(1) phải khớp hồi quy tính lại từ đầu trên cửa sổ sau rất nhiều mẫu (không trôi).
+ */
+static void test_running_sums_match_full_regression_after_long_run(void) {
+  const size_t N = TEMP_RISE_WINDOW_SAMPLES;
+  SlopeEstimator<N> slope;
+  int32_t window[N];
+  for (uint32_t k = 0; k < 500000; k++) {
+    float c = quantize(40.0f + 20.0f * sinf(k * 0.001f) + noise(0.3f));
+    slope.push(c);
+    window[k % N] = (int32_t)lroundf(c * 100.0f);
+    if (k + 1 < N || k % 9973 != 0) continue;
+
+    double sumK = 0, sumY = 0, sumKY = 0, sumKK = 0;
+    for (size_t i = 0; i < N; i++) {
+      double y = window[(k + 1 + i) % N];
+      sumK += i;
+      sumY += y;
+      sumKY += i * y;
+      sumKK += (double)i * i;
+    }
+    double centiPerSample = (N * sumKY - sumK * sumY) / (N * sumKK - sumK * sumK);
+    float expected = (float)(centiPerSample / 100.0 * 60000.0 / TEMP_CHANNEL_PERIOD_MS);
+    TEST_ASSERT_FLOAT_WITHIN(1e-4f, expected, slope.ratePerMinute(TEMP_CHANNEL_PERIOD_MS));
+  }
+}
+
+static void test_nan_sample_restarts_window(void) {
+  SlopeEstimator<TEMP_RISE_WINDOW_SAMPLES> slope;
+  for (int k = 0; k < TEMP_RISE_WINDOW_SAMPLES; k++) slope.push(30.0f);
+  TEST_ASSERT_TRUE(slope.ready());
+  slope.push(NAN);
+  TEST_ASSERT_FALSE(slope.ready());
+}
+
+// ---- Phát lại đường cong qua bộ phát hiện ----
+
+// Sạc bình thường: 25 → 45 °C trong 60 phút, nhiễu ±0.15 °C
+static float normalCharge(float tMin) {
+  return 25.0f + 20.0f * tMin / 60.0f;
+}
+
+static void test_normal_charge_never_alerts(void) {
+  ReplayResult r = replay(normalCharge, 60.0f, 0.15f);
+  char msg[120];
+  snprintf(msg, sizeof msg, "[REPLAY] sạc bình thường: dT/dt lớn nhất %.2f °C/phút, %u cảnh báo", r.maxRate, r.raises);
+  TEST_MESSAGE(msg);
+  TEST_ASSERT_EQUAL_UINT32(0, r.raises);
+  TEST_ASSERT_LESS_THAN(TEMP_RISE_LIMIT_C_PER_MIN / 2, r.maxRate);
+}
+
+/**
+ * Runaway: tăng 0.3 °C/phút tới phút 20, sau đó nhiệt tăng theo hàm mũ (tự gia nhiệt) với tốc độ
+ * ban đầu 0.3 °C/phút, nhân e mỗi 4 phút.
+ */
+static float runaway(float tMin) {
+  if (tMin < 20.0f) return 35.0f + 0.3f * tMin;
+  return 41.0f + 1.2f * (expf((tMin - 20.0f) / 4.0f) - 1.0f);
+}
+
+static void test_runaway_alerts_before_absolute_threshold(void) {
+  ReplayResult r = replay(runaway, 40.0f, 0.15f);
+  char msg[160];
+  snprintf(msg, sizeof msg, "[REPLAY] runaway: TEMP_RISE bật ở phút %.1f (%.1f °C), vượt %.0f °C ở phút %.1f: sớm hơn %.1f phút",
+           r.firstRaiseMin, r.tempAtRaise, TEMP_THRESHOLD, r.firstOverTempMin, r.firstOverTempMin - r.firstRaiseMin);
+  TEST_MESSAGE(msg);
+  TEST_ASSERT_EQUAL_UINT32(1, r.raises);                   // Một sự kiện, không chập chờn
+  TEST_ASSERT_FALSE(isnan(r.firstRaiseMin));
+  TEST_ASSERT_FALSE(isnan(r.firstOverTempMin));
+  TEST_ASSERT_GREATER_THAN(20.0f, r.firstRaiseMin);        // Không báo trong pha tăng chậm
+  TEST_ASSERT_GREATER_THAN(5.0f, r.firstOverTempMin - r.firstRaiseMin);
+  TEST_ASSERT_LESS_THAN(60.0f, r.tempAtRaise);
+}
+
+// Đầu dò rớt kết nối 10 giây giữa lúc sạc: khoảng trống không được biến thành bước nhảy giả
+static float chargeWithDropout(float tMin) {
+  if (tMin >= 30.0f && tMin < 30.0f + 10.0f / 60.0f) return NAN;
+  return normalCharge(tMin);
+}
+
+static void test_probe_dropout_does_not_alert(void) {
+  ReplayResult r = replay(chargeWithDropout, 60.0f, 0.15f);
+  TEST_ASSERT_EQUAL_UINT32(0, r.raises);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_slope_matches_ideal_ramp);
+  RUN_TEST(test_running_sums_match_full_regression_after_long_run);
+  RUN_TEST(test_nan_sample_restarts_window);
+  RUN_TEST(test_normal_charge_never_alerts);
+  RUN_TEST(test_runaway_alerts_before_absolute_threshold);
+  RUN_TEST(test_probe_dropout_does_not_alert);
+  return UNITY_END();
+}
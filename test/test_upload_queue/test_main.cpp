@@ -0,0 +1,123 @@
+/**
+ * @file test_main.cpp
+ * @brief Test đường ống upload hai mức với telemetry_log trên SPIFFS giả: bản ghi định kỳ bị bỏ khi queue
+ * NORMAL đầy, còn bản ghi cảnh báo (WARNING, khẩn tràn queue URGENT, khẩn gửi lỗi) ghi thẳng xuống log.
+ */
+
+#include <unity.h>
+#include <SPIFFS.h>
+#include <Preferences.h>
+#include "upload_queue.h"
+
+static TelemetryRecord makeRecord(TelemetryKind kind) {
+  TelemetryRecord rec = {};
+  rec.kind = kind;
+  rec.temperatureCenti = 6500;
+  rec.tempRiseCenti = TLOG_NULL_CENTI;
+  return rec;
+}
+
+static void fillNormalQueue() {
+  for (int i = 0; i < UPLOAD_NORMAL_QUEUE_DEPTH; i++) {
+    TEST_ASSERT_TRUE(uploadQueuePostNormal(makeRecord(TLOG_KIND_PERIODIC), false));
+  }
+}
+
+static TelemetryKind newestLoggedKind() {
+  static TelemetryRecord batch[UPLOAD_NORMAL_QUEUE_DEPTH + UPLOAD_URGENT_QUEUE_DEPTH + 4];
+  TelemetryLogCursor from;
+  uint32_t n = tlogPeekBatch(batch, sizeof(batch) / sizeof(batch[0]), &from);
+  TEST_ASSERT_GREATER_THAN(0, (long long)n);
+  return (TelemetryKind)batch[n - 1].kind;
+}
+
+void setUp(void) {
+  tlogBegin();
+  uploadQueueBegin();
+  // Queue là trạng thái toàn cục: rút sạch phần test trước để lại rồi bắt đầu với log rỗng
+  UploadMessage msg;
+  while (uploadQueueTakeUrgent(msg)) {}
+  uploadQueueMoveToLog();
+  uploadQueueFlushStarted();
+  hostFsClear();
+  hostNvsClear();
+  tlogBegin();
+}
+
+void tearDown(void) {}
+
+void test_periodic_record_is_dropped_when_queue_full() {
+  fillNormalQueue();
+  UploadQueueStats before = uploadQueueGetStats();
+  TEST_ASSERT_FALSE(uploadQueuePostNormal(makeRecord(TLOG_KIND_PERIODIC), false));
+  TEST_ASSERT_EQUAL_UINT32(before.normalDropped + 1, uploadQueueGetStats().normalDropped);
+  TEST_ASSERT_EQUAL_UINT32(0, tlogDepth());
+}
+
+void test_alert_goes_to_log_when_queue_full() {
+  fillNormalQueue();
+  UploadQueueStats before = uploadQueueGetStats();
+  TEST_ASSERT_TRUE(uploadQueuePostAlert(makeRecord(TLOG_KIND_ALERT)));
+
+  UploadQueueStats after = uploadQueueGetStats();
+  TEST_ASSERT_EQUAL_UINT32(before.alertDirect + 1, after.alertDirect);
+  TEST_ASSERT_EQUAL_UINT32(before.normalDropped, after.normalDropped);
+  TEST_ASSERT_EQUAL_UINT32(before.alertLost, after.alertLost);
+  TEST_ASSERT_EQUAL_UINT32(1, tlogDepth());
+  TEST_ASSERT_TRUE(uploadQueueFlushPending());
+
+  // Bản ghi định kỳ trong RAM vẫn xuống log sau cảnh báo
+  TEST_ASSERT_EQUAL_UINT32(UPLOAD_NORMAL_QUEUE_DEPTH, uploadQueueMoveToLog());
+  TEST_ASSERT_EQUAL_UINT32(UPLOAD_NORMAL_QUEUE_DEPTH + 1, tlogDepth());
+}
+
+void test_alert_uses_ram_queue_when_room() {
+  UploadQueueStats before = uploadQueueGetStats();
+  TEST_ASSERT_TRUE(uploadQueuePostAlert(makeRecord(TLOG_KIND_ALERT)));
+  TEST_ASSERT_EQUAL_UINT32(before.alertDirect, uploadQueueGetStats().alertDirect);
+  TEST_ASSERT_EQUAL_UINT32(0, tlogDepth());  // Không chạm SPIFFS trên đường cảm biến
+  TEST_ASSERT_TRUE(uploadQueueFlushPending());
+  TEST_ASSERT_EQUAL_UINT32(1, uploadQueueMoveToLog());
+  TEST_ASSERT_EQUAL_UINT32(TLOG_KIND_ALERT, newestLoggedKind());
+}
+
+void test_urgent_spill_survives_full_normal_queue() {
+  for (int i = 0; i < UPLOAD_URGENT_QUEUE_DEPTH; i++) {
+    TEST_ASSERT_TRUE(uploadQueuePostUrgent(makeRecord(TLOG_KIND_URGENT)));
+  }
+  fillNormalQueue();
+  UploadQueueStats before = uploadQueueGetStats();
+  TEST_ASSERT_TRUE(uploadQueuePostUrgent(makeRecord(TLOG_KIND_URGENT)));
+
+  UploadQueueStats after = uploadQueueGetStats();
+  TEST_ASSERT_EQUAL_UINT32(before.urgentSpilled + 1, after.urgentSpilled);
+  TEST_ASSERT_EQUAL_UINT32(before.alertDirect + 1, after.alertDirect);
+  TEST_ASSERT_EQUAL_UINT32(UPLOAD_URGENT_QUEUE_DEPTH, after.urgentDepth);  // Bản ghi khẩn đang chờ không bị ghi đè
+  TEST_ASSERT_EQUAL_UINT32(1, tlogDepth());
+  TEST_ASSERT_EQUAL_UINT32(TLOG_KIND_URGENT, newestLoggedKind());
+}
+
+void test_failed_urgent_send_is_saved_with_its_seq() {
+  UploadMessage msg;
+  TEST_ASSERT_TRUE(uploadQueuePostUrgent(makeRecord(TLOG_KIND_URGENT)));
+  TEST_ASSERT_TRUE(uploadQueueTakeUrgent(msg));
+  msg.rec.seq = tlogReserveSeq();  // Như alertTask trước lần gửi đầu
+  fillNormalQueue();               // Queue RAM đầy không ảnh hưởng đường này
+
+  TEST_ASSERT_TRUE(uploadQueueSaveUrgent(msg.rec));
+  TelemetryRecord logged;
+  TEST_ASSERT_TRUE(tlogPeek(logged));
+  TEST_ASSERT_EQUAL_UINT32(msg.rec.seq, logged.seq);
+  TEST_ASSERT_EQUAL_UINT8(TLOG_KIND_URGENT, logged.kind);
+  TEST_ASSERT_TRUE(uploadQueueFlushPending());
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_periodic_record_is_dropped_when_queue_full);
+  RUN_TEST(test_alert_goes_to_log_when_queue_full);
+  RUN_TEST(test_alert_uses_ram_queue_when_room);
+  RUN_TEST(test_urgent_spill_survives_full_normal_queue);
+  RUN_TEST(test_failed_urgent_send_is_saved_with_its_seq);
+  return UNITY_END();
+}